@@ -87,9 +87,10 @@ struct global_data_s
     void    *deconnexion_requester; /**< connexion ZeroMQ port                     */
 #endif // CHECK_SIMU_DECONNECTION
     void   **sobol_requester;       /**< data ZeroMQ Sobol port                    */
-    int      rinit_tab[5];          /**< array used to receive data                */
+    int      rinit_tab[7];          /**< array used to receive data                */
     int      sobol;                 /**< 1 if sobol computation, 0 otherwhise      */
     int      learning;              /**< 1 if learning, 0 otherwhise               */
+    melissa_wire_t wire;            /**< format and codec of the sent vectors      */
     MPI_Comm comm;                  /**< simulation mpi communicator               */
     int      rank;                  /**< mpi rank in comm                          */
     int      comm_size;             /**< mpi comm size                             */
@@ -579,10 +580,13 @@ static void melissa_init_internal (const char *field_name,
             print_zmq_error(ret);
         }
         buf_ptr = zmq_msg_data (&msg);
-        // we copy the first 5 int of the response data in the rinit tab. We will need it to init the persistent data structures.
-        memcpy(global_data.rinit_tab, buf_ptr, 5 * sizeof(int));
-        // The pointer is set to point after the 5 first int. We will comme to it later. That is why we do not close the message yet.
-        buf_ptr += 5 * sizeof(int);
+        // we copy the first 7 int of the response data in the rinit tab. We will need it to init the persistent data structures.
+        memcpy(global_data.rinit_tab, buf_ptr, 7 * sizeof(int));
+        buf_ptr += 7 * sizeof(int);
+        // then the error bound of the quantize codec
+        memcpy(&global_data.wire.tolerance, buf_ptr, sizeof(double));
+        // The pointer is set to point after the 7 first int and the double. We will comme to it later. That is why we do not close the message yet.
+        buf_ptr += sizeof(double);
     } // endif (rank == 0 && first_init != 0)
 
     // init data structure
@@ -628,8 +632,9 @@ static void melissa_init_internal (const char *field_name,
         // bcast server infos from 0 to all
         if (first_init != 0)
         {
-            MPI_Bcast(global_data.rinit_tab, 5, MPI_INT, 0, comm);
-            // we will see later the usage of the values in this 5 ints
+            MPI_Bcast(global_data.rinit_tab, 7, MPI_INT, 0, comm);
+            MPI_Bcast(&global_data.wire.tolerance, 1, MPI_DOUBLE, 0, comm);
+            // we will see later the usage of the values in this 7 ints
         }
         i = local_vect_size;
         // we use a allgather to gather all the local_vect_sizes (notice the "s" at the end)
@@ -652,11 +657,13 @@ static void melissa_init_internal (const char *field_name,
     {
         port_names = NULL;
         global_data.rank = rank;
-        // this is where we use the 5 int sent by the server to the API.
+        // this is where we use the 7 int sent by the server to the API.
         global_data.nb_proc_server = global_data.rinit_tab[0]; // the first one is the size of the server.
         global_data.sobol = global_data.rinit_tab[1]; // second one is 1 if we compute Sobol' indices, 0 otherwise.
         global_data.learning = global_data.rinit_tab[2]; // third one is a flag for learning. this one affects the data redistribution in melissa_send (not implemented yet).
         global_data.nb_parameters = global_data.rinit_tab[3]; // the number of varying parameters of the simulations
+        // the fifth one is the verbosity, the sixth and seventh ones are the format (double, float or bfloat16) and the compression of the vectors on the wire.
+        melissa_wire_init (&global_data.wire, global_data.rinit_tab[5], global_data.rinit_tab[6], global_data.wire.tolerance);
         // In the case of Sobol' indices computation, a special communication patern must be set between the members of one Sobol' group.
         if (global_data.sobol == 1)
         {
@@ -1359,9 +1366,9 @@ void melissa_send (const char   *field_name,
                                                       global_data.nb_parameters + 2,
                                                       field_name,
                                                       global_data.data_ptr,
+                                                      &global_data.wire,
                                                       field_data_ptr->data_pusher[j],
                                                       0);
-                        buff_size = 4 * sizeof(int) + MAX_FIELD_NAME + (global_data.nb_parameters + 2) * field_data_ptr->send_counts[field_data_ptr->pull_rank[i]] * sizeof(double);
                     }
                     else
                     {
@@ -1372,10 +1379,12 @@ void melissa_send (const char   *field_name,
                                                       1,
                                                       field_name,
                                                       global_data.data_ptr,
+                                                      &global_data.wire,
                                                       field_data_ptr->data_pusher[j],
                                                       0);
-                        buff_size = 4 * sizeof(int) + MAX_FIELD_NAME + field_data_ptr->send_counts[field_data_ptr->pull_rank[i]] * sizeof(double);
                     }
+                    // the size of a compressed message is only known once built
+                    buff_size = (ret > 0) ? ret : 0;
                     melissa_print(VERBOSE_DEBUG, "Message of size %d byte sent (proc %d)\n", buff_size, field_data_ptr->push_rank[i]);
                     if (ret == -1)
                     {
@@ -1406,13 +1415,14 @@ void melissa_send (const char   *field_name,
                                                   1,
                                                   field_name,
                                                   global_data.data_ptr,
+                                                  &global_data.wire,
                                                   field_data_ptr->data_pusher[i],
                                                   0);
                     buff_size = 4 * sizeof(int) + MAX_FIELD_NAME * sizeof(char);
                 }
                 else
                 {
-                    buff_size = 4 * sizeof(int) + MAX_FIELD_NAME * sizeof(char) + local_vect_size * sizeof(double);
+                    buff_size = 4 * sizeof(int) + MAX_FIELD_NAME * sizeof(char) + local_vect_size * melissa_wire_size (global_data.wire.format);
                     if (global_data.sobol == 1)
                     {
                         for (k=1; k<global_data.nb_parameters + 2; k++)
@@ -1426,9 +1436,10 @@ void melissa_send (const char   *field_name,
                                                       global_data.nb_parameters + 2,
                                                       field_name,
                                                       global_data.data_ptr,
+                                                      &global_data.wire,
                                                       field_data_ptr->data_pusher[j],
                                                       0);
-                        buff_size += local_vect_size * (global_data.nb_parameters + 1) * sizeof(double);
+                        buff_size += local_vect_size * (global_data.nb_parameters + 1) * melissa_wire_size (global_data.wire.format);
                     }
                     else if (global_data.learning == 0) // should not exist, we already are in a condition where learning >= 2
                     {
@@ -1439,6 +1450,7 @@ void melissa_send (const char   *field_name,
                                                       1,
                                                       field_name,
                                                       global_data.data_ptr,
+                                                      &global_data.wire,
                                                       field_data_ptr->data_pusher[j],
                                                       0);
                     }
@@ -1452,6 +1464,7 @@ void melissa_send (const char   *field_name,
                                                       1,
                                                       field_name,
                                                       global_data.data_ptr,
+                                                      &global_data.wire,
                                                       field_data_ptr->data_pusher[i],
                                                       0);
                     }
@@ -1624,4 +1637,10 @@ void melissa_finalize (void)
     melissa_print(VERBOSE_INFO, " --- Simulation comm time: %g s\n",total_comm_time);
 #endif
     melissa_print(VERBOSE_INFO, " --- Bytes sent: %ld bytes\n",total_bytes_sent);
+    if (global_data.wire.codec != MELISSA_WIRE_NO_CODEC && global_data.wire.packed_bytes > 0)
+    {
+        melissa_print(VERBOSE_INFO, " --- Wire compression time: %g s\n",global_data.wire.codec_time);
+        melissa_print(VERBOSE_INFO, " --- Wire compression ratio: %g\n",(double)global_data.wire.raw_bytes / global_data.wire.packed_bytes);
+    }
+    melissa_wire_free (&global_data.wire);
 }
@@ -0,0 +1,510 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file bitmap.c
+ * @brief Growable 2-D array of bits (rows x columns).
+ * @author Terraz Théophile
+ * @date 2019-03-04
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "melissa_utils.h"
+
+#define BITMAP_EMPTY_ROW 0 /**< compressed row tag: no bit set       */
+#define BITMAP_FULL_ROW  1 /**< compressed row tag: every bit set    */
+#define BITMAP_WORDS_ROW 2 /**< compressed row tag: the row is saved */
+#define BITMAP_ARRAY_ROW 3 /**< compressed row tag: the columns set  */
+#define BITMAP_RUNS_ROW  4 /**< compressed row tag: the runs of ones */
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Allocates a bitmap with every bit set to 0
+ *
+ *******************************************************************************
+ *
+ * @param[out] *bitmap
+ * the bitmap to allocate
+ *
+ * @param[in] nb_rows
+ * initial number of rows
+ *
+ * @param[in] nb_cols
+ * number of columns
+ *
+ *******************************************************************************/
+
+void alloc_bitmap (bitmap_t *bitmap,
+                   int       nb_rows,
+                   int       nb_cols)
+{
+    bitmap->nb_cols   = nb_cols;
+    bitmap->row_words = (nb_cols + 63) / 64;
+    bitmap->nb_rows   = nb_rows;
+    bitmap->capacity  = (nb_rows > 0) ? nb_rows : 1;
+    bitmap->words     = melissa_calloc ((size_t)bitmap->capacity * bitmap->row_words, sizeof(uint64_t));
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Sets the number of rows of a bitmap. The new rows are set to 0, and the
+ * storage grows geometrically.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *bitmap
+ * the bitmap to resize
+ *
+ * @param[in] nb_rows
+ * new number of rows
+ *
+ *******************************************************************************/
+
+void bitmap_resize (bitmap_t *bitmap,
+                    int       nb_rows)
+{
+    int       capacity;
+    uint64_t *words;
+
+    if (nb_rows > bitmap->capacity)
+    {
+        capacity = bitmap->capacity;
+        while (capacity < nb_rows)
+        {
+            capacity *= 2;
+        }
+        words = realloc (bitmap->words, (size_t)capacity * bitmap->row_words * sizeof(uint64_t));
+        if (words == NULL)
+        {
+            melissa_print (VERBOSE_ERROR, "Bitmap allocation failed (bitmap_resize)\n");
+            exit (1);
+        }
+        memset (&words[(size_t)bitmap->capacity * bitmap->row_words], 0,
+                (size_t)(capacity - bitmap->capacity) * bitmap->row_words * sizeof(uint64_t));
+        bitmap->words    = words;
+        bitmap->capacity = capacity;
+    }
+    else if (nb_rows < bitmap->nb_rows)
+    {
+        memset (&bitmap->words[(size_t)nb_rows * bitmap->row_words], 0,
+                (size_t)(bitmap->nb_rows - nb_rows) * bitmap->row_words * sizeof(uint64_t));
+    }
+    bitmap->nb_rows = nb_rows;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Sets a bit to 1, adding rows if needed
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *bitmap
+ * the bitmap
+ *
+ * @param[in] row
+ * row of the bit
+ *
+ * @param[in] col
+ * column of the bit
+ *
+ *******************************************************************************/
+
+void bitmap_set (bitmap_t *bitmap,
+                 int       row,
+                 int       col)
+{
+    if (row >= bitmap->nb_rows)
+    {
+        bitmap_resize (bitmap, row + 1);
+    }
+    bitmap->words[(size_t)row * bitmap->row_words + col/64] |= (uint64_t)1 << (col%64);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Tests a bit of a bitmap
+ *
+ *******************************************************************************
+ *
+ * @param[in] *bitmap
+ * the bitmap
+ *
+ * @param[in] row
+ * row of the bit
+ *
+ * @param[in] col
+ * column of the bit
+ *
+ * @return 1 if the bit is set, 0 otherwise or if the row does not exist
+ *
+ *******************************************************************************/
+
+int bitmap_test (bitmap_t *bitmap,
+                 int       row,
+                 int       col)
+{
+    if (row >= bitmap->nb_rows)
+    {
+        return 0;
+    }
+    return (bitmap->words[(size_t)row * bitmap->row_words + col/64] >> (col%64)) & 1;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Counts the bits set to 1 in a row
+ *
+ *******************************************************************************
+ *
+ * @param[in] *bitmap
+ * the bitmap
+ *
+ * @param[in] row
+ * the row to count
+ *
+ *******************************************************************************/
+
+int bitmap_count_row (bitmap_t *bitmap,
+                      int       row)
+{
+    int i;
+    int count = 0;
+    uint64_t *words;
+
+    if (row >= bitmap->nb_rows)
+    {
+        return 0;
+    }
+    words = &bitmap->words[(size_t)row * bitmap->row_words];
+    for (i=0; i<bitmap->row_words; i++)
+    {
+        count += __builtin_popcountll (words[i]);
+    }
+    return count;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Counts the bits set to 1 in a column
+ *
+ *******************************************************************************
+ *
+ * @param[in] *bitmap
+ * the bitmap
+ *
+ * @param[in] col
+ * the column to count
+ *
+ *******************************************************************************/
+
+int bitmap_count_col (bitmap_t *bitmap,
+                      int       col)
+{
+    int i;
+    int count = 0;
+    uint64_t *word = &bitmap->words[col/64];
+
+    for (i=0; i<bitmap->nb_rows; i++, word+=bitmap->row_words)
+    {
+        count += (*word >> (col%64)) & 1;
+    }
+    return count;
+}
+
+// number of runs of consecutive ones in a row
+static int bitmap_count_runs (bitmap_t *bitmap,
+                              int       row)
+{
+    int i;
+    int count = 0;
+    uint64_t *words = &bitmap->words[(size_t)row * bitmap->row_words];
+    uint64_t  carry = 0;
+
+    // a run starts on a one whose previous bit is a zero
+    for (i=0; i<bitmap->row_words; i++)
+    {
+        count += __builtin_popcountll (words[i] & ~((words[i] << 1) | carry));
+        carry = words[i] >> 63;
+    }
+    return count;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup save_stats
+ *
+ * Writes a bitmap in a file. In compressed form, the empty and full rows are
+ * only written as a one byte tag. The other rows are written in the smallest
+ * of three containers: the indices of the columns set (sparse rows), the
+ * first column and length of each run of ones (simulations that sent a range
+ * of time steps), or the words.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *bitmap
+ * the bitmap to write
+ *
+ * @param[in] compressed
+ * 1 to write the compressed form, 0 to write every word
+ *
+ * @param[in] *f
+ * file descriptor
+ *
+ *******************************************************************************/
+
+void bitmap_write (bitmap_t *bitmap,
+                   int       compressed,
+                   FILE     *f)
+{
+    int   i, j, count, nb_runs, start;
+    char *tags;
+
+    fwrite (&bitmap->nb_rows, sizeof(int), 1, f);
+    fwrite (&bitmap->nb_cols, sizeof(int), 1, f);
+    fwrite (&compressed, sizeof(int), 1, f);
+    if (compressed == 0)
+    {
+        fwrite (bitmap->words, sizeof(uint64_t), (size_t)bitmap->nb_rows * bitmap->row_words, f);
+        return;
+    }
+
+    tags = melissa_malloc (bitmap->nb_rows > 0 ? bitmap->nb_rows : 1);
+    for (i=0; i<bitmap->nb_rows; i++)
+    {
+        count = bitmap_count_row (bitmap, i);
+        if (count == 0 || count == bitmap->nb_cols)
+        {
+            tags[i] = (count == 0) ? BITMAP_EMPTY_ROW : BITMAP_FULL_ROW;
+            continue;
+        }
+        // sizes in bytes: one int per column, two ints per run, or the words
+        nb_runs = bitmap_count_runs (bitmap, i);
+        if (count * sizeof(int) <= 2 * nb_runs * sizeof(int) &&
+            count * sizeof(int) < bitmap->row_words * sizeof(uint64_t))
+        {
+            tags[i] = BITMAP_ARRAY_ROW;
+        }
+        else if (2 * nb_runs * sizeof(int) < bitmap->row_words * sizeof(uint64_t))
+        {
+            tags[i] = BITMAP_RUNS_ROW;
+        }
+        else
+        {
+            tags[i] = BITMAP_WORDS_ROW;
+        }
+    }
+    fwrite (tags, sizeof(char), bitmap->nb_rows, f);
+    for (i=0; i<bitmap->nb_rows; i++)
+    {
+        if (tags[i] == BITMAP_WORDS_ROW)
+        {
+            fwrite (&bitmap->words[(size_t)i * bitmap->row_words], sizeof(uint64_t), bitmap->row_words, f);
+        }
+        else if (tags[i] == BITMAP_ARRAY_ROW)
+        {
+            count = bitmap_count_row (bitmap, i);
+            fwrite (&count, sizeof(int), 1, f);
+            for (j=0; j<bitmap->nb_cols; j++)
+            {
+                if (bitmap_test (bitmap, i, j))
+                {
+                    fwrite (&j, sizeof(int), 1, f);
+                }
+            }
+        }
+        else if (tags[i] == BITMAP_RUNS_ROW)
+        {
+            nb_runs = bitmap_count_runs (bitmap, i);
+            fwrite (&nb_runs, sizeof(int), 1, f);
+            for (j=0; j<bitmap->nb_cols; j++)
+            {
+                if (bitmap_test (bitmap, i, j))
+                {
+                    start = j;
+                    while (j < bitmap->nb_cols && bitmap_test (bitmap, i, j))
+                    {
+                        j++;
+                    }
+                    count = j - start;
+                    fwrite (&start, sizeof(int), 1, f);
+                    fwrite (&count, sizeof(int), 1, f);
+                }
+            }
+        }
+    }
+    melissa_free (tags);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup save_stats
+ *
+ * Reads a bitmap written by bitmap_write, in an allocated bitmap with the
+ * same number of columns
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *bitmap
+ * the bitmap to read
+ *
+ * @param[in] *f
+ * file descriptor
+ *
+ * @return 0 on success, -1 if the file does not match the bitmap
+ *
+ *******************************************************************************/
+
+int bitmap_read (bitmap_t *bitmap,
+                 FILE     *f)
+{
+    int   i, j, k, nb_rows, nb_cols, compressed, count, start, length;
+    int   ret = 0;
+    char *tags;
+    uint64_t *words;
+
+    if (fread (&nb_rows, sizeof(int), 1, f) != 1 ||
+        fread (&nb_cols, sizeof(int), 1, f) != 1 ||
+        fread (&compressed, sizeof(int), 1, f) != 1 ||
+        nb_rows < 0 || nb_cols != bitmap->nb_cols)
+    {
+        return -1;
+    }
+    bitmap_resize (bitmap, 0);
+    bitmap_resize (bitmap, nb_rows);
+    if (compressed == 0)
+    {
+        if (fread (bitmap->words, sizeof(uint64_t), (size_t)nb_rows * bitmap->row_words, f) != (size_t)nb_rows * bitmap->row_words)
+        {
+            return -1;
+        }
+        return 0;
+    }
+
+    tags = melissa_malloc (nb_rows > 0 ? nb_rows : 1);
+    if (fread (tags, sizeof(char), nb_rows, f) != (size_t)nb_rows)
+    {
+        ret = -1;
+    }
+    for (i=0; i<nb_rows && ret == 0; i++)
+    {
+        words = &bitmap->words[(size_t)i * bitmap->row_words];
+        if (tags[i] == BITMAP_FULL_ROW)
+        {
+            for (j=0; j<bitmap->nb_cols; j++)
+            {
+                words[j/64] |= (uint64_t)1 << (j%64);
+            }
+        }
+        else if (tags[i] == BITMAP_WORDS_ROW)
+        {
+            if (fread (words, sizeof(uint64_t), bitmap->row_words, f) != (size_t)bitmap->row_words)
+            {
+                ret = -1;
+            }
+        }
+        else if (tags[i] == BITMAP_ARRAY_ROW)
+        {
+            if (fread (&count, sizeof(int), 1, f) != 1 || count < 0 || count > nb_cols)
+            {
+                ret = -1;
+            }
+            for (k=0; k<count && ret == 0; k++)
+            {
+                if (fread (&j, sizeof(int), 1, f) != 1 || j < 0 || j >= nb_cols)
+                {
+                    ret = -1;
+                    break;
+                }
+                words[j/64] |= (uint64_t)1 << (j%64);
+            }
+        }
+        else if (tags[i] == BITMAP_RUNS_ROW)
+        {
+            if (fread (&count, sizeof(int), 1, f) != 1 || count < 0 || count > nb_cols)
+            {
+                ret = -1;
+            }
+            for (k=0; k<count && ret == 0; k++)
+            {
+                if (fread (&start, sizeof(int), 1, f) != 1 ||
+                    fread (&length, sizeof(int), 1, f) != 1 ||
+                    start < 0 || length < 0 || length > nb_cols - start)
+                {
+                    ret = -1;
+                    break;
+                }
+                for (j=start; j<start+length; j++)
+                {
+                    words[j/64] |= (uint64_t)1 << (j%64);
+                }
+            }
+        }
+        else if (tags[i] != BITMAP_EMPTY_ROW)
+        {
+            ret = -1;
+        }
+    }
+    melissa_free (tags);
+    return ret;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Frees a bitmap
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *bitmap
+ * the bitmap to free
+ *
+ *******************************************************************************/
+
+void free_bitmap (bitmap_t *bitmap)
+{
+    melissa_free (bitmap->words);
+    bitmap->words    = NULL;
+    bitmap->nb_rows  = 0;
+    bitmap->capacity = 0;
+}
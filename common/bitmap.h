@@ -0,0 +1,91 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file bitmap.h
+ * @brief Growable 2-D array of bits (rows x columns).
+ * @author Terraz Théophile
+ * @date 2019-03-04
+ *
+ **/
+
+#ifndef MELISSA_BITMAP_H
+#define MELISSA_BITMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ *******************************************************************************
+ *
+ * @struct bitmap_s
+ *
+ * Contiguous 2-D array of bits, one row of 64 bit words per row index.
+ * Rows are added on demand, columns are fixed.
+ *
+ *******************************************************************************/
+
+struct bitmap_s
+{
+    uint64_t *words;     /**< bits, row after row, capacity * row_words     */
+    int       nb_rows;   /**< number of rows in use                         */
+    int       nb_cols;   /**< number of columns (bits per row)              */
+    int       row_words; /**< number of 64 bit words per row                */
+    int       capacity;  /**< number of allocated rows                      */
+};
+
+typedef struct bitmap_s bitmap_t; /**< type corresponding to bitmap_s */
+
+void alloc_bitmap (bitmap_t *bitmap,
+                   int       nb_rows,
+                   int       nb_cols);
+
+void bitmap_resize (bitmap_t *bitmap,
+                    int       nb_rows);
+
+void bitmap_set (bitmap_t *bitmap,
+                 int       row,
+                 int       col);
+
+int bitmap_test (bitmap_t *bitmap,
+                 int       row,
+                 int       col);
+
+int bitmap_count_row (bitmap_t *bitmap,
+                      int       row);
+
+int bitmap_count_col (bitmap_t *bitmap,
+                      int       col);
+
+void bitmap_write (bitmap_t *bitmap,
+                   int       compressed,
+                   FILE     *f);
+
+int bitmap_read (bitmap_t *bitmap,
+                 FILE     *f);
+
+void free_bitmap (bitmap_t *bitmap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELISSA_BITMAP_H
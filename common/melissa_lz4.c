@@ -0,0 +1,398 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_lz4.c
+ * @brief Byte shuffle and LZ4 blocks.
+ * @author Terraz Théophile
+ * @date 2019-04-02
+ *
+ * @defgroup melissa_lz4 byte shuffle and LZ4 blocks
+ *
+ * Arrays of numbers are first byte-shuffled (the first byte of every value,
+ * then the second byte, ...), so that the signs and exponents, that change
+ * slowly, end up next to each other, then compressed in the LZ4 block format.
+ * The codec is built in, so Melissa has no extra dependency; the blocks can
+ * still be read by any LZ4 implementation. It is used by the checkpoints of
+ * the server (melissa_codec.c) and by the data messages (melissa_messages.c).
+ *
+ **/
+
+#include <string.h>
+#include "melissa_lz4.h"
+
+#define MELISSA_LZ4_HASH_LOG      12 /**< log2 of the size of the match table         */
+#define MELISSA_LZ4_MIN_MATCH      4 /**< shortest match                               */
+#define MELISSA_LZ4_MAX_OFFSET 65535 /**< farthest match                               */
+#define MELISSA_LZ4_MF_LIMIT      12 /**< a match starts at least 12 bytes from the end */
+#define MELISSA_LZ4_LAST_LITERALS  5 /**< the last 5 bytes are literals                */
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_lz4
+ *
+ * This function gives the largest compressed size of a buffer
+ *
+ *******************************************************************************
+ *
+ * @param[in] size
+ * size of the buffer (bytes)
+ *
+ * @return the size to allocate for the compressed buffer
+ *
+ *******************************************************************************/
+
+size_t melissa_codec_bound (size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_lz4
+ *
+ * This function groups the bytes of the same rank of an array of values. The
+ * bytes after the last whole value are copied as they are.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *source
+ * array of values
+ *
+ * @param[in] size
+ * size of the array (bytes)
+ *
+ * @param[in] elem_size
+ * size of a value (bytes)
+ *
+ * @param[out] *dest
+ * shuffled array, size bytes
+ *
+ *******************************************************************************/
+
+void melissa_shuffle (const char *source,
+                      size_t      size,
+                      size_t      elem_size,
+                      char       *dest)
+{
+    size_t i, b, nb_elem = size / elem_size;
+
+    for (b=0; b<elem_size; b++)
+    {
+        for (i=0; i<nb_elem; i++)
+        {
+            dest[b * nb_elem + i] = source[i * elem_size + b];
+        }
+    }
+    memcpy (dest + nb_elem * elem_size, source + nb_elem * elem_size, size - nb_elem * elem_size);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_lz4
+ *
+ * This function reverts melissa_shuffle
+ *
+ *******************************************************************************
+ *
+ * @param[in] *source
+ * shuffled array
+ *
+ * @param[in] size
+ * size of the array (bytes)
+ *
+ * @param[in] elem_size
+ * size of a value (bytes)
+ *
+ * @param[out] *dest
+ * array of values, size bytes
+ *
+ *******************************************************************************/
+
+void melissa_unshuffle (const char *source,
+                        size_t      size,
+                        size_t      elem_size,
+                        char       *dest)
+{
+    size_t i, b, nb_elem = size / elem_size;
+
+    for (b=0; b<elem_size; b++)
+    {
+        for (i=0; i<nb_elem; i++)
+        {
+            dest[i * elem_size + b] = source[b * nb_elem + i];
+        }
+    }
+    memcpy (dest + nb_elem * elem_size, source + nb_elem * elem_size, size - nb_elem * elem_size);
+}
+
+static inline uint32_t read32 (const unsigned char *p)
+{
+    uint32_t value;
+    memcpy (&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz4_hash (uint32_t value)
+{
+    return (value * 2654435761U) >> (32 - MELISSA_LZ4_HASH_LOG);
+}
+
+// lengths above 15 continue in bytes of 255
+static inline unsigned char* write_length (unsigned char *op,
+                                           size_t         length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+// one sequence: literals, then a match (match_length 0 for the last literals)
+static unsigned char* write_sequence (unsigned char       *op,
+                                      const unsigned char *literals,
+                                      size_t               nb_literals,
+                                      size_t               offset,
+                                      size_t               match_length)
+{
+    unsigned char *token = op++;
+
+    *token = (unsigned char)((nb_literals >= 15 ? 15 : nb_literals) << 4);
+    if (nb_literals >= 15)
+    {
+        op = write_length (op, nb_literals - 15);
+    }
+    memcpy (op, literals, nb_literals);
+    op += nb_literals;
+    if (match_length == 0)
+    {
+        return op;
+    }
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    match_length -= MELISSA_LZ4_MIN_MATCH;
+    *token |= (unsigned char)(match_length >= 15 ? 15 : match_length);
+    if (match_length >= 15)
+    {
+        op = write_length (op, match_length - 15);
+    }
+    return op;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_lz4
+ *
+ * This function compresses a buffer in one LZ4 block, with a greedy search
+ * of the last position of each 4 bytes sequence
+ *
+ *******************************************************************************
+ *
+ * @param[in] *source
+ * buffer to compress
+ *
+ * @param[in] size
+ * size of the buffer (bytes)
+ *
+ * @param[out] *dest
+ * compressed block, at least melissa_codec_bound(size) bytes
+ *
+ * @return the size of the compressed block
+ *
+ *******************************************************************************/
+
+size_t melissa_lz4_compress (const char *source,
+                             size_t      size,
+                             char       *dest)
+{
+    const unsigned char *src    = (const unsigned char*)source;
+    const unsigned char *ip     = src;
+    const unsigned char *anchor = src;
+    const unsigned char *end    = src + size;
+    const unsigned char *ref;
+    unsigned char       *op     = (unsigned char*)dest;
+    uint32_t             table[1 << MELISSA_LZ4_HASH_LOG];
+    uint32_t             h;
+    size_t               match_length, misses = 0;
+
+    if (size > MELISSA_LZ4_MF_LIMIT)
+    {
+        memset (table, 0, sizeof(table));
+        ip++;
+        while (ip < end - MELISSA_LZ4_MF_LIMIT)
+        {
+            h = lz4_hash (read32 (ip));
+            ref = src + table[h];
+            table[h] = (uint32_t)(ip - src);
+            if (ref >= ip || ip - ref > MELISSA_LZ4_MAX_OFFSET || read32 (ref) != read32 (ip))
+            {
+                // skip faster in incompressible data
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            while (ip > anchor && ref > src && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+            match_length = MELISSA_LZ4_MIN_MATCH;
+            while (ip + match_length < end - MELISSA_LZ4_LAST_LITERALS && ip[match_length] == ref[match_length])
+            {
+                match_length++;
+            }
+            op = write_sequence (op, anchor, ip - anchor, ip - ref, match_length);
+            ip += match_length;
+            anchor = ip;
+        }
+    }
+    op = write_sequence (op, anchor, end - anchor, 0, 0);
+    return op - (unsigned char*)dest;
+}
+
+// reads a length continued in bytes of 255, -1 past the end of the block
+static inline int read_length (const unsigned char **ip,
+                               const unsigned char  *end,
+                               size_t               *length)
+{
+    unsigned char byte;
+
+    do
+    {
+        if (*ip >= end)
+        {
+            return -1;
+        }
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_lz4
+ *
+ * This function decompresses one LZ4 block. The block is checked, a corrupted
+ * block never writes out of dest. With dest NULL, the block is only checked,
+ * without copying: the result is the one of the decompression.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *source
+ * compressed block
+ *
+ * @param[in] size
+ * size of the block (bytes)
+ *
+ * @param[out] *dest
+ * decompressed buffer, NULL to only check the block
+ *
+ * @param[in] dest_size
+ * expected size of the decompressed buffer (bytes)
+ *
+ * @return 0 on success, -1 if the block is corrupted or of another size
+ *
+ *******************************************************************************/
+
+int melissa_lz4_decompress (const char *source,
+                            size_t      size,
+                            char       *dest,
+                            size_t      dest_size)
+{
+    const unsigned char *ip   = (const unsigned char*)source;
+    const unsigned char *iend = ip + size;
+    unsigned char       *op   = (unsigned char*)dest;
+    unsigned char       *match;
+    unsigned int         token;
+    size_t               length, offset;
+    size_t               position = 0;
+
+    while (ip < iend)
+    {
+        token = *ip++;
+        length = token >> 4;
+        if (length == 15 && read_length (&ip, iend, &length) != 0)
+        {
+            return -1;
+        }
+        if (length > (size_t)(iend - ip) || length > dest_size - position)
+        {
+            return -1;
+        }
+        if (dest != NULL)
+        {
+            memcpy (op, ip, length);
+            op += length;
+        }
+        position += length;
+        ip += length;
+        if (ip == iend)
+        {
+            // last literals
+            break;
+        }
+        if (iend - ip < 2)
+        {
+            return -1;
+        }
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > position)
+        {
+            return -1;
+        }
+        length = token & 15;
+        if (length == 15 && read_length (&ip, iend, &length) != 0)
+        {
+            return -1;
+        }
+        length += MELISSA_LZ4_MIN_MATCH;
+        if (length > dest_size - position)
+        {
+            return -1;
+        }
+        position += length;
+        if (dest == NULL)
+        {
+            continue;
+        }
+        match = op - offset;
+        if (offset >= length)
+        {
+            memcpy (op, match, length);
+            op += length;
+        }
+        else
+        {
+            // overlapping copy: repeats the last offset bytes
+            while (length-- > 0)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+    return (position == dest_size) ? 0 : -1;
+}
@@ -0,0 +1,60 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_lz4.h
+ * @author Terraz Théophile
+ * @date 2019-04-02
+ *
+ **/
+
+#ifndef MELISSA_LZ4_H
+#define MELISSA_LZ4_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+size_t melissa_codec_bound (size_t size);
+
+void melissa_shuffle (const char *source,
+                      size_t      size,
+                      size_t      elem_size,
+                      char       *dest);
+
+void melissa_unshuffle (const char *source,
+                        size_t      size,
+                        size_t      elem_size,
+                        char       *dest);
+
+size_t melissa_lz4_compress (const char *source,
+                             size_t      size,
+                             char       *dest);
+
+int melissa_lz4_decompress (const char *source,
+                            size_t      size,
+                            char       *dest,
+                            size_t      dest_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELISSA_LZ4_H
@@ -24,7 +24,9 @@
  **/
 
 #include <string.h>
+#include <stdint.h>
 #include "melissa_messages.h"
+#include "melissa_lz4.h"
 #include "melissa_utils.h"
 
 #ifdef DEBUG_MELISSA_MESSAGES
@@ -354,6 +356,104 @@ int send_message_options (char   buff[],
     return zmq_msg_send (&msg, socket, flags);
 }
 
+// the scratch buffers hold the compressed or the shuffled vectors
+static void wire_reserve (melissa_wire_t *wire,
+                          size_t          size)
+{
+    size = melissa_codec_bound (size);
+    if (wire->buffer_size < size)
+    {
+        melissa_free (wire->buffers[0]);
+        melissa_free (wire->buffers[1]);
+        wire->buffers[0] = melissa_malloc (size);
+        wire->buffers[1] = melissa_malloc (size);
+        wire->buffer_size = size;
+    }
+}
+
+// The values are rounded to the nearest multiple of 2 * tolerance, and
+// the multiples are written in buffers[1] as the zigzag of the difference
+// with the previous one: neighbour values give small integers, whose high
+// bytes are zeros once shuffled. Returns -1 if a value can not be quantized
+// (not finite, or above 2^52 times the step).
+static int wire_quantize (melissa_wire_t *wire,
+                          double        **data_ptr,
+                          int             nb_vect,
+                          int             vect_size)
+{
+    int       i, j;
+    uint64_t *dest = (uint64_t*)wire->buffers[1];
+    double    scale = 0.5 / wire->tolerance;
+    double    value;
+    int64_t   q, delta, previous = 0;
+
+    for (i=0; i<nb_vect; i++)
+    {
+        for (j=0; j<vect_size; j++)
+        {
+            value = data_ptr[i][j] * scale;
+            if (!(value > -4503599627370496.0 && value < 4503599627370496.0))
+            {
+                return -1;
+            }
+            q = (int64_t)(value < 0 ? value - 0.5 : value + 0.5);
+            delta = q - previous;
+            previous = q;
+            *dest++ = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+        }
+    }
+    return 0;
+}
+
+// compresses the vectors with the codec of the wire, or with LZ4 if they
+// can not be quantized. Incompressible vectors are sent as they are.
+static size_t wire_pack (melissa_wire_t *wire,
+                         double        **data_ptr,
+                         int             nb_vect,
+                         int             vect_size,
+                         int32_t        *codec,
+                         char          **packed)
+{
+    int    i;
+    size_t nb_values = (size_t)nb_vect * vect_size;
+    size_t elem_size = melissa_wire_size (wire->format);
+    size_t raw_size = nb_values * elem_size;
+    size_t size;
+
+    wire_reserve (wire, nb_values * sizeof(uint64_t));
+    if (wire->codec == MELISSA_WIRE_QUANTIZE &&
+        wire_quantize (wire, data_ptr, nb_vect, vect_size) == 0)
+    {
+        melissa_shuffle (wire->buffers[1], nb_values * sizeof(uint64_t), sizeof(uint64_t), wire->buffers[0]);
+        size = melissa_lz4_compress (wire->buffers[0], nb_values * sizeof(uint64_t), wire->buffers[1]);
+        if (size < raw_size)
+        {
+            *codec = MELISSA_WIRE_QUANTIZE;
+            *packed = wire->buffers[1];
+            return size;
+        }
+    }
+    for (i=0; i<nb_vect; i++)
+    {
+        melissa_wire_encode (data_ptr[i], vect_size, wire->format, wire->buffers[0] + i * vect_size * elem_size);
+    }
+    melissa_shuffle (wire->buffers[0], raw_size, elem_size, wire->buffers[1]);
+    size = melissa_lz4_compress (wire->buffers[1], raw_size, wire->buffers[0]);
+    if (size < raw_size)
+    {
+        *codec = MELISSA_WIRE_LZ4;
+        *packed = wire->buffers[0];
+        return size;
+    }
+    for (i=0; i<nb_vect; i++)
+    {
+        melissa_wire_encode (data_ptr[i], vect_size, wire->format, wire->buffers[1] + i * vect_size * elem_size);
+    }
+    *codec = MELISSA_WIRE_NO_CODEC;
+    *packed = wire->buffers[1];
+    return raw_size;
+}
+
 void message_simu_data (zmq_msg_t *msg,
                         int      time_stamp,
                         int      simu_id,
@@ -361,11 +461,31 @@ void message_simu_data (zmq_msg_t *msg,
                         int      vect_size,
                         int      nb_vect,
                         char*    field_name,
-                        double** data_ptr)
+                        double** data_ptr,
+                        melissa_wire_t *wire)
 {
     int       i;
     char*     buff_ptr = NULL;
-    zmq_msg_init_size (msg, 4 * sizeof(int) + MAX_FIELD_NAME + nb_vect * vect_size * sizeof(double));
+    char*     packed = NULL;
+    size_t    wire_size = melissa_wire_size (wire->format);
+    size_t    packed_size = 0;
+    int32_t   codec, size;
+    double    start;
+
+    if (wire->codec == MELISSA_WIRE_NO_CODEC)
+    {
+        zmq_msg_init_size (msg, 4 * sizeof(int) + MAX_FIELD_NAME + nb_vect * vect_size * wire_size);
+    }
+    else
+    {
+        // the compressed vectors follow their codec and size
+        start = melissa_get_time();
+        packed_size = wire_pack (wire, data_ptr, nb_vect, vect_size, &codec, &packed);
+        wire->codec_time += melissa_get_time() - start;
+        wire->raw_bytes += nb_vect * vect_size * wire_size;
+        wire->packed_bytes += 2 * sizeof(int32_t) + packed_size;
+        zmq_msg_init_size (msg, 4 * sizeof(int) + MAX_FIELD_NAME + 2 * sizeof(int32_t) + packed_size);
+    }
     buff_ptr = zmq_msg_data (msg);
     memcpy (buff_ptr, &time_stamp, sizeof(int));
     buff_ptr += sizeof(int);
@@ -377,10 +497,21 @@ void message_simu_data (zmq_msg_t *msg,
     buff_ptr += sizeof(int);
     memcpy (buff_ptr, field_name, MAX_FIELD_NAME);
     buff_ptr += MAX_FIELD_NAME;
+    if (wire->codec != MELISSA_WIRE_NO_CODEC)
+    {
+        size = (int32_t)packed_size;
+        memcpy (buff_ptr, &codec, sizeof(int32_t));
+        buff_ptr += sizeof(int32_t);
+        memcpy (buff_ptr, &size, sizeof(int32_t));
+        buff_ptr += sizeof(int32_t);
+        memcpy (buff_ptr, packed, packed_size);
+        return;
+    }
     for (i=0; i<nb_vect; i++)
     {
-        memcpy (buff_ptr, data_ptr[i], vect_size * sizeof(double));
-        buff_ptr += vect_size * sizeof(double);
+        // the vectors are converted while copied in the message
+        melissa_wire_encode (data_ptr[i], vect_size, wire->format, buff_ptr);
+        buff_ptr += vect_size * wire_size;
     }
 }
 
@@ -391,6 +522,7 @@ int send_message_simu_data (int      time_stamp,
                             int      nb_vect,
                             char*    field_name,
                             double** data_ptr,
+                            melissa_wire_t *wire,
                             void*    socket,
                             int      flags)
 {
@@ -402,7 +534,8 @@ int send_message_simu_data (int      time_stamp,
                        vect_size,
                        nb_vect,
                        field_name,
-                       data_ptr);
+                       data_ptr,
+                       wire);
     return zmq_msg_send (&msg, socket, flags);
 }
 
@@ -427,3 +560,267 @@ void read_message_simu_data (char*    msg_buffer,
     msg_ptr += MAX_FIELD_NAME * sizeof(char);
     *data_ptr = (double*)msg_ptr;
 }
+
+// size of a value on the wire (bytes)
+size_t melissa_wire_size (int wire_format)
+{
+    switch (wire_format)
+    {
+    case MELISSA_WIRE_FLOAT:
+        return sizeof(float);
+    case MELISSA_WIRE_BFLOAT16:
+        return sizeof(uint16_t);
+    default:
+        return sizeof(double);
+    }
+}
+
+// bfloat16 is the upper half of a float32: 8 bits of exponent, 7 of mantissa.
+// Rounded to the nearest, ties to even, NaNs stay NaNs.
+static inline uint16_t float_to_bfloat16 (float value)
+{
+    uint32_t bits;
+
+    memcpy (&bits, &value, sizeof(uint32_t));
+    if ((bits & 0x7fffffff) > 0x7f800000)
+    {
+        return (uint16_t)((bits >> 16) | 0x0040);
+    }
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+static inline float bfloat16_to_float (uint16_t value)
+{
+    uint32_t bits = (uint32_t)value << 16;
+    float    result;
+
+    memcpy (&result, &bits, sizeof(float));
+    return result;
+}
+
+void melissa_wire_encode (const double *src,
+                          int           nb_values,
+                          int           wire_format,
+                          void         *dest)
+{
+    int       i;
+    float    *f_dest = (float*)dest;
+    uint16_t *b_dest = (uint16_t*)dest;
+
+    switch (wire_format)
+    {
+    case MELISSA_WIRE_FLOAT:
+        for (i=0; i<nb_values; i++)
+        {
+            f_dest[i] = (float)src[i];
+        }
+        break;
+    case MELISSA_WIRE_BFLOAT16:
+        for (i=0; i<nb_values; i++)
+        {
+            b_dest[i] = float_to_bfloat16 ((float)src[i]);
+        }
+        break;
+    default:
+        memcpy (dest, src, nb_values * sizeof(double));
+        break;
+    }
+}
+
+void melissa_wire_decode (const void *src,
+                          int         nb_values,
+                          int         wire_format,
+                          double     *dest)
+{
+    int             i;
+    const float    *f_src = (const float*)src;
+    const uint16_t *b_src = (const uint16_t*)src;
+
+    switch (wire_format)
+    {
+    case MELISSA_WIRE_FLOAT:
+        for (i=0; i<nb_values; i++)
+        {
+            dest[i] = f_src[i];
+        }
+        break;
+    case MELISSA_WIRE_BFLOAT16:
+        for (i=0; i<nb_values; i++)
+        {
+            dest[i] = bfloat16_to_float (b_src[i]);
+        }
+        break;
+    default:
+        memcpy (dest, src, nb_values * sizeof(double));
+        break;
+    }
+}
+
+void melissa_wire_init (melissa_wire_t *wire,
+                        int             format,
+                        int             codec,
+                        double          tolerance)
+{
+    wire->format       = format;
+    wire->codec        = codec;
+    wire->tolerance    = tolerance;
+    wire->buffers[0]   = NULL;
+    wire->buffers[1]   = NULL;
+    wire->buffer_size  = 0;
+    wire->raw_bytes    = 0;
+    wire->packed_bytes = 0;
+    wire->codec_time   = 0.0;
+}
+
+void melissa_wire_free (melissa_wire_t *wire)
+{
+    melissa_free (wire->buffers[0]);
+    melissa_free (wire->buffers[1]);
+    wire->buffers[0]  = NULL;
+    wire->buffers[1]  = NULL;
+    wire->buffer_size = 0;
+}
+
+// reads the codec header of a data message payload, and checks its sizes.
+// Returns -1 if the payload is truncated.
+static int wire_header (const char          **payload,
+                        size_t                payload_size,
+                        size_t                raw_size,
+                        const melissa_wire_t *wire,
+                        int32_t              *codec,
+                        int32_t              *size)
+{
+    if (wire->codec == MELISSA_WIRE_NO_CODEC)
+    {
+        if (payload_size < raw_size)
+        {
+            return -1;
+        }
+        *codec = MELISSA_WIRE_NO_CODEC;
+        *size = 0;
+        return 0;
+    }
+    if (payload_size < 2 * sizeof(int32_t))
+    {
+        return -1;
+    }
+    memcpy (codec, *payload, sizeof(int32_t));
+    memcpy (size, *payload + sizeof(int32_t), sizeof(int32_t));
+    *payload += 2 * sizeof(int32_t);
+    if (*size < 0 || (size_t)*size > payload_size - 2 * sizeof(int32_t))
+    {
+        return -1;
+    }
+    if (*codec == MELISSA_WIRE_NO_CODEC && (size_t)*size != raw_size)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// checks a data message payload without decoding it: returns 0 if
+// melissa_wire_unpack can decode it, -1 if it is truncated or corrupted.
+// The compressed blocks are parsed, but not decompressed.
+int melissa_wire_check (const char           *payload,
+                        size_t                payload_size,
+                        int                   nb_vect,
+                        int                   vect_size,
+                        const melissa_wire_t *wire)
+{
+    size_t  nb_values = (size_t)nb_vect * vect_size;
+    size_t  raw_size = nb_values * melissa_wire_size (wire->format);
+    int32_t codec, size;
+
+    if (wire_header (&payload, payload_size, raw_size, wire, &codec, &size) != 0)
+    {
+        return -1;
+    }
+    switch (codec)
+    {
+    case MELISSA_WIRE_NO_CODEC:
+        return 0;
+    case MELISSA_WIRE_LZ4:
+        return melissa_lz4_decompress (payload, size, NULL, raw_size);
+    case MELISSA_WIRE_QUANTIZE:
+        return melissa_lz4_decompress (payload, size, NULL, nb_values * sizeof(uint64_t));
+    default:
+        return -1;
+    }
+}
+
+// decodes the nb_vect vectors of a data message payload in dest, one after
+// the other. Returns -1 if the payload is truncated or corrupted.
+int melissa_wire_unpack (const char     *payload,
+                         size_t          payload_size,
+                         int             nb_vect,
+                         int             vect_size,
+                         melissa_wire_t *wire,
+                         double         *dest)
+{
+    int             i;
+    size_t          j;
+    size_t          nb_values = (size_t)nb_vect * vect_size;
+    size_t          elem_size = melissa_wire_size (wire->format);
+    size_t          raw_size = nb_values * elem_size;
+    int32_t         codec, size;
+    int64_t         delta, q = 0;
+    const uint64_t *zigzag;
+    const char     *values;
+    double          step, start;
+
+    if (wire_header (&payload, payload_size, raw_size, wire, &codec, &size) != 0)
+    {
+        return -1;
+    }
+
+    start = melissa_get_time();
+    switch (codec)
+    {
+    case MELISSA_WIRE_NO_CODEC:
+        values = payload;
+        break;
+    case MELISSA_WIRE_LZ4:
+        wire_reserve (wire, raw_size);
+        if (melissa_lz4_decompress (payload, size, wire->buffers[0], raw_size) != 0)
+        {
+            return -1;
+        }
+        melissa_unshuffle (wire->buffers[0], raw_size, elem_size, wire->buffers[1]);
+        values = wire->buffers[1];
+        break;
+    case MELISSA_WIRE_QUANTIZE:
+        wire_reserve (wire, nb_values * sizeof(uint64_t));
+        if (melissa_lz4_decompress (payload, size, wire->buffers[0], nb_values * sizeof(uint64_t)) != 0)
+        {
+            return -1;
+        }
+        melissa_unshuffle (wire->buffers[0], nb_values * sizeof(uint64_t), sizeof(uint64_t), wire->buffers[1]);
+        zigzag = (const uint64_t*)wire->buffers[1];
+        step = 2.0 * wire->tolerance;
+        for (j=0; j<nb_values; j++)
+        {
+            delta = (int64_t)(zigzag[j] >> 1) ^ -(int64_t)(zigzag[j] & 1);
+            q += delta;
+            dest[j] = q * step;
+        }
+        values = NULL;
+        break;
+    default:
+        return -1;
+    }
+    if (values != NULL)
+    {
+        for (i=0; i<nb_vect; i++)
+        {
+            melissa_wire_decode (values + i * vect_size * elem_size, vect_size, wire->format, &dest[(size_t)i * vect_size]);
+        }
+    }
+    if (wire->codec != MELISSA_WIRE_NO_CODEC)
+    {
+        wire->codec_time += melissa_get_time() - start;
+        wire->raw_bytes += raw_size;
+        wire->packed_bytes += 2 * sizeof(int32_t) + size;
+    }
+    return 0;
+}
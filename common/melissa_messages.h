@@ -42,6 +42,41 @@ extern "C" {
 #define CONFIDENCE_INTERVAL 8
 #define OPTIONS 9
 
+// formats of the simulation data vectors on the wire
+#define MELISSA_WIRE_DOUBLE   0
+#define MELISSA_WIRE_FLOAT    1
+#define MELISSA_WIRE_BFLOAT16 2
+
+// compression of the simulation data vectors on the wire
+#define MELISSA_WIRE_NO_CODEC 0
+#define MELISSA_WIRE_LZ4      1
+#define MELISSA_WIRE_QUANTIZE 2
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_wire_s
+ *
+ * Format and compression of the simulation data vectors, with the buffers
+ * and counters of the codec. Each thread packing or unpacking messages has
+ * its own.
+ *
+ *******************************************************************************/
+
+struct melissa_wire_s
+{
+    int      format;       /**< MELISSA_WIRE_DOUBLE, MELISSA_WIRE_FLOAT or MELISSA_WIRE_BFLOAT16  */
+    int      codec;        /**< MELISSA_WIRE_NO_CODEC, MELISSA_WIRE_LZ4 or MELISSA_WIRE_QUANTIZE */
+    double   tolerance;    /**< absolute error bound of MELISSA_WIRE_QUANTIZE                     */
+    char    *buffers[2];   /**< scratch buffers of the codec                                      */
+    size_t   buffer_size;  /**< size of each scratch buffer (bytes)                               */
+    long int raw_bytes;    /**< size of the vectors before compression (bytes)                    */
+    long int packed_bytes; /**< size of the compressed vectors (bytes)                            */
+    double   codec_time;   /**< time spent compressing or decompressing (s)                       */
+};
+
+typedef struct melissa_wire_s melissa_wire_t; /**< type corresponding to melissa_wire_s */
+
 int get_message_type(char* buff);
 
 void message_hello(zmq_msg_t *msg);
@@ -159,7 +194,8 @@ void message_simu_data (zmq_msg_t *msg,
                         int      vect_size,
                         int      nb_vect,
                         char*    field_name,
-                        double** data_ptr);
+                        double** data_ptr,
+                        melissa_wire_t *wire);
 
 int send_message_simu_data(int      time_stamp,
                              int      simu_id,
@@ -168,9 +204,42 @@ int send_message_simu_data(int      time_stamp,
                              int      nb_vect,
                              char*    field_name,
                              double** data_ptr,
+                             melissa_wire_t *wire,
                              void*    socket,
                              int      flags);
 
+size_t melissa_wire_size (int wire_format);
+
+void melissa_wire_encode (const double *src,
+                          int           nb_values,
+                          int           wire_format,
+                          void         *dest);
+
+void melissa_wire_decode (const void *src,
+                          int         nb_values,
+                          int         wire_format,
+                          double     *dest);
+
+void melissa_wire_init (melissa_wire_t *wire,
+                        int             format,
+                        int             codec,
+                        double          tolerance);
+
+void melissa_wire_free (melissa_wire_t *wire);
+
+int melissa_wire_check (const char           *payload,
+                        size_t                payload_size,
+                        int                   nb_vect,
+                        int                   vect_size,
+                        const melissa_wire_t *wire);
+
+int melissa_wire_unpack (const char     *payload,
+                         size_t          payload_size,
+                         int             nb_vect,
+                         int             vect_size,
+                         melissa_wire_t *wire,
+                         double         *dest);
+
 void read_message_simu_data (char*    msg_buffer,
                              int*     time_stamp,
                              int*     simu_id,
@@ -27,12 +27,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-//#include <unistd.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
 #include <sys/timeb.h>
+#include <sys/mman.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <ifaddrs.h>
@@ -269,6 +271,343 @@ void melissa_free (void *ptr)
     }
 }
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Initializes a memory arena. Large arenas are mapped anonymously, so their
+ * pages are zeroed by the kernel and first touched by the threads computing
+ * on them (NUMA placement), and are backed by transparent huge pages when
+ * available. A size of 0 creates a sizing arena: the allocations are made
+ * on the heap and only counted, to measure the size of the real arena.
+ *
+ *******************************************************************************
+ *
+ * @param[out] *arena
+ * The arena to initialize
+ *
+ * @param[in] size
+ * Number of bytes to reserve, 0 for a sizing arena
+ *
+ *******************************************************************************/
+
+void melissa_arena_init (melissa_arena_t *arena,
+                         size_t           size)
+{
+    void *ptr = NULL;
+
+    arena->base      = NULL;
+    arena->size      = size;
+    arena->used      = 0;
+    arena->is_mapped = 0;
+    arena->fd        = -1;
+    arena->sizing_bytes = NULL;
+    if (size == 0)
+    {
+        alloc_vector (&arena->sizing, 16);
+        return;
+    }
+    arena->sizing.items = NULL;
+    arena->sizing.size  = 0;
+
+    if (size >= MELISSA_HUGE_PAGE_SIZE)
+    {
+        ptr = mmap (NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (ptr != MAP_FAILED)
+        {
+#ifdef MADV_HUGEPAGE
+            madvise (ptr, size, MADV_HUGEPAGE);
+#endif // MADV_HUGEPAGE
+            arena->base      = ptr;
+            arena->is_mapped = 1;
+            return;
+        }
+    }
+    if (posix_memalign (&ptr, MELISSA_ALIGNMENT, size) != 0)
+    {
+        fprintf (stdout, "ERROR melissa_arena_init failed\n");
+        exit(0);
+    }
+    memset (ptr, 0, size);
+    arena->base = ptr;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Initializes a memory arena backed by an anonymous (unlinked) sparse file
+ * in dir. The pages are still only allocated when first touched, and parts
+ * of the arena can be written back to the file and dropped from memory with
+ * melissa_arena_release. They are read back transparently on the next access.
+ *
+ *******************************************************************************
+ *
+ * @param[out] *arena
+ * The arena to initialize
+ *
+ * @param[in] size
+ * Number of bytes to reserve
+ *
+ * @param[in] *dir
+ * Directory of the backing file
+ *
+ *******************************************************************************/
+
+void melissa_arena_init_file (melissa_arena_t *arena,
+                              size_t           size,
+                              const char      *dir)
+{
+    char  file_name[512];
+    void *ptr;
+    int   fd;
+
+    sprintf (file_name, "%s/melissa_arena.XXXXXX", dir);
+    fd = mkstemp (file_name);
+    if (fd < 0 || ftruncate (fd, size) != 0)
+    {
+        melissa_print (VERBOSE_WARNING, "Can not create %s, statistics kept in memory\n", file_name);
+        if (fd >= 0)
+        {
+            close (fd);
+            unlink (file_name);
+        }
+        melissa_arena_init (arena, size);
+        return;
+    }
+    unlink (file_name);
+    ptr = mmap (NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED)
+    {
+        close (fd);
+        melissa_arena_init (arena, size);
+        return;
+    }
+    arena->base      = ptr;
+    arena->size      = size;
+    arena->used      = 0;
+    arena->is_mapped = 1;
+    arena->fd        = fd;
+    arena->sizing.items = NULL;
+    arena->sizing.size  = 0;
+    arena->sizing_bytes = NULL;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Writes a part of a file backed arena to its file, and drops it from memory.
+ * Only the whole pages of [offset, offset+size) are released.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *arena
+ * The arena
+ *
+ * @param[in] offset
+ * Offset of the part to release
+ *
+ * @param[in] size
+ * Size of the part to release
+ *
+ * @return The number of bytes released, 0 if the arena is not file backed
+ *
+ *******************************************************************************/
+
+size_t melissa_arena_release (melissa_arena_t *arena,
+                              size_t           offset,
+                              size_t           size)
+{
+    size_t page = sysconf (_SC_PAGESIZE);
+    size_t first, last;
+
+    if (arena->fd < 0)
+    {
+        return 0;
+    }
+    first = (offset + page - 1) / page * page;
+    last  = (offset + size) / page * page;
+    if (last <= first)
+    {
+        return 0;
+    }
+    msync (arena->base + first, last - first, MS_SYNC);
+    madvise (arena->base + first, last - first, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise (arena->fd, first, last - first, POSIX_FADV_DONTNEED);
+#endif // POSIX_FADV_DONTNEED
+    return last - first;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Fills a part of an arena from a file. When the arena comes from an anonymous
+ * mmap and the part and the file offset are page aligned, the file is mapped
+ * copy-on-write over the part: the pages are only read when first accessed.
+ * Otherwise (heap arena, or file backed arena that may be released), the part
+ * is read from the file.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *arena
+ * The arena
+ *
+ * @param[in] offset
+ * Offset of the part to fill
+ *
+ * @param[in] size
+ * Size of the part to fill
+ *
+ * @param[in] fd
+ * File descriptor to read from, it can be closed afterwards
+ *
+ * @param[in] file_offset
+ * Offset of the data in the file
+ *
+ * @return 1 if the file is mapped, 0 if it is read, -1 on failure
+ *
+ *******************************************************************************/
+
+int melissa_arena_map_file (melissa_arena_t *arena,
+                            size_t           offset,
+                            size_t           size,
+                            int              fd,
+                            off_t            file_offset)
+{
+    size_t  page = sysconf (_SC_PAGESIZE);
+    size_t  done = 0;
+    ssize_t ret;
+
+    if (offset + size > arena->size)
+    {
+        return -1;
+    }
+    if (arena->is_mapped == 1 && arena->fd < 0 &&
+        (uintptr_t)(arena->base + offset) % page == 0 && file_offset % page == 0 && size % page == 0 &&
+        mmap (arena->base + offset, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, fd, file_offset) != MAP_FAILED)
+    {
+        return 1;
+    }
+    while (done < size)
+    {
+        ret = pread (fd, arena->base + offset + done, size - done, file_offset + done);
+        if (ret <= 0)
+        {
+            return -1;
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Gives zeroed memory from an arena, aligned on MELISSA_ALIGNMENT bytes.
+ * Without arena, falls back to melissa_calloc.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *arena
+ * The arena, or NULL
+ *
+ * @param[in] num
+ * Number of elements to allocate
+ *
+ * @param[in] size
+ * Size of one element
+ *
+ * @return The pointer to the allocated memory
+ *
+ *******************************************************************************/
+
+void* melissa_arena_calloc (melissa_arena_t *arena,
+                            size_t           num,
+                            size_t           size)
+{
+    void  *ptr;
+    size_t bytes;
+
+    if (arena == NULL)
+    {
+        return melissa_calloc (num, size);
+    }
+    bytes = (num * size + MELISSA_ALIGNMENT - 1) & ~((size_t)MELISSA_ALIGNMENT - 1);
+    if (arena->size == 0)
+    {
+        ptr = melissa_calloc (num, size);
+        vector_add (&arena->sizing, ptr);
+        // raw sizes, kept with the same capacity as the vector
+        arena->sizing_bytes = melissa_realloc (arena->sizing_bytes, arena->sizing.capacity * sizeof(size_t));
+        arena->sizing_bytes[arena->sizing.size - 1] = num * size;
+        arena->used += bytes;
+        return ptr;
+    }
+    if (arena->used + bytes > arena->size)
+    {
+        fprintf (stdout, "ERROR melissa_arena_calloc: arena too small (%zu + %zu > %zu)\n", arena->used, bytes, arena->size);
+        exit(0);
+    }
+    ptr = arena->base + arena->used;
+    arena->used += bytes;
+    return ptr;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * Releases all the memory of an arena at once
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *arena
+ * The arena to free
+ *
+ *******************************************************************************/
+
+void melissa_arena_free (melissa_arena_t *arena)
+{
+    int i;
+
+    if (arena->size == 0)
+    {
+        for (i=0; i<arena->sizing.size; i++)
+        {
+            melissa_free (vector_get (&arena->sizing, i));
+        }
+        free_vector (&arena->sizing);
+        melissa_free (arena->sizing_bytes);
+    }
+    else if (arena->is_mapped == 1)
+    {
+        munmap (arena->base, arena->size);
+        if (arena->fd >= 0)
+        {
+            close (arena->fd);
+        }
+    }
+    else
+    {
+        melissa_free (arena->base);
+    }
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+    arena->is_mapped = 0;
+    arena->fd = -1;
+}
+
 /**
  *******************************************************************************
  *
@@ -38,6 +38,8 @@ extern "C" {
 #endif // BUILD_WITH_MPI
 #include <stdio.h>
 #include <stdint.h>
+#include <sys/types.h>
+#include "vector.h"
 
 #ifndef MPI_MAX_PROCESSOR_NAME
 #define MPI_MAX_PROCESSOR_NAME 256 /**< Define the macro if mpi.h not present */
@@ -47,6 +49,14 @@ extern "C" {
 #define MAX_FIELD_NAME 128 /**< Define name size if not defined */
 #endif
 
+#ifndef MELISSA_BLOCK_SIZE
+#define MELISSA_BLOCK_SIZE 512 /**< Number of vector elements updated together, sized to stay in cache */
+#endif
+
+#define MELISSA_ALIGNMENT 64 /**< Alignment of the arena allocations (cache line, AVX-512 vector) */
+
+#define MELISSA_HUGE_PAGE_SIZE (2*1024*1024) /**< Arenas at least this large are backed by transparent huge pages */
+
 #define MELISSA_ERROR 0                           /**< display only errors  */
 #define MELISSA_WARNING 1                         /**< display errors and warnings  */
 #define MELISSA_INFO 2                            /**< display usefull messages */
@@ -72,6 +82,53 @@ void* melissa_realloc (void   *ptr,
 
 void melissa_free (void *ptr);
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * @struct melissa_arena_s
+ *
+ * Contiguous memory region in which allocations are carved one after the other
+ *
+ *******************************************************************************/
+
+struct melissa_arena_s
+{
+    char     *base;      /**< start of the region, NULL for a sizing arena            */
+    size_t    size;      /**< size of the region (bytes)                              */
+    size_t    used;      /**< bytes already given, multiple of MELISSA_ALIGNMENT      */
+    int       is_mapped; /**< 1 if the region comes from mmap                         */
+    int       fd;        /**< backing file of a spillable arena, -1 otherwise         */
+    vector_t  sizing;    /**< heap allocations of a sizing arena, freed with it       */
+    size_t   *sizing_bytes; /**< requested size of each allocation of a sizing arena   */
+};
+
+typedef struct melissa_arena_s melissa_arena_t; /**< type corresponding to melissa_arena_s */
+
+void melissa_arena_init (melissa_arena_t *arena,
+                         size_t           size);
+
+void melissa_arena_init_file (melissa_arena_t *arena,
+                              size_t           size,
+                              const char      *dir);
+
+size_t melissa_arena_release (melissa_arena_t *arena,
+                              size_t           offset,
+                              size_t           size);
+
+int melissa_arena_map_file (melissa_arena_t *arena,
+                            size_t           offset,
+                            size_t           size,
+                            int              fd,
+                            off_t            file_offset);
+
+void* melissa_arena_calloc (melissa_arena_t *arena,
+                            size_t           num,
+                            size_t           size);
+
+void melissa_arena_free (melissa_arena_t *arena);
+
 void melissa_bind (void       *socket,
                    const char *port_name);
 
@@ -41,6 +41,8 @@ STUDY_OPTIONS['checkpoint_interval'] = 300              # server checkpoints eve
 STUDY_OPTIONS['coupling'] = "MELISSA_COUPLING_DEFAULT"  # option for Sobol' simulation groups coupling
 STUDY_OPTIONS['verbosity'] = 2                          # verbosity: 0: only errors, 1: errors + warnings, 2: usefull infos (default), 3: debug infos
 STUDY_OPTIONS['batch_size'] = 1
+# STUDY_OPTIONS['quantile_estimator'] = "p2"            # optional server options, given to the server as --<key> <value>
+# STUDY_OPTIONS['async_checkpoint'] = True              # optional server switches, given to the server as --<key>
 
 MELISSA_STATS = {}
 MELISSA_STATS['mean'] = True
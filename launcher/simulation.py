@@ -473,7 +473,18 @@ class Server(Job):
                     logging.error('error bad option: no operation given')
                     return
             if Job.stdy_opt['disable_fault_tolerance'] == True:
-                self.cmd_opt += " --disable_fault_tolerancel"
+                self.cmd_opt += " --disable_fault_tolerance"
+            # server options with a value, forwarded when given in the study options
+            for key in ['ingest_threads', 'memory_budget', 'quantile_estimator',
+                        'compress_checkpoint', 'gather_output', 'output_deflate',
+                        'wire_format', 'wire_codec', 'wire_tolerance']:
+                if key in Job.stdy_opt and Job.stdy_opt[key] is not None:
+                    self.cmd_opt += ' --'+key+' '+str(Job.stdy_opt[key])
+            # server switches, forwarded when set to True
+            for key in ['async_checkpoint', 'mpi_io_checkpoint',
+                        'stream_output', 'columnar_output']:
+                if key in Job.stdy_opt and Job.stdy_opt[key] == True:
+                    self.cmd_opt += ' --'+key
 
 
     def launch(self):
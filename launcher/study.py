@@ -165,6 +165,8 @@ class Messenger(Thread):
                 elif message[0] == 'interval':
                     self.confidence_interval[message[1]] = float(message[3])
                     logging.info(message[1] + ' confidence interval: ' + message[3])
+                elif message[0] == 'converged':
+                    logging.info('Sobol indices converged on server rank ' + message[1])
 
                 if last_server > 0:
                     if self.server[0].status != RUNNING:
@@ -27,9 +27,186 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "compute_stats.h"
 #include "melissa_data.h"
 #include "melissa_utils.h"
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup intern_API
+ *
+ * This function updates the moments, min and max, threshold exceedances and
+ * quantiles of one time step in a single pass over the input vectors.
+ * The vectors are processed by blocks of MELISSA_BLOCK_SIZE elements, and every
+ * requested statistic is updated on a block while it is still in cache.
+ * With several input vectors, the batched kernels are used, and each block of
+ * the statistics is read and written once for the whole batch.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * pointer to the structure containing global parameters
+ *
+ * @param[in] time_step
+ * time step of the current simulations
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] simu_id[]
+ * ids of the simulations that produced the input vectors
+ *
+ * @param[in] **in_vects
+ * input vectors
+ *
+ *******************************************************************************/
+
+static void update_classical_stats (melissa_data_t *data,
+                                    const int       time_step,
+                                    const int       nb_vects,
+                                    const int       simu_id[],
+                                    double        **in_vects)
+{
+    int            i, j, last;
+    moments_t     *moments    = &(data->moments[time_step]);
+    min_max_t     *min_max    = NULL;
+    threshold_t   *thresholds = NULL;
+    quantile_t    *quantiles  = NULL;
+    p2_quantile_t *p2         = NULL;
+
+    // the increments are updated once, before the blocks
+    moments->increment += nb_vects;
+    if (data->options->min_and_max_op == 1)
+    {
+        min_max = &(data->min_max[time_step]);
+    }
+    if (data->options->threshold_op == 1)
+    {
+        thresholds = data->thresholds[time_step];
+    }
+    if (data->options->quantile_op == 1 && data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+    {
+        // one sketch for every quantile order, the quantiles are computed by finalize_stats
+        p2 = &(data->p2_quantiles[time_step]);
+        p2->increment += nb_vects;
+    }
+    else if (data->options->quantile_op == 1)
+    {
+        quantiles = data->quantiles[time_step];
+        for (j=0; j<data->options->nb_quantiles; j++)
+        {
+            quantiles[j].increment += nb_vects;
+        }
+    }
+
+#pragma omp parallel for schedule(static) private(j, last)
+    for (i=0; i<data->vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        last = (i+MELISSA_BLOCK_SIZE < data->vect_size) ? i+MELISSA_BLOCK_SIZE : data->vect_size;
+
+        if (nb_vects == 1)
+        {
+            increment_moments_block (moments, in_vects[0], i, last);
+        }
+        else
+        {
+            increment_moments_batch_block (moments, in_vects, nb_vects, i, last);
+        }
+
+        if (min_max != NULL)
+        {
+            min_and_max_batch_block (min_max, in_vects, simu_id, nb_vects, i, last);
+        }
+
+        if (thresholds != NULL)
+        {
+            for (j=0; j<data->options->nb_thresholds; j++)
+            {
+                update_threshold_exceedance_batch_block (&(thresholds[j]), in_vects, nb_vects, i, last);
+            }
+        }
+
+        if (quantiles != NULL)
+        {
+            for (j=0; j<data->options->nb_quantiles; j++)
+            {
+                if (nb_vects == 1)
+                {
+                    increment_quantile_block (&(quantiles[j]),
+                                              data->options->sampling_size,
+                                              in_vects[0],
+                                              i,
+                                              last);
+                }
+                else
+                {
+                    increment_quantile_batch_block (&(quantiles[j]),
+                                                    data->options->sampling_size,
+                                                    in_vects,
+                                                    nb_vects,
+                                                    i,
+                                                    last);
+                }
+            }
+        }
+
+        if (p2 != NULL)
+        {
+            increment_p2_quantile_batch_block (p2, in_vects, nb_vects, i, last);
+        }
+    }
+
+    if (min_max != NULL)
+    {
+        min_max->is_init = 1;
+    }
+}
+
+// Updates the Sobol convergence of a time step, and the worst interval and
+// number of converged time steps of the structure. Only the time step
+// holding the worst interval needs a scan of the time steps.
+static void update_sobol_convergence (melissa_data_t *data,
+                                      const int       time_step)
+{
+    int    t, converged;
+    double interval, worst;
+
+    interval = update_confidence_sobol_martinez (&(data->sobol_indices[time_step]),
+                                                 data->options->nb_parameters,
+                                                 data->vect_size,
+                                                 MELISSA_SOBOL_CONFIDENCE);
+    converged = data->sobol_converged_steps
+              + (interval <= MELISSA_SOBOL_CONFIDENCE)
+              - (data->sobol_intervals[time_step] <= MELISSA_SOBOL_CONFIDENCE);
+    data->sobol_intervals[time_step] = interval;
+
+    if (interval >= data->sobol_interval)
+    {
+        data->sobol_worst_step = time_step;
+        worst = interval;
+    }
+    else if (time_step == data->sobol_worst_step)
+    {
+        worst = 0;
+        for (t=0; t<data->options->nb_time_steps; t++)
+        {
+            if (data->sobol_intervals[t] > worst)
+            {
+                worst = data->sobol_intervals[t];
+                data->sobol_worst_step = t;
+            }
+        }
+    }
+    else
+    {
+        worst = data->sobol_interval;
+    }
+    // read by the main thread when the compute threads are used
+    __atomic_store (&data->sobol_interval, &worst, __ATOMIC_RELAXED);
+    __atomic_store_n (&data->sobol_converged_steps, converged, __ATOMIC_RELEASE);
+}
+
 /**
  *******************************************************************************
  *
@@ -45,6 +222,9 @@
  * @param[in] time_step
  * time step of the current simulation
  *
+ * @param[in] simu_id
+ * id of the current simulation
+ *
  * @param[in] nb_vect
  * number of input vectors
  *
@@ -59,87 +239,184 @@ void compute_stats (melissa_data_t  *data,
                     const int        nb_vect,
                     double         **in_vect_tab)
 {
-    int i;
+    compute_stats_batch (data, time_step, 1, &simu_id, nb_vect, &in_vect_tab);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup intern_API
+ *
+ * This function updates the statistics stored in the data structure with the
+ * messages of several simulations, for the same time step
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * pointer to the structure containing global parameters
+ *
+ * @param[in] time_step
+ * time step of the current simulations
+ *
+ * @param[in] nb_simu
+ * number of simulation messages
+ *
+ * @param[in] simu_id[]
+ * ids of the simulations, size nb_simu
+ *
+ * @param[in] nb_vect
+ * number of input vectors per message
+ *
+ * @param[in] ***in_vect_tabs
+ * arrays of input vectors, size nb_simu
+ *
+ *******************************************************************************/
+
+void compute_stats_batch (melissa_data_t  *data,
+                          const int        time_step,
+                          const int        nb_simu,
+                          const int        simu_id[],
+                          const int        nb_vect,
+                          double        ***in_vect_tabs)
+{
+    int     first, nb, k;
+    double *vects[MELISSA_BATCH_SIZE];
 
     if (data->is_valid != 1)
     {
         melissa_print (VERBOSE_ERROR, "Data structure not valid (compute_stats)\n");
         exit (1);
     }
-
-    increment_moments(&(data->moments[time_step]), in_vect_tab[0], data->vect_size);
-
-    if (data->options->min_and_max_op == 1)
+    if (data->options->sobol_op == 1 && nb_vect != data->options->nb_parameters + 2)
     {
-        min_and_max (&(data->min_max[time_step]),
-                     in_vect_tab[0],
-                     simu_id,
-                     data->vect_size);
+        melissa_print (VERBOSE_ERROR, "Invalid vector number (compute_stats)\n");
+        exit (1);
     }
 
-    if (data->options->threshold_op == 1)
+    for (first=0; first<nb_simu; first+=MELISSA_BATCH_SIZE)
     {
-        for (i=0; i<data->options->nb_thresholds; i++)
+        nb = (nb_simu - first < MELISSA_BATCH_SIZE) ? nb_simu - first : MELISSA_BATCH_SIZE;
+
+        for (k=0; k<nb; k++)
         {
-            update_threshold_exceedance (&(data->thresholds[time_step][i]),
-                                         in_vect_tab[0],
-                                         data->vect_size);
+            vects[k] = in_vect_tabs[first+k][0];
         }
-    }
+        update_classical_stats (data, time_step, nb, &simu_id[first], vects);
 
-    if (data->options->quantile_op == 1)
-    {
-        for (i=0; i<data->options->nb_quantiles; i++)
+        if (data->options->sobol_op == 1)
         {
-            increment_quantile (&(data->quantiles[time_step][i]),
-                                data->options->sampling_size,
-                                in_vect_tab[0],
-                                data->vect_size);
+            if (nb == 1)
+            {
+                data->increment_sobol (&(data->sobol_indices[time_step]),
+                                       data->options->nb_parameters,
+                                       in_vect_tabs[first],
+                                       data->vect_size);
+            }
+            else
+            {
+                data->increment_sobol_batch (&(data->sobol_indices[time_step]),
+                                             data->options->nb_parameters,
+                                             &in_vect_tabs[first],
+                                             nb,
+                                             data->vect_size);
+            }
+
+            for (k=0; k<nb; k++)
+            {
+                vects[k] = in_vect_tabs[first+k][1];
+            }
+            update_classical_stats (data, time_step, nb, &simu_id[first], vects);
         }
     }
 
     if (data->options->sobol_op == 1)
     {
-        if (nb_vect != data->options->nb_parameters + 2)
-        {
-            melissa_print (VERBOSE_ERROR, "Invalid vector number (compute_stats)\n");
-            exit (1);
-        }
-        data->increment_sobol (&(data->sobol_indices[time_step]),
-                               data->options->nb_parameters,
-                               in_vect_tab,
-                               data->vect_size);
+        update_sobol_convergence (data, time_step);
+    }
+}
 
-        increment_moments(&(data->moments[time_step]), in_vect_tab[1], data->vect_size);
+/**
+ *******************************************************************************
+ *
+ * @ingroup intern_API
+ *
+ * This function rebuilds the Sobol convergence of every time step from
+ * restored indices. The time steps completed before a checkpoint get no more
+ * messages, so their intervals are not updated by compute_stats.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * pointer to the structure containing global parameters
+ *
+ *******************************************************************************/
 
-        if (data->options->min_and_max_op == 1)
-        {
-            min_and_max (&(data->min_max[time_step]),
-                         in_vect_tab[1],
-                         simu_id,
-                         data->vect_size);
-        }
+void restore_sobol_convergence (melissa_data_t *data)
+{
+    int    t;
+    int    converged = 0;
+    double interval;
+    double worst = 0;
 
-        if (data->options->threshold_op == 1)
+    if (data->options->sobol_op != 1)
+    {
+        return;
+    }
+    data->sobol_worst_step = 0;
+    for (t=0; t<data->options->nb_time_steps; t++)
+    {
+        // the last check of the restored indices is not known
+        data->sobol_indices[t].checked_iteration = 0;
+        interval = update_confidence_sobol_martinez (&(data->sobol_indices[t]),
+                                                     data->options->nb_parameters,
+                                                     data->vect_size,
+                                                     MELISSA_SOBOL_CONFIDENCE);
+        data->sobol_intervals[t] = interval;
+        converged += (interval <= MELISSA_SOBOL_CONFIDENCE);
+        if (interval > worst)
         {
-            for (i=0; i<data->options->nb_thresholds; i++)
-            {
-                update_threshold_exceedance (&(data->thresholds[time_step][i]),
-                                             in_vect_tab[1],
-                                             data->vect_size);
-            }
+            worst = interval;
+            data->sobol_worst_step = t;
         }
+    }
+    __atomic_store (&data->sobol_interval, &worst, __ATOMIC_RELAXED);
+    __atomic_store_n (&data->sobol_converged_steps, converged, __ATOMIC_RELEASE);
+}
 
-        if (data->options->quantile_op == 1)
-        {
-            for (i=0; i<data->options->nb_quantiles; i++)
-            {
-                increment_quantile (&(data->quantiles[time_step][i]),
-                                    data->options->sampling_size,
-                                    in_vect_tab[1],
-                                    data->vect_size);
-            }
-        }
+/**
+ *******************************************************************************
+ *
+ * @ingroup intern_API
+ *
+ * This function finalize the statistics of one time step, once every
+ * simulation sent it
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * pointer to the structure containing global parameters
+ *
+ * @param[in] time_step
+ * time step to finalize
+ *
+ *******************************************************************************/
+
+void finalize_step_stats (melissa_data_t *data,
+                          int             time_step)
+{
+    if (data->options->sobol_op == 1)
+    {
+        // the Sobol indices are not updated by the increments
+        compute_sobol_martinez_values (&(data->sobol_indices[time_step]),
+                                       data->options->nb_parameters,
+                                       data->vect_size);
+    }
+    if (data->options->quantile_op == 1 && data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+    {
+        compute_p2_quantiles (&(data->p2_quantiles[time_step]),
+                              data->quantiles[time_step],
+                              data->options->nb_quantiles,
+                              data->vect_size);
     }
 }
 
@@ -159,6 +436,13 @@ void compute_stats (melissa_data_t  *data,
 
 void finalize_stats (melissa_data_t *data)
 {
+    int time_step;
+
+    for (time_step = 0; time_step<data->options->nb_time_steps; time_step++)
+    {
+        finalize_step_stats (data, time_step);
+    }
+
 //    int time_step;
 //    for (time_step = 0; time_step<data->options->nb_time_steps; time_step++)
 //    {
@@ -31,12 +31,27 @@ extern "C" {
 
 #include "melissa_data.h"
 
+#define MELISSA_BATCH_SIZE 16 /**< maximum number of simulation messages computed together */
+#define MELISSA_SOBOL_CONFIDENCE 0.01 /**< width of the Sobol confidence intervals to reach for convergence */
+
 void compute_stats (melissa_data_t  *data,
                     const int        time_step,
                     const int        simu_id,
                     const int        nb_vect,
                     double         **in_vect_tab);
 
+void compute_stats_batch (melissa_data_t  *data,
+                          const int        time_step,
+                          const int        nb_simu,
+                          const int        simu_id[],
+                          const int        nb_vect,
+                          double        ***in_vect_tabs);
+
+void restore_sobol_convergence (melissa_data_t *data);
+
+void finalize_step_stats (melissa_data_t *data,
+                          int             time_step);
+
 void finalize_stats (melissa_data_t *data);
 
 #ifdef __cplusplus
@@ -51,6 +51,8 @@ melissa_simulation_t* add_simulation()
     sprintf (simu->job_id, "0");
     simu->job_status = -1;
     simu->parameters = NULL;
+    simu->nb_received = 0;
+    simu->nb_last_received = 0;
 
     return simu;
 }
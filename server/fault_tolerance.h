@@ -52,6 +52,8 @@ struct melissa_simulation_s
     char   job_id[255];    /**< simulation job ID */
     int    job_status;     /**< simulation job status */
     double *parameters;    /**< simulation parameter set */
+    int    nb_received;    /**< number of (field, client rank, time step) messages recieved */
+    int    nb_last_received; /**< number of (field, client rank) last time step messages recieved */
 };
 
 typedef struct melissa_simulation_s melissa_simulation_t; /**< type corresponding to melissa_simulation_s */
@@ -0,0 +1,332 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_checkpoint.c
+ * @brief Background writing of the server checkpoints.
+ * @author Terraz Théophile
+ * @date 2019-03-11
+ *
+ * @defgroup melissa_checkpoint Melissa background checkpoints
+ *
+ * The control thread serialises the checkpoint files in memory (the same
+ * format as the synchronous checkpoint), so the statistics are only blocked
+ * for a memory copy. An I/O thread then writes the buffers to temporary files,
+ * and renames them once written, so that an interrupted checkpoint never
+ * replaces the previous one. Appended files (incremental checkpoint logs) are
+ * written in place, their records carry their own size. The next checkpoint waits for the previous one
+ * to be written: there is at most one checkpoint in memory.
+ *
+ * If a file can not be written, the temporary file is not renamed, an
+ * appended file is truncated back to its previous size, and the remaining
+ * files of the checkpoint are dropped, so the files on disc are still those
+ * of a previous checkpoint. The failure is returned by the next wait.
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "melissa_checkpoint.h"
+#include "melissa_utils.h"
+
+static void* checkpoint_loop (void *arg)
+{
+    melissa_checkpoint_t *checkpoint = (melissa_checkpoint_t*)arg;
+    melissa_checkpoint_file_t *file;
+    char   tmp_name[260];
+    FILE  *f;
+    long   old_size;
+    int    i, failed;
+    double start;
+
+    pthread_mutex_lock (&checkpoint->mutex);
+    while (1)
+    {
+        while (checkpoint->pending == 0 && checkpoint->stop == 0)
+        {
+            pthread_cond_wait (&checkpoint->cond, &checkpoint->mutex);
+        }
+        if (checkpoint->pending == 0)
+        {
+            break;
+        }
+        pthread_mutex_unlock (&checkpoint->mutex);
+
+        start = melissa_get_time ();
+        failed = 0;
+        for (i=0; i<checkpoint->nb_files; i++)
+        {
+            file = checkpoint->files[i];
+            old_size = 0;
+            if (failed != 0)
+            {
+                // the files already on disc stay those of the previous checkpoint
+                f = NULL;
+            }
+            else if (file->append != 0)
+            {
+                strcpy (tmp_name, file->name);
+                f = fopen (tmp_name, "ab");
+                if (f != NULL && fseek (f, 0, SEEK_END) == 0)
+                {
+                    old_size = ftell (f);
+                }
+            }
+            else
+            {
+                sprintf (tmp_name, "%s.tmp", file->name);
+                f = fopen (tmp_name, "wb");
+            }
+            if (failed == 0)
+            {
+                if (f == NULL || fwrite (file->buffer, 1, file->size, f) != file->size)
+                {
+                    failed = 1;
+                }
+                if (f != NULL && fclose (f) != 0)
+                {
+                    failed = 1;
+                }
+                if (failed == 0 && file->append == 0 && rename (tmp_name, file->name) != 0)
+                {
+                    failed = 1;
+                }
+                if (failed != 0)
+                {
+                    melissa_print (VERBOSE_WARNING, "Can not write %s\n", tmp_name);
+                    if (f != NULL && file->append != 0)
+                    {
+                        // no partial record is left in the log
+                        truncate (tmp_name, old_size);
+                    }
+                    else if (f != NULL)
+                    {
+                        unlink (tmp_name);
+                    }
+                }
+            }
+            free (file->buffer);
+            melissa_free (file);
+            checkpoint->files[i] = NULL;
+        }
+
+        pthread_mutex_lock (&checkpoint->mutex);
+        checkpoint->write_time += melissa_get_time () - start;
+        checkpoint->failed += failed;
+        checkpoint->nb_files = 0;
+        checkpoint->pending = 0;
+        pthread_cond_broadcast (&checkpoint->cond);
+    }
+    pthread_mutex_unlock (&checkpoint->mutex);
+    return NULL;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_checkpoint
+ *
+ * This function starts the checkpoint I/O thread
+ *
+ *******************************************************************************
+ *
+ * @return A pointer to the background checkpoint writer
+ *
+ *******************************************************************************/
+
+melissa_checkpoint_t* melissa_checkpoint_start (void)
+{
+    melissa_checkpoint_t *checkpoint;
+
+    checkpoint = melissa_calloc (1, sizeof(melissa_checkpoint_t));
+    pthread_mutex_init (&checkpoint->mutex, NULL);
+    pthread_cond_init (&checkpoint->cond, NULL);
+    checkpoint->max_files = 16;
+    checkpoint->files = melissa_calloc (checkpoint->max_files, sizeof(melissa_checkpoint_file_t*));
+    if (pthread_create (&checkpoint->thread, NULL, checkpoint_loop, checkpoint) != 0)
+    {
+        melissa_print (VERBOSE_ERROR, "Can not start checkpoint thread\n");
+        exit (1);
+    }
+    return checkpoint;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_checkpoint
+ *
+ * This function adds a file to the next checkpoint, and returns a stream to
+ * write its content in memory. The previous checkpoint must be written
+ * (melissa_checkpoint_wait).
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *checkpoint
+ * pointer to the background checkpoint writer
+ *
+ * @param[in] *file_name
+ * name of the file to write
+ *
+ * @param[in] append
+ * 1 to append the content to the file, 0 to replace the file
+ *
+ * @return The stream to write to, closed by melissa_checkpoint_submit
+ *
+ *******************************************************************************/
+
+FILE* melissa_checkpoint_open (melissa_checkpoint_t *checkpoint,
+                               const char           *file_name,
+                               int                   append)
+{
+    melissa_checkpoint_file_t *file;
+
+    if (checkpoint->nb_files == checkpoint->max_files)
+    {
+        checkpoint->max_files *= 2;
+        checkpoint->files = realloc (checkpoint->files, checkpoint->max_files * sizeof(melissa_checkpoint_file_t*));
+        if (checkpoint->files == NULL)
+        {
+            melissa_print (VERBOSE_ERROR, "Checkpoint allocation failed\n");
+            exit (1);
+        }
+    }
+    file = melissa_malloc (sizeof(melissa_checkpoint_file_t));
+    checkpoint->files[checkpoint->nb_files] = file;
+    strncpy (file->name, file_name, sizeof(file->name) - 1);
+    file->name[sizeof(file->name) - 1] = '\0';
+    file->buffer = NULL;
+    file->size   = 0;
+    file->append = append;
+    file->stream = open_memstream (&file->buffer, &file->size);
+    if (file->stream == NULL)
+    {
+        melissa_print (VERBOSE_ERROR, "Can not open a memory stream for %s\n", file_name);
+        exit (1);
+    }
+    checkpoint->nb_files += 1;
+    return file->stream;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_checkpoint
+ *
+ * This function closes the streams of the checkpoint files, and hands them to
+ * the I/O thread
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *checkpoint
+ * pointer to the background checkpoint writer
+ *
+ *******************************************************************************/
+
+void melissa_checkpoint_submit (melissa_checkpoint_t *checkpoint)
+{
+    int i;
+
+    for (i=0; i<checkpoint->nb_files; i++)
+    {
+        fclose (checkpoint->files[i]->stream);
+        checkpoint->files[i]->stream = NULL;
+    }
+    pthread_mutex_lock (&checkpoint->mutex);
+    checkpoint->pending = 1;
+    pthread_cond_broadcast (&checkpoint->cond);
+    pthread_mutex_unlock (&checkpoint->mutex);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_checkpoint
+ *
+ * This function waits until the submitted checkpoint is written
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *checkpoint
+ * pointer to the background checkpoint writer
+ *
+ * @param[in,out] *write_time
+ * incremented by the time spent by the I/O thread writing since the last call
+ *
+ * @return 0 if the checkpoints submitted since the last call are written, -1
+ * if one of them could not be written
+ *
+ *******************************************************************************/
+
+int melissa_checkpoint_wait (melissa_checkpoint_t *checkpoint,
+                             double               *write_time)
+{
+    int ret;
+
+    pthread_mutex_lock (&checkpoint->mutex);
+    while (checkpoint->pending != 0)
+    {
+        pthread_cond_wait (&checkpoint->cond, &checkpoint->mutex);
+    }
+    *write_time += checkpoint->write_time;
+    checkpoint->write_time = 0.0;
+    ret = (checkpoint->failed != 0) ? -1 : 0;
+    checkpoint->failed = 0;
+    pthread_mutex_unlock (&checkpoint->mutex);
+    return ret;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_checkpoint
+ *
+ * This function waits for the submitted checkpoint, stops the I/O thread and
+ * frees the checkpoint writer
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *checkpoint
+ * pointer to the background checkpoint writer
+ *
+ * @param[in,out] *write_time
+ * incremented by the time spent by the I/O thread writing since the last call
+ *
+ * @return 0 if the checkpoints submitted since the last call are written, -1
+ * if one of them could not be written
+ *
+ *******************************************************************************/
+
+int melissa_checkpoint_stop (melissa_checkpoint_t *checkpoint,
+                             double               *write_time)
+{
+    int ret;
+
+    ret = melissa_checkpoint_wait (checkpoint, write_time);
+    pthread_mutex_lock (&checkpoint->mutex);
+    checkpoint->stop = 1;
+    pthread_cond_broadcast (&checkpoint->cond);
+    pthread_mutex_unlock (&checkpoint->mutex);
+    pthread_join (checkpoint->thread, NULL);
+    pthread_cond_destroy (&checkpoint->cond);
+    pthread_mutex_destroy (&checkpoint->mutex);
+    melissa_free (checkpoint->files);
+    melissa_free (checkpoint);
+    return ret;
+}
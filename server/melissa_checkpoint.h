@@ -0,0 +1,100 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_checkpoint.h
+ * @author Terraz Théophile
+ * @date 2019-03-11
+ *
+ **/
+
+#ifndef MELISSA_CHECKPOINT_H
+#define MELISSA_CHECKPOINT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <pthread.h>
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_checkpoint_file_s
+ *
+ * Structure describing one checkpoint file, serialised in memory
+ *
+ *******************************************************************************/
+
+struct melissa_checkpoint_file_s
+{
+    char    name[256]; /**< name of the file                         */
+    FILE   *stream;    /**< memory stream, open until submission     */
+    char   *buffer;    /**< content of the file                      */
+    size_t  size;      /**< size of the content (bytes)              */
+    int     append;    /**< 1 to append to the file, 0 to replace it */
+};
+
+typedef struct melissa_checkpoint_file_s melissa_checkpoint_file_t; /**< type corresponding to melissa_checkpoint_file_s */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_checkpoint_s
+ *
+ * Background checkpoint writer: the control thread serialises the
+ * statistics in memory buffers, and an I/O thread writes them out
+ *
+ *******************************************************************************/
+
+struct melissa_checkpoint_s
+{
+    pthread_t                   thread;     /**< I/O thread                                                */
+    pthread_mutex_t             mutex;      /**< protects the fields below                                 */
+    pthread_cond_t              cond;       /**< signaled when a checkpoint is submitted or written        */
+    melissa_checkpoint_file_t **files;      /**< files of the current checkpoint, at fixed addresses for
+                                                 the memory streams                                        */
+    int                         nb_files;   /**< number of files of the current checkpoint                 */
+    int                         max_files;  /**< allocated size of files                                   */
+    int                         pending;    /**< 1 while the I/O thread writes the checkpoint              */
+    int                         stop;       /**< 1 when the I/O thread must exit                           */
+    double                      write_time; /**< writing time not reported yet (seconds)                   */
+    int                         failed;     /**< number of checkpoints not written, not reported yet       */
+};
+
+typedef struct melissa_checkpoint_s melissa_checkpoint_t; /**< type corresponding to melissa_checkpoint_s */
+
+melissa_checkpoint_t* melissa_checkpoint_start (void);
+
+FILE* melissa_checkpoint_open (melissa_checkpoint_t *checkpoint,
+                               const char           *file_name,
+                               int                   append);
+
+void melissa_checkpoint_submit (melissa_checkpoint_t *checkpoint);
+
+int melissa_checkpoint_wait (melissa_checkpoint_t *checkpoint,
+                             double               *write_time);
+
+int melissa_checkpoint_stop (melissa_checkpoint_t *checkpoint,
+                             double               *write_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELISSA_CHECKPOINT_H
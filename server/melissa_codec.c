@@ -0,0 +1,325 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_codec.c
+ * @brief Lossless compression of the checkpoint slabs.
+ * @author Terraz Théophile
+ * @date 2019-04-02
+ *
+ * @defgroup melissa_codec checkpoint compression
+ *
+ * The slabs of a time step are mostly arrays of doubles. They are
+ * byte-shuffled then compressed in the LZ4 block format (melissa_lz4.c).
+ *
+ * The time steps are compressed and decompressed by a group of threads, one
+ * time step each.
+ *
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "melissa_codec.h"
+#include "melissa_utils.h"
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_codec_job_s
+ *
+ * Time steps compressed or decompressed by a group of threads. Thread i
+ * handles the time steps i, i + nb_threads, ...
+ *
+ *******************************************************************************/
+
+struct melissa_codec_job_s
+{
+    char              *base;       /**< first slab in memory                                */
+    size_t             step_size;  /**< distance between two slabs in memory                */
+    size_t             slab_size;  /**< bytes of a slab in the file                         */
+    int                nb_steps;   /**< number of time steps                                */
+    int                nb_threads; /**< number of threads, the calling thread included      */
+    int64_t           *sizes;      /**< compressed size of each time step                   */
+    off_t             *offsets;    /**< offset of each compressed time step (reading only)  */
+    int                fd;         /**< file to read (reading only)                         */
+    FILE              *f;          /**< stream to write (writing only)                      */
+    char             **shuffled;   /**< shuffled slab of each thread, slab_size bytes       */
+    char             **packed;     /**< compressed slab of each thread                      */
+    pthread_barrier_t  barrier;    /**< rounds of nb_threads time steps (writing only)      */
+    int                error;      /**< 1 if a time step can not be read                    */
+};
+
+typedef struct melissa_codec_job_s melissa_codec_job_t; /**< type corresponding to melissa_codec_job_s */
+
+struct melissa_codec_thread_s
+{
+    melissa_codec_job_t *job; /**< shared job          */
+    int                  id;  /**< rank of the thread  */
+};
+
+typedef struct melissa_codec_thread_s melissa_codec_thread_t; /**< type corresponding to melissa_codec_thread_s */
+
+// the time steps are written in order: each round, every thread compresses
+// one time step, then the calling thread writes them
+static void* write_loop (void *arg)
+{
+    melissa_codec_thread_t *thread = (melissa_codec_thread_t*)arg;
+    melissa_codec_job_t    *job = thread->job;
+    int                     i, t, round;
+
+    for (round=0; round*job->nb_threads < job->nb_steps; round++)
+    {
+        t = round * job->nb_threads + thread->id;
+        if (t < job->nb_steps)
+        {
+            melissa_shuffle (job->base + t * job->step_size, job->slab_size, sizeof(double), job->shuffled[thread->id]);
+            job->sizes[t] = melissa_lz4_compress (job->shuffled[thread->id], job->slab_size, job->packed[thread->id]);
+        }
+        pthread_barrier_wait (&job->barrier);
+        if (thread->id == 0)
+        {
+            for (i=0; i<job->nb_threads && round * job->nb_threads + i < job->nb_steps; i++)
+            {
+                fwrite (job->packed[i], 1, job->sizes[round * job->nb_threads + i], job->f);
+            }
+        }
+        // the buffers are reused by the next round
+        pthread_barrier_wait (&job->barrier);
+    }
+    return NULL;
+}
+
+static void* read_loop (void *arg)
+{
+    melissa_codec_thread_t *thread = (melissa_codec_thread_t*)arg;
+    melissa_codec_job_t    *job = thread->job;
+    char                   *packed = job->packed[thread->id];
+    char                   *shuffled = job->shuffled[thread->id];
+    ssize_t                 ret;
+    int64_t                 done;
+    int                     t;
+
+    for (t=thread->id; t<job->nb_steps; t+=job->nb_threads)
+    {
+        for (done=0; done<job->sizes[t]; done+=ret)
+        {
+            ret = pread (job->fd, packed + done, job->sizes[t] - done, job->offsets[t] + done);
+            if (ret <= 0)
+            {
+                __atomic_store_n (&job->error, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+        }
+        if (melissa_lz4_decompress (packed, job->sizes[t], shuffled, job->slab_size) != 0)
+        {
+            __atomic_store_n (&job->error, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        if (job->slab_size == job->step_size)
+        {
+            melissa_unshuffle (shuffled, job->slab_size, sizeof(double), job->base + t * job->step_size);
+        }
+        else
+        {
+            // slabs padded to other pages: same content, other padding
+            melissa_unshuffle (shuffled, job->slab_size, sizeof(double), packed);
+            memcpy (job->base + t * job->step_size, packed, (job->slab_size < job->step_size) ? job->slab_size : job->step_size);
+        }
+    }
+    return NULL;
+}
+
+// runs loop on nb_threads threads, the calling thread being the first one
+static void run_job (melissa_codec_job_t *job,
+                     void*              (*loop)(void*))
+{
+    melissa_codec_thread_t *threads;
+    pthread_t              *ids;
+    int                     i;
+
+    threads = melissa_malloc (job->nb_threads * sizeof(melissa_codec_thread_t));
+    ids     = melissa_malloc (job->nb_threads * sizeof(pthread_t));
+    job->shuffled = melissa_malloc (job->nb_threads * sizeof(char*));
+    job->packed   = melissa_malloc (job->nb_threads * sizeof(char*));
+    for (i=0; i<job->nb_threads; i++)
+    {
+        threads[i].job = job;
+        threads[i].id  = i;
+        job->shuffled[i] = melissa_malloc (job->slab_size);
+        job->packed[i]   = melissa_malloc (melissa_codec_bound (job->slab_size));
+    }
+    for (i=1; i<job->nb_threads; i++)
+    {
+        if (pthread_create (&ids[i], NULL, loop, &threads[i]) != 0)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not start the compression threads\n");
+            exit (1);
+        }
+    }
+    loop (&threads[0]);
+    for (i=1; i<job->nb_threads; i++)
+    {
+        pthread_join (ids[i], NULL);
+    }
+    for (i=0; i<job->nb_threads; i++)
+    {
+        melissa_free (job->shuffled[i]);
+        melissa_free (job->packed[i]);
+    }
+    melissa_free (job->shuffled);
+    melissa_free (job->packed);
+    melissa_free (ids);
+    melissa_free (threads);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_codec
+ *
+ * This function compresses the slabs of the time steps and writes them one
+ * after the other in a stream, at its current position
+ *
+ *******************************************************************************
+ *
+ * @param[in] *base
+ * first slab in memory
+ *
+ * @param[in] step_size
+ * size of a slab, and distance between two slabs (bytes)
+ *
+ * @param[in] nb_steps
+ * number of time steps
+ *
+ * @param[in] nb_threads
+ * number of compression threads, the calling thread included
+ *
+ * @param[out] *sizes
+ * compressed size of each time step
+ *
+ * @param[in] *f
+ * stream to write to
+ *
+ * @return the number of bytes written
+ *
+ *******************************************************************************/
+
+int64_t melissa_codec_write_steps (const char *base,
+                                   size_t      step_size,
+                                   int         nb_steps,
+                                   int         nb_threads,
+                                   int64_t    *sizes,
+                                   FILE       *f)
+{
+    melissa_codec_job_t job;
+    int64_t             total = 0;
+    int                 t;
+
+    memset (&job, 0, sizeof(job));
+    job.base       = (char*)base;
+    job.step_size  = step_size;
+    job.slab_size  = step_size;
+    job.nb_steps   = nb_steps;
+    job.nb_threads = (nb_threads < nb_steps) ? nb_threads : nb_steps;
+    job.nb_threads = (job.nb_threads > 0) ? job.nb_threads : 1;
+    job.sizes      = sizes;
+    job.f          = f;
+    pthread_barrier_init (&job.barrier, NULL, job.nb_threads);
+    run_job (&job, write_loop);
+    pthread_barrier_destroy (&job.barrier);
+    for (t=0; t<nb_steps; t++)
+    {
+        total += sizes[t];
+    }
+    return total;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_codec
+ *
+ * This function reads the compressed slabs written by melissa_codec_write_steps
+ *
+ *******************************************************************************
+ *
+ * @param[out] *base
+ * first slab in memory
+ *
+ * @param[in] step_size
+ * distance between two slabs in memory (bytes)
+ *
+ * @param[in] slab_size
+ * size of a slab in the file (bytes)
+ *
+ * @param[in] nb_steps
+ * number of time steps
+ *
+ * @param[in] nb_threads
+ * number of decompression threads, the calling thread included
+ *
+ * @param[in] *sizes
+ * compressed size of each time step
+ *
+ * @param[in] fd
+ * file to read
+ *
+ * @param[in] offset
+ * offset of the first compressed slab in the file
+ *
+ * @return 0 on success, -1 if a slab can not be read
+ *
+ *******************************************************************************/
+
+int melissa_codec_read_steps (char          *base,
+                              size_t         step_size,
+                              size_t         slab_size,
+                              int            nb_steps,
+                              int            nb_threads,
+                              const int64_t *sizes,
+                              int            fd,
+                              off_t          offset)
+{
+    melissa_codec_job_t job;
+    int                 t;
+
+    memset (&job, 0, sizeof(job));
+    job.base       = base;
+    job.step_size  = step_size;
+    job.slab_size  = slab_size;
+    job.nb_steps   = nb_steps;
+    job.nb_threads = (nb_threads < nb_steps) ? nb_threads : nb_steps;
+    job.nb_threads = (job.nb_threads > 0) ? job.nb_threads : 1;
+    job.sizes      = (int64_t*)sizes;
+    job.fd         = fd;
+    job.offsets    = melissa_malloc (nb_steps * sizeof(off_t));
+    for (t=0; t<nb_steps; t++)
+    {
+        if (sizes[t] < 0 || (size_t)sizes[t] > melissa_codec_bound (slab_size))
+        {
+            melissa_free (job.offsets);
+            return -1;
+        }
+        job.offsets[t] = offset;
+        offset += sizes[t];
+    }
+    run_job (&job, read_loop);
+    melissa_free (job.offsets);
+    return (job.error == 0) ? 0 : -1;
+}
@@ -0,0 +1,60 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_codec.h
+ * @author Terraz Théophile
+ * @date 2019-04-02
+ *
+ **/
+
+#ifndef MELISSA_CODEC_H
+#define MELISSA_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "melissa_lz4.h"
+
+#define MELISSA_CODEC_NONE 0 /**< slabs stored as they are in memory                 */
+#define MELISSA_CODEC_LZ4  1 /**< slabs byte-shuffled then compressed in LZ4 blocks */
+
+int64_t melissa_codec_write_steps (const char *base,
+                                   size_t      step_size,
+                                   int         nb_steps,
+                                   int         nb_threads,
+                                   int64_t    *sizes,
+                                   FILE       *f);
+
+int melissa_codec_read_steps (char          *base,
+                              size_t         step_size,
+                              size_t         slab_size,
+                              int            nb_steps,
+                              int            nb_threads,
+                              const int64_t *sizes,
+                              int            fd,
+                              off_t          offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELISSA_CODEC_H
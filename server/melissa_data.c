@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "melissa_data.h"
 #include "melissa_utils.h"
 #include "sobol.h"
@@ -46,122 +47,200 @@ static void melissa_init_steps (melissa_data_t *data)
 
     if (data->steps_init == 0)
     {
-        alloc_vector (&data->step_simu, data->options->sampling_size);
-        for (i=0; i<data->options->sampling_size; i++)
+        alloc_bitmap (&data->step_simu, data->options->sampling_size, data->options->nb_time_steps);
+        data->step_received = melissa_calloc (data->options->nb_time_steps, sizeof(int));
+        data->sobol_intervals = NULL;
+        if (data->options->sobol_op == 1)
         {
-            vector_add (&data->step_simu, melissa_calloc((data->options->nb_time_steps+31)/32, sizeof(int32_t)));
+            data->sobol_intervals = melissa_malloc (data->options->nb_time_steps * sizeof(double));
+            for (i=0; i<data->options->nb_time_steps; i++)
+            {
+                data->sobol_intervals[i] = 2.0;
+            }
         }
+        data->sobol_interval        = 2.0;
+        data->sobol_worst_step      = 0;
+        data->sobol_converged_steps = 0;
+        data->checkpoint_generation = 0;
+        data->checkpoint_base_size  = 0;
+        data->checkpoint_delta_size = 0;
         data->steps_init = 1;
     }
 }
 
-static void melissa_alloc_data (melissa_data_t *data)
+static int melissa_moments_order (melissa_options_t *options)
 {
-    int      i, j;
-//    int32_t* items_ptr;
-
-    if (data->is_valid != 1)
+    if (options->kurtosis_op == 1)
     {
-        melissa_print (VERBOSE_ERROR, "Data structure not valid (malloc_data)\n");
-        exit (1);
+        return 4;
     }
-
-    if (data->steps_init == 0)
+    else if (options->skewness_op == 1)
     {
-        melissa_init_steps (data);
+        return 3;
     }
-
-    if (data->vect_size <= 0)
+    else if (options->variance_op == 1)
     {
-        return;
+        return 2;
     }
-
-    data->moments = melissa_malloc (data->options->nb_time_steps * sizeof(moments_t));
-
-    if (data->options->kurtosis_op == 1)
+    else if (options->mean_op == 1)
     {
-        j = 4;
+        return 1;
     }
-    else if (data->options->skewness_op == 1)
+    return 0;
+}
+
+// per time step structures, at the begining of the arena. They are kept
+// out of the time step slabs, so that a slab only holds vectors: its pages
+// are only touched by the computations, and can be released when spilled.
+static void melissa_alloc_step_arrays (melissa_data_t  *data,
+                                       melissa_arena_t *arena)
+{
+    int i;
+    int nb_time_steps = data->options->nb_time_steps;
+
+    data->moments = melissa_arena_calloc (arena, nb_time_steps, sizeof(moments_t));
+    if (data->options->min_and_max_op == 1)
     {
-        j = 3;
+        data->min_max = melissa_arena_calloc (arena, nb_time_steps, sizeof(min_max_t));
     }
-    else if (data->options->variance_op == 1)
+    if (data->options->threshold_op == 1)
     {
-        j = 2;
+        data->thresholds = melissa_arena_calloc (arena, nb_time_steps, sizeof(threshold_t*));
+        for (i=0; i<nb_time_steps; i++)
+        {
+            data->thresholds[i] = melissa_arena_calloc (arena, data->options->nb_thresholds, sizeof(threshold_t));
+        }
     }
-    else if (data->options->mean_op == 1)
+    if (data->options->quantile_op == 1)
     {
-        j = 1;
+        data->quantiles = melissa_arena_calloc (arena, nb_time_steps, sizeof(quantile_t*));
+        for (i=0; i<nb_time_steps; i++)
+        {
+            data->quantiles[i] = melissa_arena_calloc (arena, data->options->nb_quantiles, sizeof(quantile_t));
+        }
+        if (data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+        {
+            data->p2_quantiles = melissa_arena_calloc (arena, nb_time_steps, sizeof(p2_quantile_t));
+        }
     }
-    else
+    if (data->options->sobol_op == 1)
     {
-        j = 0;
+        data->sobol_indices = melissa_arena_calloc (arena, nb_time_steps, sizeof(sobol_array_t));
     }
+}
 
-    for (i=0; i<data->options->nb_time_steps; i++)
-        init_moments (&(data->moments[i]), data->vect_size, j);
-
-//    if (data->options->mean_op == 1 && data->options->variance_op == 0)
-//    {
-//        data->means = melissa_malloc (data->options->nb_time_steps * sizeof(mean_t));
-//        for (i=0; i<data->options->nb_time_steps; i++)
-//            init_mean (&(data->means[i]), data->vect_size);
-//    }
+// every statistic vector of one time step, in one contiguous slab of the arena
+static void melissa_alloc_step (melissa_data_t  *data,
+                                int              time_step,
+                                melissa_arena_t *arena)
+{
+    int j;
 
-//    if (data->options->variance_op == 1)
-//    {
-//        data->variances = melissa_malloc (data->options->nb_time_steps * sizeof(variance_t));
-//        for (i=0; i<data->options->nb_time_steps; i++)
-//            init_variance (&(data->variances[i]), data->vect_size);
-//    }
+    init_moments_arena (&(data->moments[time_step]), data->vect_size, melissa_moments_order (data->options), arena);
 
     if (data->options->min_and_max_op == 1)
     {
-        data->min_max = melissa_malloc (data->options->nb_time_steps * sizeof(min_max_t));
-        for (i=0; i<data->options->nb_time_steps; i++)
-            init_min_max (&(data->min_max[i]), data->vect_size);
+        init_min_max_arena (&(data->min_max[time_step]), data->vect_size, arena);
     }
 
     if (data->options->threshold_op == 1)
     {
-        data->thresholds = melissa_malloc (data->options->nb_time_steps * sizeof(threshold_t*));
-        for (i=0; i<data->options->nb_time_steps; i++)
+        for (j=0; j<data->options->nb_thresholds; j++)
         {
-            data->thresholds[i] = melissa_calloc (data->options->nb_thresholds, sizeof(threshold_t));
-            for (j=0; j<data->options->nb_thresholds; j++)
-            {
-                init_threshold (&(data->thresholds[i][j]), data->vect_size, data->options->threshold[j]);
-            }
+            init_threshold_arena (&(data->thresholds[time_step][j]), data->vect_size, data->options->threshold[j], arena);
         }
     }
 
     if (data->options->quantile_op == 1)
     {
-        data->quantiles = melissa_malloc (data->options->nb_time_steps * sizeof(quantile_t*));
-        for (i=0; i<data->options->nb_time_steps; i++)
+        for (j=0; j<data->options->nb_quantiles; j++)
         {
-            data->quantiles[i] = melissa_malloc (data->options->nb_quantiles * sizeof(quantile_t));
-            for (j=0; j<data->options->nb_quantiles; j++)
-            {
-                init_quantile (&(data->quantiles[i][j]), data->vect_size, data->options->quantile_order[j]);
-            }
+            init_quantile_arena (&(data->quantiles[time_step][j]), data->vect_size, data->options->quantile_order[j], arena);
+        }
+        if (data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+        {
+            init_p2_quantile_arena (&(data->p2_quantiles[time_step]), data->vect_size, data->options->nb_quantiles, data->options->quantile_order, arena);
         }
     }
 
     if (data->options->sobol_op == 1)
     {
-        data->sobol_indices = melissa_malloc (data->options->nb_time_steps * sizeof(sobol_array_t));
-        data->init_sobol = init_sobol_martinez;
+        data->init_sobol (&data->sobol_indices[time_step], data->options->nb_parameters, data->vect_size, arena);
+    }
+}
+
+static void melissa_alloc_data (melissa_data_t *data)
+{
+    int             i;
+    size_t          page_size;
+    melissa_arena_t sizing;
+
+    if (data->is_valid != 1)
+    {
+        melissa_print (VERBOSE_ERROR, "Data structure not valid (malloc_data)\n");
+        exit (1);
+    }
+
+    if (data->steps_init == 0)
+    {
+        melissa_init_steps (data);
+    }
+
+    if (data->vect_size <= 0)
+    {
+        return;
+    }
+
+    if (data->options->sobol_op == 1)
+    {
+        data->init_sobol = init_sobol_martinez_arena;
         data->read_sobol = read_sobol_martinez;
         data->save_sobol = save_sobol_martinez;
         data->increment_sobol = increment_sobol_martinez;
+        data->increment_sobol_batch = increment_sobol_martinez_batch;
         data->free_sobol = free_sobol_martinez;
-        for (i=0; i<data->options->nb_time_steps; i++)
-        {
-            data->init_sobol (&data->sobol_indices[i], data->options->nb_parameters, data->vect_size);
-        }
     }
+
+    // every time step has the same layout: measure the first one on the heap
+    melissa_arena_init (&sizing, 0);
+    melissa_alloc_step_arrays (data, &sizing);
+    data->step_offset = sizing.used;
+    melissa_alloc_step (data, 0, &sizing);
+    data->step_size = sizing.used - data->step_offset;
+    if (data->options->sobol_op == 1)
+    {
+        melissa_free (data->sobol_indices[0].sobol_martinez);
+    }
+    melissa_arena_free (&sizing);
+
+    // then reserve everything in one region: step t is at step_offset + t * step_size
+    if (data->options->memory_budget > 0 || data->options->restart != 0 ||
+        data->options->mpi_io_checkpoint != 0)
+    {
+        // page aligned slabs, so that a time step can be released alone,
+        // mapped from a checkpoint image on restart, or written in one block
+        page_size = sysconf (_SC_PAGESIZE);
+        data->step_offset = (data->step_offset + page_size - 1) / page_size * page_size;
+        data->step_size   = (data->step_size + page_size - 1) / page_size * page_size;
+    }
+    if (data->options->memory_budget > 0)
+    {
+        melissa_arena_init_file (&data->arena, data->step_offset + data->options->nb_time_steps * data->step_size, ".");
+    }
+    else
+    {
+        melissa_arena_init (&data->arena, data->step_offset + data->options->nb_time_steps * data->step_size);
+    }
+    melissa_alloc_step_arrays (data, &data->arena);
+    for (i=0; i<data->options->nb_time_steps; i++)
+    {
+        data->arena.used = data->step_offset + i * data->step_size;
+        melissa_alloc_step (data, i, &data->arena);
+    }
+    data->step_resident = melissa_calloc ((data->options->nb_time_steps+31)/32, sizeof(uint32_t));
+    data->step_dirty    = melissa_calloc ((data->options->nb_time_steps+31)/32, sizeof(uint32_t));
+    melissa_print (VERBOSE_DEBUG, "Statistics arena: %zu bytes, %zu per time step (malloc_data)\n", data->arena.size, data->step_size);
+
     data->stats_init = 1;
 }
 
@@ -197,6 +276,7 @@ void melissa_init_data (melissa_data_t    *data,
     data->min_max         = NULL;
     data->thresholds      = NULL;
     data->quantiles       = NULL;
+    data->p2_quantiles    = NULL;
     data->sobol_indices   = NULL;
     melissa_check_data (data);
     if (vect_size > 0)
@@ -241,90 +321,195 @@ void melissa_check_data (melissa_data_t *data)
  *
  * @ingroup melissa_data
  *
- * This function frees the memory in the data structure
+ * This function marks a time step as in memory, before it is updated
  *
  *******************************************************************************
  *
- * @param[in] *data
+ * @param[in,out] *data
  * pointer to the structure containing global parameters
  *
+ * @param[in] time_step
+ * the time step
+ *
+ * @return The number of bytes brought in memory, 0 if the step was already there
+ *
  *******************************************************************************/
 
-void melissa_free_data (melissa_data_t *data)
+size_t melissa_touch_step (melissa_data_t *data,
+                           int             time_step)
 {
-    int i, j;
-
-    if (data->is_valid != 1)
+    if (data->stats_init != 1 || test_bit (data->step_resident, time_step) != 0)
     {
-        melissa_print (VERBOSE_ERROR, "Data structure not valid (free_data)\n");
-        exit (1);
+        return 0;
     }
+    set_bit (data->step_resident, time_step);
+    return data->step_size;
+}
 
-    for (i=0; i<data->options->nb_time_steps; i++)
-        free_moments (&(data->moments[i]));
-    melissa_free (data->moments);
-
-//    if (data->options->mean_op == 1 && data->options->variance_op == 0)
-//    {
-//        for (i=0; i<data->options->nb_time_steps; i++)
-//            free_mean (&(data->means[i]));
-//        melissa_free (data->means);
-//    }
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_data
+ *
+ * This function writes the statistics of a time step to the arena file and
+ * drops them from memory. They are read back transparently if accessed again.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * pointer to the structure containing global parameters
+ *
+ * @param[in] time_step
+ * the time step
+ *
+ * @return The number of bytes counted by melissa_touch_step for the time step
+ *
+ *******************************************************************************/
 
-//    if (data->options->variance_op == 1)
-//    {
-//        for (i=0; i<data->options->nb_time_steps; i++)
-//            free_variance (&(data->variances[i]));
-//        melissa_free (data->variances);
-//    }
+size_t melissa_spill_step (melissa_data_t *data,
+                           int             time_step)
+{
+    if (data->stats_init != 1 || data->arena.fd < 0 || test_bit (data->step_resident, time_step) == 0)
+    {
+        return 0;
+    }
+    clear_bit (data->step_resident, time_step);
+    melissa_arena_release (&data->arena,
+                           data->step_offset + time_step * data->step_size,
+                           data->step_size);
+    // only the whole pages are released, but the accounting must match
+    // melissa_touch_step
+    return data->step_size;
+}
 
-    if (data->options->min_and_max_op == 1)
+// the allocations of one time step slab, carved on the heap
+static void melissa_measure_step (melissa_data_t  *data,
+                                  int              vect_size,
+                                  melissa_arena_t *sizing)
+{
+    melissa_data_t  temp = *data;
+    melissa_arena_t arrays;
+
+    temp.vect_size = vect_size;
+    melissa_arena_init (&arrays, 0);
+    melissa_alloc_step_arrays (&temp, &arrays);
+    melissa_arena_init (sizing, 0);
+    melissa_alloc_step (&temp, 0, sizing);
+    if (data->options->sobol_op == 1)
     {
-        for (i=0; i<data->options->nb_time_steps; i++)
-            free_min_max (&(data->min_max[i]));
-        melissa_free (data->min_max);
+        melissa_free (temp.sobol_indices[0].sobol_martinez);
     }
+    melissa_arena_free (&arrays);
+}
 
-    if (data->options->threshold_op == 1)
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_data
+ *
+ * This function describes the time step slab of a data structure for another
+ * vector size: the position of each block, and its size per vector element.
+ * The vectors of every statistic are element major, so a range of elements is
+ * a range of bytes in each block.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * pointer to the structure containing global parameters, allocated
+ *
+ * @param[in] vect_size
+ * the vector size of the slab to describe
+ *
+ * @param[out] *nb_blocks
+ * number of blocks of the slab
+ *
+ * @return The array of blocks, to free with melissa_free
+ *
+ *******************************************************************************/
+
+melissa_slab_block_t* melissa_slab_layout (melissa_data_t *data,
+                                           int             vect_size,
+                                           int            *nb_blocks)
+{
+    melissa_arena_t       one, two;
+    melissa_slab_block_t *blocks;
+    size_t                offset = 0;
+    int                   i;
+
+    // a block of k bytes per element is twice as large for two elements
+    melissa_measure_step (data, 1, &one);
+    melissa_measure_step (data, 2, &two);
+    *nb_blocks = one.sizing.size;
+    blocks = melissa_malloc (*nb_blocks * sizeof(melissa_slab_block_t));
+    for (i=0; i<*nb_blocks; i++)
     {
-        for (i=0; i<data->options->nb_time_steps; i++)
+        if (one.sizing_bytes[i] > 0 && two.sizing_bytes[i] == 2 * one.sizing_bytes[i])
         {
-            for (j=0; j<data->options->nb_thresholds; j++)
-            {
-                free_threshold (&(data->thresholds[i][j]));
-            }
-            melissa_free (data->thresholds[i]);
+            blocks[i].elem_bytes = one.sizing_bytes[i];
+            blocks[i].bytes      = one.sizing_bytes[i] * vect_size;
         }
-        melissa_free (data->thresholds);
+        else
+        {
+            blocks[i].elem_bytes = 0;
+            blocks[i].bytes      = one.sizing_bytes[i];
+        }
+        blocks[i].offset = offset;
+        offset += (blocks[i].bytes + MELISSA_ALIGNMENT - 1) & ~((size_t)MELISSA_ALIGNMENT - 1);
     }
+    melissa_arena_free (&one);
+    melissa_arena_free (&two);
+    return blocks;
+}
 
-    if (data->options->quantile_op == 1)
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_data
+ *
+ * This function frees the memory in the data structure
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * pointer to the structure containing global parameters
+ *
+ *******************************************************************************/
+
+void melissa_free_data (melissa_data_t *data)
+{
+    int i;
+
+    if (data->is_valid != 1)
     {
-        for (i=0; i<data->options->nb_time_steps; i++)
-        {
-            for (j=0; j<data->options->nb_quantiles; j++)
-            {
-                free_quantile (&(data->quantiles[i][j]));
-            }
-            melissa_free (data->quantiles[i]);
-        }
-        melissa_free (data->quantiles);
+        melissa_print (VERBOSE_ERROR, "Data structure not valid (free_data)\n");
+        exit (1);
     }
 
-    if (data->options->sobol_op == 1)
+    if (data->stats_init == 1)
     {
-        for (i=0; i<data->options->nb_time_steps; i++)
+        // every statistic lives in the arena, but the Sobol parameter arrays
+        if (data->options->sobol_op == 1)
         {
-            data->free_sobol (&data->sobol_indices[i], data->options->nb_parameters);
+            for (i=0; i<data->options->nb_time_steps; i++)
+            {
+                melissa_free (data->sobol_indices[i].sobol_martinez);
+            }
         }
-        melissa_free (data->sobol_indices);
+        melissa_arena_free (&data->arena);
+        melissa_free (data->step_resident);
+        melissa_free (data->step_dirty);
+        data->moments       = NULL;
+        data->min_max       = NULL;
+        data->thresholds    = NULL;
+        data->quantiles     = NULL;
+        data->p2_quantiles  = NULL;
+        data->sobol_indices = NULL;
+        data->stats_init    = 0;
     }
 
-    for (i=0; i<data->step_simu.size; i++)
-    {
-        melissa_free(vector_get(&data->step_simu, i));
-    }
-    free_vector (&data->step_simu);
+    free_bitmap (&data->step_simu);
+    melissa_free (data->step_received);
+    melissa_free (data->sobol_intervals);
 
     data->options = NULL;
 
@@ -38,9 +38,11 @@ extern "C" {
 #include "min_max.h"
 #include "threshold.h"
 #include "quantile.h"
+#include "p2_quantile.h"
 #include "covariance.h"
 #include "sobol.h"
 #include "vector.h"
+#include "bitmap.h"
 
 /**
  *******************************************************************************
@@ -86,25 +88,68 @@ struct melissa_data_s
     min_max_t           *min_max;                                /**< array of min and max structures, size nb_time_steps             */
     threshold_t        **thresholds;                             /**< array of threshold exceedance structures                        */
     quantile_t         **quantiles;                              /**< array of quantile structures, size nb_time_steps * nb_quantiles */
+    p2_quantile_t       *p2_quantiles;                           /**< array of P² quantile structures, size nb_time_steps (P² only)    */
     moments_t           *moments;                                /**< array of genera moment structures, size nb_time_steps           */
     sobol_array_t       *sobol_indices;                          /**< array of sobol array structures, size nb_time_steps             */
-    void (*init_sobol)(sobol_array_t*, int, int);                /**< pointer to Sobol initialization function                        */
+    void (*init_sobol)(sobol_array_t*, int, int, melissa_arena_t*); /**< pointer to Sobol initialization function                     */
     void (*read_sobol)(sobol_array_t*, int, int, int, FILE*);    /**< pointer to Sobol read function                                  */
     void (*save_sobol)(sobol_array_t*, int, int, int, FILE*);    /**< pointer to Sobol save function                                  */
     void (*increment_sobol)(sobol_array_t*, int, double**, int); /**< pointer to Sobol increment function                             */
+    void (*increment_sobol_batch)(sobol_array_t*, int, double***, int, int); /**< pointer to Sobol batched increment function        */
     void (*free_sobol)(sobol_array_t*, int);                     /**< pointer to Sobol free function                                  */
     int                  nb_simu;                                /**< number of simulation that have sent a message                   */
-    vector_t             step_simu;                              /**< vector of arrays of bits, size nb_groups                        */
+    bitmap_t             step_simu;                              /**< received time steps, one row of bits per simulation             */
+    melissa_arena_t      arena;                                  /**< arena holding the statistics, one slab per time step            */
+    size_t               step_offset;                            /**< offset of the first time step slab in the arena                 */
+    size_t               step_size;                              /**< size of one time step slab in the arena (bytes)                 */
+    uint32_t            *step_resident;                          /**< bits of the time steps in memory                                */
+    uint32_t            *step_dirty;                             /**< bits of the time steps modified since the last checkpoint       */
+    int                  checkpoint_generation;                  /**< number of full checkpoints, delta logs refer to it              */
+    long int             checkpoint_base_size;                   /**< size of the last full checkpoint (bytes), 0 if none             */
+    long int             checkpoint_delta_size;                  /**< size of the delta log since the last full checkpoint (bytes)    */
+    int                 *step_received;                          /**< number of simulations received, per time step                   */
+    double              *sobol_intervals;                        /**< worst Sobol confidence interval, per time step                  */
+    double               sobol_interval;                         /**< worst Sobol confidence interval of all the time steps           */
+    int                  sobol_worst_step;                       /**< time step of sobol_interval                                     */
+    int                  sobol_converged_steps;                  /**< number of time steps with converged Sobol indices               */
 };
 
 typedef struct melissa_data_s melissa_data_t; /**< type corresponding to melissa_data_s */
 
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_slab_block_s
+ *
+ * One allocation of a time step slab, in carving order
+ *
+ *******************************************************************************/
+
+struct melissa_slab_block_s
+{
+    size_t  offset;     /**< offset of the block in the slab                       */
+    size_t  elem_bytes; /**< bytes per vector element, 0 for a block of fixed size */
+    size_t  bytes;      /**< size of the block                                     */
+};
+
+typedef struct melissa_slab_block_s melissa_slab_block_t; /**< type corresponding to melissa_slab_block_s */
+
 void melissa_init_data (melissa_data_t    *data,
                         melissa_options_t *options,
                         int                vect_size);
 
 void melissa_check_data (melissa_data_t *data);
 
+size_t melissa_touch_step (melissa_data_t *data,
+                           int             time_step);
+
+size_t melissa_spill_step (melissa_data_t *data,
+                           int             time_step);
+
+melissa_slab_block_t* melissa_slab_layout (melissa_data_t *data,
+                                           int             vect_size,
+                                           int            *nb_blocks);
+
 void melissa_free_data (melissa_data_t *data);
 
 //long int mem_conso (melissa_options_t *options);
@@ -102,6 +102,7 @@ void melissa_get_fields (int               argc,
     for (i=0; i<nb_fields; i++)
     {
         fields[i].stats_data = NULL;
+        fields[i].step_streamed = NULL;
     }
 
     optind = 1;
@@ -287,7 +288,7 @@ void finalize_field_data (melissa_field_t   *fields,
                           double *total_write_time)
 {
     double start_write_time, end_write_time;
-    int i, j;
+    int i, j, t;
     if (fields == NULL)
     {
         return;
@@ -308,10 +309,31 @@ void finalize_field_data (melissa_field_t   *fields,
         start_write_time = melissa_get_time();
         for (j=0; j<options->nb_fields; j++)
         {
-            melissa_write_stats_seq (&(fields[j].stats_data),
-                                      options,
-                                      comm_data,
-                                      fields[j].name);
+            if (fields[j].step_streamed != NULL)
+            {
+                // streamed output: only the time steps not written yet
+                for (t=0; t<options->nb_time_steps; t++)
+                {
+                    if (test_bit (fields[j].step_streamed, t) == 0)
+                    {
+                        melissa_write_step_parts (fields[j].stats_data,
+                                                  options,
+                                                  comm_data,
+                                                  fields[j].name,
+                                                  t);
+                    }
+                }
+                melissa_merge_step_parts (options,
+                                          comm_data,
+                                          fields[j].name);
+            }
+            else
+            {
+                melissa_write_stats_seq (&(fields[j].stats_data),
+                                          options,
+                                          comm_data,
+                                          fields[j].name);
+            }
         }
         end_write_time = melissa_get_time();
         *total_write_time += end_write_time - start_write_time;
@@ -326,6 +348,7 @@ void finalize_field_data (melissa_field_t   *fields,
                 }
             }
             melissa_free (fields[j].stats_data);
+            melissa_free (fields[j].step_streamed);
         }
     }
     return;
@@ -45,6 +45,7 @@ struct melissa_field_s /**< Structure for a linked list of output fields */
     char            name[MAX_FIELD_NAME]; /**< name of the field                                       */
     melissa_data_t *stats_data;           /**< stats_data structure                                    */
     int            *client_vect_sizes;    /**< client vector sizes for this field for each client rank */
+    uint32_t       *step_streamed;        /**< time steps written during the study (streamed output)   */
 };
 
 typedef struct melissa_field_s melissa_field_t; /**< type corresponding to field_s */
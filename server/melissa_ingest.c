@@ -0,0 +1,609 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_ingest.c
+ * @brief Multi-threaded reception and computation of simulation messages.
+ * @author Terraz Théophile
+ * @date 2019-02-04
+ *
+ * @defgroup melissa_ingest Melissa ingest pipeline
+ *
+ * The receiver thread is the only one touching the data socket. It moves the
+ * messages into a bounded queue read by the control thread (the one running
+ * melissa_server_run), which keeps the launcher, fault tolerance and
+ * bookkeeping work. The control thread then hands the payloads to compute
+ * workers. A worker owns every (field, client rank, time step) key hashed to
+ * it, so two workers never update the same statistic structure.
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include "melissa_ingest.h"
+#include "compute_stats.h"
+#include "melissa_messages.h"
+#include "melissa_utils.h"
+
+#define MELISSA_RECV_QUEUE_SIZE 256 /**< capacity of the receiver queue, power of 2 */
+#define MELISSA_JOB_QUEUE_SIZE  64  /**< capacity of a worker queue, power of 2     */
+
+static inline void backoff (int *idle)
+{
+    if (*idle < 64)
+    {
+        sched_yield ();
+    }
+    else
+    {
+        usleep (100);
+    }
+    *idle += 1;
+}
+
+static void ring_init (melissa_ring_t *ring,
+                       unsigned int    capacity)
+{
+    unsigned int i;
+
+    ring->slots = melissa_malloc (capacity * sizeof(melissa_job_t));
+    for (i=0; i<capacity; i++)
+    {
+        zmq_msg_init (&ring->slots[i].msg);
+    }
+    ring->mask = capacity - 1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+static void ring_free (melissa_ring_t *ring)
+{
+    unsigned int i;
+
+    for (i=0; i<=ring->mask; i++)
+    {
+        zmq_msg_close (&ring->slots[i].msg);
+    }
+    melissa_free (ring->slots);
+}
+
+/* producer side: the message is moved into the ring, job->msg is left empty */
+static int ring_push (melissa_ring_t *ring,
+                      melissa_job_t  *job)
+{
+    unsigned int   tail = __atomic_load_n (&ring->tail, __ATOMIC_RELAXED);
+    melissa_job_t *slot;
+
+    if (tail - __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) > ring->mask)
+    {
+        return 0;
+    }
+    slot = &ring->slots[tail & ring->mask];
+    zmq_msg_move (&slot->msg, &job->msg);
+    slot->data       = job->data;
+    slot->time_stamp = job->time_stamp;
+    slot->simu_id    = job->simu_id;
+    slot->nb_vect    = job->nb_vect;
+    slot->offset     = job->offset;
+    __atomic_store_n (&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* consumer side: job->msg must be an initialized (empty) message */
+static int ring_pop (melissa_ring_t *ring,
+                     melissa_job_t  *job)
+{
+    unsigned int   head = __atomic_load_n (&ring->head, __ATOMIC_RELAXED);
+    melissa_job_t *slot;
+
+    if (head == __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE))
+    {
+        return 0;
+    }
+    slot = &ring->slots[head & ring->mask];
+    zmq_msg_move (&job->msg, &slot->msg);
+    job->data       = slot->data;
+    job->time_stamp = slot->time_stamp;
+    job->simu_id    = slot->simu_id;
+    job->nb_vect    = slot->nb_vect;
+    job->offset     = slot->offset;
+    __atomic_store_n (&ring->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static void* receiver_loop (void *arg)
+{
+    melissa_ingest_t *ingest = (melissa_ingest_t*)arg;
+    melissa_job_t     job;
+    int               idle;
+    zmq_pollitem_t    item = { ingest->data_puller, 0, ZMQ_POLLIN, 0 };
+
+    zmq_msg_init (&job.msg);
+    while (__atomic_load_n (&ingest->stop, __ATOMIC_ACQUIRE) == 0)
+    {
+        zmq_poll (&item, 1, 100);
+        if ((item.revents & ZMQ_POLLIN) == 0)
+        {
+            continue;
+        }
+        while (zmq_msg_recv (&job.msg, ingest->data_puller, ZMQ_DONTWAIT) >= 0)
+        {
+            idle = 0;
+            // queue full: stop reading, the socket high water mark
+            // then pushes back on the simulations
+            while (ring_push (&ingest->received, &job) == 0)
+            {
+                if (__atomic_load_n (&ingest->stop, __ATOMIC_ACQUIRE) != 0)
+                {
+                    zmq_msg_close (&job.msg);
+                    return NULL;
+                }
+                backoff (&idle);
+            }
+        }
+    }
+    zmq_msg_close (&job.msg);
+    return NULL;
+}
+
+/* consumer side: 1 if the next job updates the same statistics as job */
+static int ring_next_is (melissa_ring_t *ring,
+                         melissa_job_t  *job)
+{
+    unsigned int   head = __atomic_load_n (&ring->head, __ATOMIC_RELAXED);
+    melissa_job_t *slot;
+
+    if (head == __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE))
+    {
+        return 0;
+    }
+    slot = &ring->slots[head & ring->mask];
+    return (slot->data == job->data && slot->time_stamp == job->time_stamp);
+}
+
+static void* worker_loop (void *arg)
+{
+    melissa_worker_t *worker = (melissa_worker_t*)arg;
+    melissa_ingest_t *ingest = worker->ingest;
+    melissa_job_t    *batch  = worker->batch;
+    int               i, k, m, nb;
+    int               idle = 0;
+    size_t            size;
+    char             *payload;
+    double            start;
+
+    for (k=0; k<MELISSA_BATCH_SIZE; k++)
+    {
+        zmq_msg_init (&batch[k].msg);
+    }
+    while (1)
+    {
+        if (ring_pop (&worker->jobs, &batch[0]) == 1)
+        {
+            idle = 0;
+            start = melissa_get_time();
+            // the queued messages of the same time step are computed
+            // together, the statistics are then read once for all of them
+            nb = 1;
+            while (nb < MELISSA_BATCH_SIZE &&
+                   ring_next_is (&worker->jobs, &batch[0]) == 1 &&
+                   ring_pop (&worker->jobs, &batch[nb]) == 1)
+            {
+                nb++;
+            }
+            m = 0;
+            for (k=0; k<nb; k++)
+            {
+                // small messages are stored inside zmq_msg_t, so the payload
+                // address is only known once the message reached the worker
+                payload = (char*)zmq_msg_data (&batch[k].msg) + batch[k].offset;
+                if (worker->wire.format == MELISSA_WIRE_DOUBLE &&
+                    worker->wire.codec == MELISSA_WIRE_NO_CODEC)
+                {
+                    worker->vect_tabs[m][0] = (double*)payload;
+                    for (i=1; i<batch[k].nb_vect; i++)
+                    {
+                        worker->vect_tabs[m][i] = worker->vect_tabs[m][i-1] + batch[k].data->vect_size;
+                    }
+                }
+                else
+                {
+                    // float, bfloat16 or compressed vectors are decoded in a
+                    // private buffer, the kernels only compute in double. The
+                    // payload was checked before the dispatch
+                    // (melissa_wire_check), the decoding can not fail.
+                    size = (size_t)batch[k].nb_vect * batch[k].data->vect_size;
+                    if (worker->wire_sizes[m] < size)
+                    {
+                        melissa_free (worker->wire_buffers[m]);
+                        worker->wire_buffers[m] = melissa_malloc (size * sizeof(double));
+                        worker->wire_sizes[m] = size;
+                    }
+                    if (melissa_wire_unpack (payload,
+                                             zmq_msg_size (&batch[k].msg) - batch[k].offset,
+                                             batch[k].nb_vect,
+                                             batch[k].data->vect_size,
+                                             &worker->wire,
+                                             worker->wire_buffers[m]) != 0)
+                    {
+                        melissa_print (VERBOSE_ERROR, "Corrupted data (simulation %d, time step %d), message ignored\n", batch[k].simu_id, batch[k].time_stamp);
+                        continue;
+                    }
+                    for (i=0; i<batch[k].nb_vect; i++)
+                    {
+                        worker->vect_tabs[m][i] = &worker->wire_buffers[m][(size_t)i * batch[k].data->vect_size];
+                    }
+                }
+                worker->simu_ids[m] = batch[k].simu_id;
+                m++;
+            }
+            if (m > 0)
+            {
+                compute_stats_batch (batch[0].data,
+                                     batch[0].time_stamp,
+                                     m,
+                                     worker->simu_ids,
+                                     batch[0].nb_vect,
+                                     worker->vect_tabs);
+            }
+            for (k=0; k<nb; k++)
+            {
+                zmq_msg_close (&batch[k].msg);
+                zmq_msg_init (&batch[k].msg);
+            }
+            worker->computation_time += melissa_get_time() - start;
+            __atomic_store_n (&worker->nb_done, worker->nb_done + nb, __ATOMIC_RELEASE);
+        }
+        else if (__atomic_load_n (&ingest->stop, __ATOMIC_ACQUIRE) != 0)
+        {
+            break;
+        }
+        else
+        {
+            backoff (&idle);
+        }
+    }
+    for (k=0; k<MELISSA_BATCH_SIZE; k++)
+    {
+        zmq_msg_close (&batch[k].msg);
+    }
+    return NULL;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_ingest
+ *
+ * This function starts the receiver thread and the compute workers
+ *
+ *******************************************************************************
+ *
+ * @param[in] *options
+ * pointer to the structure containing options parsed from command line
+ *
+ * @param[in] *data_puller
+ * data socket, must not be used by the calling thread afterwards
+ *
+ * @param[in] nb_workers
+ * number of compute workers
+ *
+ * @retval ingest
+ * pointer to the new pipeline
+ *
+ *******************************************************************************/
+
+melissa_ingest_t* melissa_ingest_start (melissa_options_t *options,
+                                        void              *data_puller,
+                                        int                nb_workers)
+{
+    melissa_ingest_t *ingest;
+    int               i, j;
+
+    ingest = melissa_malloc (sizeof(melissa_ingest_t));
+    ingest->options = options;
+    ingest->data_puller = data_puller;
+    ingest->nb_workers = nb_workers;
+    ingest->stop = 0;
+    ring_init (&ingest->received, MELISSA_RECV_QUEUE_SIZE);
+
+    ingest->workers = melissa_malloc (nb_workers * sizeof(melissa_worker_t));
+    for (i=0; i<nb_workers; i++)
+    {
+        ring_init (&ingest->workers[i].jobs, MELISSA_JOB_QUEUE_SIZE);
+        for (j=0; j<MELISSA_BATCH_SIZE; j++)
+        {
+            ingest->workers[i].vect_tabs[j] = melissa_malloc ((options->nb_parameters + 2) * sizeof(double*));
+            ingest->workers[i].wire_buffers[j] = NULL;
+            ingest->workers[i].wire_sizes[j] = 0;
+        }
+        melissa_wire_init (&ingest->workers[i].wire, options->wire_format, options->wire_codec, options->wire_tolerance);
+        ingest->workers[i].nb_dispatched = 0;
+        ingest->workers[i].nb_done = 0;
+        ingest->workers[i].computation_time = 0.0;
+        ingest->workers[i].ingest = ingest;
+        if (pthread_create (&ingest->workers[i].thread, NULL, worker_loop, &ingest->workers[i]) != 0)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not start compute worker %d\n", i);
+            exit (1);
+        }
+    }
+    if (pthread_create (&ingest->receiver, NULL, receiver_loop, ingest) != 0)
+    {
+        melissa_print (VERBOSE_ERROR, "Can not start receiver thread\n");
+        exit (1);
+    }
+
+    return ingest;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_ingest
+ *
+ * This function gets the next message from the receiver thread, if any
+ *
+ *******************************************************************************
+ *
+ * @param[in] *ingest
+ * pointer to the pipeline
+ *
+ * @param[out] *msg
+ * initialized message, receives the data message
+ *
+ * @retval 1 if a message was available, 0 otherwise
+ *
+ *******************************************************************************/
+
+int melissa_ingest_pop_received (melissa_ingest_t *ingest,
+                                 zmq_msg_t        *msg)
+{
+    melissa_job_t job;
+
+    zmq_msg_init (&job.msg);
+    if (ring_pop (&ingest->received, &job) == 0)
+    {
+        zmq_msg_close (&job.msg);
+        return 0;
+    }
+    zmq_msg_move (msg, &job.msg);
+    zmq_msg_close (&job.msg);
+    return 1;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_ingest
+ *
+ * This function hands a data message to the worker owning its key.
+ * The message is moved to the worker, msg is left empty. Its payload must
+ * have been checked with melissa_wire_check.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *ingest
+ * pointer to the pipeline
+ *
+ * @param[in,out] *msg
+ * data message
+ *
+ * @param[in] *data
+ * statistic structure to update
+ *
+ * @param[in] field_id
+ * field id of the message
+ *
+ * @param[in] client_rank
+ * rank of the simulation process that sent the message
+ *
+ * @param[in] time_stamp
+ * time step of the message
+ *
+ * @param[in] simu_id
+ * simulation id of the message
+ *
+ * @param[in] nb_vect
+ * number of vectors in the message
+ *
+ * @param[in] *vect
+ * first vector of the message, inside msg
+ *
+ *******************************************************************************/
+
+void melissa_ingest_dispatch (melissa_ingest_t *ingest,
+                              zmq_msg_t        *msg,
+                              melissa_data_t   *data,
+                              int               field_id,
+                              int               client_rank,
+                              int               time_stamp,
+                              int               simu_id,
+                              int               nb_vect,
+                              double           *vect)
+{
+    melissa_job_t     job;
+    melissa_worker_t *worker;
+    long int          key;
+    int               idle = 0;
+
+    key = (long int)field_id + (long int)client_rank * ingest->options->nb_fields;
+    if (ingest->options->sobol_op != 1)
+    {
+        key = key * ingest->options->nb_time_steps + time_stamp;
+    }
+    worker = &ingest->workers[key % ingest->nb_workers];
+
+    zmq_msg_init (&job.msg);
+    job.offset     = (char*)vect - (char*)zmq_msg_data (msg);
+    zmq_msg_move (&job.msg, msg);
+    job.data       = data;
+    job.time_stamp = time_stamp;
+    job.simu_id    = simu_id;
+    job.nb_vect    = nb_vect;
+    while (ring_push (&worker->jobs, &job) == 0)
+    {
+        backoff (&idle);
+    }
+    zmq_msg_close (&job.msg);
+    worker->nb_dispatched += 1;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_ingest
+ *
+ * This function waits until the workers computed every dispatched message.
+ * It must be called before reading or saving the statistics.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *ingest
+ * pointer to the pipeline
+ *
+ *******************************************************************************/
+
+void melissa_ingest_drain (melissa_ingest_t *ingest)
+{
+    int i;
+    int idle = 0;
+
+    for (i=0; i<ingest->nb_workers; i++)
+    {
+        while (__atomic_load_n (&ingest->workers[i].nb_done, __ATOMIC_ACQUIRE) < ingest->workers[i].nb_dispatched)
+        {
+            backoff (&idle);
+        }
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_ingest
+ *
+ * This function copies the number of messages dispatched to each compute
+ * worker, to wait later for them without draining the pipeline
+ *
+ *******************************************************************************
+ *
+ * @param[in] *ingest
+ * pointer to the pipeline
+ *
+ * @param[out] *tickets
+ * number of messages dispatched to each worker (nb_workers values)
+ *
+ *******************************************************************************/
+
+void melissa_ingest_tickets (melissa_ingest_t *ingest,
+                             long int         *tickets)
+{
+    int i;
+
+    for (i=0; i<ingest->nb_workers; i++)
+    {
+        tickets[i] = ingest->workers[i].nb_dispatched;
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_ingest
+ *
+ * This function tells if the compute workers finished the messages counted
+ * by melissa_ingest_tickets, without waiting
+ *
+ *******************************************************************************
+ *
+ * @param[in] *ingest
+ * pointer to the pipeline
+ *
+ * @param[in] *tickets
+ * tickets returned by melissa_ingest_tickets
+ *
+ * @return 1 if every message of the tickets is computed, 0 otherwise
+ *
+ *******************************************************************************/
+
+int melissa_ingest_reached (melissa_ingest_t *ingest,
+                            const long int   *tickets)
+{
+    int i;
+
+    for (i=0; i<ingest->nb_workers; i++)
+    {
+        if (__atomic_load_n (&ingest->workers[i].nb_done, __ATOMIC_ACQUIRE) < tickets[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_ingest
+ *
+ * This function stops the pipeline, joins the threads and frees the structure.
+ * Messages still waiting in the receiver queue are dropped.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *ingest
+ * pointer to the pipeline
+ *
+ * @param[out] *computation_time
+ * incremented by the time spent in the workers
+ *
+ * @param[out] *wire
+ * its counters are incremented by the ones of the workers
+ *
+ *******************************************************************************/
+
+void melissa_ingest_stop (melissa_ingest_t *ingest,
+                          double           *computation_time,
+                          melissa_wire_t   *wire)
+{
+    int i, j;
+
+    melissa_ingest_drain (ingest);
+    __atomic_store_n (&ingest->stop, 1, __ATOMIC_RELEASE);
+    pthread_join (ingest->receiver, NULL);
+    for (i=0; i<ingest->nb_workers; i++)
+    {
+        pthread_join (ingest->workers[i].thread, NULL);
+        *computation_time += ingest->workers[i].computation_time;
+        ring_free (&ingest->workers[i].jobs);
+        for (j=0; j<MELISSA_BATCH_SIZE; j++)
+        {
+            melissa_free (ingest->workers[i].vect_tabs[j]);
+            melissa_free (ingest->workers[i].wire_buffers[j]);
+        }
+        wire->raw_bytes += ingest->workers[i].wire.raw_bytes;
+        wire->packed_bytes += ingest->workers[i].wire.packed_bytes;
+        wire->codec_time += ingest->workers[i].wire.codec_time;
+        melissa_wire_free (&ingest->workers[i].wire);
+    }
+    ring_free (&ingest->received);
+    melissa_free (ingest->workers);
+    melissa_free (ingest);
+}
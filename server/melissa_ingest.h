@@ -0,0 +1,163 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_ingest.h
+ * @author Terraz Théophile
+ * @date 2019-02-04
+ *
+ **/
+
+#ifndef MELISSA_INGEST_H
+#define MELISSA_INGEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <zmq.h>
+#include "melissa_data.h"
+#include "melissa_options.h"
+#include "compute_stats.h"
+#include "melissa_messages.h"
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_job_s
+ *
+ * Structure describing one simulation message in flight between the server threads
+ *
+ *******************************************************************************/
+
+struct melissa_job_s
+{
+    zmq_msg_t       msg;        /**< ZeroMQ message holding the payload, owned by the job */
+    melissa_data_t *data;       /**< statistic structure to update                         */
+    int             time_stamp; /**< time step of the message                              */
+    int             simu_id;    /**< simulation (group) id of the message                  */
+    int             nb_vect;    /**< number of vectors in the payload                      */
+    size_t          offset;     /**< offset of the first vector in the payload (bytes)      */
+};
+
+typedef struct melissa_job_s melissa_job_t; /**< type corresponding to melissa_job_s */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_ring_s
+ *
+ * Bounded single producer / single consumer lock-free queue of jobs
+ *
+ *******************************************************************************/
+
+struct melissa_ring_s
+{
+    melissa_job_t *slots;                          /**< job array, size capacity              */
+    unsigned int   mask;                           /**< capacity - 1, capacity is a power of 2 */
+    unsigned int   head __attribute__((aligned(64))); /**< next slot to pop (consumer side)    */
+    unsigned int   tail __attribute__((aligned(64))); /**< next slot to push (producer side)   */
+};
+
+typedef struct melissa_ring_s melissa_ring_t; /**< type corresponding to melissa_ring_s */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_worker_s
+ *
+ * Structure describing a compute worker thread
+ *
+ *******************************************************************************/
+
+struct melissa_worker_s
+{
+    pthread_t         thread;           /**< worker thread                                */
+    melissa_ring_t    jobs;             /**< jobs dispatched by the control thread        */
+    melissa_job_t     batch[MELISSA_BATCH_SIZE];     /**< jobs of the same time step, computed together */
+    double          **vect_tabs[MELISSA_BATCH_SIZE]; /**< private input vector arrays for compute_stats */
+    int               simu_ids[MELISSA_BATCH_SIZE];  /**< simulation ids of the batch                   */
+    double           *wire_buffers[MELISSA_BATCH_SIZE]; /**< vectors decoded from the messages           */
+    size_t            wire_sizes[MELISSA_BATCH_SIZE];   /**< sizes of wire_buffers (values)              */
+    melissa_wire_t    wire;             /**< format, codec and counters of the messages   */
+    long int          nb_dispatched;    /**< jobs pushed by the control thread            */
+    long int          nb_done;          /**< jobs completed by the worker                 */
+    double            computation_time; /**< time spent in compute_stats                  */
+    struct melissa_ingest_s *ingest;    /**< back pointer to the pipeline                 */
+};
+
+typedef struct melissa_worker_s melissa_worker_t; /**< type corresponding to melissa_worker_s */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_ingest_s
+ *
+ * Multi-threaded ingest pipeline: one receiver thread owning the data socket,
+ * a bounded queue to the control thread, and compute workers sharded by
+ * (field, client rank, time step)
+ *
+ *******************************************************************************/
+
+struct melissa_ingest_s
+{
+    melissa_options_t *options;        /**< study options                                  */
+    void              *data_puller;    /**< data socket, owned by the receiver thread      */
+    pthread_t          receiver;       /**< receiver thread                                */
+    melissa_ring_t     received;       /**< receiver -> control thread queue               */
+    int                nb_workers;     /**< number of compute workers                      */
+    melissa_worker_t  *workers;        /**< compute workers                                */
+    int                stop;           /**< 1 when the threads must exit                   */
+};
+
+typedef struct melissa_ingest_s melissa_ingest_t; /**< type corresponding to melissa_ingest_s */
+
+melissa_ingest_t* melissa_ingest_start (melissa_options_t *options,
+                                        void              *data_puller,
+                                        int                nb_workers);
+
+int melissa_ingest_pop_received (melissa_ingest_t *ingest,
+                                 zmq_msg_t        *msg);
+
+void melissa_ingest_dispatch (melissa_ingest_t *ingest,
+                              zmq_msg_t        *msg,
+                              melissa_data_t   *data,
+                              int               field_id,
+                              int               client_rank,
+                              int               time_stamp,
+                              int               simu_id,
+                              int               nb_vect,
+                              double           *vect);
+
+void melissa_ingest_drain (melissa_ingest_t *ingest);
+
+void melissa_ingest_tickets (melissa_ingest_t *ingest,
+                             long int         *tickets);
+
+int melissa_ingest_reached (melissa_ingest_t *ingest,
+                            const long int   *tickets);
+
+void melissa_ingest_stop (melissa_ingest_t *ingest,
+                          double           *computation_time,
+                          melissa_wire_t   *wire);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELISSA_INGEST_H
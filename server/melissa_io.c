@@ -30,10 +30,15 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
 //#include "hdf5.h"
 #include "melissa_data.h"
 #include "melissa_utils.h"
 #include "fault_tolerance.h"
+#include "melissa_checkpoint.h"
+#include "melissa_codec.h"
 
 /**
  *******************************************************************************
@@ -119,6 +124,714 @@ int read_client_data (int                *client_comm_size,
     return ret;
 }
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function writes the stats of a client rank in a stream
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * data structure to save
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] *field_name
+ * name of the field to write
+ *
+ * @param[in] client_rank
+ * mpi rank of the client process
+ *
+ * @param[in] *f
+ * stream to write to
+ *
+ *******************************************************************************/
+
+static void write_stats (melissa_data_t *data,
+                         comm_data_t    *comm_data,
+                         char           *field_name,
+                         int             client_rank,
+                         FILE           *f)
+{
+    int temp_size;
+
+    fwrite(&data[client_rank].vect_size, sizeof(int), 1, f);
+    if (data[client_rank].vect_size > 0)
+    {
+//            if (data[client_rank].options->mean_op != 0 && data[client_rank].options->variance_op == 0)
+//            {
+//                save_mean(data[client_rank].means, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, f);
+//            }
+//            if (data[client_rank].options->variance_op != 0)
+//            {
+//                save_variance(data[client_rank].variances, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, f);
+//            }
+        melissa_print (VERBOSE_DEBUG, "Save moments (field %s, server rank %d, client rank %d) (write_stats)\n", field_name, comm_data->rank, client_rank);
+        save_moments(data[client_rank].moments, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, f);
+        if (data[client_rank].options->min_and_max_op != 0)
+        {
+            melissa_print (VERBOSE_DEBUG, "Save min and max (field %s, server rank %d, client rank %d) (write_stats)\n", field_name, comm_data->rank, client_rank);
+            save_min_max(data[client_rank].min_max, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, f);
+        }
+        if (data[client_rank].options->threshold_op != 0)
+        {
+            melissa_print (VERBOSE_DEBUG, "Save threshold exceedances (field %s, server rank %d, client rank %d) (write_stats)\n", field_name, comm_data->rank, client_rank);
+            save_threshold(data[client_rank].thresholds, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, data[client_rank].options->nb_thresholds, f);
+        }
+        if (data[client_rank].options->quantile_op != 0)
+        {
+            melissa_print (VERBOSE_DEBUG, "Save quantiles (field %s, server rank %d, client rank %d) (write_stats)\n", field_name, comm_data->rank, client_rank);
+            if (data[client_rank].options->quantile_estimator == MELISSA_QUANTILE_P2)
+            {
+                save_p2_quantile(data[client_rank].p2_quantiles, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, f);
+            }
+            else
+            {
+                save_quantile(data[client_rank].quantiles, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, data[client_rank].options->nb_quantiles, f);
+            }
+        }
+        if (data[client_rank].options->sobol_op != 0)
+        {
+            melissa_print (VERBOSE_DEBUG, "Save Sobol indices (field %s, server rank %d, client rank %d) (write_stats)\n", field_name, comm_data->rank, client_rank);
+            data[client_rank].save_sobol(data[client_rank].sobol_indices, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, data[client_rank].options->nb_parameters, f);
+        }
+        melissa_print (VERBOSE_DEBUG, "Save simulation steps (field %s, server rank %d, client rank %d) (write_stats)\n", field_name, comm_data->rank, client_rank);
+        // -1 marks the bitmap format, older checkpoints start with the number of simulations
+        temp_size = -1;
+        fwrite(&temp_size, sizeof(int), 1, f);
+        bitmap_write (&data[client_rank].step_simu, 1, f);
+        // the delta log of this checkpoint refers to its generation
+        fwrite(&data[client_rank].checkpoint_generation, sizeof(int), 1, f);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function writes the stats of one time step in a stream
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * data structure of the client rank to save
+ *
+ * @param[in] t
+ * time step to write
+ *
+ * @param[in] vect_size
+ * number of vector elements to write, 0 to only write the counters
+ *
+ * @param[in] *f
+ * stream to write to
+ *
+ *******************************************************************************/
+
+static void write_step (melissa_data_t *data,
+                        int             t,
+                        int             vect_size,
+                        FILE           *f)
+{
+    fwrite(&t, sizeof(int), 1, f);
+    save_moments(&data->moments[t], vect_size, 1, f);
+    if (data->options->min_and_max_op != 0)
+    {
+        save_min_max(&data->min_max[t], vect_size, 1, f);
+    }
+    if (data->options->threshold_op != 0)
+    {
+        save_threshold(&data->thresholds[t], vect_size, 1, data->options->nb_thresholds, f);
+    }
+    if (data->options->quantile_op != 0)
+    {
+        if (data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+        {
+            save_p2_quantile(&data->p2_quantiles[t], vect_size, 1, f);
+        }
+        else
+        {
+            save_quantile(&data->quantiles[t], vect_size, 1, data->options->nb_quantiles, f);
+        }
+    }
+    if (data->options->sobol_op != 0)
+    {
+        data->save_sobol(&data->sobol_indices[t], vect_size, 1, data->options->nb_parameters, f);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function reads the stats of one time step from a stream
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * data structure of the client rank to read
+ *
+ * @param[in] vect_size
+ * number of vector elements to read, 0 to only read the counters
+ *
+ * @param[in] *f
+ * stream to read from
+ *
+ * @return 0 on success, -1 if the stream does not hold a valid time step
+ *
+ *******************************************************************************/
+
+static int read_step (melissa_data_t *data,
+                      int             vect_size,
+                      FILE           *f)
+{
+    int t;
+
+    if (fread(&t, sizeof(int), 1, f) != 1 || t < 0 || t >= data->options->nb_time_steps)
+    {
+        return -1;
+    }
+    read_moments(&data->moments[t], vect_size, 1, f);
+    if (data->options->min_and_max_op != 0)
+    {
+        read_min_max(&data->min_max[t], vect_size, 1, f);
+    }
+    if (data->options->threshold_op != 0)
+    {
+        read_threshold(&data->thresholds[t], vect_size, 1, data->options->nb_thresholds, f);
+    }
+    if (data->options->quantile_op != 0)
+    {
+        if (data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+        {
+            read_p2_quantile(&data->p2_quantiles[t], vect_size, 1, f);
+        }
+        else
+        {
+            read_quantile(&data->quantiles[t], vect_size, 1, data->options->nb_quantiles, f);
+        }
+    }
+    if (data->options->sobol_op != 0)
+    {
+        data->read_sobol(&data->sobol_indices[t], vect_size, 1, data->options->nb_parameters, f);
+    }
+    return 0;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function appends one record to a delta log: the time steps modified
+ * since the last checkpoint, and the simulation steps. The record starts with
+ * its size, so that a record cut by a crash is detected on restart.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * data structure of the client rank to save, its dirty bits are cleared
+ *
+ * @param[in] *f
+ * stream to write to
+ *
+ * @return The number of bytes written
+ *
+ *******************************************************************************/
+
+static long int write_delta (melissa_data_t *data,
+                             FILE           *f)
+{
+    char    *buffer = NULL;
+    size_t   size = 0;
+    int64_t  record_size;
+    int      t, nb_steps = 0;
+    FILE    *record;
+
+    for (t=0; t<data->options->nb_time_steps; t++)
+    {
+        nb_steps += (test_bit (data->step_dirty, t) != 0);
+    }
+    record = open_memstream (&buffer, &size);
+    if (record == NULL)
+    {
+        melissa_print (VERBOSE_ERROR, "Can not open a memory stream (write_delta)\n");
+        exit (1);
+    }
+    fwrite(&nb_steps, sizeof(int), 1, record);
+    for (t=0; t<data->options->nb_time_steps; t++)
+    {
+        if (test_bit (data->step_dirty, t) != 0)
+        {
+            write_step (data, t, data->vect_size, record);
+        }
+    }
+    bitmap_write (&data->step_simu, 1, record);
+    fclose (record);
+
+    record_size = size;
+    fwrite(&record_size, sizeof(int64_t), 1, f);
+    fwrite(buffer, 1, size, f);
+    free (buffer);
+    memset (data->step_dirty, 0, ((data->options->nb_time_steps+31)/32) * sizeof(uint32_t));
+    return sizeof(int64_t) + size;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * Header of a checkpoint image. The image holds the time step slabs of the
+ * statistics arena, each one aligned on a page, so that a restarted server can
+ * map them in its own arena. The scalars of the statistics follow the slabs.
+ * Compressed images (--compress_checkpoint) hold the compressed size of each
+ * time step at data_offset instead, then the compressed slabs, one after the
+ * other. They are read, not mapped.
+ *
+ *******************************************************************************/
+
+struct melissa_image_header_s
+{
+    char     magic[8];      /**< MELISSA_IMAGE_MAGIC                                */
+    int32_t  version;       /**< MELISSA_IMAGE_VERSION                              */
+    int32_t  vect_size;     /**< local size of the vectors                          */
+    int32_t  nb_time_steps; /**< number of time steps                               */
+    int32_t  generation;    /**< full checkpoint number, repeated in the delta log  */
+    int32_t  layout[8];     /**< statistics of the slabs, see image_layout          */
+    int64_t  page_size;     /**< page size of the writer                            */
+    int64_t  data_offset;   /**< offset of the first slab                           */
+    int64_t  stride;        /**< distance between two slabs, multiple of page_size  */
+    int64_t  slab_size;     /**< bytes of statistics in a slab                      */
+    int64_t  scalar_offset; /**< offset of the scalars of the statistics            */
+    int32_t  codec;         /**< MELISSA_CODEC_NONE or MELISSA_CODEC_LZ4 (version 2) */
+    int32_t  reserved;      /**< 0                                                  */
+};
+
+typedef struct melissa_image_header_s melissa_image_header_t; /**< type corresponding to melissa_image_header_s */
+
+#define MELISSA_IMAGE_MAGIC   "MELIMAGE" /**< first bytes of a checkpoint image */
+#define MELISSA_IMAGE_VERSION 2          /**< version of the image layout, 1 had no codec */
+
+// the statistics carved in each slab, two images with the same layout have the same slabs
+static void image_layout (melissa_data_t *data,
+                          int32_t         layout[8])
+{
+    memset (layout, 0, 8 * sizeof(int32_t));
+    layout[0] = data->moments[0].max_order;
+    layout[1] = data->options->min_and_max_op;
+    layout[2] = (data->options->threshold_op != 0) ? data->options->nb_thresholds : 0;
+    layout[3] = (data->options->quantile_op != 0) ? data->options->nb_quantiles : 0;
+    layout[4] = (data->options->quantile_op != 0) ? data->options->quantile_estimator : 0;
+    layout[5] = (data->options->sobol_op != 0) ? data->options->nb_parameters : 0;
+}
+
+// the fields of the statistics out of the slabs (counters, thresholds, ...)
+static void write_scalars (melissa_data_t *data,
+                           FILE           *f)
+{
+    int nb_time_steps = data->options->nb_time_steps;
+
+    save_moments(data->moments, 0, nb_time_steps, f);
+    if (data->options->min_and_max_op != 0)
+    {
+        save_min_max(data->min_max, 0, nb_time_steps, f);
+    }
+    if (data->options->threshold_op != 0)
+    {
+        save_threshold(data->thresholds, 0, nb_time_steps, data->options->nb_thresholds, f);
+    }
+    if (data->options->quantile_op != 0)
+    {
+        if (data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+        {
+            save_p2_quantile(data->p2_quantiles, 0, nb_time_steps, f);
+        }
+        else
+        {
+            save_quantile(data->quantiles, 0, nb_time_steps, data->options->nb_quantiles, f);
+        }
+    }
+    if (data->options->sobol_op != 0)
+    {
+        data->save_sobol(data->sobol_indices, 0, nb_time_steps, data->options->nb_parameters, f);
+    }
+}
+
+static void read_scalars (melissa_data_t *data,
+                          FILE           *f)
+{
+    int nb_time_steps = data->options->nb_time_steps;
+
+    read_moments(data->moments, 0, nb_time_steps, f);
+    if (data->options->min_and_max_op != 0)
+    {
+        read_min_max(data->min_max, 0, nb_time_steps, f);
+    }
+    if (data->options->threshold_op != 0)
+    {
+        read_threshold(data->thresholds, 0, nb_time_steps, data->options->nb_thresholds, f);
+    }
+    if (data->options->quantile_op != 0)
+    {
+        if (data->options->quantile_estimator == MELISSA_QUANTILE_P2)
+        {
+            read_p2_quantile(data->p2_quantiles, 0, nb_time_steps, f);
+        }
+        else
+        {
+            read_quantile(data->quantiles, 0, nb_time_steps, data->options->nb_quantiles, f);
+        }
+    }
+    if (data->options->sobol_op != 0)
+    {
+        data->read_sobol(data->sobol_indices, 0, nb_time_steps, data->options->nb_parameters, f);
+    }
+}
+
+// fills the header of the image of a client rank, and computes the Sobol
+// index values, that live in the slabs
+static void image_header (melissa_data_t         *data,
+                          melissa_image_header_t *header)
+{
+    int t;
+
+    memset (header, 0, sizeof(*header));
+    memcpy (header->magic, MELISSA_IMAGE_MAGIC, sizeof(header->magic));
+    header->version       = MELISSA_IMAGE_VERSION;
+    header->vect_size     = data->vect_size;
+    header->nb_time_steps = data->options->nb_time_steps;
+    header->generation    = data->checkpoint_generation;
+    image_layout (data, header->layout);
+    header->page_size     = sysconf (_SC_PAGESIZE);
+    header->data_offset   = (sizeof(*header) + header->page_size - 1) / header->page_size * header->page_size;
+    header->slab_size     = data->step_size;
+    header->stride        = (header->slab_size + header->page_size - 1) / header->page_size * header->page_size;
+    header->scalar_offset = header->data_offset + header->nb_time_steps * header->stride;
+
+    if (data->options->sobol_op != 0)
+    {
+        for (t=0; t<header->nb_time_steps; t++)
+        {
+            compute_sobol_martinez_values (&data->sobol_indices[t], data->options->nb_parameters, data->vect_size);
+        }
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function writes the checkpoint image of a client rank in a stream
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * data structure of the client rank to save
+ *
+ * @param[in] *f
+ * stream to write to, at its begining
+ *
+ *******************************************************************************/
+
+static void write_image (melissa_data_t *data,
+                         FILE           *f)
+{
+    melissa_image_header_t header;
+    int64_t *sizes;
+    int64_t  packed_size;
+    long int end;
+    int t;
+
+    image_header (data, &header);
+    if (data->options->compress_checkpoint > 0)
+    {
+        header.codec  = MELISSA_CODEC_LZ4;
+        header.stride = 0;
+        sizes = melissa_calloc (header.nb_time_steps, sizeof(int64_t));
+        fseek (f, header.data_offset + header.nb_time_steps * sizeof(int64_t), SEEK_SET);
+        packed_size = melissa_codec_write_steps (data->arena.base + data->step_offset, data->step_size, header.nb_time_steps,
+                                                 data->options->compress_checkpoint, sizes, f);
+        header.scalar_offset = ftell (f);
+        write_scalars (data, f);
+        bitmap_write (&data->step_simu, 1, f);
+        // the sizes are known once compressed, the stream ends at the end of the image
+        end = ftell (f);
+        fseek (f, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, f);
+        fseek (f, header.data_offset, SEEK_SET);
+        fwrite(sizes, sizeof(int64_t), header.nb_time_steps, f);
+        fseek (f, end, SEEK_SET);
+        melissa_print (VERBOSE_DEBUG, "Time steps compressed from %ld to %ld bytes (save_stats)\n",
+                       (long int)(header.nb_time_steps * data->step_size), (long int)packed_size);
+        melissa_free (sizes);
+        return;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    for (t=0; t<header.nb_time_steps; t++)
+    {
+        fseek (f, header.data_offset + t * header.stride, SEEK_SET);
+        fwrite(data->arena.base + data->step_offset + t * data->step_size, 1, data->step_size, f);
+    }
+    fseek (f, header.scalar_offset, SEEK_SET);
+    write_scalars (data, f);
+    bitmap_write (&data->step_simu, 1, f);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function restores a client rank from its checkpoint image. The slabs
+ * are mapped in the statistics arena when possible, so that they are only read
+ * from the disc when accessed. Compressed slabs are decompressed in the arena.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * data structure of the client rank, allocated
+ *
+ * @param[in] fd
+ * file holding the image, left open
+ *
+ * @param[in] base
+ * offset of the image in the file
+ *
+ * @param[in] *file_name
+ * name of the file, for the messages
+ *
+ * @return 0 on success, -1 if there is no usable image
+ *
+ *******************************************************************************/
+
+static int read_image_at (melissa_data_t *data,
+                          int             fd,
+                          off_t           base,
+                          const char     *file_name)
+{
+    melissa_image_header_t header;
+    int32_t  layout[8];
+    int      t, mapped;
+    int64_t  slab_size;
+    int64_t *sizes;
+    FILE*    f = NULL;
+
+    image_layout (data, layout);
+    if (pread (fd, &header, sizeof(header), base) != sizeof(header) ||
+        memcmp (header.magic, MELISSA_IMAGE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version < 1 || header.version > MELISSA_IMAGE_VERSION ||
+        (header.version > 1 && header.codec != MELISSA_CODEC_NONE && header.codec != MELISSA_CODEC_LZ4) ||
+        header.vect_size != data->vect_size ||
+        header.nb_time_steps != data->options->nb_time_steps ||
+        memcmp (header.layout, layout, sizeof(layout)) != 0)
+    {
+        melissa_print (VERBOSE_WARNING, "%s does not match the study, ignored (read_saved_stats)\n", file_name);
+        return -1;
+    }
+
+    if (header.version < 2)
+    {
+        // the header was followed by the padding of its page
+        header.codec = MELISSA_CODEC_NONE;
+    }
+
+    if (header.codec == MELISSA_CODEC_LZ4)
+    {
+        sizes = melissa_malloc (header.nb_time_steps * sizeof(int64_t));
+        mapped = -1;
+        if (pread (fd, sizes, header.nb_time_steps * sizeof(int64_t), base + header.data_offset) == (ssize_t)(header.nb_time_steps * sizeof(int64_t)))
+        {
+            mapped = melissa_codec_read_steps (data->arena.base + data->step_offset, data->step_size, header.slab_size, header.nb_time_steps,
+                                               (data->options->compress_checkpoint > 0) ? data->options->compress_checkpoint : 1,
+                                               sizes, fd, base + header.data_offset + header.nb_time_steps * sizeof(int64_t));
+        }
+        melissa_free (sizes);
+    }
+    else if (header.stride == (int64_t)data->step_size)
+    {
+        mapped = melissa_arena_map_file (&data->arena, data->step_offset, header.nb_time_steps * data->step_size, fd, base + header.data_offset);
+    }
+    else
+    {
+        // slabs aligned on other pages: same content, other padding
+        slab_size = (header.slab_size < (int64_t)data->step_size) ? header.slab_size : (int64_t)data->step_size;
+        mapped = 0;
+        for (t=0; t<header.nb_time_steps && mapped == 0; t++)
+        {
+            mapped = melissa_arena_map_file (&data->arena, data->step_offset + t * data->step_size, slab_size, fd, base + header.data_offset + t * header.stride);
+        }
+    }
+    f = fdopen (dup (fd), "rb");
+    if (mapped < 0 || f == NULL || fseeko (f, base + header.scalar_offset, SEEK_SET) != 0)
+    {
+        melissa_print (VERBOSE_ERROR, "Can not read %s (read_saved_stats)\n", file_name);
+        exit (1);
+    }
+    read_scalars (data, f);
+    if (bitmap_read (&data->step_simu, f) != 0)
+    {
+        melissa_print (VERBOSE_ERROR, "Bad simulation steps in %s (read_saved_stats)\n", file_name);
+        exit (1);
+    }
+    data->checkpoint_generation = header.generation;
+    melissa_print (VERBOSE_DEBUG, "%s %s (read_saved_stats)\n", file_name, (mapped == 1) ? "mapped" : "read");
+    fclose (f);
+    return 0;
+}
+
+static int read_image (melissa_data_t *data,
+                       const char     *file_name)
+{
+    int ret, fd;
+
+    fd = open (file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ret = read_image_at (data, fd, 0, file_name);
+    // the mappings keep their own reference on the file
+    close (fd);
+    return ret;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function checkpoints the stats of a client rank. Only the time steps
+ * modified since the last checkpoint are appended to a delta log. The log is
+ * compacted in a full checkpoint (image) once it is as large as the image.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * data structure to save
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] *field_name
+ * name of the field to write
+ *
+ * @param[in] client_rank
+ * mpi rank of the client process
+ *
+ * @param[in,out] *checkpoint
+ * background checkpoint writer, NULL to write synchronously
+ *
+ * @return 0 on success, -1 if a file can not be opened
+ *
+ *******************************************************************************/
+
+static int save_client_stats (melissa_data_t       *data,
+                              comm_data_t          *comm_data,
+                              char                 *field_name,
+                              int                   client_rank,
+                              melissa_checkpoint_t *checkpoint)
+{
+    char           file_name[256];
+    char           tmp_name[260];
+    int            t, append;
+    FILE*          f = NULL;
+    melissa_data_t *client_data = &data[client_rank];
+
+    if (client_data->vect_size > 0 && client_data->stats_init == 1 &&
+        client_data->checkpoint_base_size > 0 &&
+        client_data->checkpoint_delta_size < client_data->checkpoint_base_size)
+    {
+        for (t=0; t<client_data->options->nb_time_steps; t++)
+        {
+            if (test_bit (client_data->step_dirty, t) != 0)
+            {
+                break;
+            }
+        }
+        if (t == client_data->options->nb_time_steps)
+        {
+            // nothing changed since the last checkpoint
+            return 0;
+        }
+        sprintf(file_name, "%s%d_%d.delta", field_name, comm_data->rank, client_rank);
+        append = (client_data->checkpoint_delta_size > 0);
+        f = (checkpoint != NULL) ? melissa_checkpoint_open (checkpoint, file_name, append) : fopen(file_name, append ? "ab" : "wb+");
+        if (f == NULL)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not open %s (save_stats)\n", file_name);
+            return -1;
+        }
+        if (append == 0)
+        {
+            fwrite(&client_data->checkpoint_generation, sizeof(int), 1, f);
+            fwrite(&client_data->vect_size, sizeof(int), 1, f);
+            client_data->checkpoint_delta_size = 2 * sizeof(int);
+        }
+        melissa_print (VERBOSE_DEBUG, "Save delta (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, client_rank);
+        client_data->checkpoint_delta_size += write_delta (client_data, f);
+    }
+    else if (client_data->vect_size > 0 && client_data->stats_init == 1)
+    {
+        // written aside then renamed: a restarted server may have mapped the previous image
+        sprintf(file_name, "%s%d_%d.image", field_name, comm_data->rank, client_rank);
+        sprintf(tmp_name, "%s.tmp", file_name);
+        f = (checkpoint != NULL) ? melissa_checkpoint_open (checkpoint, file_name, 0) : fopen(tmp_name, "wb");
+        if (f == NULL)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not open %s (save_stats)\n", file_name);
+            return -1;
+        }
+        client_data->checkpoint_generation += 1;
+        memset (client_data->step_dirty, 0, ((client_data->options->nb_time_steps+31)/32) * sizeof(uint32_t));
+        melissa_print (VERBOSE_DEBUG, "Save image (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, client_rank);
+        write_image (client_data, f);
+        client_data->checkpoint_base_size  = ftell (f);
+        if (checkpoint == NULL)
+        {
+            if (fclose(f) != 0 || rename (tmp_name, file_name) != 0)
+            {
+                melissa_print (VERBOSE_ERROR, "Can not write %s (save_stats)\n", file_name);
+                return -1;
+            }
+        }
+        // empty log of the new image, written after it: a log left by an older
+        // study with the same generation number is never replayed
+        sprintf(file_name, "%s%d_%d.delta", field_name, comm_data->rank, client_rank);
+        f = (checkpoint != NULL) ? melissa_checkpoint_open (checkpoint, file_name, 0) : fopen(file_name, "wb");
+        if (f == NULL)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not open %s (save_stats)\n", file_name);
+            return -1;
+        }
+        fwrite(&client_data->checkpoint_generation, sizeof(int), 1, f);
+        fwrite(&client_data->vect_size, sizeof(int), 1, f);
+        // no record yet: the next delta rewrites this header
+        client_data->checkpoint_delta_size = 0;
+    }
+    else
+    {
+        sprintf(file_name, "%s%d_%d.data", field_name, comm_data->rank, client_rank);
+        f = (checkpoint != NULL) ? melissa_checkpoint_open (checkpoint, file_name, 0) : fopen(file_name, "wb+");
+        if (f == NULL)
+        {
+            melissa_print (VERBOSE_ERROR, "ERROR: Can not open %s%d_%d.data (save_stats)\n", field_name, comm_data->rank, client_rank);
+            return -1;
+        }
+        write_stats (data, comm_data, field_name, client_rank, f);
+    }
+    if (checkpoint == NULL)
+    {
+        fclose(f);
+    }
+    return 0;
+}
+
 /**
  *******************************************************************************
  *
@@ -128,76 +841,810 @@ int read_client_data (int                *client_comm_size,
  *
  *******************************************************************************
  *
- * @param[in] *data
- * data structure to save
+ * @param[in] *data
+ * data structure to save
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] *field_name
+ * name of the field to write
+ *
+ *******************************************************************************/
+
+void save_stats (melissa_data_t *data,
+                 comm_data_t    *comm_data,
+                 char           *field_name)
+{
+    int        i;
+
+    for (i=0; i<comm_data->client_comm_size; i++)
+    {
+        if (save_client_stats (data, comm_data, field_name, i, NULL) != 0)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function copies the stats in memory, to be written on disc by the
+ * checkpoint I/O thread
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * data structure to save
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] *field_name
+ * name of the field to write
+ *
+ * @param[in,out] *checkpoint
+ * background checkpoint writer
+ *
+ *******************************************************************************/
+
+void save_stats_async (melissa_data_t       *data,
+                       comm_data_t          *comm_data,
+                       char                 *field_name,
+                       melissa_checkpoint_t *checkpoint)
+{
+    int        i;
+
+    for (i=0; i<comm_data->client_comm_size; i++)
+    {
+        save_client_stats (data, comm_data, field_name, i, checkpoint);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_shared_header_s
+ *
+ * Header of a shared checkpoint: the images of every (server rank, client rank)
+ * pair of a field in one file, found through an index
+ *
+ *******************************************************************************/
+
+struct melissa_shared_header_s
+{
+    char     magic[8];     /**< MELISSA_SHARED_MAGIC                               */
+    int32_t  version;      /**< MELISSA_SHARED_VERSION                             */
+    int32_t  nb_servers;   /**< number of server ranks that wrote the file         */
+    int32_t  nb_clients;   /**< number of client ranks                             */
+    int32_t  page_size;    /**< alignment of the images in the file                */
+    int32_t  consistent;   /**< 1 if the images of a client rank received the same
+                                simulation time steps (shared_steps_consistent)  */
+    int32_t  reserved;     /**< 0, aligns the offsets                              */
+    int64_t  index_offset; /**< offset of the index, nb_servers x nb_clients entries */
+    int64_t  sizes_offset; /**< offset of the vector sizes of the client ranks     */
+    int64_t  data_offset;  /**< offset of the first image                          */
+};
+
+typedef struct melissa_shared_header_s melissa_shared_header_t; /**< type corresponding to melissa_shared_header_s */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_shared_entry_s
+ *
+ * Index entry of a shared checkpoint, one per (server rank, client rank) pair,
+ * server rank major
+ *
+ *******************************************************************************/
+
+struct melissa_shared_entry_s
+{
+    int32_t  vect_size;  /**< vector size of the pair, 0 if it has no image */
+    int32_t  generation; /**< generation of the image                       */
+    int64_t  offset;     /**< offset of the image in the file               */
+    int64_t  size;       /**< size of the image, rounded to a page          */
+};
+
+typedef struct melissa_shared_entry_s melissa_shared_entry_t; /**< type corresponding to melissa_shared_entry_s */
+
+#define MELISSA_SHARED_MAGIC   "MELSHARE" /**< first bytes of a shared checkpoint */
+#define MELISSA_SHARED_VERSION 3          /**< version of the shared layout       */
+
+#ifdef BUILD_WITH_MPI
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function checks that the shared checkpoint of a field would be a
+ * consistent cut: every simulation time step of a client rank was received
+ * by all the server ranks holding a part of the client rank, or by none of
+ * them. Only such a checkpoint can be read on another number of server ranks.
+ * This function is collective on comm.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * data structure of the field, NULL if this rank has no client rank yet
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] comm
+ * communicator of the server ranks dedicated to the checkpoints
+ *
+ * @return 1 if the cut is consistent, 0 otherwise
+ *
+ *******************************************************************************/
+
+int shared_steps_consistent (melissa_data_t *data,
+                             comm_data_t    *comm_data,
+                             MPI_Comm        comm)
+{
+    int       c, row, w;
+    int       nb_rows = 0, row_words = 0;
+    int       nb_clients = (data != NULL) ? comm_data->client_comm_size : 0;
+    int       local_clients = nb_clients;
+    int       consistent = 1;
+    size_t    nb_words;
+    uint64_t *all_steps, *any_steps, *words;
+
+    for (c=0; c<local_clients; c++)
+    {
+        if (data[c].vect_size > 0 && data[c].stats_init == 1)
+        {
+            nb_rows   = (data[c].step_simu.nb_rows > nb_rows) ? data[c].step_simu.nb_rows : nb_rows;
+            row_words = data[c].step_simu.row_words;
+        }
+    }
+    MPI_Allreduce (MPI_IN_PLACE, &nb_clients, 1, MPI_INT, MPI_MAX, comm);
+    MPI_Allreduce (MPI_IN_PLACE, &nb_rows, 1, MPI_INT, MPI_MAX, comm);
+    MPI_Allreduce (MPI_IN_PLACE, &row_words, 1, MPI_INT, MPI_MAX, comm);
+
+    // steps received by every holder of a client rank, and by at least one:
+    // a rank without a part of a client rank is neutral in both
+    nb_words  = (size_t)nb_clients * nb_rows * row_words;
+    all_steps = melissa_malloc ((nb_words > 0 ? nb_words : 1) * sizeof(uint64_t));
+    any_steps = melissa_calloc ((nb_words > 0 ? nb_words : 1), sizeof(uint64_t));
+    memset (all_steps, 0xff, nb_words * sizeof(uint64_t));
+    for (c=0; c<local_clients; c++)
+    {
+        if (data[c].vect_size <= 0 || data[c].stats_init != 1)
+        {
+            continue;
+        }
+        for (row=0; row<nb_rows; row++)
+        {
+            words = &all_steps[((size_t)c * nb_rows + row) * row_words];
+            if (row < data[c].step_simu.nb_rows)
+            {
+                memcpy (words, &data[c].step_simu.words[(size_t)row * row_words], row_words * sizeof(uint64_t));
+                memcpy (&any_steps[((size_t)c * nb_rows + row) * row_words], words, row_words * sizeof(uint64_t));
+            }
+            else
+            {
+                memset (words, 0, row_words * sizeof(uint64_t));
+            }
+        }
+    }
+    MPI_Allreduce (MPI_IN_PLACE, all_steps, nb_words, MPI_UINT64_T, MPI_BAND, comm);
+    MPI_Allreduce (MPI_IN_PLACE, any_steps, nb_words, MPI_UINT64_T, MPI_BOR, comm);
+    for (w=0; (size_t)w<nb_words && consistent != 0; w++)
+    {
+        consistent = ((any_steps[w] & ~all_steps[w]) == 0);
+    }
+    melissa_free (all_steps);
+    melissa_free (any_steps);
+    return consistent;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function saves the stats of a field in one file shared by all the
+ * server ranks, with collective MPI-IO writes. The file holds a header, an
+ * index, the vector size of each client rank, then the image of each
+ * (server rank, client rank) pair, aligned on a page. This function is
+ * collective on comm.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * data structure to save
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] *field_name
+ * name of the field to write
+ *
+ * @param[in] comm
+ * communicator of the server ranks dedicated to the checkpoints
+ *
+ * @param[in] consistent
+ * result of shared_steps_consistent, recorded in the header
+ *
+ * @return 0 on success, -1 if the file can not be written
+ *
+ *******************************************************************************/
+
+int save_stats_shared (melissa_data_t *data,
+                       comm_data_t    *comm_data,
+                       char           *field_name,
+                       MPI_Comm        comm,
+                       int             consistent)
+{
+    char                     file_name[256];
+    char                     tmp_name[260];
+    melissa_shared_header_t  shared;
+    melissa_shared_entry_t  *entries;
+    melissa_image_header_t  *headers;
+    char                   **tails;
+    size_t                  *tail_sizes;
+    char                    *head = NULL;
+    size_t                   head_size = 0;
+    int64_t                  local_size = 0, rank_offset = 0, end, total;
+    int                      i, c, active, ret, err = 0;
+    int                      nb_clients = comm_data->client_comm_size;
+    long int                 page_size = sysconf (_SC_PAGESIZE);
+    FILE*                    f = NULL;
+    MPI_File                 fh;
+    MPI_Datatype             page_type;
+    MPI_Status               status;
+    melissa_data_t          *client_data;
+
+    memset (&shared, 0, sizeof(shared));
+    memcpy (shared.magic, MELISSA_SHARED_MAGIC, sizeof(shared.magic));
+    shared.version      = MELISSA_SHARED_VERSION;
+    shared.nb_servers   = comm_data->comm_size;
+    shared.nb_clients   = nb_clients;
+    shared.page_size    = page_size;
+    shared.consistent   = consistent;
+    shared.index_offset = sizeof(shared);
+    shared.sizes_offset = shared.index_offset + (int64_t)comm_data->comm_size * nb_clients * sizeof(melissa_shared_entry_t);
+    shared.data_offset  = (shared.sizes_offset + nb_clients * sizeof(int64_t) + page_size - 1) / page_size * page_size;
+
+    // the images are serialized first, their sizes give the offsets
+    entries    = melissa_calloc (nb_clients, sizeof(melissa_shared_entry_t));
+    headers    = melissa_calloc (nb_clients, sizeof(melissa_image_header_t));
+    tails      = melissa_calloc (nb_clients, sizeof(char*));
+    tail_sizes = melissa_calloc (nb_clients, sizeof(size_t));
+    for (c=0; c<nb_clients; c++)
+    {
+        client_data = &data[c];
+        if (client_data->vect_size <= 0 || client_data->stats_init != 1)
+        {
+            continue;
+        }
+        client_data->checkpoint_generation += 1;
+        memset (client_data->step_dirty, 0, ((client_data->options->nb_time_steps+31)/32) * sizeof(uint32_t));
+        image_header (client_data, &headers[c]);
+        if (headers[c].stride != (int64_t)client_data->step_size)
+        {
+            melissa_print (VERBOSE_ERROR, "Statistics slabs not aligned on pages (save_stats_shared)\n");
+            exit (1);
+        }
+        f = open_memstream (&tails[c], &tail_sizes[c]);
+        write_scalars (client_data, f);
+        bitmap_write (&client_data->step_simu, 1, f);
+        fclose (f);
+        if (tail_sizes[c] > INT_MAX)
+        {
+            melissa_print (VERBOSE_ERROR, "Statistics counters too large for one write (save_stats_shared)\n");
+            exit (1);
+        }
+        entries[c].vect_size  = client_data->vect_size;
+        entries[c].generation = client_data->checkpoint_generation;
+        entries[c].offset     = local_size;
+        entries[c].size       = (headers[c].scalar_offset + tail_sizes[c] + page_size - 1) / page_size * page_size;
+        local_size += entries[c].size;
+    }
+    MPI_Exscan (&local_size, &rank_offset, 1, MPI_INT64_T, MPI_SUM, comm);
+    if (comm_data->rank == 0)
+    {
+        rank_offset = 0;
+    }
+    for (c=0; c<nb_clients; c++)
+    {
+        if (entries[c].size > 0)
+        {
+            entries[c].offset += shared.data_offset + rank_offset;
+        }
+    }
+    end = shared.data_offset + rank_offset + local_size;
+    MPI_Allreduce (&end, &total, 1, MPI_INT64_T, MPI_MAX, comm);
+
+    // rank 0 writes the header, the whole index and the client vector sizes
+    if (comm_data->rank == 0)
+    {
+        head_size = shared.sizes_offset + nb_clients * sizeof(int64_t);
+        head = melissa_calloc (head_size, 1);
+        memcpy (head, &shared, sizeof(shared));
+    }
+    MPI_Gather (entries, nb_clients * sizeof(melissa_shared_entry_t), MPI_BYTE,
+                (head != NULL) ? head + shared.index_offset : NULL, nb_clients * sizeof(melissa_shared_entry_t), MPI_BYTE,
+                0, comm);
+    if (comm_data->rank == 0)
+    {
+        for (i=0; i<comm_data->comm_size * nb_clients; i++)
+        {
+            ((int64_t*)(head + shared.sizes_offset))[i % nb_clients] += ((melissa_shared_entry_t*)(head + shared.index_offset))[i].vect_size;
+        }
+    }
+
+    // written aside then renamed: a restarted server may have mapped the previous file
+    sprintf(file_name, "%s.ckpt", field_name);
+    sprintf(tmp_name, "%s.tmp", file_name);
+    ret = MPI_File_open (comm, tmp_name, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    if (ret != MPI_SUCCESS)
+    {
+        melissa_print (VERBOSE_ERROR, "Can not open %s (save_stats_shared)\n", tmp_name);
+        err = -1;
+    }
+    else
+    {
+        MPI_File_set_size (fh, total);
+        ret = MPI_File_write_at_all (fh, 0, head, head_size, MPI_BYTE, &status);
+        err = (ret != MPI_SUCCESS) ? -1 : err;
+        MPI_Type_contiguous (page_size, MPI_BYTE, &page_type);
+        MPI_Type_commit (&page_type);
+        // the same number of collective calls on every rank, empty for the pairs without image
+        for (c=0; c<nb_clients; c++)
+        {
+            active = (entries[c].size > 0);
+            ret = MPI_File_write_at_all (fh, entries[c].offset, &headers[c],
+                                         active ? sizeof(melissa_image_header_t) : 0, MPI_BYTE, &status);
+            err = (ret != MPI_SUCCESS) ? -1 : err;
+            ret = MPI_File_write_at_all (fh, entries[c].offset + headers[c].data_offset,
+                                         active ? data[c].arena.base + data[c].step_offset : NULL,
+                                         active ? headers[c].nb_time_steps * headers[c].stride / page_size : 0, page_type, &status);
+            err = (ret != MPI_SUCCESS) ? -1 : err;
+            ret = MPI_File_write_at_all (fh, entries[c].offset + headers[c].scalar_offset, tails[c],
+                                         active ? (int)tail_sizes[c] : 0, MPI_BYTE, &status);
+            err = (ret != MPI_SUCCESS) ? -1 : err;
+        }
+        MPI_Type_free (&page_type);
+        ret = MPI_File_close (&fh);
+        err = (ret != MPI_SUCCESS) ? -1 : err;
+        if (err != 0)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not write %s (save_stats_shared)\n", tmp_name);
+        }
+        MPI_Allreduce (MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, comm);
+        if (comm_data->rank == 0 && err == 0 && rename (tmp_name, file_name) != 0)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not rename %s (save_stats_shared)\n", tmp_name);
+            err = -1;
+        }
+        // the file is in place on every rank when this function returns
+        MPI_Bcast (&err, 1, MPI_INT, 0, comm);
+    }
+
+    for (c=0; c<nb_clients; c++)
+    {
+        free (tails[c]);
+    }
+    melissa_free (tails);
+    melissa_free (tail_sizes);
+    melissa_free (headers);
+    melissa_free (entries);
+    if (head != NULL)
+    {
+        melissa_free (head);
+    }
+    return err;
+}
+#endif // BUILD_WITH_MPI
+
+// reads size bytes at offset, exits on a short read
+static void pread_full (int         fd,
+                        void       *buffer,
+                        size_t      size,
+                        off_t       offset,
+                        const char *file_name)
+{
+    ssize_t ret;
+
+    while (size > 0)
+    {
+        ret = pread (fd, buffer, size, offset);
+        if (ret <= 0)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not read %s (read_saved_stats)\n", file_name);
+            exit (1);
+        }
+        buffer  = (char*)buffer + ret;
+        size   -= ret;
+        offset += ret;
+    }
+}
+
+// first element of a server rank, with the partition of the simulation side
+// (comm_n_to_m_init): the global vector is split in nb_servers contiguous
+// ranges, the first ones one element larger
+static int64_t server_first (int64_t global_size,
+                             int     nb_servers,
+                             int     rank)
+{
+    int64_t remainder = global_size % nb_servers;
+
+    return rank * (global_size / nb_servers) + ((rank < remainder) ? rank : remainder);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function restores a client rank from a shared checkpoint written by
+ * another number of server ranks. The element range of the client rank on
+ * this server rank is rebuilt from the element ranges of the old pairs of the
+ * same client rank: the vectors of each time step are copied block by block.
+ * The old pairs must have received the same simulation time steps, their
+ * counters are then the same (shared_steps_consistent): otherwise, the
+ * server exits with an error.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * data structure of the client rank, allocated
  *
  * @param[in] *comm_data
  * communication structure
  *
- * @param[in] *field_name
- * name of the field to write
+ * @param[in] client_rank
+ * mpi rank of sending client process
+ *
+ * @param[in] fd
+ * shared checkpoint, left open
+ *
+ * @param[in] *shared
+ * header of the shared checkpoint
+ *
+ * @param[in] *file_name
+ * name of the file, for the messages
  *
  *******************************************************************************/
 
-void save_stats (melissa_data_t *data,
-                 comm_data_t    *comm_data,
-                 char           *field_name)
+static void read_shared_elastic (melissa_data_t          *data,
+                                 comm_data_t             *comm_data,
+                                 int                      client_rank,
+                                 int                      fd,
+                                 melissa_shared_header_t *shared,
+                                 const char              *file_name)
 {
-    char       file_name[256];
-    int        i, j;
-    FILE*      f = NULL;
+    melissa_shared_entry_t  entry;
+    melissa_image_header_t  header;
+    melissa_slab_block_t   *blocks, *old_blocks;
+    melissa_data_t         *pieces;
+    int64_t                *client_sizes;
+    int64_t                 global_size = 0, client_first = 0;
+    int64_t                 first, end, old_first, old_end, lo, hi;
+    int32_t                 layout[8];
+    int                     c, s, t, b, k, row, count;
+    int                     nb_blocks, nb_old_blocks, nb_pieces = 0, nb_inconsistent = 0, nb_rows = 0;
+    int                     nb_time_steps = data->options->nb_time_steps;
+    char                   *slab, *buffer = NULL;
+    size_t                  size = 0;
+    FILE*                   f = NULL;
 
-    for (i=0; i<comm_data->client_comm_size; i++)
+    // the element range of the client rank, in the global vector
+    client_sizes = melissa_malloc (shared->nb_clients * sizeof(int64_t));
+    pread_full (fd, client_sizes, shared->nb_clients * sizeof(int64_t), shared->sizes_offset, file_name);
+    for (c=0; c<shared->nb_clients; c++)
     {
-        sprintf(file_name, "%s%d_%d.data", field_name, comm_data->rank, i);
-        f = fopen(file_name, "wb+");
-        if (f == NULL)
+        global_size += client_sizes[c];
+        client_first += (c < client_rank) ? client_sizes[c] : 0;
+    }
+    first = server_first (global_size, comm_data->comm_size, comm_data->rank);
+    end   = server_first (global_size, comm_data->comm_size, comm_data->rank + 1);
+    first = (first > client_first) ? first : client_first;
+    end   = (end < client_first + client_sizes[client_rank]) ? end : client_first + client_sizes[client_rank];
+    if (end - first != data->vect_size)
+    {
+        melissa_print (VERBOSE_ERROR, "%s holds %ld elements of client rank %d for server rank %d, %d received (read_saved_stats)\n",
+                       file_name, (long)(end - first), client_rank, comm_data->rank, data->vect_size);
+        exit (1);
+    }
+
+    image_layout (data, layout);
+    blocks = melissa_slab_layout (data, data->vect_size, &nb_blocks);
+    pieces = melissa_calloc (shared->nb_servers, sizeof(melissa_data_t));
+    for (s=0; s<shared->nb_servers; s++)
+    {
+        old_first = server_first (global_size, shared->nb_servers, s);
+        old_end   = server_first (global_size, shared->nb_servers, s + 1);
+        old_first = (old_first > client_first) ? old_first : client_first;
+        old_end   = (old_end < client_first + client_sizes[client_rank]) ? old_end : client_first + client_sizes[client_rank];
+        pread_full (fd, &entry, sizeof(entry), shared->index_offset + ((int64_t)s * shared->nb_clients + client_rank) * sizeof(entry), file_name);
+        if (entry.vect_size != ((old_end > old_first) ? old_end - old_first : 0))
         {
-            melissa_print (VERBOSE_ERROR, 2, "ERROR: Can not open %s%d_%d.data (save_stats)\n", field_name, comm_data->rank, i);
-            return;
+            // a pair never received a message before the checkpoint
+            melissa_print (VERBOSE_ERROR, "%s is incomplete: %d elements of client rank %d on server rank %d, %ld expected (read_saved_stats)\n",
+                           file_name, entry.vect_size, client_rank, s, (long)(old_end - old_first));
+            exit (1);
         }
-        fwrite(&data[i].vect_size, sizeof(int), 1, f);
-        if (data[i].vect_size > 0)
+        lo = (old_first > first) ? old_first : first;
+        hi = (old_end < end) ? old_end : end;
+        if (lo >= hi)
         {
-//            if (data[i].options->mean_op != 0 && data[i].options->variance_op == 0)
-//            {
-//                save_mean(data[i].means, data[i].vect_size, data[i].options->nb_time_steps, f);
-//            }
-//            if (data[i].options->variance_op != 0)
-//            {
-//                save_variance(data[i].variances, data[i].vect_size, data[i].options->nb_time_steps, f);
-//            }
-            melissa_print (VERBOSE_DEBUG, "Save moments (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, i);
-            save_moments(data[i].moments, data[i].vect_size, data[i].options->nb_time_steps, f);
-            if (data[i].options->min_and_max_op != 0)
-            {
-                melissa_print (VERBOSE_DEBUG, "Save min and max (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, i);
-                save_min_max(data[i].min_max, data[i].vect_size, data[i].options->nb_time_steps, f);
-            }
-            if (data[i].options->threshold_op != 0)
+            continue;
+        }
+
+        pread_full (fd, &header, sizeof(header), entry.offset, file_name);
+        if (memcmp (header.magic, MELISSA_IMAGE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version < 1 || header.version > MELISSA_IMAGE_VERSION ||
+            (header.version > 1 && header.codec != MELISSA_CODEC_NONE) ||
+            header.vect_size != entry.vect_size ||
+            header.nb_time_steps != nb_time_steps ||
+            memcmp (header.layout, layout, sizeof(layout)) != 0)
+        {
+            melissa_print (VERBOSE_ERROR, "%s does not match the study (read_saved_stats)\n", file_name);
+            exit (1);
+        }
+        old_blocks = melissa_slab_layout (data, entry.vect_size, &nb_old_blocks);
+        for (t=0; t<nb_time_steps; t++)
+        {
+            slab = data->arena.base + data->step_offset + t * data->step_size;
+            for (b=0; b<nb_blocks; b++)
             {
-                melissa_print (VERBOSE_DEBUG, "Save threshold exceedances (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, i);
-                save_threshold(data[i].thresholds, data[i].vect_size, data[i].options->nb_time_steps, data[i].options->nb_thresholds, f);
+                if (blocks[b].elem_bytes > 0)
+                {
+                    pread_full (fd, slab + blocks[b].offset + (lo - first) * blocks[b].elem_bytes,
+                                (hi - lo) * blocks[b].elem_bytes,
+                                entry.offset + header.data_offset + t * header.stride + old_blocks[b].offset + (lo - old_first) * blocks[b].elem_bytes,
+                                file_name);
+                }
+                else if (nb_pieces == 0)
+                {
+                    // same content in every pair
+                    pread_full (fd, slab + blocks[b].offset, blocks[b].bytes,
+                                entry.offset + header.data_offset + t * header.stride + old_blocks[b].offset, file_name);
+                }
             }
-            if (data[i].options->quantile_op != 0)
+        }
+        melissa_free (old_blocks);
+
+        // counters and simulation steps of the old pair
+        pieces[nb_pieces].is_valid = 1;
+        melissa_init_data (&pieces[nb_pieces], data->options, 1);
+        f = fdopen (dup (fd), "rb");
+        if (f == NULL || fseeko (f, entry.offset + header.scalar_offset, SEEK_SET) != 0)
+        {
+            melissa_print (VERBOSE_ERROR, "Can not read %s (read_saved_stats)\n", file_name);
+            exit (1);
+        }
+        read_scalars (&pieces[nb_pieces], f);
+        if (bitmap_read (&pieces[nb_pieces].step_simu, f) != 0)
+        {
+            melissa_print (VERBOSE_ERROR, "Bad simulation steps in %s (read_saved_stats)\n", file_name);
+            exit (1);
+        }
+        fclose (f);
+        if (entry.generation > data->checkpoint_generation)
+        {
+            data->checkpoint_generation = entry.generation;
+        }
+        nb_pieces += 1;
+    }
+
+    for (k=0; k<nb_pieces; k++)
+    {
+        nb_rows = (pieces[k].step_simu.nb_rows > nb_rows) ? pieces[k].step_simu.nb_rows : nb_rows;
+    }
+    // the counters and scalars of a time step can only be rebuilt if every
+    // old pair received the same simulation time steps: the statistics of
+    // the elements of an old pair that missed some of them can not be told
+    // apart in the new pair
+    for (row=0; row<nb_rows; row++)
+    {
+        for (t=0; t<nb_time_steps; t++)
+        {
+            count = 0;
+            for (k=0; k<nb_pieces; k++)
             {
-                melissa_print (VERBOSE_DEBUG, "Save quantiles (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, i);
-                save_quantile(data[i].quantiles, data[i].vect_size, data[i].options->nb_time_steps, data[i].options->nb_quantiles, f);
+                count += (row < pieces[k].step_simu.nb_rows && bitmap_test (&pieces[k].step_simu, row, t) != 0);
             }
-            if (data[i].options->sobol_op != 0)
+            nb_inconsistent += (count > 0 && count < nb_pieces);
+            if (count > 0)
             {
-                melissa_print (VERBOSE_DEBUG, "Save Sobol indices (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, i);
-                data[i].save_sobol(data[i].sobol_indices, data[i].vect_size, data[i].options->nb_time_steps, data[i].options->nb_parameters, f);
+                bitmap_set (&data->step_simu, row, t);
             }
-            melissa_print (VERBOSE_DEBUG, "Save simulation steps (field %s, server rank %d, client rank %d) (save_stats)\n", field_name, comm_data->rank, i);
-            fwrite(&data[i].step_simu.size, sizeof(int), 1, f);
-            for (j=0; j<data[i].step_simu.size; j++)
+        }
+    }
+    if (nb_inconsistent > 0)
+    {
+        melissa_print (VERBOSE_ERROR, "%d simulation time steps of client rank %d were only received by a part of the old server ranks, %s can not be read on another number of server ranks (read_saved_stats)\n",
+                       nb_inconsistent, client_rank, file_name);
+        exit (1);
+    }
+    f = open_memstream (&buffer, &size);
+    for (t=0; t<nb_time_steps; t++)
+    {
+        write_step (&pieces[0], t, 0, f);
+    }
+    fclose (f);
+    f = fmemopen (buffer, size, "rb");
+    for (t=0; t<nb_time_steps; t++)
+    {
+        read_step (data, 0, f);
+        if (data->options->sobol_op != 0)
+        {
+            // the index values of the copied elements come from several pairs
+            data->sobol_indices[t].values_iteration = -1;
+        }
+    }
+    fclose (f);
+    free (buffer);
+
+    melissa_print (VERBOSE_DEBUG, "Client rank %d rebuilt from %d pairs of %s (read_saved_stats)\n", client_rank, nb_pieces, file_name);
+    for (k=0; k<nb_pieces; k++)
+    {
+        melissa_free_data (&pieces[k]);
+    }
+    melissa_free (pieces);
+    melissa_free (blocks);
+    melissa_free (client_sizes);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function restores a client rank from the shared checkpoint of its
+ * field, written by save_stats_shared, possibly by another number of server
+ * ranks
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * data structure of the client rank, allocated
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] *field_name
+ * name of the field to read
+ *
+ * @param[in] client_rank
+ * mpi rank of sending client process
+ *
+ * @return 0 on success, -1 if there is no shared checkpoint
+ *
+ *******************************************************************************/
+
+static int read_shared_image (melissa_data_t *data,
+                              comm_data_t    *comm_data,
+                              char           *field_name,
+                              int             client_rank)
+{
+    char                    file_name[256];
+    melissa_shared_header_t shared;
+    melissa_shared_entry_t  entry;
+    int                     fd, ret;
+
+    sprintf(file_name, "%s/%s.ckpt", data->options->restart_dir, field_name);
+    fd = open (file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (pread (fd, &shared, sizeof(shared), 0) != sizeof(shared) ||
+        memcmp (shared.magic, MELISSA_SHARED_MAGIC, sizeof(shared.magic)) != 0 ||
+        shared.version != MELISSA_SHARED_VERSION ||
+        shared.nb_clients != comm_data->client_comm_size)
+    {
+        melissa_print (VERBOSE_WARNING, "%s does not match the study, ignored (read_saved_stats)\n", file_name);
+        close (fd);
+        return -1;
+    }
+    if (shared.nb_servers != comm_data->comm_size)
+    {
+        if (shared.consistent == 0)
+        {
+            melissa_print (VERBOSE_ERROR, "%s was written while the server ranks had not received the same simulation time steps, it can only be read on %d server ranks (read_saved_stats)\n",
+                           file_name, shared.nb_servers);
+            exit (1);
+        }
+        read_shared_elastic (data, comm_data, client_rank, fd, &shared, file_name);
+        close (fd);
+        return 0;
+    }
+    if (pread (fd, &entry, sizeof(entry), shared.index_offset + ((int64_t)comm_data->rank * shared.nb_clients + client_rank) * sizeof(entry)) != sizeof(entry) ||
+        entry.vect_size != data->vect_size)
+    {
+        melissa_print (VERBOSE_ERROR, "No image of client rank %d in %s (read_saved_stats)\n", client_rank, file_name);
+        exit (1);
+    }
+    ret = read_image_at (data, fd, entry.offset, file_name);
+    close (fd);
+    return ret;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function replays the delta log of a full checkpoint. The records are
+ * applied in order, a record cut by a crash and the following ones are ignored.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *data
+ * data structure of the client rank, read from the full checkpoint
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in] *field_name
+ * name of the field to read
+ *
+ * @param[in] client_rank
+ * mpi rank of sending client process
+ *
+ *******************************************************************************/
+
+static void read_deltas (melissa_data_t *data,
+                         comm_data_t    *comm_data,
+                         char           *field_name,
+                         int             client_rank)
+{
+    char       file_name[256];
+    int        i, generation, vect_size, nb_steps, nb_records = 0;
+    int64_t    record_size;
+    long int   file_size, record_start;
+    FILE*      f = NULL;
+
+    sprintf(file_name, "%s/%s%d_%d.delta", data->options->restart_dir, field_name, comm_data->rank, client_rank);
+    f = fopen(file_name, "rb");
+    if (f == NULL)
+    {
+        return;
+    }
+    fseek (f, 0, SEEK_END);
+    file_size = ftell (f);
+    fseek (f, 0, SEEK_SET);
+    if (fread(&generation, sizeof(int), 1, f) != 1 || fread(&vect_size, sizeof(int), 1, f) != 1 ||
+        generation != data->checkpoint_generation || vect_size != data->vect_size)
+    {
+        // log of an older full checkpoint
+        fclose(f);
+        return;
+    }
+    while (fread(&record_size, sizeof(int64_t), 1, f) == 1)
+    {
+        record_start = ftell (f);
+        if (record_size < (int64_t)sizeof(int) || record_start + record_size > file_size)
+        {
+            melissa_print (VERBOSE_WARNING, "Incomplete record in %s, ignored (read_saved_stats)\n", file_name);
+            break;
+        }
+        fread(&nb_steps, sizeof(int), 1, f);
+        for (i=0; i<nb_steps; i++)
+        {
+            if (read_step (data, data->vect_size, f) != 0)
             {
-                fwrite(data[i].step_simu.items[j], sizeof(int32_t), (data[i].options->nb_time_steps+31)/32, f);
+                melissa_print (VERBOSE_ERROR, "Bad time step in %s (read_saved_stats)\n", file_name);
+                exit (1);
             }
         }
-        fclose(f);
+        if (bitmap_read (&data->step_simu, f) != 0 || ftell (f) != record_start + record_size)
+        {
+            melissa_print (VERBOSE_ERROR, "Bad record in %s (read_saved_stats)\n", file_name);
+            exit (1);
+        }
+        nb_records += 1;
     }
+    melissa_print (VERBOSE_DEBUG, "%d records read from %s (read_saved_stats)\n", nb_records, file_name);
+    fclose(f);
 }
 
 /**
@@ -229,14 +1676,40 @@ void read_saved_stats (melissa_data_t *data,
                        int             client_rank)
 {
     char       file_name[256];
-    int        j, temp_size;
+    int        j, t, temp_size;
+    uint32_t  *step_words;
     FILE*      f = NULL;
 
+    if (data[client_rank].options->mpi_io_checkpoint != 0 &&
+        read_shared_image (&data[client_rank], comm_data, field_name, client_rank) == 0)
+    {
+        // shared checkpoints are always full ones
+        for (t=0; t<data[client_rank].options->nb_time_steps; t++)
+        {
+            data[client_rank].step_received[t] = bitmap_count_col (&data[client_rank].step_simu, t);
+        }
+        return;
+    }
+
+    sprintf(file_name, "%s/%s%d_%d.image", data[client_rank].options->restart_dir, field_name, comm_data->rank, client_rank);
+    if (read_image (&data[client_rank], file_name) == 0)
+    {
+        read_deltas (&data[client_rank], comm_data, field_name, client_rank);
+        for (t=0; t<data[client_rank].options->nb_time_steps; t++)
+        {
+            data[client_rank].step_received[t] = bitmap_count_col (&data[client_rank].step_simu, t);
+        }
+        // the first checkpoint of this run is a full one
+        data[client_rank].checkpoint_base_size  = 0;
+        data[client_rank].checkpoint_delta_size = 0;
+        return;
+    }
+
     sprintf(file_name, "%s/%s%d_%d.data", data[client_rank].options->restart_dir, field_name, comm_data->rank, client_rank);
     f = fopen(file_name, "rb");
     if (f == NULL)
     {
-        melissa_print (VERBOSE_ERROR, 2, "ERROR: can not open %s/%s%d_%d.data (read_saved_stats)\n", data[client_rank].options->restart_dir, field_name, comm_data->rank, client_rank);
+        melissa_print (VERBOSE_ERROR, "ERROR: can not open %s/%s%d_%d.data (read_saved_stats)\n", data[client_rank].options->restart_dir, field_name, comm_data->rank, client_rank);
         return;
     }
     fread(&data[client_rank].vect_size, sizeof(int), 1, f);
@@ -264,7 +1737,14 @@ void read_saved_stats (melissa_data_t *data,
         if (data[client_rank].options->quantile_op != 0)
         {
             melissa_print (VERBOSE_DEBUG, "Read quantiles (field %s, server rank %d, client rank %d) (read_saved_stats)\n", field_name, comm_data->rank, client_rank);
-            read_quantile(data[client_rank].quantiles, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, data[client_rank].options->nb_quantiles, f);
+            if (data[client_rank].options->quantile_estimator == MELISSA_QUANTILE_P2)
+            {
+                read_p2_quantile(data[client_rank].p2_quantiles, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, f);
+            }
+            else
+            {
+                read_quantile(data[client_rank].quantiles, data[client_rank].vect_size, data[client_rank].options->nb_time_steps, data[client_rank].options->nb_quantiles, f);
+            }
         }
         if (data[client_rank].options->sobol_op != 0)
         {
@@ -275,19 +1755,79 @@ void read_saved_stats (melissa_data_t *data,
         {
             melissa_print (VERBOSE_DEBUG, "Read simu steps (field %s, server rank %d, client rank %d) (read_saved_stats)\n", field_name, comm_data->rank, client_rank);
             fread(&temp_size, sizeof(int), 1, f);
-            while (temp_size > data[client_rank].step_simu.size)
+            if (temp_size < 0)
             {
-                vector_add(&data[client_rank].step_simu, melissa_calloc((data[client_rank].options->nb_time_steps+31)/32, sizeof(int32_t)));
+                if (bitmap_read (&data[client_rank].step_simu, f) != 0)
+                {
+                    melissa_print (VERBOSE_ERROR, "Bad simulation steps in %s%d_%d.data (read_saved_stats)\n", field_name, comm_data->rank, client_rank);
+                    exit (1);
+                }
+                if (fread(&data[client_rank].checkpoint_generation, sizeof(int), 1, f) == 1)
+                {
+                    read_deltas (&data[client_rank], comm_data, field_name, client_rank);
+                }
             }
-            for (j=0; j<data[client_rank].step_simu.size; j++)
+            else
             {
-                fread(data[client_rank].step_simu.items[j], sizeof(int32_t), (data[client_rank].options->nb_time_steps+31)/32, f);
+                // one array of 32 bit words per simulation
+                step_words = melissa_calloc ((data[client_rank].options->nb_time_steps+31)/32, sizeof(uint32_t));
+                for (j=0; j<temp_size; j++)
+                {
+                    fread(step_words, sizeof(uint32_t), (data[client_rank].options->nb_time_steps+31)/32, f);
+                    for (t=0; t<data[client_rank].options->nb_time_steps; t++)
+                    {
+                        if (test_bit (step_words, t) != 0)
+                        {
+                            bitmap_set (&data[client_rank].step_simu, j, t);
+                        }
+                    }
+                }
+                melissa_free (step_words);
             }
+            for (t=0; t<data[client_rank].options->nb_time_steps; t++)
+            {
+                data[client_rank].step_received[t] = bitmap_count_col (&data[client_rank].step_simu, t);
+            }
+            // the first checkpoint of this run is a full one
+            data[client_rank].checkpoint_base_size  = 0;
+            data[client_rank].checkpoint_delta_size = 0;
         }
     }
     fclose(f);
 }
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function writes the simulation states in a stream
+ *
+ *******************************************************************************
+ *
+ * @param[in] *simu
+ * simulations vector
+ *
+ * @param[in] *f
+ * stream to write to
+ *
+ *******************************************************************************/
+
+static void write_simu_states (vector_t *simu,
+                               FILE     *f)
+{
+    melissa_simulation_t *simu_ptr;
+    int                   i;
+
+    fwrite(&simu->size, sizeof(int), 1, f);
+    for (i=0; i<simu->size; i++)
+    {
+        simu_ptr = simu->items[i];
+        melissa_print (VERBOSE_DEBUG, "Simulation %d status: %d (write_simu_states)\n", i, simu_ptr->status);
+        fwrite(&simu_ptr->status, sizeof(int), 1, f);
+    }
+}
+
 /**
  *******************************************************************************
  *
@@ -310,8 +1850,6 @@ void save_simu_states (vector_t    *simu,
 {
     char                  file_name[256];
     FILE*                 f = NULL;
-    melissa_simulation_t *simu_ptr;
-    int                   i;
 
     sprintf(file_name, "simu_%d.data",comm_data->rank);
     f = fopen(file_name, "wb+");
@@ -320,13 +1858,7 @@ void save_simu_states (vector_t    *simu,
         melissa_print (VERBOSE_WARNING, "Can not open simu_state_%d.data (save_simu_states)\n", comm_data->rank);
         return;
     }
-    fwrite(&simu->size, sizeof(int), 1, f);
-    for (i=0; i<simu->size; i++)
-    {
-        simu_ptr = simu->items[i];
-        melissa_print (VERBOSE_DEBUG, "Simulation %d status: %d (save_simu_states)\n", i, simu_ptr->status);
-        fwrite(&simu_ptr->status, sizeof(int), 1, f);
-    }
+    write_simu_states (simu, f);
     fclose(f);
 }
 
@@ -335,7 +1867,39 @@ void save_simu_states (vector_t    *simu,
  *
  * @ingroup melissa_io
  *
- * This function reads simulation states from disc
+ * This function copies the simulation states in memory, to be written on disc
+ * by the checkpoint I/O thread
+ *
+ *******************************************************************************
+ *
+ * @param[in] *simu
+ * simulations vector
+ *
+ * @param[in] *comm_data
+ * communication structure
+ *
+ * @param[in,out] *checkpoint
+ * background checkpoint writer
+ *
+ *******************************************************************************/
+
+void save_simu_states_async (vector_t             *simu,
+                             comm_data_t          *comm_data,
+                             melissa_checkpoint_t *checkpoint)
+{
+    char file_name[256];
+
+    sprintf(file_name, "simu_%d.data",comm_data->rank);
+    write_simu_states (simu, melissa_checkpoint_open (checkpoint, file_name, 0));
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_io
+ *
+ * This function reads simulation states from disc. This function is
+ * collective.
  *
  *******************************************************************************
  *
@@ -356,51 +1920,74 @@ void read_simu_states (vector_t          *simu,
 {
     char                  file_name[256];
     FILE*                 f = NULL;
-    int                   i, size, max_size;
+    int                   i, k, size, status;
+    int                   max_size = 0, nb_files = 0;
+    int                  *states = NULL;
     melissa_simulation_t *simu_ptr;
-#ifdef BUILD_WITH_MPI
-    MPI_Request          *request;
-#endif // BUILD_WITH_MPI
 
-    sprintf(file_name, "%s/simu_%d.data", options->restart_dir, comm_data->rank);
-    f = fopen(file_name, "rb");
-    if (f == NULL)
+    // the files of ranks rank, rank + comm_size, ...: every file is read by one
+    // rank, even if the checkpoint was written by another number of ranks
+    for (k=comm_data->rank; ; k+=comm_data->comm_size)
+    {
+        sprintf(file_name, "%s/simu_%d.data", options->restart_dir, k);
+        f = fopen(file_name, "rb");
+        if (f == NULL)
+        {
+            break;
+        }
+        if (fread(&size, sizeof(int), 1, f) != 1 || size < 0)
+        {
+            size = 0;
+        }
+        melissa_print (VERBOSE_DEBUG, "Read file %s (read_simu_states)\n", file_name);
+        melissa_print (VERBOSE_WARNING, "Size : %d (process %d)\n", size, comm_data->rank);
+        if (size > max_size)
+        {
+            states = melissa_realloc (states, size * sizeof(int));
+            for (i=max_size; i<size; i++)
+            {
+                states[i] = INT_MAX;
+            }
+            max_size = size;
+        }
+        // a simulation missing from a file was not started on its rank
+        for (i=0; i<max_size; i++)
+        {
+            status = 0;
+            if (i < size)
+            {
+                fread(&status, sizeof(int), 1, f);
+            }
+            states[i] = (status < states[i]) ? status : states[i];
+        }
+        fclose(f);
+        nb_files += 1;
+    }
+    if (nb_files == 0)
     {
-      melissa_print (VERBOSE_WARNING, "Can not open %s (read_simu_states)\n", file_name);
-      return;
+        melissa_print (VERBOSE_WARNING, "Can not open %s (read_simu_states)\n", file_name);
     }
 
-    fread(&size, sizeof(int), 1, f);
-    melissa_print (VERBOSE_DEBUG, "Read file %s (read_simu_states)\n", file_name);
-    melissa_print (VERBOSE_WARNING, "Size : %d (process %d)\n", size, comm_data->rank);
+    // a simulation is finished if every rank saw it finished
+    size = max_size;
 #ifdef BUILD_WITH_MPI
     MPI_Allreduce (&size, &max_size, 1, MPI_INT, MPI_MAX, comm_data->comm);
     melissa_print (VERBOSE_DEBUG, "Max size : %d\n", max_size);
-    request = melissa_malloc(max_size * sizeof(MPI_Request));
-#else // BUILD_WITH_MPI
-    max_size = size;
 #endif // BUILD_WITH_MPI
-    alloc_vector (simu, max_size);
-    for (i=0; i<max_size; i++)
-    {
-        vector_add (simu, add_simulation());
-    }
-    for (i=0; i<size; i++)
-    {
-        simu_ptr = vector_get(simu, i);
-        fread(&simu_ptr->status, sizeof(int), 1, f);
-#ifdef BUILD_WITH_MPI
-        MPI_Allreduce (MPI_IN_PLACE, &simu_ptr->status, 1, MPI_INT, MPI_MIN, comm_data->comm);
-    }
+    states = melissa_realloc (states, (max_size + 1) * sizeof(int));
     for (i=size; i<max_size; i++)
     {
-        simu_ptr = vector_get(simu, i);
-        MPI_Allreduce (MPI_IN_PLACE, &simu_ptr->status, 1, MPI_INT, MPI_MIN, comm_data->comm);
-#endif // BUILD_WITH_MPI
+        states[i] = (nb_files > 0) ? 0 : INT_MAX;
     }
 #ifdef BUILD_WITH_MPI
-    melissa_free (request);
+    MPI_Allreduce (MPI_IN_PLACE, states, max_size, MPI_INT, MPI_MIN, comm_data->comm);
 #endif // BUILD_WITH_MPI
-
-    fclose(f);
+    alloc_vector (simu, max_size);
+    for (i=0; i<max_size; i++)
+    {
+        simu_ptr = add_simulation();
+        simu_ptr->status = states[i];
+        vector_add (simu, simu_ptr);
+    }
+    melissa_free (states);
 }
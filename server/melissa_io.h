@@ -31,6 +31,7 @@ extern "C" {
 
 #include "melissa_data.h"
 #include "melissa_options.h"
+#include "melissa_checkpoint.h"
 
 void write_stats_bin(melissa_data_t    **data,
                      melissa_options_t  *options,
@@ -58,6 +59,23 @@ void save_stats (melissa_data_t *data,
                  comm_data_t    *comm_data,
                  char           *field_name);
 
+void save_stats_async (melissa_data_t       *data,
+                       comm_data_t          *comm_data,
+                       char                 *field_name,
+                       melissa_checkpoint_t *checkpoint);
+
+#ifdef BUILD_WITH_MPI
+int shared_steps_consistent (melissa_data_t *data,
+                             comm_data_t    *comm_data,
+                             MPI_Comm        comm);
+
+int save_stats_shared (melissa_data_t *data,
+                       comm_data_t    *comm_data,
+                       char           *field_name,
+                       MPI_Comm        comm,
+                       int             consistent);
+#endif // BUILD_WITH_MPI
+
 void read_saved_stats (melissa_data_t *data,
                        comm_data_t    *comm_data,
                        char           *field_name,
@@ -66,6 +84,10 @@ void read_saved_stats (melissa_data_t *data,
 void save_simu_states (vector_t    *simu_states,
                        comm_data_t *comm_data);
 
+void save_simu_states_async (vector_t             *simu_states,
+                             comm_data_t          *comm_data,
+                             melissa_checkpoint_t *checkpoint);
+
 void read_simu_states (vector_t          *simu_states,
                        melissa_options_t *options,
                        comm_data_t       *comm_data);
@@ -33,6 +33,7 @@
 #include "melissa_options.h"
 #include "melissa_data.h"
 #include "melissa_utils.h"
+#include "melissa_messages.h"
 
 static inline void stats_usage ()
 {
@@ -55,11 +56,43 @@ static inline void stats_usage ()
             "                  (default: mean:variance)\n"
             " -e <double>    : threshold value for threshold exceedance computaion\n"
             " -q <char*>     : quantile values separated by semicolons\n"
+            " --quantile_estimator <char*> : quantile estimator\n"
+            "                  possibles values :\n"
+            "                  robbins_monro\n"
+            "                  p2\n"
+            "                  (default: robbins_monro)\n"
             " -n <char*>     : Melissa Launcher node name (default: localhost)\n"
             " -l             : Learning mode\n"
             " -r <char*>     : Melissa restart files directory\n"
             " -c <double>    : Server checkpoints intervals (seconds, default: 300)\n"
             " -v             : Verbosity level\n"
+            " --ingest_threads <int> : number of compute threads (default: 0,\n"
+            "                  statistics computed by the main thread)\n"
+            " --memory_budget <int> : memory for the statistics, in MB. Above it,\n"
+            "                  finished time steps are spilled to disk (default: 0,\n"
+            "                  no limit)\n"
+            " --async_checkpoint : write the checkpoints in a background thread\n"
+            " --mpi_io_checkpoint : write one shared checkpoint file per field,\n"
+            "                  with collective MPI-IO\n"
+            " --compress_checkpoint <int> : compress the checkpoints with <int>\n"
+            "                  threads (default: 0, not compressed)\n"
+            " --gather_output <int> : largest statistic gathered and written by\n"
+            "                  rank 0, larger ones are written by every rank\n"
+            "                  (elements, default: 1048576)\n"
+            " --stream_output : write the statistics of each time step once\n"
+            "                  every simulation sent it, one part per rank\n"
+            " --output_deflate <int> : deflate level of the netCDF output\n"
+            "                  (0 to 9, default: 0, not compressed)\n"
+            " --columnar_output : write all the statistics of a field in one\n"
+            "                  binary container, results.<field>.mres\n"
+            " --wire_format <char*> : format of the simulation data sent to\n"
+            "                  the server (double, float32 or bfloat16,\n"
+            "                  default: double)\n"
+            " --wire_codec <char*> : compression of the simulation data sent\n"
+            "                  to the server (none, lz4 or quantize,\n"
+            "                  default: none)\n"
+            " --wire_tolerance <double> : absolute error bound of the\n"
+            "                  quantize codec\n"
             " -h             : Print this message\n"
             "\n"
             );
@@ -93,11 +126,24 @@ static inline void init_options (melissa_options_t *options)
     options->threshold_op    = 0;
     options->quantile_op     = 0;
     options->nb_quantiles    = 0;
+    options->quantile_estimator = MELISSA_QUANTILE_ROBBINS_MONRO;
     options->sobol_op        = 0;
     options->sobol_order     = 0;
     options->learning        = 0;
     options->restart         = 0;
     options->disable_fault_tolerance = 0;
+    options->nb_ingest_threads = 0;
+    options->memory_budget   = 0;
+    options->async_checkpoint = 0;
+    options->mpi_io_checkpoint = 0;
+    options->compress_checkpoint = 0;
+    options->gather_output   = MELISSA_GATHER_OUTPUT;
+    options->stream_output   = 0;
+    options->output_deflate  = 0;
+    options->columnar_output = 0;
+    options->wire_format     = MELISSA_WIRE_DOUBLE;
+    options->wire_codec      = MELISSA_WIRE_NO_CODEC;
+    options->wire_tolerance  = 0.0;
     options->verbose_lvl     = MELISSA_INFO;
     options->check_interval  = 300.0;
     options->timeout_simu    = 300.0;
@@ -342,7 +388,10 @@ void melissa_print_options (melissa_options_t *options)
     if (options->threshold_op != 0)
         melissa_print(VERBOSE_INFO, "    threshold exceedance (%d values)\n", options->nb_thresholds);
     if (options->quantile_op != 0)
-        melissa_print(VERBOSE_INFO, "    quantiles (%d values)\n", options->nb_quantiles);
+    {
+        melissa_print(VERBOSE_INFO, "    quantiles (%d values, %s)\n", options->nb_quantiles,
+                      options->quantile_estimator == MELISSA_QUANTILE_P2 ? "P2" : "Robbins-Monro");
+    }
     if (options->sobol_op != 0)
         melissa_print(VERBOSE_INFO, "    sobol indices\n");
     if (options->learning != 0)
@@ -352,6 +401,30 @@ void melissa_print_options (melissa_options_t *options)
     melissa_print(VERBOSE_DEBUG, "Melissa launcher node name: %s\n", options->launcher_name);
     melissa_print(VERBOSE_INFO, "Checkpoint every %g seconds\n", options->check_interval);
     melissa_print(VERBOSE_DEBUG, "Wait time for simulation message before timeout: %d seconds\n", options->timeout_simu);
+    if (options->nb_ingest_threads > 0)
+        melissa_print(VERBOSE_INFO, "Compute threads: %d\n", options->nb_ingest_threads);
+    if (options->memory_budget > 0)
+        melissa_print(VERBOSE_INFO, "Statistics memory budget: %d MB\n", options->memory_budget);
+    if (options->async_checkpoint != 0)
+        melissa_print(VERBOSE_INFO, "Background checkpoints\n");
+    if (options->mpi_io_checkpoint != 0)
+        melissa_print(VERBOSE_INFO, "Shared MPI-IO checkpoints\n");
+    if (options->compress_checkpoint > 0)
+        melissa_print(VERBOSE_INFO, "Compressed checkpoints (%d threads)\n", options->compress_checkpoint);
+    melissa_print(VERBOSE_DEBUG, "Statistics above %d elements written by every rank\n", options->gather_output);
+    if (options->stream_output != 0)
+        melissa_print(VERBOSE_INFO, "Statistics written during the study\n");
+    if (options->output_deflate > 0)
+        melissa_print(VERBOSE_INFO, "Output deflate level: %d\n", options->output_deflate);
+    if (options->columnar_output != 0)
+        melissa_print(VERBOSE_INFO, "Statistics written in one container per field\n");
+    if (options->wire_format != MELISSA_WIRE_DOUBLE)
+        melissa_print(VERBOSE_INFO, "Simulation data sent as %s\n",
+                      options->wire_format == MELISSA_WIRE_FLOAT ? "float32" : "bfloat16");
+    if (options->wire_codec == MELISSA_WIRE_LZ4)
+        melissa_print(VERBOSE_INFO, "Simulation data compressed (LZ4)\n");
+    if (options->wire_codec == MELISSA_WIRE_QUANTIZE)
+        melissa_print(VERBOSE_INFO, "Simulation data quantized (absolute error: %g)\n", options->wire_tolerance);
     melissa_print(VERBOSE_INFO, "Melissa verbosity: %d\n", options->verbose_lvl);
 }
 
@@ -413,6 +486,19 @@ void melissa_get_options (int                 argc,
                                 { "txt_req_port",            required_argument, NULL, 1003 },
                                 { "horovod",                 no_argument,       NULL, 1004 },
                                 { "disable_fault_tolerance", no_argument,       NULL, 1005 },
+                                { "ingest_threads",          required_argument, NULL, 1006 },
+                                { "memory_budget",           required_argument, NULL, 1007 },
+                                { "quantile_estimator",      required_argument, NULL, 1008 },
+                                { "async_checkpoint",        no_argument,       NULL, 1009 },
+                                { "mpi_io_checkpoint",       no_argument,       NULL, 1010 },
+                                { "compress_checkpoint",     required_argument, NULL, 1011 },
+                                { "gather_output",           required_argument, NULL, 1012 },
+                                { "stream_output",           no_argument,       NULL, 1013 },
+                                { "output_deflate",          required_argument, NULL, 1014 },
+                                { "columnar_output",         no_argument,       NULL, 1015 },
+                                { "wire_format",             required_argument, NULL, 1016 },
+                                { "wire_codec",              required_argument, NULL, 1017 },
+                                { "wire_tolerance",          required_argument, NULL, 1018 },
                                 { NULL,                      0,                 NULL,  0   }};
 
     do
@@ -497,6 +583,95 @@ void melissa_get_options (int                 argc,
         case 1005:
             options->disable_fault_tolerance = 1;
             break;
+        case 1006:
+            options->nb_ingest_threads = atoi (optarg);
+            break;
+        case 1007:
+            options->memory_budget = atoi (optarg);
+            break;
+        case 1008:
+            str_tolower (optarg);
+            if (0 == strcmp(optarg, "p2"))
+            {
+                options->quantile_estimator = MELISSA_QUANTILE_P2;
+            }
+            else if (0 == strcmp(optarg, "robbins_monro"))
+            {
+                options->quantile_estimator = MELISSA_QUANTILE_ROBBINS_MONRO;
+            }
+            else
+            {
+                fprintf (stderr, "Error: unknown quantile estimator %s\n", optarg);
+                stats_usage ();
+                exit (1);
+            }
+            break;
+        case 1009:
+            options->async_checkpoint = 1;
+            break;
+        case 1010:
+            options->mpi_io_checkpoint = 1;
+            break;
+        case 1011:
+            options->compress_checkpoint = atoi (optarg);
+            break;
+        case 1012:
+            options->gather_output = atoi (optarg);
+            break;
+        case 1013:
+            options->stream_output = 1;
+            break;
+        case 1014:
+            options->output_deflate = atoi (optarg);
+            break;
+        case 1015:
+            options->columnar_output = 1;
+            break;
+        case 1016:
+            str_tolower (optarg);
+            if (0 == strcmp(optarg, "double"))
+            {
+                options->wire_format = MELISSA_WIRE_DOUBLE;
+            }
+            else if (0 == strcmp(optarg, "float32") || 0 == strcmp(optarg, "float"))
+            {
+                options->wire_format = MELISSA_WIRE_FLOAT;
+            }
+            else if (0 == strcmp(optarg, "bfloat16"))
+            {
+                options->wire_format = MELISSA_WIRE_BFLOAT16;
+            }
+            else
+            {
+                fprintf (stderr, "Error: unknown wire format %s\n", optarg);
+                stats_usage ();
+                exit (1);
+            }
+            break;
+        case 1017:
+            str_tolower (optarg);
+            if (0 == strcmp(optarg, "none"))
+            {
+                options->wire_codec = MELISSA_WIRE_NO_CODEC;
+            }
+            else if (0 == strcmp(optarg, "lz4"))
+            {
+                options->wire_codec = MELISSA_WIRE_LZ4;
+            }
+            else if (0 == strcmp(optarg, "quantize"))
+            {
+                options->wire_codec = MELISSA_WIRE_QUANTIZE;
+            }
+            else
+            {
+                fprintf (stderr, "Error: unknown wire codec %s\n", optarg);
+                stats_usage ();
+                exit (1);
+            }
+            break;
+        case 1018:
+            options->wire_tolerance = atof (optarg);
+            break;
         case 'h':
             stats_usage ();
             exit (0);
@@ -637,6 +812,98 @@ void melissa_check_options (melissa_options_t  *options)
         melissa_print (VERBOSE_WARNING, "time before simulation timeout too small, changing to 5.0\n");
         options->timeout_simu = 5.0;
     }
+
+    if (options->nb_ingest_threads < 0)
+    {
+        melissa_print (VERBOSE_WARNING, "negative number of compute threads, changing to 0\n");
+        options->nb_ingest_threads = 0;
+    }
+
+    if (options->memory_budget < 0)
+    {
+        melissa_print (VERBOSE_WARNING, "negative memory budget, changing to 0 (no limit)\n");
+        options->memory_budget = 0;
+    }
+
+    if (options->nb_ingest_threads > 0 && options->learning > 0)
+    {
+        // learning hands every message back to the caller, one by one
+        melissa_print (VERBOSE_WARNING, "compute threads disabled in learning mode\n");
+        options->nb_ingest_threads = 0;
+    }
+
+#ifndef BUILD_WITH_MPI
+    if (options->mpi_io_checkpoint != 0)
+    {
+        melissa_print (VERBOSE_WARNING, "MPI-IO checkpoints need MPI, disabled\n");
+        options->mpi_io_checkpoint = 0;
+    }
+#endif // BUILD_WITH_MPI
+    if (options->mpi_io_checkpoint != 0 && options->learning > 0)
+    {
+        // learning checkpoints from the caller, outside of the collective protocol
+        melissa_print (VERBOSE_WARNING, "MPI-IO checkpoints disabled in learning mode\n");
+        options->mpi_io_checkpoint = 0;
+    }
+
+    if (options->compress_checkpoint < 0)
+    {
+        melissa_print (VERBOSE_WARNING, "negative number of compression threads, changing to 0\n");
+        options->compress_checkpoint = 0;
+    }
+
+    if (options->gather_output < 0)
+    {
+        melissa_print (VERBOSE_WARNING, "negative output gather size, changing to 0\n");
+        options->gather_output = 0;
+    }
+
+    if (options->compress_checkpoint > 0 && options->mpi_io_checkpoint != 0)
+    {
+        // the shared images are written in place by collective writes
+        melissa_print (VERBOSE_WARNING, "compressed checkpoints are not shared, compression disabled\n");
+        options->compress_checkpoint = 0;
+    }
+
+    if (options->stream_output != 0 && options->learning > 0)
+    {
+        // the learning side owns the statistics during the study
+        melissa_print (VERBOSE_WARNING, "streamed output disabled in learning mode\n");
+        options->stream_output = 0;
+    }
+
+    if (options->output_deflate < 0 || options->output_deflate > 9)
+    {
+        melissa_print (VERBOSE_WARNING, "deflate level out of 0-9, changing to 0 (not compressed)\n");
+        options->output_deflate = 0;
+    }
+
+    if (options->columnar_output != 0 && options->stream_output != 0)
+    {
+        // the container is written by collective writes, at the end of the study
+        melissa_print (VERBOSE_WARNING, "streamed output disabled with the columnar output\n");
+        options->stream_output = 0;
+    }
+
+    if (options->wire_format != MELISSA_WIRE_DOUBLE && options->learning > 0)
+    {
+        // the learning side reads the simulation data in the messages
+        melissa_print (VERBOSE_WARNING, "simulation data sent as double in learning mode\n");
+        options->wire_format = MELISSA_WIRE_DOUBLE;
+    }
+
+    if (options->wire_codec != MELISSA_WIRE_NO_CODEC && options->learning > 0)
+    {
+        // the learning side reads the simulation data in the messages
+        melissa_print (VERBOSE_WARNING, "simulation data not compressed in learning mode\n");
+        options->wire_codec = MELISSA_WIRE_NO_CODEC;
+    }
+
+    if (options->wire_codec == MELISSA_WIRE_QUANTIZE && !(options->wire_tolerance > 0))
+    {
+        melissa_print (VERBOSE_WARNING, "the quantize codec needs a positive --wire_tolerance, changing to lz4\n");
+        options->wire_codec = MELISSA_WIRE_LZ4;
+    }
 }
 
 /**
@@ -29,6 +29,11 @@
 extern "C" {
 #endif
 
+#define MELISSA_QUANTILE_ROBBINS_MONRO 0 /**< stochastic approximation, one vector per quantile order */
+#define MELISSA_QUANTILE_P2            1 /**< extended P², one sketch for every quantile order       */
+
+#define MELISSA_GATHER_OUTPUT 1048576 /**< default largest statistic gathered on rank 0 for the output (elements) */
+
 /**
  *******************************************************************************
  *
@@ -56,6 +61,7 @@ struct melissa_options_s
     int                  quantile_op;             /**< 1 if the user needs to compute quantiles, 0 otherwise            */
     int                  nb_quantiles;            /**< number of quantile fields                                        */
     double              *quantile_order;          /**< array of quantile orders                                         */
+    int                  quantile_estimator;      /**< MELISSA_QUANTILE_ROBBINS_MONRO or MELISSA_QUANTILE_P2             */
     int                  sobol_op;                /**< 1 if the user needs to compute sobol indices, 0 otherwise        */
     int                  sobol_order;             /**< max order of the computes sobol indices                          */
     int                  learning;                /**< > 1 if the user needs to do learning, 0 otherwise.               */
@@ -72,6 +78,18 @@ struct melissa_options_s
     int                  data_port;               /**< Data port number                                                 */
     int                  verbose_lvl;             /**< requested level of verbosity                                     */
     int                  disable_fault_tolerance; /**< 1 to disable fault tolerance, 0 otherwise                        */
+    int                  nb_ingest_threads;       /**< number of compute threads, 0 to compute in the main thread       */
+    int                  memory_budget;           /**< memory for the statistics before spilling (MB), 0 for no limit    */
+    int                  async_checkpoint;        /**< 1 to write the checkpoints in a background thread, 0 otherwise   */
+    int                  mpi_io_checkpoint;       /**< 1 to write one shared checkpoint per field with MPI-IO, 0 otherwise */
+    int                  compress_checkpoint;     /**< number of checkpoint compression threads, 0 to not compress      */
+    int                  gather_output;           /**< largest statistic gathered on rank 0 for the output (elements)   */
+    int                  stream_output;           /**< 1 to write the time steps during the study, one part per rank    */
+    int                  output_deflate;          /**< deflate level of the netCDF output, 0 to not compress            */
+    int                  columnar_output;         /**< 1 to write the statistics of a field in one container, 0 otherwise */
+    int                  wire_format;             /**< format of the simulation data on the wire (MELISSA_WIRE_DOUBLE...) */
+    int                  wire_codec;              /**< compression of the simulation data on the wire (MELISSA_WIRE_LZ4...) */
+    double               wire_tolerance;          /**< absolute error bound of MELISSA_WIRE_QUANTIZE                    */
 };
 
 typedef struct melissa_options_s melissa_options_t; /**< type corresponding to melissa_options_s */
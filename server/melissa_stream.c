@@ -0,0 +1,310 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_stream.c
+ * @brief Writing of the finished time steps during the study.
+ * @author Terraz Théophile
+ * @date 2019-04-16
+ *
+ * @defgroup melissa_stream Melissa streamed output
+ *
+ * A time step is finished on a server rank once every simulation sent it to
+ * every client rank. Its statistics do not change anymore: the control thread
+ * finalizes them and queues the time step, and an I/O thread writes it with
+ * melissa_write_step_parts. The server ranks are not synchronized, so each
+ * rank writes its own part of the files, without communication. The parts are
+ * reassembled at the end of the study (melissa_merge_step_parts). With compute
+ * threads, a finished time step waits until the messages dispatched before
+ * its completion are computed.
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "melissa_stream.h"
+#include "melissa_output.h"
+#include "compute_stats.h"
+#include "melissa_utils.h"
+
+static void* stream_loop (void *arg)
+{
+    melissa_stream_t *stream = (melissa_stream_t*)arg;
+    int    field_id, time_step;
+    double start;
+
+    pthread_mutex_lock (&stream->mutex);
+    while (1)
+    {
+        while (stream->queue_head == stream->queue_tail && stream->stop == 0)
+        {
+            pthread_cond_wait (&stream->cond, &stream->mutex);
+        }
+        if (stream->queue_head == stream->queue_tail)
+        {
+            break;
+        }
+        field_id  = stream->queue[stream->queue_head] / stream->options->nb_time_steps;
+        time_step = stream->queue[stream->queue_head] % stream->options->nb_time_steps;
+        pthread_mutex_unlock (&stream->mutex);
+
+        start = melissa_get_time ();
+        melissa_write_step_parts (stream->fields[field_id].stats_data,
+                                  stream->options,
+                                  stream->comm_data,
+                                  stream->fields[field_id].name,
+                                  time_step);
+
+        pthread_mutex_lock (&stream->mutex);
+        stream->write_time += melissa_get_time () - start;
+        stream->queue_head += 1;
+    }
+    pthread_mutex_unlock (&stream->mutex);
+    return NULL;
+}
+
+// finalizes a time step in the control thread, and hands it to the I/O thread
+static void queue_step (melissa_stream_t *stream,
+                        int               step)
+{
+    melissa_data_t *data = stream->fields[step / stream->options->nb_time_steps].stats_data;
+    int             i;
+
+    for (i=0; i<stream->comm_data->client_comm_size; i++)
+    {
+        if (data[i].vect_size > 0)
+        {
+            finalize_step_stats (&data[i], step % stream->options->nb_time_steps);
+        }
+    }
+    pthread_mutex_lock (&stream->mutex);
+    stream->queue[stream->queue_tail] = step;
+    stream->queue_tail += 1;
+    pthread_cond_broadcast (&stream->cond);
+    pthread_mutex_unlock (&stream->mutex);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_stream
+ *
+ * This function starts the streamed output I/O thread, once the fields are
+ * initialized. The fields get a bitmap of their streamed time steps
+ * (step_streamed), freed with the fields.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *fields
+ * Melissa field array
+ *
+ * @param[in] *options
+ * Melissa options
+ *
+ * @param[in] *comm_data
+ * Melissa communication structure
+ *
+ * @param[in] *ingest
+ * compute threads, NULL if the main thread computes the statistics
+ *
+ * @return A pointer to the streamed output, NULL if the output module can not
+ * write parts of files
+ *
+ *******************************************************************************/
+
+melissa_stream_t* melissa_stream_start (melissa_field_t   *fields,
+                                        melissa_options_t *options,
+                                        comm_data_t       *comm_data,
+                                        melissa_ingest_t  *ingest)
+{
+    melissa_stream_t *stream;
+    char             *buffer = NULL;
+    double            value = 0.0;
+    int               nb_steps = options->nb_fields * options->nb_time_steps;
+    int               j;
+
+    // the same answer on every rank, so that they all write parts or none
+    if (encode_output_d ("", 0, 0, 1, &value, &buffer) < 0)
+    {
+        melissa_print (VERBOSE_WARNING, "The output module can not write parts of files, streamed output disabled\n");
+        return NULL;
+    }
+    free (buffer);
+
+    stream = melissa_calloc (1, sizeof(melissa_stream_t));
+    pthread_mutex_init (&stream->mutex, NULL);
+    pthread_cond_init (&stream->cond, NULL);
+    stream->fields    = fields;
+    stream->options   = options;
+    stream->comm_data = comm_data;
+    stream->ingest    = ingest;
+    // a time step is queued at most once
+    stream->queue     = melissa_malloc (nb_steps * sizeof(int));
+    stream->waiting   = melissa_malloc (nb_steps * sizeof(int));
+    if (ingest != NULL)
+    {
+        stream->tickets = melissa_malloc (nb_steps * ingest->nb_workers * sizeof(long int));
+    }
+    for (j=0; j<options->nb_fields; j++)
+    {
+        fields[j].step_streamed = melissa_calloc ((options->nb_time_steps+31)/32, sizeof(uint32_t));
+    }
+    if (pthread_create (&stream->thread, NULL, stream_loop, stream) != 0)
+    {
+        melissa_print (VERBOSE_ERROR, "Can not start output thread\n");
+        exit (1);
+    }
+    return stream;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_stream
+ *
+ * This function is called by the control thread after each new message. It
+ * queues the time step if every simulation sent it to every client rank.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *stream
+ * pointer to the streamed output
+ *
+ * @param[in] field_id
+ * field of the message
+ *
+ * @param[in] time_step
+ * time step of the message
+ *
+ *******************************************************************************/
+
+void melissa_stream_check (melissa_stream_t *stream,
+                           int               field_id,
+                           int               time_step)
+{
+    melissa_field_t *field = &stream->fields[field_id];
+    int              i;
+
+    if (test_bit (field->step_streamed, time_step) != 0)
+    {
+        return;
+    }
+    for (i=0; i<stream->comm_data->client_comm_size; i++)
+    {
+        if (field->stats_data[i].steps_init == 0 ||
+            field->stats_data[i].step_received[time_step] < stream->options->sampling_size)
+        {
+            return;
+        }
+    }
+    set_bit (field->step_streamed, time_step);
+    if (stream->ingest == NULL)
+    {
+        queue_step (stream, field_id * stream->options->nb_time_steps + time_step);
+    }
+    else
+    {
+        stream->waiting[stream->nb_waiting] = field_id * stream->options->nb_time_steps + time_step;
+        melissa_ingest_tickets (stream->ingest, &stream->tickets[stream->nb_waiting * stream->ingest->nb_workers]);
+        stream->nb_waiting += 1;
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_stream
+ *
+ * This function is called by the control thread in the main loop. It queues
+ * the waiting time steps computed by the compute threads.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *stream
+ * pointer to the streamed output
+ *
+ *******************************************************************************/
+
+void melissa_stream_poll (melissa_stream_t *stream)
+{
+    int i;
+    int nb_left = 0;
+    int nb_workers;
+
+    if (stream->nb_waiting == 0)
+    {
+        return;
+    }
+    nb_workers = stream->ingest->nb_workers;
+    for (i=0; i<stream->nb_waiting; i++)
+    {
+        if (melissa_ingest_reached (stream->ingest, &stream->tickets[i * nb_workers]) != 0)
+        {
+            queue_step (stream, stream->waiting[i]);
+        }
+        else
+        {
+            stream->waiting[nb_left] = stream->waiting[i];
+            memmove (&stream->tickets[nb_left * nb_workers], &stream->tickets[i * nb_workers], nb_workers * sizeof(long int));
+            nb_left += 1;
+        }
+    }
+    stream->nb_waiting = nb_left;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_stream
+ *
+ * This function waits for the queued time steps, stops the I/O thread and
+ * frees the streamed output. The time steps still waiting for the compute
+ * threads are left to the final output.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *stream
+ * pointer to the streamed output
+ *
+ * @return The time spent by the I/O thread writing
+ *
+ *******************************************************************************/
+
+double melissa_stream_stop (melissa_stream_t *stream)
+{
+    double write_time;
+    int    i, nb_time_steps = stream->options->nb_time_steps;
+
+    for (i=0; i<stream->nb_waiting; i++)
+    {
+        clear_bit (stream->fields[stream->waiting[i] / nb_time_steps].step_streamed, stream->waiting[i] % nb_time_steps);
+    }
+    pthread_mutex_lock (&stream->mutex);
+    stream->stop = 1;
+    pthread_cond_broadcast (&stream->cond);
+    pthread_mutex_unlock (&stream->mutex);
+    pthread_join (stream->thread, NULL);
+    write_time = stream->write_time;
+    pthread_cond_destroy (&stream->cond);
+    pthread_mutex_destroy (&stream->mutex);
+    melissa_free (stream->queue);
+    melissa_free (stream->waiting);
+    melissa_free (stream->tickets);
+    melissa_free (stream);
+    return write_time;
+}
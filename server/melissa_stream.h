@@ -0,0 +1,84 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_stream.h
+ * @author Terraz Théophile
+ * @date 2019-04-16
+ *
+ **/
+
+#ifndef MELISSA_STREAM_H
+#define MELISSA_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include "melissa_fields.h"
+#include "melissa_ingest.h"
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_stream_s
+ *
+ * Streamed output: the control thread detects the finished time steps, and
+ * an I/O thread writes their statistics during the study
+ *
+ *******************************************************************************/
+
+struct melissa_stream_s
+{
+    pthread_t          thread;     /**< I/O thread                                                  */
+    pthread_mutex_t    mutex;      /**< protects queue_head, queue_tail, stop and write_time        */
+    pthread_cond_t     cond;       /**< signaled when a time step is queued or the writer must stop */
+    melissa_field_t   *fields;     /**< fields of the study                                         */
+    melissa_options_t *options;    /**< study options                                               */
+    comm_data_t       *comm_data;  /**< server communication structure                              */
+    melissa_ingest_t  *ingest;     /**< compute threads, NULL if the main thread computes           */
+    int               *queue;      /**< time steps to write (field * nb_time_steps + time step)     */
+    int                queue_head; /**< next time step to write                                     */
+    int                queue_tail; /**< end of the queue                                            */
+    int               *waiting;    /**< finished time steps not computed yet by the compute threads */
+    long int          *tickets;    /**< compute threads tickets of the waiting time steps           */
+    int                nb_waiting; /**< number of waiting time steps                                */
+    int                stop;       /**< 1 when the I/O thread must exit                             */
+    double             write_time; /**< writing time (seconds)                                      */
+};
+
+typedef struct melissa_stream_s melissa_stream_t; /**< type corresponding to melissa_stream_s */
+
+melissa_stream_t* melissa_stream_start (melissa_field_t   *fields,
+                                        melissa_options_t *options,
+                                        comm_data_t       *comm_data,
+                                        melissa_ingest_t  *ingest);
+
+void melissa_stream_check (melissa_stream_t *stream,
+                           int               field_id,
+                           int               time_step);
+
+void melissa_stream_poll (melissa_stream_t *stream);
+
+double melissa_stream_stop (melissa_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELISSA_STREAM_H
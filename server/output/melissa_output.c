@@ -32,6 +32,7 @@
 #include <math.h>
 //#include "hdf5.h"
 #include "melissa_output.h"
+#include "melissa_results.h"
 #include "melissa_utils.h"
 #include "fault_tolerance.h"
 
@@ -104,12 +105,419 @@ static inline void igather_data(comm_data_t *comm_data,
 #endif // BUILD_WITH_MPI
 }
 
+#ifdef BUILD_WITH_MPI
+#define MELISSA_OUTPUT_CHUNK (1<<20) /**< unit of the collective writes (bytes), a rank part may exceed 2 GB */
+
 /**
  *******************************************************************************
  *
  * @ingroup melissa_output
  *
- * This function writes the computed statistics on files
+ * This function writes the part of every rank in one file, with a collective
+ * MPI-IO write. The parts are written one after the other, in the rank order.
+ *
+ *******************************************************************************
+ *
+ * @param[in] comm_data
+ * structure containing communications parameters
+ *
+ * @param[in] *file_name
+ * name of the file
+ *
+ * @param[in] *buffer
+ * part of this rank, encoded by the output module
+ *
+ * @param[in] size
+ * size of the part (bytes)
+ *
+ *******************************************************************************/
+
+static void write_part (comm_data_t *comm_data,
+                        const char  *file_name,
+                        char        *buffer,
+                        long int     size)
+{
+    MPI_File     f;
+    MPI_Status   status;
+    MPI_Datatype chunk_type;
+    int64_t      local_size = size;
+    int64_t      offset = 0;
+    int64_t      total = 0;
+    long int     nb_chunks = size / MELISSA_OUTPUT_CHUNK;
+
+    MPI_Exscan (&local_size, &offset, 1, MPI_INT64_T, MPI_SUM, comm_data->comm);
+    if (comm_data->rank == 0)
+    {
+        offset = 0;
+    }
+    MPI_Allreduce (&local_size, &total, 1, MPI_INT64_T, MPI_SUM, comm_data->comm);
+    if (MPI_File_open (comm_data->comm, (char*)file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f) != MPI_SUCCESS)
+    {
+        melissa_print (VERBOSE_WARNING, "Can not open %s (melissa_write_stats)\n", file_name);
+        return;
+    }
+    // an older and longer file is cut
+    MPI_File_set_size (f, total);
+    MPI_Type_contiguous (MELISSA_OUTPUT_CHUNK, MPI_BYTE, &chunk_type);
+    MPI_Type_commit (&chunk_type);
+    MPI_File_write_at_all (f, offset, buffer, nb_chunks, chunk_type, &status);
+    MPI_File_write_at_all (f, offset + nb_chunks * MELISSA_OUTPUT_CHUNK, buffer + nb_chunks * MELISSA_OUTPUT_CHUNK,
+                           size - nb_chunks * MELISSA_OUTPUT_CHUNK, MPI_BYTE, &status);
+    MPI_Type_free (&chunk_type);
+    MPI_File_close (&f);
+}
+#endif // BUILD_WITH_MPI
+
+// columnar container of a field (melissa_results.h), written by every rank
+typedef struct
+{
+    melissa_results_header_t  header;
+    melissa_results_entry_t  *entries;   // statistics
+    int64_t                  *index;     // offset of each (statistic, time step) block
+    int64_t                   offset;    // first element of the rank
+    int                       vect_size; // number of elements of the rank
+#ifdef BUILD_WITH_MPI
+    MPI_File                  f;
+#else // BUILD_WITH_MPI
+    FILE                     *f;
+#endif // BUILD_WITH_MPI
+} results_writer_t;
+
+static void results_entry (melissa_results_entry_t *entries,
+                           int                     *nb_statistics,
+                           const char              *name,
+                           int                      type)
+{
+    if (entries != NULL)
+    {
+        memset (&entries[*nb_statistics], 0, sizeof(melissa_results_entry_t));
+        strncpy (entries[*nb_statistics].name, name, sizeof(entries[*nb_statistics].name) - 1);
+        entries[*nb_statistics].type      = type;
+        entries[*nb_statistics].elem_size = (type == MELISSA_RESULTS_INT) ? sizeof(int32_t) : sizeof(double);
+    }
+    *nb_statistics += 1;
+}
+
+// the statistics of the study, in the order of melissa_write_stats_seq.
+// Only counts them if entries is NULL.
+static int results_entries (melissa_options_t       *options,
+                            melissa_results_entry_t *entries)
+{
+    int  nb_statistics = 0;
+    int  p;
+    char name[256];
+
+    if (options->mean_op == 1)
+    {
+        results_entry (entries, &nb_statistics, "mean", MELISSA_RESULTS_DOUBLE);
+    }
+    if (options->variance_op == 1)
+    {
+        results_entry (entries, &nb_statistics, "variance", MELISSA_RESULTS_DOUBLE);
+    }
+    if (options->skewness_op == 1)
+    {
+        results_entry (entries, &nb_statistics, "skewness", MELISSA_RESULTS_DOUBLE);
+    }
+    if (options->kurtosis_op == 1)
+    {
+        results_entry (entries, &nb_statistics, "kurtosis", MELISSA_RESULTS_DOUBLE);
+    }
+    if (options->min_and_max_op == 1)
+    {
+        results_entry (entries, &nb_statistics, "min", MELISSA_RESULTS_DOUBLE);
+        results_entry (entries, &nb_statistics, "min_id", MELISSA_RESULTS_INT);
+        results_entry (entries, &nb_statistics, "max", MELISSA_RESULTS_DOUBLE);
+        results_entry (entries, &nb_statistics, "max_id", MELISSA_RESULTS_INT);
+    }
+    if (options->threshold_op == 1)
+    {
+        for (p=0; p<options->nb_thresholds; p++)
+        {
+            snprintf (name, sizeof(name), "threshold%g", options->threshold[p]);
+            results_entry (entries, &nb_statistics, name, MELISSA_RESULTS_INT);
+        }
+    }
+    if (options->quantile_op == 1)
+    {
+        for (p=0; p<options->nb_quantiles; p++)
+        {
+            snprintf (name, sizeof(name), "quantile%g", options->quantile_order[p]);
+            results_entry (entries, &nb_statistics, name, MELISSA_RESULTS_DOUBLE);
+        }
+    }
+    if (options->sobol_op == 1)
+    {
+        for (p=0; p<options->nb_parameters; p++)
+        {
+            snprintf (name, sizeof(name), "sobol%d", p);
+            results_entry (entries, &nb_statistics, name, MELISSA_RESULTS_DOUBLE);
+        }
+        for (p=0; p<options->nb_parameters; p++)
+        {
+            snprintf (name, sizeof(name), "sobol_tot%d", p);
+            results_entry (entries, &nb_statistics, name, MELISSA_RESULTS_DOUBLE);
+        }
+    }
+    return nb_statistics;
+}
+
+// creates results.<field>.mres: the header, the entries and the index are
+// computed by every rank and written by rank 0. Collective on comm_data->comm.
+static results_writer_t* results_open (const char        *field,
+                                       melissa_options_t *options,
+                                       comm_data_t       *comm_data,
+                                       int                vect_size,
+                                       int                offset,
+                                       int                global_vect_size)
+{
+    results_writer_t *results;
+    char              file_name[256];
+    int64_t           position;
+    int               nb_blocks, i, ret = 0;
+#ifdef BUILD_WITH_MPI
+    MPI_Status        status;
+#endif // BUILD_WITH_MPI
+
+    results = melissa_calloc (1, sizeof(results_writer_t));
+    results->offset    = offset;
+    results->vect_size = vect_size;
+    memcpy (results->header.magic, MELISSA_RESULTS_MAGIC, sizeof(results->header.magic));
+    results->header.version       = MELISSA_RESULTS_VERSION;
+    results->header.nb_time_steps = options->nb_time_steps;
+    results->header.nb_statistics = results_entries (options, NULL);
+    results->header.vect_size     = global_vect_size;
+    strncpy (results->header.field, field, sizeof(results->header.field) - 1);
+    results->entries = melissa_calloc (results->header.nb_statistics, sizeof(melissa_results_entry_t));
+    results_entries (options, results->entries);
+
+    nb_blocks = results->header.nb_statistics * results->header.nb_time_steps;
+    results->index = melissa_malloc (nb_blocks * sizeof(int64_t));
+    results->header.entries = sizeof(melissa_results_header_t);
+    results->header.index   = results->header.entries + results->header.nb_statistics * sizeof(melissa_results_entry_t);
+    position = results->header.index + nb_blocks * sizeof(int64_t);
+    for (i=0; i<nb_blocks; i++)
+    {
+        position = (position + MELISSA_RESULTS_ALIGN - 1) / MELISSA_RESULTS_ALIGN * MELISSA_RESULTS_ALIGN;
+        results->index[i] = position;
+        position += global_vect_size * (int64_t)results->entries[i / results->header.nb_time_steps].elem_size;
+    }
+    results->header.file_size = position;
+
+    snprintf (file_name, sizeof(file_name), "results.%s.mres", field);
+#ifdef BUILD_WITH_MPI
+    if (MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &results->f) != MPI_SUCCESS)
+    {
+        ret = -1;
+    }
+    // the next calls are collective: if the file can not be opened on one
+    // rank, every rank gives up. The file is not closed on the other ranks,
+    // MPI_File_close being collective too.
+    MPI_Allreduce (MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, comm_data->comm);
+    if (ret == 0)
+    {
+        // an older and longer file is cut
+        MPI_File_set_size (results->f, results->header.file_size);
+        if (comm_data->rank == 0)
+        {
+            MPI_File_write_at (results->f, 0, &results->header, sizeof(melissa_results_header_t), MPI_BYTE, &status);
+            MPI_File_write_at (results->f, results->header.entries, results->entries,
+                               results->header.nb_statistics * sizeof(melissa_results_entry_t), MPI_BYTE, &status);
+            MPI_File_write_at (results->f, results->header.index, results->index, nb_blocks * sizeof(int64_t), MPI_BYTE, &status);
+        }
+    }
+#else // BUILD_WITH_MPI
+    results->f = fopen (file_name, "wb");
+    if (results->f == NULL)
+    {
+        ret = -1;
+    }
+    else
+    {
+        fwrite (&results->header, sizeof(melissa_results_header_t), 1, results->f);
+        fwrite (results->entries, sizeof(melissa_results_entry_t), results->header.nb_statistics, results->f);
+        fwrite (results->index, sizeof(int64_t), nb_blocks, results->f);
+    }
+#endif // BUILD_WITH_MPI
+    if (ret != 0)
+    {
+        melissa_print (VERBOSE_WARNING, "Can not open %s (melissa_write_stats)\n", file_name);
+        melissa_free (results->entries);
+        melissa_free (results->index);
+        melissa_free (results);
+        return NULL;
+    }
+    return results;
+}
+
+// writes the elements of the rank of a statistic of a time step in its block.
+// Collective on comm_data->comm.
+static void results_write (results_writer_t *results,
+                           const char       *statistics_name,
+                           int               t,
+                           const void       *vec)
+{
+    melissa_results_entry_t *entry;
+    int64_t                  position;
+    int                      i;
+#ifdef BUILD_WITH_MPI
+    MPI_Status               status;
+#endif // BUILD_WITH_MPI
+
+    for (i=0; i<results->header.nb_statistics; i++)
+    {
+        if (strcmp (results->entries[i].name, statistics_name) == 0)
+        {
+            break;
+        }
+    }
+    if (i == results->header.nb_statistics)
+    {
+        melissa_print (VERBOSE_WARNING, "No %s in the results of %s\n", statistics_name, results->header.field);
+        return;
+    }
+    entry = &results->entries[i];
+    position = results->index[i * results->header.nb_time_steps + t] + results->offset * entry->elem_size;
+#ifdef BUILD_WITH_MPI
+    MPI_File_write_at_all (results->f, position, vec, results->vect_size,
+                           (entry->type == MELISSA_RESULTS_INT) ? MPI_INT : MPI_DOUBLE, &status);
+#else // BUILD_WITH_MPI
+    fseek (results->f, position, SEEK_SET);
+    fwrite (vec, entry->elem_size, results->vect_size, results->f);
+#endif // BUILD_WITH_MPI
+}
+
+static void results_close (results_writer_t *results)
+{
+#ifdef BUILD_WITH_MPI
+    MPI_File_close (&results->f);
+#else // BUILD_WITH_MPI
+    fclose (results->f);
+#endif // BUILD_WITH_MPI
+    melissa_free (results->entries);
+    melissa_free (results->index);
+    melissa_free (results);
+}
+
+// writes a statistic of a time step. The local values are at the begining of
+// d_buffer. With a file per field (field_output, a columnar container or a
+// file of the output module), every rank writes its values in it, otherwise large statistics are written by every rank, the others
+// gathered on rank 0. Collective on comm_data->comm.
+static void output_d (melissa_options_t *options,
+                      comm_data_t       *comm_data,
+                      void              *field_output,
+                      int               *local_vect_sizes,
+                      int                global_vect_size,
+                      double            *d_buffer,
+                      const char        *file_name,
+                      const char        *field,
+                      const char        *statistics_name,
+                      int                t)
+{
+#ifdef BUILD_WITH_MPI
+    char     *buffer = NULL;
+    long int  size;
+#endif // BUILD_WITH_MPI
+
+    if (field_output != NULL)
+    {
+        if (options->columnar_output != 0)
+        {
+            results_write (field_output, statistics_name, t, d_buffer);
+        }
+        else
+        {
+            write_field_output_d (field_output, statistics_name, t, d_buffer);
+        }
+        return;
+    }
+#ifdef BUILD_WITH_MPI
+    if (comm_data->comm_size > 1 && global_vect_size > options->gather_output)
+    {
+        // every rank gets the same answer from the output module
+        size = encode_output_d (file_name, t, comm_data->rank == 0, local_vect_sizes[comm_data->rank], d_buffer, &buffer);
+        if (size >= 0)
+        {
+            write_part (comm_data, file_name, buffer, size);
+            free (buffer);
+            return;
+        }
+    }
+#endif // BUILD_WITH_MPI
+    dgather_data (comm_data, local_vect_sizes, d_buffer);
+    if (comm_data->rank == 0)
+    {
+        (*write_output_d)(file_name,
+                          field,
+                          statistics_name,
+                          t,
+                          global_vect_size,
+                          d_buffer);
+    }
+}
+
+static void output_i (melissa_options_t *options,
+                      comm_data_t       *comm_data,
+                      void              *field_output,
+                      int               *local_vect_sizes,
+                      int                global_vect_size,
+                      int               *i_buffer,
+                      const char        *file_name,
+                      const char        *field,
+                      const char        *statistics_name,
+                      int                t)
+{
+#ifdef BUILD_WITH_MPI
+    char     *buffer = NULL;
+    long int  size;
+#endif // BUILD_WITH_MPI
+
+    if (field_output != NULL)
+    {
+        if (options->columnar_output != 0)
+        {
+            results_write (field_output, statistics_name, t, i_buffer);
+        }
+        else
+        {
+            write_field_output_i (field_output, statistics_name, t, i_buffer);
+        }
+        return;
+    }
+#ifdef BUILD_WITH_MPI
+    if (comm_data->comm_size > 1 && global_vect_size > options->gather_output)
+    {
+        size = encode_output_i (file_name, t, comm_data->rank == 0, local_vect_sizes[comm_data->rank], i_buffer, &buffer);
+        if (size >= 0)
+        {
+            write_part (comm_data, file_name, buffer, size);
+            free (buffer);
+            return;
+        }
+    }
+#endif // BUILD_WITH_MPI
+    igather_data (comm_data, local_vect_sizes, i_buffer);
+    if (comm_data->rank == 0)
+    {
+        (*write_output_i)(file_name,
+                          field,
+                          statistics_name,
+                          t,
+                          global_vect_size,
+                          i_buffer);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_output
+ *
+ * This function writes the computed statistics on files. The statistics larger
+ * than options->gather_output are written by every rank in the same file, the
+ * others are gathered and written by rank 0. With options->columnar_output,
+ * or if the output module writes one file per field (open_field_output), every
+ * rank writes all its statistics in the file of the field.
  *
  *******************************************************************************
  *
@@ -133,19 +541,18 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                              char               *field)
 {
     long int    temp_offset=0;
-#ifdef BUILD_WITH_MPI
-    MPI_Status  status;
-#endif // BUILD_WITH_MPI
-    long int    i, j;
+    long int    i;
     int        *offsets;
     int         t, p;
     char        file_name[256];
+    char        statistics_name[256];
     int         max_size_time;
     int         vect_size = 0;
     int        *local_vect_sizes;
     int         global_vect_size = 0;
     int        *i_buffer;
     double     *d_buffer;
+    void       *field_output;
 //    double temp1, temp2;
 
     max_size_time=floor(log10(options->nb_time_steps))+1;
@@ -175,7 +582,25 @@ void melissa_write_stats_seq(melissa_data_t    **data,
 
     // ============================================ //
 
-    d_buffer = melissa_malloc (global_vect_size * sizeof(double));
+    if (options->columnar_output != 0)
+    {
+        field_output = results_open (field, options, comm_data, vect_size, offsets[comm_data->rank], global_vect_size);
+    }
+    else
+    {
+        // NULL if the output module writes a file per statistic and time step
+        field_output = open_field_output (field, options, comm_data, vect_size, offsets[comm_data->rank], global_vect_size);
+    }
+
+    // only rank 0 receives the gathered statistics
+    if (comm_data->rank == 0)
+    {
+        d_buffer = melissa_malloc (global_vect_size * sizeof(double));
+    }
+    else
+    {
+        d_buffer = melissa_malloc ((vect_size > 0 ? vect_size : 1) * sizeof(double));
+    }
 
     if (options->mean_op == 1)
     {
@@ -184,7 +609,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
 #endif // BUILD_WITH_MPI
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_mean.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_mean.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
@@ -194,16 +619,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                 }
             }
             temp_offset = 0;
-            dgather_data (comm_data, local_vect_sizes, d_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_d)(file_name,
-                                  field,
-                                  "mean",
-                                  t,
-                                  global_vect_size,
-                                  d_buffer);
-            }
+            output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, "mean", t);
         }
     }
 
@@ -214,26 +630,17 @@ void melissa_write_stats_seq(melissa_data_t    **data,
 #endif // BUILD_WITH_MPI
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_variance.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_variance.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
                 {
-                    memcpy(&d_buffer[temp_offset], (*data)[i].moments[t].theta2, (*data)[i].vect_size*sizeof(double));
+                    compute_variance (&(*data)[i].moments[t], &d_buffer[temp_offset], (*data)[i].vect_size);
                     temp_offset += (*data)[i].vect_size;
                 }
             }
             temp_offset = 0;
-            dgather_data (comm_data, local_vect_sizes, d_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_d)(file_name,
-                                  field,
-                                  "variance",
-                                  t,
-                                  global_vect_size,
-                                  d_buffer);
-            }
+            output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, "variance", t);
         }
     }
 
@@ -244,7 +651,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
 #endif // BUILD_WITH_MPI
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_skewness.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_skewness.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
@@ -254,16 +661,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                 }
             }
             temp_offset = 0;
-            dgather_data (comm_data, local_vect_sizes, d_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_d)(file_name,
-                                  field,
-                                  "skewness",
-                                  t,
-                                  global_vect_size,
-                                  d_buffer);
-            }
+            output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, "skewness", t);
         }
     }
 
@@ -274,7 +672,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
 #endif // BUILD_WITH_MPI
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_kurtosis.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_kurtosis.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
@@ -284,16 +682,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                 }
             }
             temp_offset = 0;
-            dgather_data (comm_data, local_vect_sizes, d_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_d)(file_name,
-                                  field,
-                                  "kurtosis",
-                                  t,
-                                  global_vect_size,
-                                  d_buffer);
-            }
+            output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, "kurtosis", t);
         }
     }
 
@@ -304,7 +693,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
 #endif // BUILD_WITH_MPI
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_min.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_min.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
@@ -314,16 +703,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                 }
             }
             temp_offset = 0;
-            dgather_data (comm_data, local_vect_sizes, d_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_d)(file_name,
-                                  field,
-                                  "min",
-                                  t,
-                                  global_vect_size,
-                                  d_buffer);
-            }
+            output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, "min", t);
         }
 
 #ifdef BUILD_WITH_MPI
@@ -332,7 +712,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
         i_buffer = (int*)d_buffer;
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_min_id.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_min_id.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
@@ -342,16 +722,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                 }
             }
             temp_offset = 0;
-            igather_data (comm_data, local_vect_sizes, i_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_i)(file_name,
-                                  field,
-                                  "min_id",
-                                  t,
-                                  global_vect_size,
-                                  i_buffer);
-            }
+            output_i (options, comm_data, field_output, local_vect_sizes, global_vect_size, i_buffer, file_name, field, "min_id", t);
         }
 
 #ifdef BUILD_WITH_MPI
@@ -359,7 +730,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
 #endif // BUILD_WITH_MPI
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_max.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_max.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
@@ -369,16 +740,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                 }
             }
             temp_offset = 0;
-            dgather_data (comm_data, local_vect_sizes, d_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_d)(file_name,
-                                  field,
-                                  "max",
-                                  t,
-                                  global_vect_size,
-                                  d_buffer);
-            }
+            output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, "max", t);
         }
 
 #ifdef BUILD_WITH_MPI
@@ -387,7 +749,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
         i_buffer = (int*)d_buffer;
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "results.%s_max_id.%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "results.%s_max_id.%.*d", field, max_size_time, (int)t+1);
             for (i=0; i<comm_data->client_comm_size; i++)
             {
                 if ((*data)[i].vect_size > 0)
@@ -397,16 +759,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                 }
             }
             temp_offset = 0;
-            igather_data (comm_data, local_vect_sizes, i_buffer);
-            if (comm_data->rank == 0)
-            {
-                (*write_output_i)(file_name,
-                                  field,
-                                  "max_id",
-                                  t,
-                                  global_vect_size,
-                                  i_buffer);
-            }
+            output_i (options, comm_data, field_output, local_vect_sizes, global_vect_size, i_buffer, file_name, field, "max_id", t);
         }
     }
 
@@ -421,7 +774,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
         {
             for (t=0; t<options->nb_time_steps; t++)
             {
-                sprintf(file_name, "results.%s_threshold%g.%.*d", field, options->threshold[value], max_size_time, (int)t+1);
+                snprintf(file_name, sizeof(file_name), "results.%s_threshold%g.%.*d", field, options->threshold[value], max_size_time, (int)t+1);
                 for (i=0; i<comm_data->client_comm_size; i++)
                 {
                     if ((*data)[i].vect_size > 0)
@@ -431,16 +784,8 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                     }
                 }
                 temp_offset = 0;
-                igather_data (comm_data, local_vect_sizes, i_buffer);
-                if (comm_data->rank == 0)
-                {
-                    (*write_output_i)(file_name,
-                                      field,
-                                      "threshold",
-                                      t,
-                                      global_vect_size,
-                                      i_buffer);
-                }
+                snprintf(statistics_name, sizeof(statistics_name), "threshold%g", options->threshold[value]);
+                output_i (options, comm_data, field_output, local_vect_sizes, global_vect_size, i_buffer, file_name, field, statistics_name, t);
             }
         }
     }
@@ -455,7 +800,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
         {
             for (t=0; t<options->nb_time_steps; t++)
             {
-                sprintf(file_name, "results.%s_quantile%g.%.*d", field, options->quantile_order[value], max_size_time, (int)t+1);
+                snprintf(file_name, sizeof(file_name), "results.%s_quantile%g.%.*d", field, options->quantile_order[value], max_size_time, (int)t+1);
                 for (i=0; i<comm_data->client_comm_size; i++)
                 {
                     if ((*data)[i].vect_size > 0)
@@ -465,18 +810,8 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                     }
                 }
                 temp_offset = 0;
-                dgather_data (comm_data, local_vect_sizes, d_buffer);
-                if (comm_data->rank == 0)
-                {
-                  char statistics_name[256];
-                  sprintf(statistics_name, "quantile%g", options->quantile_order[value]);
-                    (*write_output_d)(file_name,
-                                      field,
-                                      statistics_name,
-                                      t,
-                                      global_vect_size,
-                                      d_buffer);
-                }
+                snprintf(statistics_name, sizeof(statistics_name), "quantile%g", options->quantile_order[value]);
+                output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, statistics_name, t);
             }
         }
     }
@@ -490,7 +825,7 @@ void melissa_write_stats_seq(melissa_data_t    **data,
         {
             for (t=0; t<options->nb_time_steps; t++)
             {
-                sprintf(file_name, "results.%s_sobol%d.%.*d", field, p, max_size_time, (int)(t+1));
+                snprintf(file_name, sizeof(file_name), "results.%s_sobol%d.%.*d", field, p, max_size_time, (int)(t+1));
                 for (i=0; i<comm_data->client_comm_size; i++)
                 {
                     if ((*data)[i].vect_size > 0)
@@ -500,25 +835,15 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                     }
                 }
                 temp_offset = 0;
-                dgather_data (comm_data, local_vect_sizes, d_buffer);
-                if (comm_data->rank == 0)
-                {
-                    char statistics_name[256];
-                    sprintf(statistics_name, "sobol%d", p);
-                    (*write_output_d)(file_name,
-                                      field,
-                                      statistics_name,
-                                      t,
-                                      global_vect_size,
-                                      d_buffer);
-                }
+                snprintf(statistics_name, sizeof(statistics_name), "sobol%d", p);
+                output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, statistics_name, t);
             }
         }
         for (p=0; p<options->nb_parameters; p++)
         {
             for (t=0; t<options->nb_time_steps; t++)
             {
-                sprintf(file_name, "results.%s_sobol_tot%d.%.*d", field, p, max_size_time, (int)(t+1));
+                snprintf(file_name, sizeof(file_name), "results.%s_sobol_tot%d.%.*d", field, p, max_size_time, (int)(t+1));
                 for (i=0; i<comm_data->client_comm_size; i++)
                 {
                     if ((*data)[i].vect_size > 0)
@@ -528,18 +853,8 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                     }
                 }
                 temp_offset = 0;
-                dgather_data (comm_data, local_vect_sizes, d_buffer);
-                if (comm_data->rank == 0)
-                {
-                    char statistics_name[256];
-                    sprintf(statistics_name, "sobol_tot%d", p);
-                    (*write_output_d)(file_name,
-                                      field,
-                                      statistics_name,
-                                      t,
-                                      global_vect_size,
-                                      d_buffer);
-                }
+                snprintf(statistics_name, sizeof(statistics_name), "sobol_tot%d", p);
+                output_d (options, comm_data, field_output, local_vect_sizes, global_vect_size, d_buffer, file_name, field, statistics_name, t);
             }
         }
     }
@@ -554,11 +869,524 @@ void melissa_write_stats_seq(melissa_data_t    **data,
     MPI_Barrier(comm_data->comm);
 #endif // BUILD_WITH_MPI
 
+    if (field_output != NULL && options->columnar_output != 0)
+    {
+        results_close (field_output);
+    }
+    else if (field_output != NULL)
+    {
+        close_field_output (field_output);
+    }
     melissa_free (d_buffer);
     melissa_free (offsets);
     melissa_free (local_vect_sizes);
 }
 
+// writes the local part of a statistic of a time step in <file_name>.p<rank>.
+// Returns -1 if the output module can not write parts of files.
+static int write_step_part_d (comm_data_t  *comm_data,
+                              const char   *file_name,
+                              int           t,
+                              size_t        vect_size,
+                              const double *d_buffer)
+{
+    char     *buffer = NULL;
+    char      part_name[300];
+    long int  size;
+    FILE     *f;
+
+    size = encode_output_d (file_name, t, comm_data->rank == 0, vect_size, d_buffer, &buffer);
+    if (size < 0)
+    {
+        return -1;
+    }
+    snprintf (part_name, sizeof(part_name), "%s.p%.*d", file_name, (int)floor(log10(comm_data->comm_size))+1, comm_data->rank);
+    f = fopen (part_name, "wb");
+    if (f == NULL || fwrite (buffer, 1, size, f) != (size_t)size)
+    {
+        melissa_print (VERBOSE_WARNING, "Can not write %s\n", part_name);
+    }
+    if (f != NULL)
+    {
+        fclose (f);
+    }
+    free (buffer);
+    return 0;
+}
+
+static int write_step_part_i (comm_data_t *comm_data,
+                              const char  *file_name,
+                              int          t,
+                              size_t       vect_size,
+                              const int   *i_buffer)
+{
+    char     *buffer = NULL;
+    char      part_name[300];
+    long int  size;
+    FILE     *f;
+
+    size = encode_output_i (file_name, t, comm_data->rank == 0, vect_size, i_buffer, &buffer);
+    if (size < 0)
+    {
+        return -1;
+    }
+    snprintf (part_name, sizeof(part_name), "%s.p%.*d", file_name, (int)floor(log10(comm_data->comm_size))+1, comm_data->rank);
+    f = fopen (part_name, "wb");
+    if (f == NULL || fwrite (buffer, 1, size, f) != (size_t)size)
+    {
+        melissa_print (VERBOSE_WARNING, "Can not write %s\n", part_name);
+    }
+    if (f != NULL)
+    {
+        fclose (f);
+    }
+    free (buffer);
+    return 0;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_output
+ *
+ * This function writes the statistics of one time step computed by this rank,
+ * without communication. Each statistic goes in <file name>.p<rank>, in the
+ * format of the output module, the first part holding the header: the parts
+ * concatenated in the order of the ranks are the file written by
+ * melissa_write_stats_seq (melissa_merge_step_parts). The statistics of the
+ * time step must be finalized.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *data
+ * array of structures containing statistics data, one per client rank
+ *
+ * @param[in] *options
+ * Melissa option structure
+ *
+ * @param[in] comm_data
+ * structure containing communications parameters
+ *
+ * @param[in] *field
+ * name of the statistic field to write
+ *
+ * @param[in] t
+ * time step to write
+ *
+ * @return 0, or -1 if the output module can not write parts of files
+ *
+ *******************************************************************************/
+
+int melissa_write_step_parts (melissa_data_t    *data,
+                              melissa_options_t *options,
+                              comm_data_t       *comm_data,
+                              char              *field,
+                              int                t)
+{
+    long int    temp_offset=0;
+    long int    i;
+    int         p, value;
+    char        file_name[256];
+    int         max_size_time;
+    int         vect_size = 0;
+    int        *i_buffer;
+    double     *d_buffer;
+    int         ret = 0;
+
+    max_size_time=floor(log10(options->nb_time_steps))+1;
+    for (i=0; i<comm_data->client_comm_size; i++)
+    {
+        vect_size += data[i].vect_size;
+    }
+    d_buffer = melissa_malloc ((vect_size > 0 ? vect_size : 1) * sizeof(double));
+    i_buffer = (int*)d_buffer;
+
+    if (options->mean_op == 1 && ret == 0)
+    {
+        snprintf(file_name, sizeof(file_name), "results.%s_mean.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                memcpy(&d_buffer[temp_offset], data[i].moments[t].m1, data[i].vect_size*sizeof(double));
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+    }
+
+    if (options->variance_op == 1 && ret == 0)
+    {
+        snprintf(file_name, sizeof(file_name), "results.%s_variance.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                compute_variance (&data[i].moments[t], &d_buffer[temp_offset], data[i].vect_size);
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+    }
+
+    if (options->skewness_op == 1 && ret == 0)
+    {
+        snprintf(file_name, sizeof(file_name), "results.%s_skewness.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                compute_skewness (&data[i].moments[t], &d_buffer[temp_offset], data[i].vect_size);
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+    }
+
+    if (options->kurtosis_op == 1 && ret == 0)
+    {
+        snprintf(file_name, sizeof(file_name), "results.%s_kurtosis.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                compute_kurtosis (&data[i].moments[t], &d_buffer[temp_offset], data[i].vect_size);
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+    }
+
+    if (options->min_and_max_op == 1 && ret == 0)
+    {
+        snprintf(file_name, sizeof(file_name), "results.%s_min.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                memcpy(&d_buffer[temp_offset], data[i].min_max[t].min, data[i].vect_size*sizeof(double));
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+        if (ret != 0)
+        {
+            melissa_free (d_buffer);
+            return ret;
+        }
+
+        snprintf(file_name, sizeof(file_name), "results.%s_min_id.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                memcpy(&i_buffer[temp_offset], data[i].min_max[t].min_id, data[i].vect_size*sizeof(int));
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_i (comm_data, file_name, t, vect_size, i_buffer);
+        if (ret != 0)
+        {
+            melissa_free (d_buffer);
+            return ret;
+        }
+
+        snprintf(file_name, sizeof(file_name), "results.%s_max.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                memcpy(&d_buffer[temp_offset], data[i].min_max[t].max, data[i].vect_size*sizeof(double));
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+        if (ret != 0)
+        {
+            melissa_free (d_buffer);
+            return ret;
+        }
+
+        snprintf(file_name, sizeof(file_name), "results.%s_max_id.%.*d", field, max_size_time, (int)t+1);
+        for (i=0; i<comm_data->client_comm_size; i++)
+        {
+            if (data[i].vect_size > 0)
+            {
+                memcpy(&i_buffer[temp_offset], data[i].min_max[t].max_id, data[i].vect_size*sizeof(int));
+                temp_offset += data[i].vect_size;
+            }
+        }
+        temp_offset = 0;
+        ret = write_step_part_i (comm_data, file_name, t, vect_size, i_buffer);
+    }
+
+    if (options->threshold_op == 1 && ret == 0)
+    {
+        for (value=0; value<options->nb_thresholds && ret == 0; value++)
+        {
+            snprintf(file_name, sizeof(file_name), "results.%s_threshold%g.%.*d", field, options->threshold[value], max_size_time, (int)t+1);
+            for (i=0; i<comm_data->client_comm_size; i++)
+            {
+                if (data[i].vect_size > 0)
+                {
+                    memcpy(&i_buffer[temp_offset], data[i].thresholds[t][value].threshold_exceedance, data[i].vect_size*sizeof(int));
+                    temp_offset += data[i].vect_size;
+                }
+            }
+            temp_offset = 0;
+            ret = write_step_part_i (comm_data, file_name, t, vect_size, i_buffer);
+        }
+    }
+
+    if (options->quantile_op == 1 && ret == 0)
+    {
+        for (value=0; value<options->nb_quantiles && ret == 0; value++)
+        {
+            snprintf(file_name, sizeof(file_name), "results.%s_quantile%g.%.*d", field, options->quantile_order[value], max_size_time, (int)t+1);
+            for (i=0; i<comm_data->client_comm_size; i++)
+            {
+                if (data[i].vect_size > 0)
+                {
+                    memcpy(&d_buffer[temp_offset], data[i].quantiles[t][value].quantile, data[i].vect_size*sizeof(double));
+                    temp_offset += data[i].vect_size;
+                }
+            }
+            temp_offset = 0;
+            ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+        }
+    }
+
+    if (options->sobol_op == 1 && ret == 0)
+    {
+        for (p=0; p<options->nb_parameters && ret == 0; p++)
+        {
+            snprintf(file_name, sizeof(file_name), "results.%s_sobol%d.%.*d", field, p, max_size_time, (int)(t+1));
+            for (i=0; i<comm_data->client_comm_size; i++)
+            {
+                if (data[i].vect_size > 0)
+                {
+                    memcpy(&d_buffer[temp_offset], data[i].sobol_indices[t].sobol_martinez[p].first_order_values, data[i].vect_size*sizeof(double));
+                    temp_offset += data[i].vect_size;
+                }
+            }
+            temp_offset = 0;
+            ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+            if (ret != 0)
+            {
+                break;
+            }
+
+            snprintf(file_name, sizeof(file_name), "results.%s_sobol_tot%d.%.*d", field, p, max_size_time, (int)(t+1));
+            for (i=0; i<comm_data->client_comm_size; i++)
+            {
+                if (data[i].vect_size > 0)
+                {
+                    memcpy(&d_buffer[temp_offset], data[i].sobol_indices[t].sobol_martinez[p].total_order_values, data[i].vect_size*sizeof(double));
+                    temp_offset += data[i].vect_size;
+                }
+            }
+            temp_offset = 0;
+            ret = write_step_part_d (comm_data, file_name, t, vect_size, d_buffer);
+        }
+    }
+
+    melissa_free (d_buffer);
+    return ret;
+}
+
+// names of the files of one time step written by melissa_write_step_parts,
+// in the same order. Returns the number of files, names can be NULL.
+static int step_file_names (melissa_options_t *options,
+                            char              *field,
+                            int                t,
+                            char             (*names)[256])
+{
+    int  nb_files = 0;
+    int  max_size_time;
+    int  value, p;
+    char stat_name[64];
+    const char *min_max[4] = {"min", "min_id", "max", "max_id"};
+
+    max_size_time=floor(log10(options->nb_time_steps))+1;
+#define ADD_FILE(...) \
+    do { \
+        snprintf (stat_name, sizeof(stat_name), __VA_ARGS__); \
+        if (names != NULL) \
+        { \
+            snprintf (names[nb_files], sizeof(names[nb_files]), "results.%s_%s.%.*d", field, stat_name, max_size_time, t+1); \
+        } \
+        nb_files++; \
+    } while (0)
+    if (options->mean_op == 1)
+    {
+        ADD_FILE ("mean");
+    }
+    if (options->variance_op == 1)
+    {
+        ADD_FILE ("variance");
+    }
+    if (options->skewness_op == 1)
+    {
+        ADD_FILE ("skewness");
+    }
+    if (options->kurtosis_op == 1)
+    {
+        ADD_FILE ("kurtosis");
+    }
+    if (options->min_and_max_op == 1)
+    {
+        for (value=0; value<4; value++)
+        {
+            ADD_FILE ("%s", min_max[value]);
+        }
+    }
+    if (options->threshold_op == 1)
+    {
+        for (value=0; value<options->nb_thresholds; value++)
+        {
+            ADD_FILE ("threshold%g", options->threshold[value]);
+        }
+    }
+    if (options->quantile_op == 1)
+    {
+        for (value=0; value<options->nb_quantiles; value++)
+        {
+            ADD_FILE ("quantile%g", options->quantile_order[value]);
+        }
+    }
+    if (options->sobol_op == 1)
+    {
+        for (p=0; p<options->nb_parameters; p++)
+        {
+            ADD_FILE ("sobol%d", p);
+            ADD_FILE ("sobol_tot%d", p);
+        }
+    }
+#undef ADD_FILE
+    return nb_files;
+}
+
+// concatenates <file_name>.p<rank> of every rank in <file_name>, and removes
+// the parts. The parts are kept if one of them can not be read.
+static int merge_file_parts (const char *file_name,
+                             int         comm_size,
+                             char       *buffer,
+                             size_t      buffer_size)
+{
+    char    part_name[300];
+    int     r;
+    int     ret = 0;
+    size_t  size;
+    FILE   *f, *part;
+
+    f = fopen (file_name, "wb");
+    if (f == NULL)
+    {
+        melissa_print (VERBOSE_WARNING, "Can not write %s\n", file_name);
+        return -1;
+    }
+    for (r=0; r<comm_size && ret == 0; r++)
+    {
+        snprintf (part_name, sizeof(part_name), "%s.p%.*d", file_name, (int)floor(log10(comm_size))+1, r);
+        part = fopen (part_name, "rb");
+        if (part == NULL)
+        {
+            melissa_print (VERBOSE_WARNING, "Can not read %s\n", part_name);
+            ret = -1;
+            break;
+        }
+        while ((size = fread (buffer, 1, buffer_size, part)) > 0)
+        {
+            if (fwrite (buffer, 1, size, f) != size)
+            {
+                melissa_print (VERBOSE_WARNING, "Can not write %s\n", file_name);
+                ret = -1;
+                break;
+            }
+        }
+        fclose (part);
+    }
+    fclose (f);
+    if (ret != 0)
+    {
+        remove (file_name);
+        return ret;
+    }
+    for (r=0; r<comm_size; r++)
+    {
+        snprintf (part_name, sizeof(part_name), "%s.p%.*d", file_name, (int)floor(log10(comm_size))+1, r);
+        remove (part_name);
+    }
+    return 0;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_output
+ *
+ * This function reassembles the parts written by melissa_write_step_parts at
+ * the end of the study: each file is the concatenation of its parts, in the
+ * order of the ranks, and is the same as the file written by
+ * melissa_write_stats_seq. The files are shared between the ranks, and the
+ * parts are removed. Collective on comm_data->comm, every part of every time
+ * step must be written.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *options
+ * Melissa option structure
+ *
+ * @param[in] comm_data
+ * structure containing communications parameters
+ *
+ * @param[in] *field
+ * name of the statistic field
+ *
+ *******************************************************************************/
+
+void melissa_merge_step_parts (melissa_options_t *options,
+                               comm_data_t       *comm_data,
+                               char              *field)
+{
+    char  (*names)[256];
+    char   *buffer;
+    size_t  buffer_size = 1 << 20;
+    int     nb_files, t, k;
+    long    file_id = 0;
+
+    nb_files = step_file_names (options, field, 0, NULL);
+    names = melissa_malloc ((nb_files > 0 ? nb_files : 1) * sizeof(*names));
+    buffer = melissa_malloc (buffer_size);
+#ifdef BUILD_WITH_MPI
+    // the parts of the other ranks must be closed
+    MPI_Barrier (comm_data->comm);
+#endif // BUILD_WITH_MPI
+    for (t=0; t<options->nb_time_steps; t++)
+    {
+        step_file_names (options, field, t, names);
+        for (k=0; k<nb_files; k++, file_id++)
+        {
+            if (file_id % comm_data->comm_size == comm_data->rank)
+            {
+                merge_file_parts (names[k], comm_data->comm_size, buffer, buffer_size);
+            }
+        }
+    }
+#ifdef BUILD_WITH_MPI
+    MPI_Barrier (comm_data->comm);
+#endif // BUILD_WITH_MPI
+    melissa_free (buffer);
+    melissa_free (names);
+}
+
 /**
  *******************************************************************************
  *
@@ -599,6 +1427,7 @@ void write_stats_bin (melissa_data_t    **data,
     char       file_name[256];
     int        max_size_time;
     int        vect_size = 0;
+    double    *d_buffer;
     int       *local_vect_sizes;
     int        global_vect_size = 0;
 
@@ -643,7 +1472,7 @@ void write_stats_bin (melissa_data_t    **data,
     {
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "%s_mean_%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "%s_mean_%.*d", field, max_size_time, (int)t+1);
 //            /*
 //             * Set up file access property list with parallel I/O access
 //             */
@@ -694,7 +1523,7 @@ void write_stats_bin (melissa_data_t    **data,
     {
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "%s_variance_%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "%s_variance_%.*d", field, max_size_time, (int)t+1);
 #ifdef BUILD_WITH_MPI
             MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
             temp_offset = 0;
@@ -705,12 +1534,15 @@ void write_stats_bin (melissa_data_t    **data,
             {
                 if ((*data)[i].vect_size > 0)
                 {
+                    d_buffer = melissa_malloc ((*data)[i].vect_size * sizeof(double));
+                    compute_variance (&(*data)[i].moments[t], d_buffer, (*data)[i].vect_size);
 #ifdef BUILD_WITH_MPI
-                    MPI_File_write_at (f, offset + temp_offset, (*data)[i].moments[t].theta2, (*data)[i].vect_size, MPI_DOUBLE, &status);
+                    MPI_File_write_at (f, offset + temp_offset, d_buffer, (*data)[i].vect_size, MPI_DOUBLE, &status);
                     temp_offset += (*data)[i].vect_size;
 #else // BUILD_WITH_MPI
-                    fwrite((*data)[i].moments[t].theta2, sizeof(double), (*data)[i].vect_size, f);
+                    fwrite(d_buffer, sizeof(double), (*data)[i].vect_size, f);
 #endif // BUILD_WITH_MPI
+                    melissa_free (d_buffer);
                 }
             }
 #ifdef BUILD_WITH_MPI
@@ -725,7 +1557,7 @@ void write_stats_bin (melissa_data_t    **data,
     {
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "%s_min_%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "%s_min_%.*d", field, max_size_time, (int)t+1);
 #ifdef BUILD_WITH_MPI
             MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
             temp_offset = 0;
@@ -753,7 +1585,7 @@ void write_stats_bin (melissa_data_t    **data,
 
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "%s_max_%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "%s_max_%.*d", field, max_size_time, (int)t+1);
 #ifdef BUILD_WITH_MPI
             MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
             temp_offset = 0;
@@ -784,7 +1616,7 @@ void write_stats_bin (melissa_data_t    **data,
     {
         for (t=0; t<options->nb_time_steps; t++)
         {
-            sprintf(file_name, "%s_threshold_exceedance_%.*d", field, max_size_time, (int)t+1);
+            snprintf(file_name, sizeof(file_name), "%s_threshold_exceedance_%.*d", field, max_size_time, (int)t+1);
 #ifdef BUILD_WITH_MPI
             MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
             temp_offset = 0;
@@ -818,7 +1650,7 @@ void write_stats_bin (melissa_data_t    **data,
         {
             for (t=0; t<options->nb_time_steps; t++)
             {
-                sprintf(file_name, "%s_quantile%g_%.*d", field, options->quantile_order[value], max_size_time, (int)t+1);
+                snprintf(file_name, sizeof(file_name), "%s_quantile%g_%.*d", field, options->quantile_order[value], max_size_time, (int)t+1);
 #ifdef BUILD_WITH_MPI
                 MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
                 temp_offset = 0;
@@ -853,7 +1685,7 @@ void write_stats_bin (melissa_data_t    **data,
         {
             for (p=0; p<options->nb_parameters; p++)
             {
-                sprintf(file_name, "%s_sobol_indices_%.*d.%d",field,  max_size_time, (int)t+1, p);
+                snprintf(file_name, sizeof(file_name), "%s_sobol_indices_%.*d.%d",field,  max_size_time, (int)t+1, p);
 #ifdef BUILD_WITH_MPI
                 MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
                 temp_offset = 0;
@@ -884,7 +1716,7 @@ void write_stats_bin (melissa_data_t    **data,
         {
             for (p=0; p<options->nb_parameters; p++)
             {
-                sprintf(file_name, "%s_sobol_total_indices_%.*d.%d",field,  max_size_time, (int)t+1, p);
+                snprintf(file_name, sizeof(file_name), "%s_sobol_total_indices_%.*d.%d",field,  max_size_time, (int)t+1, p);
 #ifdef BUILD_WITH_MPI
                 MPI_File_open (comm_data->comm, file_name, MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
                 temp_offset = 0;
@@ -1025,7 +1857,7 @@ void write_simu_param (vector_t *simulations,
     int                   i, j;
     melissa_simulation_t *simu_ptr;
 
-    sprintf(file_name, "simu_param.txt");
+    snprintf(file_name, sizeof(file_name), "simu_param.txt");
     melissa_print (VERBOSE_DEBUG, "Write simulation parameters in %s (write_simu_param)\n", file_name);
     f = fopen(file_name, "w");
     if (f == NULL)
@@ -47,6 +47,16 @@ void melissa_write_stats_seq(melissa_data_t    **data,
                              comm_data_t        *comm_data,
                              char               *field);
 
+int melissa_write_step_parts (melissa_data_t    *data,
+                              melissa_options_t *options,
+                              comm_data_t       *comm_data,
+                              char              *field,
+                              int                t);
+
+void melissa_merge_step_parts (melissa_options_t *options,
+                               comm_data_t       *comm_data,
+                               char              *field);
+
 void write_stats_txt(melissa_data_t    **data,
                      melissa_options_t  *options,
                      comm_data_t        *comm_data,
@@ -78,6 +88,39 @@ void write_output_i(const char   *file_name,
                         const size_t  vec_size,
                         const int     vec[]);
 
+long int encode_output_d(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vec_size,
+                         const double  vec[],
+                         char        **buffer);
+
+long int encode_output_i(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vec_size,
+                         const int     vec[],
+                         char        **buffer);
+
+void* open_field_output (const char        *field,
+                         melissa_options_t *options,
+                         comm_data_t       *comm_data,
+                         const size_t       vec_size,
+                         const size_t       offset,
+                         const size_t       global_vec_size);
+
+void write_field_output_d (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const double  vec[]);
+
+void write_field_output_i (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const int     vec[]);
+
+void close_field_output (void *output);
+
 void write_simu_param (vector_t *simulations,
                        int       nb_parameters);
 
@@ -1,27 +1,16 @@
 #include "melissa_output.h"
 
-void write_output_d(const char   *file_name,
-                            const char   *field,
-                            const int     t,
-                            const size_t  vect_size,
-                            const double  vec[])
+// the ensight header: description, part, element type
+static void write_header (FILE       *f,
+                          const char *file_name,
+                          const int   t)
 {
     int     i;
-    FILE*   f;
     double  time_value;
     char    c_buffer[81], c_buffer2[81];
-    float  *s_buffer;
     int32_t     n = 1;
 
     time_value = 0.0012 * t;
-    s_buffer = melissa_malloc (vect_size * sizeof(float));
-
-    for (i=0; i<vect_size; i++)
-    {
-        s_buffer[i] = (float)vec[i];
-    }
-
-    f = fopen(file_name, "w");
     sprintf(c_buffer, "%s (time values: %d, %g)", file_name, (int)t, time_value);
     strncpy(c_buffer2, c_buffer, 80);
     for (i=strlen(c_buffer); i < 80; i++)
@@ -41,56 +30,137 @@ void write_output_d(const char   *file_name,
         c_buffer2[i] = ' ';
     c_buffer2[80] = '\0';
     fwrite (c_buffer2, sizeof(char), 80, f);
+}
+
+static void write_values_d (FILE         *f,
+                            const size_t  vect_size,
+                            const double  vec[])
+{
+    int     i;
+    float  *s_buffer;
+
+    s_buffer = melissa_malloc (vect_size * sizeof(float));
+    for (i=0; i<vect_size; i++)
+    {
+        s_buffer[i] = (float)vec[i];
+    }
     fwrite (s_buffer, sizeof(float), vect_size, f);
+    melissa_free (s_buffer);
+}
 
-    fclose(f);
+static void write_values_i (FILE         *f,
+                            const size_t  vect_size,
+                            const int     vec[])
+{
+    int     i;
+    float  *s_buffer;
+
+    s_buffer = melissa_malloc (vect_size * sizeof(float));
+    for (i=0; i<vect_size; i++)
+    {
+        s_buffer[i] = (float)vec[i];
+    }
+    fwrite (s_buffer, sizeof(float), vect_size, f);
     melissa_free (s_buffer);
 }
 
+void write_output_d(const char   *file_name,
+                            const char   *field,
+                            const char   *statistics_name,
+                            const int     t,
+                            const size_t  vect_size,
+                            const double  vec[])
+{
+    FILE*   f;
+
+    f = fopen(file_name, "w");
+    write_header (f, file_name, t);
+    write_values_d (f, vect_size, vec);
+    fclose(f);
+}
+
 
 void write_output_i(const char   *file_name,
                             const char   *field,
+                            const char   *statistics_name,
                             const int     t,
                             const size_t  vect_size,
                             const int     vec[])
 {
-    int     i;
     FILE*   f;
-    double  time_value;
-    char    c_buffer[81], c_buffer2[81];
-    float  *s_buffer;
-    int32_t     n = 1;
 
-    time_value = 0.0012 * t;
-    s_buffer = melissa_malloc (vect_size * sizeof(float));
+    f = fopen(file_name, "w");
+    write_header (f, file_name, t);
+    write_values_i (f, vect_size, vec);
+    fclose(f);
+}
 
-    for (i=0; i<vect_size; i++)
+// the first part of the file holds the header
+long int encode_output_d(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vect_size,
+                         const double  vec[],
+                         char        **buffer)
+{
+    size_t size;
+    FILE*  f;
+
+    f = open_memstream (buffer, &size);
+    if (header != 0)
     {
-        s_buffer[i] = (float)vec[i];
+        write_header (f, file_name, t);
     }
+    write_values_d (f, vect_size, vec);
+    fclose(f);
+    return size;
+}
 
-    f = fopen(file_name, "w");
-    sprintf(c_buffer, "%s (time values: %d, %g)", file_name, (int)t, time_value);
-    strncpy(c_buffer2, c_buffer, 80);
-    for (i=strlen(c_buffer); i < 80; i++)
-        c_buffer2[i] = ' ';
-    c_buffer2[80] = '\0';
-    fwrite (c_buffer2, sizeof(char), 80, f);
-    sprintf(c_buffer, "part");
-    strncpy(c_buffer2, c_buffer, 80);
-    for (i=strlen(c_buffer); i < 80; i++)
-        c_buffer2[i] = ' ';
-    c_buffer2[80] = '\0';
-    fwrite (c_buffer2, sizeof(char), 80, f);
-    fwrite (&n, sizeof(int32_t), 1, f);
-    sprintf(c_buffer, "hexa8");
-    strncpy(c_buffer2, c_buffer, 80);
-    for (i=strlen(c_buffer); i < 80; i++)
-        c_buffer2[i] = ' ';
-    c_buffer2[80] = '\0';
-    fwrite (c_buffer2, sizeof(char), 80, f);
-    fwrite (s_buffer, sizeof(float), vect_size, f);
+long int encode_output_i(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vect_size,
+                         const int     vec[],
+                         char        **buffer)
+{
+    size_t size;
+    FILE*  f;
 
+    f = open_memstream (buffer, &size);
+    if (header != 0)
+    {
+        write_header (f, file_name, t);
+    }
+    write_values_i (f, vect_size, vec);
     fclose(f);
-    melissa_free (s_buffer);
+    return size;
+}
+
+// one file per statistic and time step, not per field
+void* open_field_output (const char        *field,
+                         melissa_options_t *options,
+                         comm_data_t       *comm_data,
+                         const size_t       vec_size,
+                         const size_t       offset,
+                         const size_t       global_vec_size)
+{
+    return NULL;
+}
+
+void write_field_output_d (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const double  vec[])
+{
+}
+
+void write_field_output_i (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const int     vec[])
+{
+}
+
+void close_field_output (void *output)
+{
 }
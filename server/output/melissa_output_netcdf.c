@@ -1,363 +1,424 @@
 #include "melissa_output.h"
 #include <netcdf.h>
-#include <unistd.h>
+#ifdef BUILD_WITH_MPI
+#include <netcdf_par.h>
+#endif // BUILD_WITH_MPI
 
-// for debugging:
-#include <signal.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-#ifdef __DEBUG  // TODO: check if this is the correct debug symbol
-#define D(x ...) printf("++++++++:"); printf(x); printf(" %s:%d\n", __FILE__, __LINE__)
-#else
-#define D(...)
-#endif
+#define MAX_DIMS 10
 
-void ERROR(const char * message)
+// one netCDF-4 file per field: every statistic is a (time, grid) variable
+typedef struct
+{
+    int    ncid;                    // netCDF file
+    char   file_name[256];          // name of the file, for the messages
+    int    nb_dims;                 // number of grid dimensions
+    size_t start[MAX_DIMS+1];       // first (time, grid) index of the rank
+    size_t count[MAX_DIMS+1];       // number of (time, grid) indices of the rank
+} netcdf_output_t;
+
+static int check (int         status,
+                  const char *file_name,
+                  const char *what)
 {
-    printf("ERROR! %s\n", message);
-    raise(SIGINT);
-    exit(1);
+    if (status != NC_NOERR)
+    {
+        melissa_print (VERBOSE_WARNING, "netCDF: %s %s: %s\n", what, file_name, nc_strerror (status));
+    }
+    return status;
 }
 
 /**
- * Format must be:
+ * The grid shape, slowest dimension first. Format must be:
  * export MELISSA_NETCDF_DIMENSIONS="<dimlen z>;<dimlen y>;<dimlen x>;"
  * export MELISSA_NETCDF_DIMENSIONS="<dimlen y>;<dimlen x>;"
  * ...
- * For one dimension MELISSA_NETCDF_DIMENSIONS can left unset.
+ * Returns the number of dimensions, 0 if MELISSA_NETCDF_DIMENSIONS is unset.
  */
-void getDimsFromEnv(size_t * dims, size_t * n)
+static int grid_shape (size_t *n)
 {
-    // returns the number of dims
-    // in n the size of each dimension can be found!
-    *dims = 0;
-    char dim_str_cp[256];
-    char * dim_str = dim_str_cp;
-    strcpy(dim_str, getenv("MELISSA_NETCDF_DIMENSIONS"));
-    if (dim_str == NULL)
-    {
-        *dims = 1;
-        return;
-    }
+    char *env = getenv ("MELISSA_NETCDF_DIMENSIONS");
+    char *end;
+    int   nb_dims = 0;
 
-    char * old = dim_str;
-    for (; *dim_str != '\0'; ++dim_str)
+    while (env != NULL && *env != '\0' && nb_dims < MAX_DIMS)
     {
-        if (*dim_str == ';')
+        n[nb_dims] = strtoul (env, &end, 10);
+        if (end == env || n[nb_dims] == 0)
         {
-            *dim_str = '\0';
-            n[*dims] = atoi(old);
-            ++(*dims);
-            old = dim_str+1;
+            return 0;
         }
+        nb_dims += 1;
+        env = (*end == ';') ? end + 1 : end;
     }
+    return nb_dims;
 }
 
-
-
-
-/**
- * Creates dimension or only returns its id if already existent.
- */
-int getDim(int ncID, const char *name, size_t len, int *idp)
+static void dim_name (char *dest,
+                      int   i,
+                      int   nb_dims)
 {
-    int res = nc_def_dim(ncID, name, len, idp);
+    const char std_dims[3][2] = {"z","y","x"};
 
-    if (res == NC_ENAMEINUSE)
+    if (nb_dims <= 3)
     {
-        res = nc_inq_varid(ncID, name, idp);
+        // for 2D for example i=0 needs to map to y and not to z!
+        strcpy (dest, std_dims[3 - nb_dims + i]);
     }
-    if (res != NC_NOERR)
+    else
     {
-        printf("Netcdf Error code: %d\n", res);
-        ERROR("Could not create dimension");
+        sprintf (dest, "x%d", i);
     }
-    return res;
 }
 
-/**
- * Creates variables or only returns its id if already existent.
- */
-void getVar(const int ncID, const char *name, const int ndims, const int dimids[], int *idp, const nc_type xtype)
+static void define_variable (netcdf_output_t *output,
+                             const char      *name,
+                             nc_type          xtype,
+                             const int        dim_ids[],
+                             const size_t     chunk[],
+                             int              deflate)
 {
-    nc_redef(ncID);
-    int res = nc_def_var(ncID, name, xtype, ndims, dimids, idp);
+    int var_id;
 
-    if (res == NC_ENAMEINUSE)
+    if (check (nc_def_var (output->ncid, name, xtype, output->nb_dims + 1, dim_ids, &var_id), output->file_name, name) != NC_NOERR)
     {
-        res = nc_inq_varid(ncID, name, idp);
-        if (res != NC_NOERR)
-        {
-            ERROR("Could not find variable");
-        }
+        return;
     }
-    if (res != NC_NOERR)
+    check (nc_def_var_chunking (output->ncid, var_id, NC_CHUNKED, chunk), output->file_name, name);
+    if (deflate > 0)
     {
-        printf("Netcdf Error code: %d\n", res);
-        ERROR("Could not create variable");
+        // the shuffle filter puts the bytes of the same rank together
+        check (nc_def_var_deflate (output->ncid, var_id, 1, 1, deflate), output->file_name, name);
     }
+#ifdef BUILD_WITH_MPI
+    // a filtered variable can only be written by collective writes
+    check (nc_var_par_access (output->ncid, var_id, NC_COLLECTIVE), output->file_name, name);
+#endif // BUILD_WITH_MPI
 }
 
-void getDimName(char * dest, int i, int dims)
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_output
+ *
+ * This function creates results.<field>.nc, with one variable per statistic,
+ * whose dimensions are the time steps and the grid (MELISSA_NETCDF_DIMENSIONS,
+ * or the elements of the field). Every rank writes its own elements, the
+ * chunks are the largest range of elements of a rank, so that the ranks write
+ * whole chunks when the partition is even. Collective on comm_data->comm.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *field
+ * name of the field
+ *
+ * @param[in] *options
+ * Melissa option structure
+ *
+ * @param[in] *comm_data
+ * structure containing communications parameters
+ *
+ * @param[in] vec_size
+ * number of elements of the rank
+ *
+ * @param[in] offset
+ * first element of the rank in the field
+ *
+ * @param[in] global_vec_size
+ * number of elements of the field
+ *
+ * @return The netCDF output of the field, NULL on every rank if the file can
+ * not be created on one of them
+ *
+ *******************************************************************************/
+
+void* open_field_output (const char        *field,
+                         melissa_options_t *options,
+                         comm_data_t       *comm_data,
+                         const size_t       vec_size,
+                         const size_t       offset,
+                         const size_t       global_vec_size)
 {
-    if (dims <= 3) {
-        char std_dims [3][2] = {"z","y","x"};
-        int j = 3 - dims;  // for 2D for example i=0 needs to map to y and not to z!
-        strcpy(dest, std_dims[j+i]);
+    netcdf_output_t    *output;
+    size_t              n[MAX_DIMS];
+    size_t              chunk[MAX_DIMS+1];
+    size_t              time_start = 0, time_count = 0;
+    unsigned long long  max_size = vec_size;
+    size_t              inner = 1;
+    int                 dim_ids[MAX_DIMS+1];
+    int                 time_id, aligned, i, t, p;
+    int                 status, failed;
+    char                name[256];
+    double             *time_values;
+
+    output = melissa_calloc (1, sizeof(netcdf_output_t));
+    sprintf (output->file_name, "results.%s.nc", field);
+
+    // the grid shape is kept if every rank owns whole slices of its slowest dimension
+    output->nb_dims = grid_shape (n);
+    for (i=1; i<output->nb_dims; i++)
+    {
+        inner *= n[i];
     }
-    else
+    aligned = (output->nb_dims > 0 && n[0] * inner == global_vec_size &&
+               offset % inner == 0 && vec_size % inner == 0);
+#ifdef BUILD_WITH_MPI
+    MPI_Allreduce (MPI_IN_PLACE, &aligned, 1, MPI_INT, MPI_MIN, comm_data->comm);
+    MPI_Allreduce (MPI_IN_PLACE, &max_size, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm_data->comm);
+#endif // BUILD_WITH_MPI
+    if (aligned == 0)
     {
-        sprintf(dest, "x%d", i);
+        output->nb_dims = 1;
+        n[0] = global_vec_size;
+        inner = 1;
     }
-}
 
-#define MAX_DIMS 10
-#define MAX_FILE_NAME 512
-typedef struct  {
-    const char file_name[MAX_FILE_NAME];
-    size_t dims;
-    size_t n[MAX_DIMS];
-    int ncID;
-
-
-    int variable_var_id;
-    int time_var_id;
-
-} CacheEntry;
-
-// I want to write CPP!!
-// Allows 4096 different output files...
-#define FILE_CACHE_SIZE 4096
-static CacheEntry cache[FILE_CACHE_SIZE];
-static size_t last_entry = 0;
-
-// Returns NULL if not found.
-CacheEntry * findEntry(const char* file_name)
-{
-    int i;
-    for (i = 0; i < FILE_CACHE_SIZE; ++i)
+#ifdef BUILD_WITH_MPI
+    status = check (nc_create_par (output->file_name, NC_NETCDF4|NC_MPIIO|NC_CLOBBER, comm_data->comm, MPI_INFO_NULL, &output->ncid),
+                    output->file_name, "can not create");
+    // the next calls are collective: if the file can not be created on one
+    // rank, every rank gives up. The file is not closed on the other ranks,
+    // nc_close being collective too.
+    failed = (status != NC_NOERR);
+    MPI_Allreduce (MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, comm_data->comm);
+#else
+    status = check (nc_create (output->file_name, NC_NETCDF4|NC_CLOBBER, &output->ncid),
+                    output->file_name, "can not create");
+    failed = (status != NC_NOERR);
+#endif // BUILD_WITH_MPI
+    if (failed != 0)
     {
-        if (strcmp(cache[i].file_name, file_name) == 0)
-            return &cache[i];
+        melissa_free (output);
+        return NULL;
     }
-    return NULL;
-}
-
 
+    check (nc_def_dim (output->ncid, "time", options->nb_time_steps, &dim_ids[0]), output->file_name, "time");
+    for (i=0; i<output->nb_dims; i++)
+    {
+        dim_name (name, i, output->nb_dims);
+        check (nc_def_dim (output->ncid, name, n[i], &dim_ids[i+1]), output->file_name, name);
+    }
+    check (nc_def_var (output->ncid, "time", NC_DOUBLE, 1, dim_ids, &time_id), output->file_name, "time");
+#ifdef BUILD_WITH_MPI
+    check (nc_var_par_access (output->ncid, time_id, NC_COLLECTIVE), output->file_name, "time");
+#endif // BUILD_WITH_MPI
+
+    // one time step of the elements of the rank
+    output->start[0] = 0;
+    output->count[0] = 1;
+    output->start[1] = offset / inner;
+    output->count[1] = vec_size / inner;
+    chunk[0] = 1;
+    chunk[1] = (max_size / inner > 0) ? max_size / inner : 1;
+    for (i=1; i<output->nb_dims; i++)
+    {
+        output->start[i+1] = 0;
+        output->count[i+1] = n[i];
+        chunk[i+1] = n[i];
+    }
 
-/**
- * Opens/ creates file if not already there
- */
-CacheEntry * CreateFile(const char* file_name, const char* variable_name, size_t vec_size, nc_type xtype)
-{
-    CacheEntry * c = &cache[last_entry];
-    last_entry++;
-
-    // nice value when dimensions turn out to be 0.
-    c->n[0] = vec_size;
-    getDimsFromEnv(&c->dims, c->n);
-    // sometimes we get only 2D slizes... handle them nicely!
-    //printf("\nshape: %d %d %d == %d\n", c->n[0], c->n[1], c->n[2], vec_size);
-    if (vec_size == c->n[1] * c->n[2])
+    // every variable is defined before the first write
+    if (options->mean_op == 1)
     {
-        c->dims = 2;
-        c->n[0] = c->n[1];
-        c->n[1] = c->n[2];
+        define_variable (output, "mean", NC_DOUBLE, dim_ids, chunk, options->output_deflate);
     }
-    else
+    if (options->variance_op == 1)
     {
-        int prod = 1;
-        int i;
-        for (i = 0; i < c->dims; ++i)
-        {
-            prod *= c->n[i];
-        }
-        if (prod != vec_size)
+        define_variable (output, "variance", NC_DOUBLE, dim_ids, chunk, options->output_deflate);
+    }
+    if (options->skewness_op == 1)
+    {
+        define_variable (output, "skewness", NC_DOUBLE, dim_ids, chunk, options->output_deflate);
+    }
+    if (options->kurtosis_op == 1)
+    {
+        define_variable (output, "kurtosis", NC_DOUBLE, dim_ids, chunk, options->output_deflate);
+    }
+    if (options->min_and_max_op == 1)
+    {
+        define_variable (output, "min", NC_DOUBLE, dim_ids, chunk, options->output_deflate);
+        define_variable (output, "min_id", NC_INT, dim_ids, chunk, options->output_deflate);
+        define_variable (output, "max", NC_DOUBLE, dim_ids, chunk, options->output_deflate);
+        define_variable (output, "max_id", NC_INT, dim_ids, chunk, options->output_deflate);
+    }
+    if (options->threshold_op == 1)
+    {
+        for (p=0; p<options->nb_thresholds; p++)
         {
-            c->n[0] = vec_size;
-            c->dims=1;
+            sprintf (name, "threshold%g", options->threshold[p]);
+            define_variable (output, name, NC_INT, dim_ids, chunk, options->output_deflate);
         }
     }
-    c->ncID = 0;
-
-    if (access(file_name, F_OK) == -1)
+    if (options->quantile_op == 1)
     {
-        // TODO parallel file opening if sequential is too slow?
-        // TODO: race condition? who opens it first?
-        //#ifdef BUILD_WITH_MPI
-        //int status = nc_create_par(file_name, NC_NETCDF4 | NC_MPIIO, comm_data->comm, MPI_INFO_NULL, &ncID);
-        //#else
-        //int status = nc_create(file_name, NC_NETCDF4, &ncID);
-        int status = nc_create(file_name, 0, &c->ncID);
-        //#endif
-        if (status != NC_NOERR)
+        for (p=0; p<options->nb_quantiles; p++)
         {
-            printf("Error! nc error code: %d\c", status);
-            ERROR("Could not create file!");
+            sprintf (name, "quantile%g", options->quantile_order[p]);
+            define_variable (output, name, NC_DOUBLE, dim_ids, chunk, options->output_deflate);
         }
     }
-    else
+    if (options->sobol_op == 1)
     {
-        // open it
-        // should never get here...
-        D("file exists already. Opening it!");
-        //#ifdef BUILD_WITH_MPI
-        //if (nc_open_par(file_name, NC_MPIIO | NC_WRITE, comm_data->comm, MPI_INFO_NULL, &ncID) != NC_NOERR)
-        //#else
-        int status = nc_open(file_name, NC_WRITE, &c->ncID);
-        if (status!= NC_NOERR)
-            //#endif
+        for (p=0; p<options->nb_parameters; p++)
         {
-            printf("Error! nc error code: %d", status);
-            ERROR("Could not open file!");
+            sprintf (name, "sobol%d", p);
+            define_variable (output, name, NC_DOUBLE, dim_ids, chunk, options->output_deflate);
+            sprintf (name, "sobol_tot%d", p);
+            define_variable (output, name, NC_DOUBLE, dim_ids, chunk, options->output_deflate);
         }
     }
-
-    // create file. if it exists already, just load it.
-
-    // add/get Dimensions
-    //getDim(ncID, "x", nX, pxID);
-    //getDim(ncID, "y", nY, pyID);
-    //getDim(ncID, "z", nZ, pzID);
-    //getDim(ncID, "time", NC_UNLIMITED, ptime_id);
-
-    int ID[c->dims];
-    int i;
-    for (i = 0; i < c->dims; ++i)
+    failed = (check (nc_enddef (output->ncid), output->file_name, "can not define") != NC_NOERR);
+#ifdef BUILD_WITH_MPI
+    MPI_Allreduce (MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, comm_data->comm);
+#endif // BUILD_WITH_MPI
+    if (failed != 0)
     {
-        char dim_name[256];
-        getDimName(dim_name, i, c->dims);
-        getDim(c->ncID, dim_name, c->n[i], &ID[i]);
+        nc_close (output->ncid);
+        melissa_free (output);
+        return NULL;
     }
 
-    int time_id;
-
-    // TODO: maybe we are more performant if we write out all the time variables at once!
-    getDim(c->ncID, "time", NC_UNLIMITED, &time_id);
-
-    int variable_dims[c->dims+1];  //={ time_id, zID, yID, xID };
-    variable_dims[0] = time_id;
-    memcpy(&variable_dims[1], ID, sizeof(int) * c->dims);
-
-    getVar(c->ncID, variable_name, c->dims+1, variable_dims, &c->variable_var_id, xtype);
-
-    getVar(c->ncID, "time", 1, &time_id, &c->time_var_id, NC_DOUBLE);
-
-    // set time only once per file!
-    //nc_var_par_access(current_file_id, time_var_id, NC_COLLECTIVE);
-    // TODO: check if already something in time variable!
-    //size_t len_t;
-    //nc_inq_dimlen(current_file_id, time_var_id, &len_t);
-    // required for compatibility with netcdf3 :
-    nc_enddef(c->ncID);
-
-    strcpy(c->file_name, file_name);
+    // the time values, written by rank 0
+    time_values = melissa_malloc (options->nb_time_steps * sizeof(double));
+    for (t=0; t<options->nb_time_steps; t++)
+    {
+        time_values[t] = (double)t;
+    }
+    if (comm_data->rank == 0)
+    {
+        time_count = options->nb_time_steps;
+    }
+    check (nc_put_vara_double (output->ncid, time_id, &time_start, &time_count, time_values), output->file_name, "time");
+    melissa_free (time_values);
 
-    return c;
+    return output;
 }
 
-void write_netcdf(const char   *statistics_name,
-        const char   *variable_name,
-        const int     t,
-        const size_t  vec_size,
-        const void * vec[],
-        const nc_type xtype)
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_output
+ *
+ * This function writes the elements of the rank of a statistic of a time step
+ * in the netCDF file of the field. Collective on comm_data->comm.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *output
+ * netCDF output of the field (open_field_output)
+ *
+ * @param[in] *statistics_name
+ * name of the statistic
+ *
+ * @param[in] t
+ * time step
+ *
+ * @param[in] vec[]
+ * values of the elements of the rank
+ *
+ *******************************************************************************/
+
+void write_field_output_d (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const double  vec[])
 {
+    netcdf_output_t *nc_output = (netcdf_output_t*)output;
+    int              var_id;
 
-            // just write vector
-
-    //          nz ny nx
-    //size_t n[3] = {10, 5, 4};
-    //int n[dims] = {11, 6, 1}
-    //size_t dims = 3;
-
-    // iterators:
-    long int i, j;
-
-    // the following variables are currently just used by rank 0
-
-    int nc_status;
-
-    char file_name[MAX_FILE_NAME];
-
-    sprintf(file_name, "%s_%s.nc", variable_name, statistics_name);
-    if (t == 0)
+    if (check (nc_inq_varid (nc_output->ncid, statistics_name, &var_id), nc_output->file_name, statistics_name) != NC_NOERR)
     {
-      printf("Start writing %s\n", file_name);
+        return;
     }
+    nc_output->start[0] = t;
+    check (nc_put_vara_double (nc_output->ncid, var_id, nc_output->start, nc_output->count, vec),
+           nc_output->file_name, statistics_name);
+}
 
-    CacheEntry *c;
-    if (t == 0)
-    {
-        c = CreateFile(file_name, variable_name, vec_size, xtype);
-    }
-    else
+void write_field_output_i (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const int     vec[])
+{
+    netcdf_output_t *nc_output = (netcdf_output_t*)output;
+    int              var_id;
+
+    if (check (nc_inq_varid (nc_output->ncid, statistics_name, &var_id), nc_output->file_name, statistics_name) != NC_NOERR)
     {
-        c = findEntry(file_name);
+        return;
     }
+    nc_output->start[0] = t;
+    check (nc_put_vara_int (nc_output->ncid, var_id, nc_output->start, nc_output->count, vec),
+           nc_output->file_name, statistics_name);
+}
 
-    // add variable Time and variable "variable":
+void close_field_output (void *output)
+{
+    netcdf_output_t *nc_output = (netcdf_output_t*)output;
 
-    size_t start[c->dims+1];  //= { t, 0, 0, 0 };
-    size_t count[c->dims+1];  //= { 1, nZ, nY, nX};
-    start[0] = t;
-    count[0] = 1;  // writing one value
-    double double_time = (double) t;
-    nc_status = nc_put_vara_double(c->ncID, c->time_var_id, start, count, &double_time);
+    check (nc_close (nc_output->ncid), nc_output->file_name, "can not close");
+    melissa_free (nc_output);
+}
 
-    // refresh all the values of time step t:
-    //                  t  z  y  x
-    start[0] = t;
-    for (i = 1; i < c->dims+1; ++i)
-    {
-        start[i] = 0;
-    }
-    count[0] = 1;
-    memcpy(&count[1], c->n, sizeof(size_t) * c->dims);
-    //printf("%d,%d,%d,%d", count[0], count[1], count[2], count[3]);
-    // now do a write to the cdf! (! all the preparations up there are necessary!)
-    nc_status = nc_put_vara_double(c->ncID, c->variable_var_id, start, count, vec);
-    //printf("put_state: %d\n", nc_status);
-    D("putting doubles");
-    D("wrote %s\n", file_name);
-
-    const char * cnb_timesteps = getenv("MELISSA_NETCDF_NB_TIME_STEPS");
-    if (cnb_timesteps == NULL)
-    {
-        ERROR("Need to set environment variable MELISSA_NETCDF_NB_TIME_STEPS!");
-    }
+// only used if results.<field>.nc can not be created: the gathered
+// statistic in <file_name>.nc
+static void write_netcdf (const char   *file_name,
+                          const char   *statistics_name,
+                          const size_t  vec_size,
+                          const void   *vec,
+                          nc_type       xtype)
+{
+    char   nc_name[300];
+    int    ncid, dim_id, var_id;
 
-    int nb_timesteps = atoi(cnb_timesteps);
-    if (nb_timesteps == 0)
-    {
-        ERROR("Need meaningful value (e.g. >0) for MELISSA_NETCDF_NB_TIME_STEPS!");
-    }
-    if (t == nb_timesteps-1)
+    sprintf (nc_name, "%s.nc", file_name);
+    if (check (nc_create (nc_name, NC_NETCDF4|NC_CLOBBER, &ncid), nc_name, "can not create") != NC_NOERR)
     {
-        nc_close(c->ncID);
-        printf("Finished writing %s\n", file_name);
-        //D("Closed file!");
+        return;
     }
+    check (nc_def_dim (ncid, "x", vec_size, &dim_id), nc_name, "x");
+    check (nc_def_var (ncid, statistics_name, xtype, 1, &dim_id, &var_id), nc_name, statistics_name);
+    check (nc_enddef (ncid), nc_name, "can not define");
+    check (nc_put_var (ncid, var_id, vec), nc_name, statistics_name);
+    check (nc_close (ncid), nc_name, "can not close");
 }
 
 void write_output_d(const char   *file_name,
-        const char   *field,
-        const char   *statisics_name,
-        const int     t,
-        const size_t  vec_size,
-        const double  vec[])
+                    const char   *field,
+                    const char   *statistics_name,
+                    const int     t,
+                    const size_t  vec_size,
+                    const double  vec[])
 {
-    write_netcdf(statisics_name, field, t, vec_size, vec, NC_DOUBLE);
+    write_netcdf (file_name, statistics_name, vec_size, vec, NC_DOUBLE);
 }
 
 void write_output_i(const char   *file_name,
-        const char   *field,
-        const char   *statisics_name,
-        const int     t,
-        const size_t  vec_size,
-        const int     vec[])
+                    const char   *field,
+                    const char   *statistics_name,
+                    const int     t,
+                    const size_t  vec_size,
+                    const int     vec[])
+{
+    write_netcdf (file_name, statistics_name, vec_size, vec, NC_INT);
+}
+
+// a netCDF file is not a concatenation of parts: the statistics are gathered
+long int encode_output_d(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vec_size,
+                         const double  vec[],
+                         char        **buffer)
 {
-    write_netcdf(statisics_name, field, t, vec_size, vec, NC_INT);
+    return -1;
 }
 
+long int encode_output_i(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vec_size,
+                         const int     vec[],
+                         char        **buffer)
+{
+    return -1;
+}
@@ -1,5 +1,29 @@
 #include "melissa_output.h"
 
+static void print_values_d (FILE         *f,
+                            const size_t  vec_size,
+                            const double  vec[])
+{
+    size_t i;
+
+    for (i=0; i<vec_size; i++)
+    {
+        fprintf (f, "%.*e\n", 12, vec[i]);
+    }
+}
+
+static void print_values_i (FILE         *f,
+                            const size_t  vec_size,
+                            const int     vec[])
+{
+    size_t i;
+
+    for (i=0; i<vec_size; i++)
+    {
+        fprintf (f, "%d\n", vec[i]);
+    }
+}
+
 void write_output_d(const char   *file_name,
                         const char   *statistics_name,
                         const char   *field,
@@ -7,14 +31,10 @@ void write_output_d(const char   *file_name,
                         const size_t  vec_size,
                         const double  vec[])
 {
-    int   i;
     FILE* f;
 
     f = fopen(file_name, "w");
-    for (i=0; i<vec_size; i++)
-    {
-        fprintf (f, "%.*e\n", 12, vec[i]);
-    }
+    print_values_d (f, vec_size, vec);
     fclose(f);
 }
 
@@ -25,13 +45,71 @@ void write_output_i(const char   *file_name,
                         const size_t  vec_size,
                         const int     vec[])
 {
-    int   i;
     FILE* f;
 
     f = fopen(file_name, "w");
-    for (i=0; i<vec_size; i++)
-    {
-        fprintf (f, "%d\n", vec[i]);
-    }
+    print_values_i (f, vec_size, vec);
+    fclose(f);
+}
+
+// text files have no header: a part of the file is the lines of its values
+long int encode_output_d(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vec_size,
+                         const double  vec[],
+                         char        **buffer)
+{
+    size_t size;
+    FILE*  f;
+
+    f = open_memstream (buffer, &size);
+    print_values_d (f, vec_size, vec);
     fclose(f);
+    return size;
+}
+
+long int encode_output_i(const char   *file_name,
+                         const int     t,
+                         const int     header,
+                         const size_t  vec_size,
+                         const int     vec[],
+                         char        **buffer)
+{
+    size_t size;
+    FILE*  f;
+
+    f = open_memstream (buffer, &size);
+    print_values_i (f, vec_size, vec);
+    fclose(f);
+    return size;
+}
+
+// one file per statistic and time step, not per field
+void* open_field_output (const char        *field,
+                         melissa_options_t *options,
+                         comm_data_t       *comm_data,
+                         const size_t       vec_size,
+                         const size_t       offset,
+                         const size_t       global_vec_size)
+{
+    return NULL;
+}
+
+void write_field_output_d (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const double  vec[])
+{
+}
+
+void write_field_output_i (void         *output,
+                           const char   *statistics_name,
+                           const int     t,
+                           const int     vec[])
+{
+}
+
+void close_field_output (void *output)
+{
 }
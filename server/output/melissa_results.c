@@ -0,0 +1,306 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_results.c
+ * @brief Reader of the columnar results containers.
+ * @author Terraz Théophile
+ * @date 2019-04-23
+ *
+ * @defgroup melissa_results Melissa results container reader
+ *
+ * With the --columnar_output option, the server writes all the statistics of
+ * a field in one container, results.<field>.mres (melissa_output.c). The
+ * reader maps the whole file, so that post-processing tools can slice any
+ * statistic and time step without reading the others. It does not depend on
+ * MPI nor on the server.
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "melissa_results.h"
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_results
+ *
+ * This function maps a results container in memory and checks its header
+ *
+ *******************************************************************************
+ *
+ * @param[in] *file_name
+ * name of the container (results.<field>.mres)
+ *
+ * @return The mapped container, NULL if the file can not be mapped or is not
+ * a valid container
+ *
+ *******************************************************************************/
+
+melissa_results_t* melissa_results_open (const char *file_name)
+{
+    melissa_results_t        *results;
+    melissa_results_header_t *header;
+    struct stat               st;
+    void                     *map;
+    int64_t                   nb_blocks, elem_size, i;
+    int                       fd;
+
+    fd = open (file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat (fd, &st) != 0 || (size_t)st.st_size < sizeof(melissa_results_header_t))
+    {
+        close (fd);
+        return NULL;
+    }
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // the sizes are compared to what is left in the file, so that a crafted
+    // header can not overflow the bounds
+    header = (melissa_results_header_t*)map;
+    nb_blocks = (int64_t)header->nb_statistics * header->nb_time_steps;
+    if (memcmp (header->magic, MELISSA_RESULTS_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != MELISSA_RESULTS_VERSION ||
+        header->nb_statistics < 0 || header->nb_time_steps < 0 || header->vect_size < 0 ||
+        header->file_size != st.st_size ||
+        header->entries < (int64_t)sizeof(melissa_results_header_t) ||
+        header->entries > header->file_size ||
+        header->entries % sizeof(int64_t) != 0 ||
+        header->nb_statistics > (header->file_size - header->entries) / (int64_t)sizeof(melissa_results_entry_t) ||
+        header->index < header->entries + header->nb_statistics * (int64_t)sizeof(melissa_results_entry_t) ||
+        header->index > header->file_size ||
+        header->index % sizeof(int64_t) != 0 ||
+        nb_blocks > (header->file_size - header->index) / (int64_t)sizeof(int64_t))
+    {
+        munmap (map, st.st_size);
+        return NULL;
+    }
+
+    results = malloc (sizeof(melissa_results_t));
+    if (results == NULL)
+    {
+        munmap (map, st.st_size);
+        return NULL;
+    }
+    results->map     = map;
+    results->size    = st.st_size;
+    results->header  = header;
+    results->entries = (melissa_results_entry_t*)((char*)map + header->entries);
+    results->index   = (int64_t*)((char*)map + header->index);
+
+    // every statistic has the size of its type
+    for (i=0; i<header->nb_statistics; i++)
+    {
+        if ((results->entries[i].type != MELISSA_RESULTS_DOUBLE || results->entries[i].elem_size != sizeof(double)) &&
+            (results->entries[i].type != MELISSA_RESULTS_INT || results->entries[i].elem_size != sizeof(int32_t)))
+        {
+            melissa_results_close (results);
+            return NULL;
+        }
+    }
+    // every block must be in the file, aligned on its values
+    for (i=0; i<nb_blocks; i++)
+    {
+        elem_size = results->entries[i / header->nb_time_steps].elem_size;
+        if (results->index[i] < 0 || results->index[i] > header->file_size ||
+            results->index[i] % elem_size != 0 ||
+            header->vect_size > (header->file_size - results->index[i]) / elem_size)
+        {
+            melissa_results_close (results);
+            return NULL;
+        }
+    }
+    return results;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_results
+ *
+ * This function finds a statistic in a results container
+ *
+ *******************************************************************************
+ *
+ * @param[in] *results
+ * mapped container
+ *
+ * @param[in] *statistic
+ * name of the statistic (mean, variance, min_id, threshold<value>,
+ * quantile<value>, sobol<parameter>, sobol_tot<parameter>...)
+ *
+ * @return The number of the statistic in the container, -1 if absent
+ *
+ *******************************************************************************/
+
+int melissa_results_find (melissa_results_t *results,
+                          const char        *statistic)
+{
+    int i;
+
+    for (i=0; i<results->header->nb_statistics; i++)
+    {
+        if (strncmp (results->entries[i].name, statistic, sizeof(results->entries[i].name)) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_results
+ *
+ * This function returns the values of a statistic at a time step, in the
+ * mapping of the container
+ *
+ *******************************************************************************
+ *
+ * @param[in] *results
+ * mapped container
+ *
+ * @param[in] statistic
+ * number of the statistic (melissa_results_find)
+ *
+ * @param[in] time_step
+ * time step, from 0
+ *
+ * @return The header->vect_size values, of type entries[statistic].type, NULL
+ * if the statistic or the time step does not exist
+ *
+ *******************************************************************************/
+
+const void* melissa_results_block (melissa_results_t *results,
+                                   int                statistic,
+                                   int                time_step)
+{
+    if (statistic < 0 || statistic >= results->header->nb_statistics ||
+        time_step < 0 || time_step >= results->header->nb_time_steps)
+    {
+        return NULL;
+    }
+    return (char*)results->map + results->index[statistic * results->header->nb_time_steps + time_step];
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_results
+ *
+ * This function returns the values of a statistic of doubles at a time step
+ *
+ *******************************************************************************
+ *
+ * @param[in] *results
+ * mapped container
+ *
+ * @param[in] *statistic
+ * name of the statistic
+ *
+ * @param[in] time_step
+ * time step, from 0
+ *
+ * @return The header->vect_size values, NULL if the statistic does not exist
+ * or is not made of doubles
+ *
+ *******************************************************************************/
+
+const double* melissa_results_get_d (melissa_results_t *results,
+                                     const char        *statistic,
+                                     int                time_step)
+{
+    int i = melissa_results_find (results, statistic);
+
+    if (i < 0 || results->entries[i].type != MELISSA_RESULTS_DOUBLE)
+    {
+        return NULL;
+    }
+    return (const double*)melissa_results_block (results, i, time_step);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_results
+ *
+ * This function returns the values of a statistic of integers at a time step
+ *
+ *******************************************************************************
+ *
+ * @param[in] *results
+ * mapped container
+ *
+ * @param[in] *statistic
+ * name of the statistic
+ *
+ * @param[in] time_step
+ * time step, from 0
+ *
+ * @return The header->vect_size values, NULL if the statistic does not exist
+ * or is not made of integers
+ *
+ *******************************************************************************/
+
+const int32_t* melissa_results_get_i (melissa_results_t *results,
+                                      const char        *statistic,
+                                      int                time_step)
+{
+    int i = melissa_results_find (results, statistic);
+
+    if (i < 0 || results->entries[i].type != MELISSA_RESULTS_INT)
+    {
+        return NULL;
+    }
+    return (const int32_t*)melissa_results_block (results, i, time_step);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_results
+ *
+ * This function unmaps a results container. The values returned by the other
+ * functions are not valid anymore.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *results
+ * mapped container
+ *
+ *******************************************************************************/
+
+void melissa_results_close (melissa_results_t *results)
+{
+    munmap (results->map, results->size);
+    free (results);
+}
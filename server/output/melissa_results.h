@@ -0,0 +1,133 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file melissa_results.h
+ * @brief Columnar results container: one file per field.
+ * @author Terraz Théophile
+ * @date 2019-04-23
+ *
+ **/
+
+#ifndef MELISSA_RESULTS_H
+#define MELISSA_RESULTS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MELISSA_RESULTS_MAGIC   "MELRES\0\0" /**< first bytes of a results container      */
+#define MELISSA_RESULTS_VERSION 1            /**< version of the results container format */
+#define MELISSA_RESULTS_ALIGN   64           /**< alignment of the blocks (bytes)         */
+
+#define MELISSA_RESULTS_DOUBLE  0            /**< block of doubles                        */
+#define MELISSA_RESULTS_INT     1            /**< block of 32 bits integers               */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_results_header_s
+ *
+ * Header of a results container. It is followed by nb_statistics entries,
+ * then by the index: the offset of the block of each (statistic, time step),
+ * statistic after statistic. Each block holds the vect_size values of the
+ * field, and starts on a MELISSA_RESULTS_ALIGN bytes boundary.
+ *
+ *******************************************************************************/
+
+struct melissa_results_header_s
+{
+    char    magic[8];      /**< MELISSA_RESULTS_MAGIC                  */
+    int32_t version;       /**< MELISSA_RESULTS_VERSION                */
+    int32_t nb_time_steps; /**< number of time steps                   */
+    int32_t nb_statistics; /**< number of statistics                   */
+    int32_t reserved;      /**< unused, 0                              */
+    int64_t vect_size;     /**< number of values of the field          */
+    int64_t entries;       /**< offset of the entries (bytes)          */
+    int64_t index;         /**< offset of the index (bytes)            */
+    int64_t file_size;     /**< size of the container (bytes)          */
+    char    field[64];     /**< name of the field                      */
+};
+
+typedef struct melissa_results_header_s melissa_results_header_t; /**< type corresponding to melissa_results_header_s */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_results_entry_s
+ *
+ * Description of a statistic of a results container
+ *
+ *******************************************************************************/
+
+struct melissa_results_entry_s
+{
+    char    name[48];  /**< name of the statistic (mean, quantile0.5, sobol0...) */
+    int32_t type;      /**< MELISSA_RESULTS_DOUBLE or MELISSA_RESULTS_INT         */
+    int32_t elem_size; /**< size of a value (bytes)                               */
+    int64_t reserved;  /**< unused, 0                                             */
+};
+
+typedef struct melissa_results_entry_s melissa_results_entry_t; /**< type corresponding to melissa_results_entry_s */
+
+/**
+ *******************************************************************************
+ *
+ * @struct melissa_results_s
+ *
+ * Results container mapped in memory by melissa_results_open
+ *
+ *******************************************************************************/
+
+struct melissa_results_s
+{
+    void                     *map;     /**< mapping of the whole file */
+    size_t                    size;    /**< size of the mapping       */
+    melissa_results_header_t *header;  /**< header of the container   */
+    melissa_results_entry_t  *entries; /**< statistics                */
+    int64_t                  *index;   /**< offsets of the blocks     */
+};
+
+typedef struct melissa_results_s melissa_results_t; /**< type corresponding to melissa_results_s */
+
+melissa_results_t* melissa_results_open (const char *file_name);
+
+int melissa_results_find (melissa_results_t *results,
+                          const char        *statistic);
+
+const void* melissa_results_block (melissa_results_t *results,
+                                   int                statistic,
+                                   int                time_step);
+
+const double* melissa_results_get_d (melissa_results_t *results,
+                                     const char        *statistic,
+                                     int                time_step);
+
+const int32_t* melissa_results_get_i (melissa_results_t *results,
+                                      const char        *statistic,
+                                      int                time_step);
+
+void melissa_results_close (melissa_results_t *results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELISSA_RESULTS_H
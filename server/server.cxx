@@ -45,6 +45,7 @@ extern "C" {
 #include "fault_tolerance.h"
 #include "melissa_messages.h"
 #include "melissa_output.h"
+#include "melissa_ingest.h"
 }
 
 static volatile int end_signal = 0;
@@ -89,6 +90,7 @@ void melissa_server_init (int argc, char **argv, void **server_handle)
     server_ptr->fields = NULL;
     server_ptr->nb_bufferized_messages = 32;
     server_ptr->nb_converged_fields = 0;
+    server_ptr->converged_sent = 0;
     server_ptr->start_time = 0;
     server_ptr->total_comm_time = 0;
     server_ptr->start_comm_time = 0;
@@ -102,15 +104,27 @@ void melissa_server_init (int argc, char **argv, void **server_handle)
     server_ptr->total_save_time = 0;
     server_ptr->start_save_time = 0;
     server_ptr->end_save_time = 0;
+    server_ptr->total_stall_time = 0;
     server_ptr->total_read_time = 0;
     server_ptr->start_read_time = 0;
     server_ptr->end_read_time = 0;
     server_ptr->total_write_time = 0;
+    server_ptr->total_stream_time = 0;
     server_ptr->total_mbytes_recv = 0;
     server_ptr->last_timeout_check = 0;
     server_ptr->nb_finished_simulations = 0;
     server_ptr->last_checkpoint_time = 0.0;
     server_ptr->timeout_launcher = 250;
+    server_ptr->ingest = NULL;
+    server_ptr->checkpoint = NULL;
+    server_ptr->stream = NULL;
+    server_ptr->wire_buffer = NULL;
+    server_ptr->wire_buffer_size = 0;
+    server_ptr->resident_bytes = 0;
+    server_ptr->spill_step = 0;
+    server_ptr->spill_ticket_end = 0;
+    server_ptr->spill_tickets = NULL;
+    zmq_msg_init (&server_ptr->learning_msg);
 
     // === init ZMQ context === //
 
@@ -152,6 +166,11 @@ void melissa_server_init (int argc, char **argv, void **server_handle)
     // === Read options from command line === //
 
     melissa_get_options (argc, argv, &server_ptr->melissa_options);
+    melissa_wire_init (&server_ptr->wire,
+                       server_ptr->melissa_options.wire_format,
+                       server_ptr->melissa_options.wire_codec,
+                       server_ptr->melissa_options.wire_tolerance);
+    server_ptr->next_spill_check = (size_t)server_ptr->melissa_options.memory_budget * 1024 * 1024;
 
     // === Install signal handler === //
 
@@ -310,11 +329,187 @@ void melissa_server_init (int argc, char **argv, void **server_handle)
             melissa_print (VERBOSE_INFO, "Reading simulation states at checkpoint time ok \n");
         }
     }
+
+    // === Start the receiver and compute threads === //
+
+    if (server_ptr->melissa_options.nb_ingest_threads > 0)
+    {
+        server_ptr->ingest = melissa_ingest_start (&server_ptr->melissa_options,
+                                                   server_ptr->data_puller,
+                                                   server_ptr->melissa_options.nb_ingest_threads);
+        server_ptr->spill_tickets = (long int*)melissa_malloc (server_ptr->ingest->nb_workers * sizeof(long int));
+    }
+
+    // === Start the checkpoint I/O thread === //
+
+    if (server_ptr->melissa_options.async_checkpoint != 0)
+    {
+        server_ptr->checkpoint = melissa_checkpoint_start ();
+    }
+#ifdef BUILD_WITH_MPI
+    server_ptr->checkpoint_request = MPI_REQUEST_NULL;
+    if (server_ptr->melissa_options.mpi_io_checkpoint != 0)
+    {
+        // the shared checkpoints have their own collectives
+        MPI_Comm_dup (server_ptr->comm_data.comm, &server_ptr->checkpoint_comm);
+    }
+#endif // BUILD_WITH_MPI
 }
 
-void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
+#ifdef BUILD_WITH_MPI
+// The shared checkpoints are collective, but the ranks are not synchronized:
+// each rank votes when its checkpoint interval expires, with a non blocking
+// reduction, and the checkpoint is written once every rank voted. A finishing
+// rank votes 1 and waits: it still takes part in the checkpoints of the other
+// ranks until they all finish.
+// The messages of a simulation time step reach the server ranks at different
+// times, so the ranks then check that they received the same time steps. If
+// not, the checkpoint is postponed and the ranks vote again, at most until
+// the checkpoint is one interval late: a checkpoint that is not a consistent
+// cut can not be read on another number of server ranks.
+// Returns 1 when the checkpoint can be written.
+static int shared_checkpoint_ready (melissa_server_t *server_ptr,
+                                    int               final)
+{
+    int flag, i;
+
+    if (server_ptr->checkpoint_request == MPI_REQUEST_NULL)
+    {
+        server_ptr->checkpoint_vote[0] = final;
+        server_ptr->checkpoint_vote[1] = (final != 0 ||
+            server_ptr->last_checkpoint_time + 2 * server_ptr->melissa_options.check_interval > melissa_get_time());
+        MPI_Iallreduce (server_ptr->checkpoint_vote, server_ptr->checkpoint_all, 2, MPI_INT,
+                        MPI_MIN, server_ptr->checkpoint_comm, &server_ptr->checkpoint_request);
+    }
+    if (final != 0)
+    {
+        MPI_Wait (&server_ptr->checkpoint_request, MPI_STATUS_IGNORE);
+        flag = 1;
+    }
+    else
+    {
+        MPI_Test (&server_ptr->checkpoint_request, &flag, MPI_STATUS_IGNORE);
+    }
+    if (flag == 0)
+    {
+        return 0;
+    }
+    server_ptr->checkpoint_consistent = 1;
+    for (i=0; i<server_ptr->melissa_options.nb_fields; i++)
+    {
+        if (shared_steps_consistent (server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->checkpoint_comm) == 0)
+        {
+            server_ptr->checkpoint_consistent = 0;
+        }
+    }
+    // the same decision on every rank
+    if (server_ptr->checkpoint_consistent == 0 &&
+        server_ptr->checkpoint_all[0] == 0 && server_ptr->checkpoint_all[1] != 0)
+    {
+        melissa_print (VERBOSE_DEBUG, "Shared checkpoint postponed, the server ranks did not receive the same time steps (proc %d)\n", server_ptr->comm_data.rank);
+        return 0;
+    }
+    return 1;
+}
+#endif // BUILD_WITH_MPI
+
+// waits for the background checkpoint. If it could not be written, the next
+// checkpoint of every client rank is a full one: the time steps of a lost delta
+// record are no longer dirty.
+static void wait_checkpoint (melissa_server_t *server_ptr)
+{
+    int i, j;
+
+    if (melissa_checkpoint_wait (server_ptr->checkpoint, &server_ptr->total_save_time) == 0)
+    {
+        return;
+    }
+    melissa_print (VERBOSE_WARNING, "Checkpoint not written, the next one is a full checkpoint (proc %d)\n", server_ptr->comm_data.rank);
+    for (i=0; i<server_ptr->melissa_options.nb_fields; i++)
+    {
+        for (j=0; j<server_ptr->comm_data.client_comm_size && server_ptr->fields[i].stats_data != NULL; j++)
+        {
+            server_ptr->fields[i].stats_data[j].checkpoint_base_size = 0;
+        }
+    }
+}
+
+// checkpoint of the statistics at the end of the study or on interruption
+static void save_final_stats (melissa_server_t *server_ptr)
+{
+    int i;
+
+#ifdef BUILD_WITH_MPI
+    if (server_ptr->melissa_options.mpi_io_checkpoint != 0)
+    {
+        do
+        {
+            if (shared_checkpoint_ready (server_ptr, 1) == 0)
+            {
+                continue;
+            }
+            for (i=0; i<server_ptr->melissa_options.nb_fields; i++)
+            {
+                save_stats_shared (server_ptr->fields[i].stats_data, &server_ptr->comm_data,
+                                   server_ptr->fields[i].name, server_ptr->checkpoint_comm,
+                                   server_ptr->checkpoint_consistent);
+            }
+        } while (server_ptr->checkpoint_all[0] == 0);
+        return;
+    }
+#endif // BUILD_WITH_MPI
+    for (i=0; i<server_ptr->melissa_options.nb_fields; i++)
+    {
+        save_stats (server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->fields[i].name);
+    }
+}
+
+// points buff_tab_ptr on the nb_vect vectors of a data message. Vectors sent
+// as float or bfloat16, or compressed, are first decoded in a scratch buffer
+// of the server, as the statistics are computed in double.
+// returns -1 if the payload can not be decoded
+static int wire_vectors (melissa_server_t *server_ptr,
+                         char             *buf_ptr,
+                         size_t            payload_size,
+                         int               nb_vect,
+                         int               vect_size)
+{
+    int    i;
+    size_t size = (size_t)nb_vect * vect_size;
+
+    if (server_ptr->wire.format == MELISSA_WIRE_DOUBLE &&
+        server_ptr->wire.codec == MELISSA_WIRE_NO_CODEC)
+    {
+        if (payload_size < size * sizeof(double))
+        {
+            return -1;
+        }
+        for (i=0; i<nb_vect; i++)
+        {
+            server_ptr->buff_tab_ptr[i] = (double*)buf_ptr;
+            buf_ptr += vect_size * sizeof(double);
+        }
+        return 0;
+    }
+    if (server_ptr->wire_buffer_size < size)
+    {
+        melissa_free (server_ptr->wire_buffer);
+        server_ptr->wire_buffer = (double*)melissa_malloc (size * sizeof(double));
+        server_ptr->wire_buffer_size = size;
+    }
+    for (i=0; i<nb_vect; i++)
+    {
+        server_ptr->buff_tab_ptr[i] = &server_ptr->wire_buffer[(size_t)i * vect_size];
+    }
+    return melissa_wire_unpack (buf_ptr, payload_size, nb_vect, vect_size, &server_ptr->wire, server_ptr->wire_buffer);
+}
+
+// code where the data for one time step from one simulation and one field arrives
+// returns 1 if the message brought new data, 0 otherwise
+static int process_data_message (melissa_server_t  *server_ptr,
+                                 simulation_data_t *simu_data,
+                                 zmq_msg_t         *msg)
 {
-    melissa_server_t     *server_ptr;
     int                   i;
     int                   field_id;
     int                   old_simu_state;
@@ -322,15 +517,354 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
     int                   old_last_time_step_state;
 #endif // CHECK_SIMU_DECONNECTION
     int                   recv_vect_size = 0;
+    int                   nb_vect = 1;
+    size_t                payload_size;
     int                   client_rank;
     int                   new_data = 0;
     char                 *buf_ptr;
     char                  txt_buffer[MPI_MAX_PROCESSOR_NAME];
-    zmq_msg_t             msg;
     int                   wait_launcher_msg = 0;
     melissa_simulation_t *simu_ptr = NULL;
     char                 *field_name_ptr = NULL;
     melissa_data_t       *data_ptr = NULL;
+    double                interval;
+
+    server_ptr->start_comm_time = melissa_get_time();
+
+    read_message_simu_data ((char*)zmq_msg_data (msg),
+                            &simu_data->time_stamp,
+                            &simu_data->simu_id,
+                            &client_rank,
+                            &recv_vect_size,
+                            &field_name_ptr,
+                            (double**)&buf_ptr);
+
+    simu_data->val_size = recv_vect_size;
+    new_data = 1;
+
+    melissa_print (VERBOSE_DEBUG, "Server rank %d recieved timestep %d from rank %d of group %d (vect_size: %d, field: %s)\n", server_ptr->comm_data.rank,
+                                                                                                                   simu_data->time_stamp,
+                                                                                                                   client_rank,
+                                                                                                                   simu_data->simu_id,
+                                                                                                                   recv_vect_size,
+                                                                                                                   field_name_ptr);
+
+    if (simu_data->time_stamp >= server_ptr->melissa_options.nb_time_steps || simu_data->time_stamp < 0)
+    {
+        melissa_print (VERBOSE_WARNING, "Bad time stamp (field %s)\n", field_name_ptr);
+        return 0;
+    }
+
+    field_id = get_field_id(server_ptr->fields, server_ptr->melissa_options.nb_fields, field_name_ptr);
+    if (field_id == -1)
+    {
+        if (simu_data->time_stamp == 0 && client_rank == 0)
+        {
+            melissa_print (VERBOSE_WARNING, "Not computing field %s\n", field_name_ptr);
+        }
+        return 0;
+    }
+    if (server_ptr->first_send[field_id*server_ptr->comm_data.client_comm_size+client_rank] == 0)
+    {
+        server_ptr->local_nb_messages += 1;
+        server_ptr->first_send[field_id*server_ptr->comm_data.client_comm_size+client_rank] = 1;
+    }
+    if (simu_data->simu_id > server_ptr->simulations.size)
+    {
+        for (i=server_ptr->simulations.size; i<simu_data->simu_id; i++)
+        {
+            vector_add (&server_ptr->simulations, add_simulation());
+        }
+        if (server_ptr->melissa_options.sampling_size < server_ptr->simulations.size)
+        {
+            server_ptr->melissa_options.sampling_size = server_ptr->simulations.size;
+        }
+    }
+
+    data_ptr = server_ptr->fields[field_id].stats_data;
+    if (data_ptr[client_rank].stats_init != 1 && recv_vect_size > 0)
+    {
+        melissa_init_data (&data_ptr[client_rank], &server_ptr->melissa_options, recv_vect_size);
+        server_ptr->last_checkpoint_time = melissa_get_time();
+        if (server_ptr->melissa_options.restart > 0)
+        {
+            server_ptr->start_read_time = melissa_get_time();
+            if (server_ptr->comm_data.rank == 0)
+            {
+                melissa_print (VERBOSE_INFO, "reading checkpoint files...\n");
+            }
+            read_saved_stats (data_ptr, &server_ptr->comm_data, field_name_ptr, client_rank);
+            // the message counters of the simulations, from the restored bits
+            for (i=0; i<data_ptr[client_rank].step_simu.nb_rows && i<server_ptr->simulations.size; i++)
+            {
+                simu_ptr = (melissa_simulation_t*)server_ptr->simulations.items[i];
+                simu_ptr->nb_received += bitmap_count_row (&data_ptr[client_rank].step_simu, i);
+                simu_ptr->nb_last_received += bitmap_test (&data_ptr[client_rank].step_simu, i,
+                                                           server_ptr->melissa_options.nb_time_steps - 1);
+            }
+            for (i=0; i<server_ptr->melissa_options.nb_time_steps; i++)
+            {
+                server_ptr->resident_bytes += melissa_touch_step (&data_ptr[client_rank], i);
+            }
+            restore_sobol_convergence (&data_ptr[client_rank]);
+            if (server_ptr->comm_data.rank == 0)
+            {
+                melissa_print (VERBOSE_INFO, "reading checkpoint files ok\n");
+            }
+            server_ptr->last_checkpoint_time = melissa_get_time();
+            server_ptr->end_read_time = melissa_get_time();
+            server_ptr->total_read_time += server_ptr->end_read_time - server_ptr->start_read_time;
+            simu_data->status = 3;
+        }
+    }
+    else if (data_ptr[client_rank].steps_init != 1)
+    {
+        melissa_init_data (&data_ptr[client_rank], &server_ptr->melissa_options, recv_vect_size);
+        server_ptr->last_checkpoint_time = melissa_get_time();
+    }
+    simu_ptr = (melissa_simulation_t*)server_ptr->simulations.items[simu_data->simu_id];
+
+    if (simu_ptr->parameters == NULL && recv_vect_size > 0)
+    {
+        // ask launcher for the simulation informations
+        sprintf (txt_buffer, "simu_info %d", simu_data->simu_id);
+        zmq_send(server_ptr->text_requester, txt_buffer, strlen(txt_buffer), 0);
+        sprintf (txt_buffer, "wait response...\n");
+        wait_launcher_msg = 1;
+    }
+
+    simu_ptr->last_message = melissa_get_time();
+    if (recv_vect_size > 0 && server_ptr->melissa_options.learning > 0)
+    {
+        // No copy of the payload: the learning side gets a reference on the
+        // message, released when the next one arrives. val is only valid
+        // until the next call to melissa_server_run.
+        zmq_msg_copy (&server_ptr->learning_msg, msg);
+        simu_data->val = (double*)((char*)zmq_msg_data (&server_ptr->learning_msg) + (buf_ptr - (char*)zmq_msg_data (msg)));
+    }
+    server_ptr->total_mbytes_recv += zmq_msg_size (msg);
+    server_ptr->start_computation_time = melissa_get_time();
+
+    if (bitmap_test (&data_ptr[client_rank].step_simu, simu_data->simu_id, simu_data->time_stamp) != 0)
+    {
+        // Time step already computed, message ignored.
+        melissa_print (VERBOSE_WARNING,  "Allready computed time step (simulation %d, time step %d)\n", simu_data->simu_id, simu_data->time_stamp);
+        new_data = 0;
+    }
+
+    if (new_data == 1 && recv_vect_size > 0)
+    {
+        // a message that can not be decoded is not counted: the simulation
+        // has to send it again
+        payload_size = zmq_msg_size (msg) - (buf_ptr - (char*)zmq_msg_data (msg));
+        nb_vect = (server_ptr->melissa_options.sobol_op == 1) ? server_ptr->melissa_options.nb_parameters+2 : 1;
+        if ((server_ptr->ingest != NULL &&
+             melissa_wire_check (buf_ptr, payload_size, nb_vect, recv_vect_size, &server_ptr->wire) != 0) ||
+            (server_ptr->ingest == NULL &&
+             wire_vectors (server_ptr, buf_ptr, payload_size, nb_vect, recv_vect_size) != 0))
+        {
+            melissa_print (VERBOSE_ERROR, "Corrupted data (simulation %d, time step %d), message ignored\n", simu_data->simu_id, simu_data->time_stamp);
+            new_data = 0;
+        }
+    }
+
+    if (new_data == 1)
+    {
+        if (recv_vect_size > 0)
+        {
+            server_ptr->resident_bytes += melissa_touch_step (&data_ptr[client_rank], simu_data->time_stamp);
+            if (server_ptr->ingest != NULL)
+            {
+                // === Hand the message to the compute worker owning its key === //
+                // msg, buf_ptr and field_name_ptr must not be used afterwards
+                melissa_ingest_dispatch (server_ptr->ingest,
+                                         msg,
+                                         &data_ptr[client_rank],
+                                         field_id,
+                                         client_rank,
+                                         simu_data->time_stamp,
+                                         simu_data->simu_id,
+                                         nb_vect,
+                                         (double*)buf_ptr);
+                if (server_ptr->melissa_options.sobol_op == 1 &&
+                    server_ptr->comm_data.rank == 0 &&
+                    simu_data->time_stamp == server_ptr->melissa_options.nb_time_steps -1)
+                {
+                    // the worker may not be done yet, the interval can lag a few messages
+                    __atomic_load (&data_ptr[client_rank].sobol_interval, &interval, __ATOMIC_RELAXED);
+                    send_message_confidence_interval("Sobol",
+                                                     server_ptr->fields[field_id].name,
+                                                     interval,
+                                                     server_ptr->text_pusher,
+                                                     0);
+                }
+            }
+            else if (server_ptr->melissa_options.sobol_op != 1)
+            {
+                // === Compute classical statistics === //
+                compute_stats (&data_ptr[client_rank],
+                               simu_data->time_stamp,
+                               simu_data->simu_id,
+                               1,
+                               server_ptr->buff_tab_ptr);
+            }
+            else
+            {
+                // === Compute classical statistics + Sobol indices === //
+                compute_stats (&data_ptr[client_rank],
+                               simu_data->time_stamp,
+                               simu_data->simu_id,
+                               server_ptr->melissa_options.nb_parameters+2,
+                               server_ptr->buff_tab_ptr);
+//                        confidence_sobol_martinez (&(data_ptr[client_rank].sobol_indices[simu_data->time_stamp]),
+//                                server_ptr->melissa_options.nb_parameters,
+//                                data_ptr[client_rank].vect_size);
+
+                if (server_ptr->comm_data.rank == 0 &&
+                        simu_data->time_stamp == server_ptr->melissa_options.nb_time_steps -1)
+                {
+                    // REM: atm only showing for last timestep on 0 rank
+//                            log_confidence_sobol_martinez(&(data_ptr[client_rank].sobol_indices[simu_data->time_stamp]),
+//                                    server_ptr->melissa_options.nb_parameters);
+
+                    send_message_confidence_interval("Sobol",
+                                                     field_name_ptr,
+                                                     data_ptr[client_rank].sobol_interval,
+                                                     server_ptr->text_pusher,
+                                                     0);
+
+                }
+            }
+        }
+        bitmap_set (&data_ptr[client_rank].step_simu, simu_data->simu_id, simu_data->time_stamp);
+        if (data_ptr[client_rank].stats_init == 1)
+        {
+            // the next checkpoint only saves the modified time steps
+            set_bit (data_ptr[client_rank].step_dirty, simu_data->time_stamp);
+        }
+        data_ptr[client_rank].step_received[simu_data->time_stamp] += 1;
+        if (server_ptr->stream != NULL)
+        {
+            melissa_stream_check (server_ptr->stream, field_id, simu_data->time_stamp);
+        }
+        simu_ptr->nb_received += 1;
+        if (simu_data->time_stamp == server_ptr->melissa_options.nb_time_steps - 1)
+        {
+            simu_ptr->nb_last_received += 1;
+        }
+        if (server_ptr->melissa_options.memory_budget > 0 &&
+            server_ptr->resident_bytes > server_ptr->next_spill_check)
+        {
+            spill_finished_steps (server_ptr);
+        }
+    }
+    server_ptr->end_computation_time = melissa_get_time();
+    server_ptr->total_computation_time += server_ptr->end_computation_time - server_ptr->start_computation_time;
+
+    if (wait_launcher_msg == 1)
+    {
+        wait_launcher_msg = 0;
+        zmq_msg_t msg2;
+//                    char text[melissa_get_message_len()];
+        printf (" Waiting launcher message\n");
+        zmq_msg_init (&msg2);
+        zmq_msg_recv (&msg2, server_ptr->text_requester, 0);
+        server_ptr->last_msg_launcher = melissa_get_time();
+        process_launcher_message(zmq_msg_data (&msg2), server_ptr);
+        zmq_msg_close (&msg2);
+//                    zmq_recv (server_ptr->text_requester, text, melissa_get_message_len()-1, 0);
+//                    server_ptr->last_msg_launcher = melissa_get_time();
+//                    process_launcher_message(text, server_ptr);
+    }
+    if (simu_ptr->parameters != NULL && recv_vect_size > 0)
+    {
+        memcpy(simu_data->parameters, simu_ptr->parameters, sizeof(double)*server_ptr->melissa_options.nb_parameters);
+    }
+
+
+    // check the simulation progress //
+    old_simu_state = simu_ptr->status;
+    simu_ptr->status = check_simu_state(simu_ptr, server_ptr->local_nb_messages, server_ptr->melissa_options.nb_time_steps);
+    simu_ptr->job_status = 1;
+    melissa_print(VERBOSE_DEBUG, "Group %d, rank %d, status %d\n", simu_data->simu_id, server_ptr->comm_data.rank, simu_ptr->status);
+
+#ifdef CHECK_SIMU_DECONNECTION
+    // check if we recieved all the last timestep messages //
+    if (simu_data->time_stamp == server_ptr->melissa_options.nb_time_steps-1)
+    {
+        old_last_time_step_state = simu_ptr->last_time_step;
+        simu_ptr->last_time_step = check_last_timestep(simu_ptr, server_ptr->local_nb_messages);
+        melissa_print(VERBOSE_DEBUG, "Group %d, rank %d, last timestep status: %d\n", simu_data->simu_id, server_ptr->comm_data.rank, simu_ptr->status);
+    }
+#endif // CHECK_SIMU_DECONNECTION
+
+    if (simu_ptr->status == 2 && old_simu_state != 2)
+    {
+#ifdef CHECK_SIMU_DECONNECTION
+        if (server_ptr->comm_data.rank != 0)
+        {
+            server_ptr->nb_finished_simulations += 1;
+        }
+#else // CHECK_SIMU_DECONNECTION
+        server_ptr->nb_finished_simulations += 1;
+#endif // CHECK_SIMU_DECONNECTION
+    }
+
+    // === Send a message to the Python master in case of simulation status update === //  TODO: can't we put all this stuff into functions?  technical debt?
+#ifdef CHECK_SIMU_DECONNECTION
+    if (old_simu_state != simu_ptr->status && server_ptr->comm_data.rank == 0 && simu_ptr->status == 1)
+#else // CHECK_SIMU_DECONNECTION
+    if (old_simu_state != simu_ptr->status && server_ptr->comm_data.rank == 0)
+#endif // CHECK_SIMU_DECONNECTION
+    {
+        send_message_simu_status(simu_data->simu_id, simu_ptr->status, server_ptr->text_pusher, 0);
+        if (simu_ptr->status == 2)
+        {
+            melissa_print(VERBOSE_INFO, "Simulation %d finished\n", simu_data->simu_id);
+            melissa_print(VERBOSE_INFO, "Finished simulations: %d/%d\n", server_ptr->nb_finished_simulations, server_ptr->simulations.size);
+        }
+    }
+
+#ifdef CHECK_SIMU_DECONNECTION
+    // === Send a message to the Python master in case of last timestep status update === //
+    if (old_last_time_step_state != simu_ptr->last_time_step && server_ptr->comm_data.rank == 0 && simu_ptr->last_time_step == 1)
+    {
+        sprintf (txt_buffer, "timestep_state %d %d", simu_data->simu_id, simu_ptr->last_time_step);
+        melissa_print(VERBOSE_DEBUG, "Send \"%s\" to launcher\n", txt_buffer);
+        zmq_send(server_ptr->text_pusher, txt_buffer, strlen(txt_buffer), 0);
+    }
+#endif // CHECK_SIMU_DECONNECTION
+
+    if (server_ptr->melissa_options.sobol_op != 1)
+    {
+        server_ptr->buff_tab_ptr[0] = NULL;
+    }
+    else
+    {
+        for (i=0; i<server_ptr->melissa_options.nb_parameters+2; i++)
+        {
+            server_ptr->buff_tab_ptr[i] = NULL;
+        }
+    }
+    buf_ptr = NULL;
+
+    return new_data;
+}
+
+void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
+{
+    melissa_server_t     *server_ptr;
+    int                   i;
+    int                   new_data = 0;
+    int                   nb_items;
+    int                   data_item;
+    double                interval;
+    char                 *buf_ptr;
+    char                  txt_buffer[MPI_MAX_PROCESSOR_NAME];
+    zmq_msg_t             msg;
+#ifdef CHECK_SIMU_DECONNECTION
+    melissa_simulation_t *simu_ptr = NULL;
+#endif // CHECK_SIMU_DECONNECTION
 
     server_ptr = (melissa_server_t*)*server_handle;
 
@@ -383,12 +917,43 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
             }
         }
 
-        if (server_ptr->last_checkpoint_time + server_ptr->melissa_options.check_interval < melissa_get_time() && server_ptr->last_checkpoint_time > 0.1)
+        if (server_ptr->last_checkpoint_time + server_ptr->melissa_options.check_interval < melissa_get_time() && server_ptr->last_checkpoint_time > 0.1
+#ifdef BUILD_WITH_MPI
+            && (server_ptr->melissa_options.mpi_io_checkpoint == 0 || shared_checkpoint_ready (server_ptr, 0) != 0)
+#endif // BUILD_WITH_MPI
+           )
         {
+            double checkpoint_wait_time = 0.0;
             server_ptr->start_save_time = melissa_get_time();
+            if (server_ptr->ingest != NULL)
+            {
+                melissa_ingest_drain (server_ptr->ingest);
+            }
+            if (server_ptr->checkpoint != NULL)
+            {
+                // the previous checkpoint must be on disc before we reuse its buffers
+                checkpoint_wait_time = melissa_get_time();
+                wait_checkpoint (server_ptr);
+                checkpoint_wait_time = melissa_get_time() - checkpoint_wait_time;
+            }
             for (i=0; i<server_ptr->melissa_options.nb_fields; i++)
             {
-                save_stats(server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->fields[i].name);
+#ifdef BUILD_WITH_MPI
+                if (server_ptr->melissa_options.mpi_io_checkpoint != 0)
+                {
+                    save_stats_shared (server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->fields[i].name, server_ptr->checkpoint_comm,
+                                       server_ptr->checkpoint_consistent);
+                }
+                else
+#endif // BUILD_WITH_MPI
+                if (server_ptr->checkpoint != NULL)
+                {
+                    save_stats_async (server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->fields[i].name, server_ptr->checkpoint);
+                }
+                else
+                {
+                    save_stats (server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->fields[i].name);
+                }
                 if (server_ptr->comm_data.rank == 0)
                 {
                     char dir[256];
@@ -396,11 +961,25 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
                     melissa_print(VERBOSE_DEBUG, "Statistic field %s saved in %s\n", server_ptr->fields[i].name, dir);
                 }
             }
-            save_simu_states (&server_ptr->simulations, &server_ptr->comm_data);
+            if (server_ptr->checkpoint != NULL)
+            {
+                save_simu_states_async (&server_ptr->simulations, &server_ptr->comm_data, server_ptr->checkpoint);
+                melissa_checkpoint_submit (server_ptr->checkpoint);
+            }
+            else
+            {
+                save_simu_states (&server_ptr->simulations, &server_ptr->comm_data);
+            }
             server_ptr->last_checkpoint_time = melissa_get_time();
             server_ptr->end_save_time = melissa_get_time();
             melissa_print(VERBOSE_DEBUG, "Chekpoint time: %g (proc %d)\n", server_ptr->end_save_time - server_ptr->start_save_time, server_ptr->comm_data.rank);
-            server_ptr->total_save_time += server_ptr->end_save_time - server_ptr->start_save_time;
+            if (server_ptr->checkpoint == NULL || server_ptr->melissa_options.mpi_io_checkpoint != 0)
+            {
+                // the statistics were written by this thread. The time blocked
+                // on the I/O thread is already counted in its writing time.
+                server_ptr->total_save_time += server_ptr->end_save_time - server_ptr->start_save_time - checkpoint_wait_time;
+            }
+            server_ptr->total_stall_time += server_ptr->end_save_time - server_ptr->start_save_time;
             simu_data->status = 2;
             if (server_ptr->melissa_options.learning > 0)
             {
@@ -414,16 +993,22 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
         zmq_pollitem_t items [] = {
             { server_ptr->text_puller, 0, ZMQ_POLLIN, 0 },
             { server_ptr->connexion_responder, 0, ZMQ_POLLIN, 0 },
-            { server_ptr->data_puller, 0, ZMQ_POLLIN, 0 }
 #ifdef CHECK_SIMU_DECONNECTION
-            ,{ server_ptr->deconnexion_responder, 0, ZMQ_POLLIN, 0 }
+            { server_ptr->deconnexion_responder, 0, ZMQ_POLLIN, 0 },
 #endif // CHECK_SIMU_DECONNECTION
+            { server_ptr->data_puller, 0, ZMQ_POLLIN, 0 }
         };
-#ifdef CHECK_SIMU_DECONNECTION
-        zmq_poll (items, 4, 100);
-#else // CHECK_SIMU_DECONNECTION
-        zmq_poll (items, 3, 100);
-#endif // CHECK_SIMU_DECONNECTION
+        nb_items = sizeof(items) / sizeof(zmq_pollitem_t);
+        data_item = nb_items - 1;
+        if (server_ptr->ingest == NULL)
+        {
+            zmq_poll (items, nb_items, 100);
+        }
+        else
+        {
+            // the data socket belongs to the receiver thread
+            zmq_poll (items, nb_items - 1, 1);
+        }
         server_ptr->end_wait_time = melissa_get_time();
         server_ptr->total_wait_time += server_ptr->end_wait_time - server_ptr->start_wait_time;
 
@@ -461,7 +1046,7 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
                 zmq_msg_recv (&msg, server_ptr->connexion_responder, 0);
                 memcpy(server_ptr->rinit_tab, zmq_msg_data (&msg), 2 * sizeof(int));
                 zmq_msg_close (&msg);
-                zmq_msg_init_size (&msg, 5 * sizeof(int) + server_ptr->comm_data.comm_size * MPI_MAX_PROCESSOR_NAME * sizeof(char));
+                zmq_msg_init_size (&msg, 7 * sizeof(int) + sizeof(double) + server_ptr->comm_data.comm_size * MPI_MAX_PROCESSOR_NAME * sizeof(char));
                 buf_ptr = (char*)zmq_msg_data (&msg);
                 memcpy (buf_ptr, &server_ptr->comm_data.comm_size, sizeof(int));
                 buf_ptr += sizeof(int);
@@ -473,6 +1058,12 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
                 buf_ptr += sizeof(int);
                 memcpy (buf_ptr, &server_ptr->melissa_options.verbose_lvl, sizeof(int));
                 buf_ptr += sizeof(int);
+                memcpy (buf_ptr, &server_ptr->melissa_options.wire_format, sizeof(int));
+                buf_ptr += sizeof(int);
+                memcpy (buf_ptr, &server_ptr->melissa_options.wire_codec, sizeof(int));
+                buf_ptr += sizeof(int);
+                memcpy (buf_ptr, &server_ptr->melissa_options.wire_tolerance, sizeof(double));
+                buf_ptr += sizeof(double);
                 memcpy (buf_ptr, server_ptr->port_names, server_ptr->comm_data.comm_size * MPI_MAX_PROCESSOR_NAME * sizeof(char));
                 zmq_msg_send (&msg, server_ptr->connexion_responder, 0);
                 if (server_ptr->first_init == 2)
@@ -513,6 +1104,13 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
             add_fields(server_ptr->fields,
                        server_ptr->comm_data.client_comm_size,
                        server_ptr->melissa_options.nb_fields);
+            if (server_ptr->melissa_options.stream_output != 0)
+            {
+                server_ptr->stream = melissa_stream_start (server_ptr->fields,
+                                                           &server_ptr->melissa_options,
+                                                           &server_ptr->comm_data,
+                                                           server_ptr->ingest);
+            }
 
             server_ptr->first_init = 0;
             simu_data->first_init = 1;
@@ -525,282 +1123,41 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
         }
 
         // === Data reception and statistics computation === //
-        // code where the data for one time step from one simulation and one field arrives
-        if (items[2].revents & ZMQ_POLLIN)
-        {
-            server_ptr->start_comm_time = melissa_get_time();
-            zmq_msg_init (&msg);
-            zmq_msg_recv (&msg, server_ptr->data_puller, 0);
-
-            read_message_simu_data ((char*)zmq_msg_data (&msg),
-                                    &simu_data->time_stamp,
-                                    &simu_data->simu_id,
-                                    &client_rank,
-                                    &recv_vect_size,
-                                    &field_name_ptr,
-                                    (double**)&buf_ptr);
-
-            if (recv_vect_size > simu_data->max_val_size && recv_vect_size > 0)
-            {
-                melissa_print (VERBOSE_DEBUG, "realloc, new size: %d\n", recv_vect_size);
-                simu_data->val = (double*)melissa_realloc(simu_data->val, recv_vect_size*sizeof(double));
-                simu_data->max_val_size = recv_vect_size;
-            }
-            simu_data->val_size = recv_vect_size;
-            new_data = 1;
-
-            melissa_print (VERBOSE_DEBUG, "Server rank %d recieved timestep %d from rank %d of group %d (vect_size: %d, field: %s)\n", server_ptr->comm_data.rank,
-                                                                                                                           simu_data->time_stamp,
-                                                                                                                           client_rank,
-                                                                                                                           simu_data->simu_id,
-                                                                                                                           recv_vect_size,
-                                                                                                                           field_name_ptr);
-
-            if (simu_data->time_stamp >= server_ptr->melissa_options.nb_time_steps || simu_data->time_stamp < 0)
-            {
-                melissa_print (VERBOSE_WARNING, "Bad time stamp (field %s)\n", field_name_ptr);
-                continue;
-            }
-
-            field_id = get_field_id(server_ptr->fields, server_ptr->melissa_options.nb_fields, field_name_ptr);
-            if (field_id == -1)
-            {
-                if (simu_data->time_stamp == 0 && client_rank == 0)
-                {
-                    melissa_print (VERBOSE_WARNING, "Not computing field %s\n", field_name_ptr);
-                }
-                continue;
-            }
-            if (server_ptr->first_send[field_id*server_ptr->comm_data.client_comm_size+client_rank] == 0)
-            {
-                server_ptr->local_nb_messages += 1;
-                server_ptr->first_send[field_id*server_ptr->comm_data.client_comm_size+client_rank] = 1;
-            }
-            if (simu_data->simu_id > server_ptr->simulations.size)
-            {
-                for (i=server_ptr->simulations.size; i<simu_data->simu_id; i++)
-                {
-                    vector_add (&server_ptr->simulations, add_simulation());
-                }
-                if (server_ptr->melissa_options.sampling_size < server_ptr->simulations.size)
-                {
-                    server_ptr->melissa_options.sampling_size = server_ptr->simulations.size;
-                }
-            }
-
-            data_ptr = server_ptr->fields[field_id].stats_data;
-            if (data_ptr[client_rank].stats_init != 1 && recv_vect_size > 0)
-            {
-                melissa_init_data (&data_ptr[client_rank], &server_ptr->melissa_options, recv_vect_size);
-                server_ptr->last_checkpoint_time = melissa_get_time();
-                if (server_ptr->melissa_options.restart > 0)
-                {
-                    server_ptr->start_read_time = melissa_get_time();
-                    if (server_ptr->comm_data.rank == 0)
-                    {
-                        melissa_print (VERBOSE_INFO, "reading checkpoint files...\n");
-                    }
-                    read_saved_stats (data_ptr, &server_ptr->comm_data, field_name_ptr, client_rank);
-                    if (server_ptr->comm_data.rank == 0)
-                    {
-                        melissa_print (VERBOSE_INFO, "reading checkpoint files ok\n");
-                    }
-                    server_ptr->last_checkpoint_time = melissa_get_time();
-                    server_ptr->end_read_time = melissa_get_time();
-                    server_ptr->total_read_time += server_ptr->end_read_time - server_ptr->start_read_time;
-                    simu_data->status = 3;
-                }
-            }
-            else if (data_ptr[client_rank].steps_init != 1)
-            {
-                melissa_init_data (&data_ptr[client_rank], &server_ptr->melissa_options, recv_vect_size);
-                server_ptr->last_checkpoint_time = melissa_get_time();
-            }
-            simu_ptr = (melissa_simulation_t*)server_ptr->simulations.items[simu_data->simu_id];
-
-            if (simu_ptr->parameters == NULL && recv_vect_size > 0)
-            {
-                // ask launcher for the simulation informations
-                sprintf (txt_buffer, "simu_info %d", simu_data->simu_id);
-                zmq_send(server_ptr->text_requester, txt_buffer, strlen(txt_buffer), 0);
-                sprintf (txt_buffer, "wait response...\n");
-                wait_launcher_msg = 1;
-            }
-
-            simu_ptr->last_message = melissa_get_time();
-            if (recv_vect_size > 0)
-            {
-                memcpy(simu_data->val, buf_ptr, recv_vect_size*sizeof(double));
-            }
-            server_ptr->total_mbytes_recv += zmq_msg_size (&msg);
-            server_ptr->start_computation_time = melissa_get_time();
-
-            if (simu_data->simu_id >= data_ptr[client_rank].step_simu.size)
-            {
-                uint32_t *item;
-                for (i=data_ptr[client_rank].step_simu.size; i<simu_data->simu_id; i++)
-                {
-                    item = (uint32_t*)melissa_calloc((data_ptr[client_rank].options->nb_time_steps+31)/32, sizeof(uint32_t));
-                    vector_add(&data_ptr[client_rank].step_simu, (void*)item);
-
-                }
-            }
 
-            if (test_bit ((uint32_t*)data_ptr[client_rank].step_simu.items[simu_data->simu_id], simu_data->time_stamp) != 0)
-            {
-                // Time step already computed, message ignored.
-                melissa_print (VERBOSE_WARNING,  "Allready computed time step (simulation %d, time step %d)\n", simu_data->simu_id, simu_data->time_stamp);
-                new_data = 0;
-            }
-
-            if (new_data == 1)
-            {
-                if (recv_vect_size > 0)
-                {
-                    if (server_ptr->melissa_options.sobol_op != 1)
-                    {
-                        server_ptr->buff_tab_ptr[0] = (double*)buf_ptr;
-                        // === Compute classical statistics === //
-                        compute_stats (&data_ptr[client_rank],
-                                       simu_data->time_stamp,
-                                       simu_data->simu_id,
-                                       1,
-                                       server_ptr->buff_tab_ptr);
-                    }
-                    else
-                    {
-                        for (i=0; i<server_ptr->melissa_options.nb_parameters+2; i++)
-                        {
-                            server_ptr->buff_tab_ptr[i] = (double*)buf_ptr;
-                            buf_ptr += recv_vect_size * sizeof(double);
-                        }
-                        // === Compute classical statistics + Sobol indices === //
-                        compute_stats (&data_ptr[client_rank],
-                                       simu_data->time_stamp,
-                                       simu_data->simu_id,
-                                       server_ptr->melissa_options.nb_parameters+2,
-                                       server_ptr->buff_tab_ptr);
-//                        confidence_sobol_martinez (&(data_ptr[client_rank].sobol_indices[simu_data->time_stamp]),
-//                                server_ptr->melissa_options.nb_parameters,
-//                                data_ptr[client_rank].vect_size);
-
-                        if (server_ptr->comm_data.rank == 0 &&
-                                simu_data->time_stamp == server_ptr->melissa_options.nb_time_steps -1)
-                        {
-                            // REM: atm only showing for last timestep on 0 rank
-//                            log_confidence_sobol_martinez(&(data_ptr[client_rank].sobol_indices[simu_data->time_stamp]),
-//                                    server_ptr->melissa_options.nb_parameters);
-
-                            send_message_confidence_interval("Sobol",
-                                                             field_name_ptr,
-                                                             simplified_confidence_sobol_martinez (data_ptr[client_rank].sobol_indices[simu_data->time_stamp].iteration),
-                                                             server_ptr->text_pusher,
-                                                             0);
-
-                        }
-
-                        server_ptr->nb_converged_fields += check_convergence_sobol_martinez(&(data_ptr[client_rank].sobol_indices),
-                                                                                            0.01,
-                                                                                            server_ptr->melissa_options.nb_time_steps,
-                                                                                            server_ptr->melissa_options.nb_parameters);
-                    }
-                }
-                set_bit((uint32_t*)data_ptr[client_rank].step_simu.items[simu_data->simu_id], simu_data->time_stamp);
-            }
-            server_ptr->end_computation_time = melissa_get_time();
-            server_ptr->total_computation_time += server_ptr->end_computation_time - server_ptr->start_computation_time;
-
-            if (wait_launcher_msg == 1)
-            {
-                wait_launcher_msg = 0;
-                zmq_msg_t msg2;
-//                    char text[melissa_get_message_len()];
-                printf (" Waiting launcher message\n");
-                zmq_msg_init (&msg2);
-                zmq_msg_recv (&msg2, server_ptr->text_requester, 0);
-                server_ptr->last_msg_launcher = melissa_get_time();
-                process_launcher_message(zmq_msg_data (&msg2), server_ptr);
-                zmq_msg_close (&msg2);
-//                    zmq_recv (server_ptr->text_requester, text, melissa_get_message_len()-1, 0);
-//                    server_ptr->last_msg_launcher = melissa_get_time();
-//                    process_launcher_message(text, server_ptr);
-            }
-            if (simu_ptr->parameters != NULL && recv_vect_size > 0)
-            {
-                memcpy(simu_data->parameters, simu_ptr->parameters, sizeof(double)*server_ptr->melissa_options.nb_parameters);
-            }
-
-
-            // check the simulation progress //
-            old_simu_state = simu_ptr->status;
-            simu_ptr->status = check_simu_state(server_ptr->fields, server_ptr->melissa_options.nb_fields, simu_data->simu_id, server_ptr->melissa_options.nb_time_steps, &server_ptr->comm_data);
-            simu_ptr->job_status = 1;
-            melissa_print(VERBOSE_DEBUG, "Group %d, rank %d, status %d\n", simu_data->simu_id, server_ptr->comm_data.rank, simu_ptr->status);
-
-#ifdef CHECK_SIMU_DECONNECTION
-            // check if we recieved all the last timestep messages //
-            if (simu_data->time_stamp == server_ptr->melissa_options.nb_time_steps-1)
+        if (server_ptr->ingest == NULL)
+        {
+            if (items[data_item].revents & ZMQ_POLLIN)
             {
-                old_last_time_step_state = simu_ptr->last_time_step;
-                simu_ptr->last_time_step = check_last_timestep(server_ptr->fields, server_ptr->melissa_options.nb_fields, simu_data->simu_id, server_ptr->melissa_options.nb_time_steps, &server_ptr->comm_data);
-                melissa_print(VERBOSE_DEBUG, "Group %d, rank %d, last timestep status: %d\n", simu_data->simu_id, server_ptr->comm_data.rank, simu_ptr->status);
+                zmq_msg_init (&msg);
+                zmq_msg_recv (&msg, server_ptr->data_puller, 0);
+                new_data = process_data_message (server_ptr, simu_data, &msg);
+                zmq_msg_close (&msg);
             }
-#endif // CHECK_SIMU_DECONNECTION
-
-            if (simu_ptr->status == 2 && old_simu_state != 2)
+        }
+        else
+        {
+            // bounded batch, so that launcher messages are not delayed
+            zmq_msg_init (&msg);
+            for (i=0; i<server_ptr->nb_bufferized_messages; i++)
             {
-#ifdef CHECK_SIMU_DECONNECTION
-                if (server_ptr->comm_data.rank != 0)
+                if (melissa_ingest_pop_received (server_ptr->ingest, &msg) == 0)
                 {
-                    server_ptr->nb_finished_simulations += 1;
+                    break;
                 }
-#else // CHECK_SIMU_DECONNECTION
-                server_ptr->nb_finished_simulations += 1;
-#endif // CHECK_SIMU_DECONNECTION
-            }
-
-            // === Send a message to the Python master in case of simulation status update === //  TODO: can't we put all this stuff into functions?  technical debt?
-#ifdef CHECK_SIMU_DECONNECTION
-            if (old_simu_state != simu_ptr->status && server_ptr->comm_data.rank == 0 && simu_ptr->status == 1)
-#else // CHECK_SIMU_DECONNECTION
-            if (old_simu_state != simu_ptr->status && server_ptr->comm_data.rank == 0)
-#endif // CHECK_SIMU_DECONNECTION
-            {
-                send_message_simu_status(simu_data->simu_id, simu_ptr->status, server_ptr->text_pusher, 0);
-                if (simu_ptr->status == 2)
-                {
-                    melissa_print(VERBOSE_INFO, "Simulation %d finished\n", simu_data->simu_id);
-                    melissa_print(VERBOSE_INFO, "Finished simulations: %d/%d\n", server_ptr->nb_finished_simulations, server_ptr->simulations.size);
-                }
-            }
-
-#ifdef CHECK_SIMU_DECONNECTION
-            // === Send a message to the Python master in case of last timestep status update === //
-            if (old_last_time_step_state != simu_ptr->last_time_step && server_ptr->comm_data.rank == 0 && simu_ptr->last_time_step == 1)
-            {
-                sprintf (txt_buffer, "timestep_state %d %d", simu_data->simu_id, simu_ptr->last_time_step);
-                melissa_print(VERBOSE_DEBUG, "Send \"%s\" to launcher\n", txt_buffer);
-                zmq_send(server_ptr->text_pusher, txt_buffer, strlen(txt_buffer), 0);
-            }
-#endif // CHECK_SIMU_DECONNECTION
-
-            if (server_ptr->melissa_options.sobol_op != 1)
-            {
-                server_ptr->buff_tab_ptr[0] = NULL;
+                new_data = process_data_message (server_ptr, simu_data, &msg);
+                zmq_msg_close (&msg);
+                zmq_msg_init (&msg);
             }
-            else
+            zmq_msg_close (&msg);
+            if (server_ptr->stream != NULL)
             {
-                for (i=0; i<server_ptr->melissa_options.nb_parameters+2; i++)
-                {
-                    server_ptr->buff_tab_ptr[i] = NULL;
-                }
+                // finished time steps whose last messages are computed
+                melissa_stream_poll (server_ptr->stream);
             }
-            buf_ptr = NULL;
-            zmq_msg_close (&msg);
         }
 
 #ifdef CHECK_SIMU_DECONNECTION
-        if (items[3].revents & ZMQ_POLLIN)
+        if (items[2].revents & ZMQ_POLLIN)
         {
             if (server_ptr->comm_data.rank == 0)
             {
@@ -833,20 +1190,28 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
 
         if (end_signal == SIGINT || end_signal == SIGUSR1 || end_signal == SIGUSR2)
         {
+            double checkpoint_wait_time = 0.0;
             server_ptr->start_save_time = melissa_get_time();
             if (server_ptr->comm_data.rank == 0)
             {
                 melissa_print(VERBOSE_WARNING, "\n --- INTERUPTED ---\n");
             }
-            for (i=0; i<server_ptr->melissa_options.nb_fields; i++)
+            if (server_ptr->ingest != NULL)
             {
-                save_stats (server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->fields[i].name);
-                if (server_ptr->comm_data.rank == 0)
-                {
-                    char dir[256];
-                    getcwd(dir, 256*sizeof(char));
-                    melissa_print(VERBOSE_INFO, "Statistic fields saved in %s\n\n", dir);
-                }
+                melissa_ingest_drain (server_ptr->ingest);
+            }
+            if (server_ptr->checkpoint != NULL)
+            {
+                checkpoint_wait_time = melissa_get_time();
+                wait_checkpoint (server_ptr);
+                checkpoint_wait_time = melissa_get_time() - checkpoint_wait_time;
+            }
+            save_final_stats (server_ptr);
+            if (server_ptr->comm_data.rank == 0)
+            {
+                char dir[256];
+                getcwd(dir, 256*sizeof(char));
+                melissa_print(VERBOSE_INFO, "Statistic fields saved in %s\n\n", dir);
             }
             simu_data->status = 2;
             save_simu_states (&server_ptr->simulations, &server_ptr->comm_data);
@@ -859,19 +1224,34 @@ void melissa_server_run (void **server_handle, simulation_data_t *simu_data)
             }
             server_ptr->end_save_time = melissa_get_time();
             melissa_print(VERBOSE_DEBUG, "Chekpoint time: %g (proc %d)\n", server_ptr->end_save_time - server_ptr->start_save_time, server_ptr->comm_data.rank);
-            server_ptr->total_save_time += server_ptr->end_save_time - server_ptr->start_save_time;
+            // the final checkpoint is written by this thread
+            server_ptr->total_save_time += server_ptr->end_save_time - server_ptr->start_save_time - checkpoint_wait_time;
+            server_ptr->total_stall_time += server_ptr->end_save_time - server_ptr->start_save_time;
             break;
         }
 
         // === Send a message to the Python Launcher in case of Sobol indices convergence === //
 
         if (server_ptr->first_init == 0 &&
-            server_ptr->nb_converged_fields >= server_ptr->melissa_options.nb_fields * server_ptr->local_nb_messages &&
             server_ptr->melissa_options.sobol_op == 1 &&
-            server_ptr->nb_finished_simulations > 1)
+            server_ptr->nb_converged_fields < server_ptr->local_nb_messages)
         {
+            interval = 0;
+            server_ptr->nb_converged_fields = global_confidence_sobol_martinez (server_ptr->fields,
+                                                                                server_ptr->melissa_options.nb_fields,
+                                                                                &server_ptr->comm_data,
+                                                                                &interval);
+        }
+        if (server_ptr->first_init == 0 &&
+            server_ptr->melissa_options.sobol_op == 1 &&
+            server_ptr->converged_sent == 0 &&
+            server_ptr->local_nb_messages > 0 &&
+            server_ptr->nb_converged_fields >= server_ptr->local_nb_messages)
+        {
+            // every (field, client rank) of this server process reached MELISSA_SOBOL_CONFIDENCE
             sprintf (txt_buffer, "converged %d", server_ptr->comm_data.rank);
             zmq_send(server_ptr->text_pusher, txt_buffer, strlen(txt_buffer), 0);
+            server_ptr->converged_sent = 1;
             //                if (strcmp ("stop", txt_buffer))
             //                {
             //                    break;
@@ -897,17 +1277,43 @@ void melissa_server_finalize (void** server_handle, simulation_data_t *simu_data
     melissa_server_t *server_ptr;
     double            interval1;
 //    double            interval_tot;
-    int               i;
 
     server_ptr = (melissa_server_t*)*server_handle;
 
-    melissa_free (simu_data->val);
+    if (server_ptr->ingest != NULL)
+    {
+        melissa_ingest_stop (server_ptr->ingest, &server_ptr->total_computation_time, &server_ptr->wire);
+        server_ptr->ingest = NULL;
+        melissa_free (server_ptr->spill_tickets);
+        server_ptr->spill_tickets = NULL;
+    }
 
-    for (i=0; i<server_ptr->melissa_options.nb_fields; i++)
+    if (server_ptr->checkpoint != NULL)
     {
-        save_stats (server_ptr->fields[i].stats_data, &server_ptr->comm_data, server_ptr->fields[i].name);
+        if (melissa_checkpoint_stop (server_ptr->checkpoint, &server_ptr->total_save_time) != 0)
+        {
+            melissa_print (VERBOSE_WARNING, "Checkpoint not written (proc %d)\n", server_ptr->comm_data.rank);
+        }
+        server_ptr->checkpoint = NULL;
     }
 
+    if (server_ptr->stream != NULL)
+    {
+        server_ptr->total_stream_time += melissa_stream_stop (server_ptr->stream);
+        server_ptr->stream = NULL;
+    }
+
+    zmq_msg_close (&server_ptr->learning_msg);
+    simu_data->val = NULL;
+
+    save_final_stats (server_ptr);
+#ifdef BUILD_WITH_MPI
+    if (server_ptr->melissa_options.mpi_io_checkpoint != 0)
+    {
+        MPI_Comm_free (&server_ptr->checkpoint_comm);
+    }
+#endif // BUILD_WITH_MPI
+
     save_simu_states (&server_ptr->simulations, &server_ptr->comm_data);
 
     if (server_ptr->comm_data.rank == 0)
@@ -920,6 +1326,8 @@ void melissa_server_finalize (void** server_handle, simulation_data_t *simu_data
     {
         melissa_free (server_ptr->buff_tab_ptr);
     }
+    melissa_free (server_ptr->wire_buffer);
+    melissa_wire_free (&server_ptr->wire);
 
     if (server_ptr->comm_data.rank == 0)
     {
@@ -936,7 +1344,10 @@ void melissa_server_finalize (void** server_handle, simulation_data_t *simu_data
 //                                          &server_ptr->comm_data,
 //                                          &interval1,
 //                                          &interval_tot);
-        interval1 = simplified_confidence_sobol_martinez (server_ptr->nb_finished_simulations);
+        global_confidence_sobol_martinez (server_ptr->fields,
+                                          server_ptr->melissa_options.nb_fields,
+                                          &server_ptr->comm_data,
+                                          &interval1);
     }
 
     if (end_signal == 0)
@@ -960,6 +1371,12 @@ void melissa_server_finalize (void** server_handle, simulation_data_t *simu_data
     server_ptr->total_comm_time = temp1 / server_ptr->comm_data.comm_size;
     MPI_Reduce (&server_ptr->total_mbytes_recv, &temp2, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
     server_ptr->total_mbytes_recv = temp2 / 1000000;
+    MPI_Reduce (&server_ptr->wire.codec_time, &temp1, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    server_ptr->wire.codec_time = temp1 / server_ptr->comm_data.comm_size;
+    MPI_Reduce (&server_ptr->wire.raw_bytes, &temp2, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    server_ptr->wire.raw_bytes = temp2;
+    MPI_Reduce (&server_ptr->wire.packed_bytes, &temp2, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    server_ptr->wire.packed_bytes = temp2;
 #endif // BUILD_WITH_MPI
     if (server_ptr->comm_data.rank==0)
     {
@@ -971,9 +1388,19 @@ void melissa_server_finalize (void** server_handle, simulation_data_t *simu_data
         melissa_print (VERBOSE_INFO, " --- Waiting time:                    %g s\n", server_ptr->total_wait_time);
         melissa_print (VERBOSE_INFO, " --- Reading time:                    %g s\n", server_ptr->total_read_time);
         melissa_print (VERBOSE_INFO, " --- Writing time:                    %g s\n", server_ptr->total_write_time);
+        if (server_ptr->melissa_options.stream_output != 0)
+        {
+            melissa_print (VERBOSE_INFO, " --- Streamed writing time:           %g s\n", server_ptr->total_stream_time);
+        }
         melissa_print (VERBOSE_INFO, " --- Chekpointing time:               %g s\n", server_ptr->total_save_time);
+        melissa_print (VERBOSE_INFO, " --- Checkpoint stall time:           %g s\n", server_ptr->total_stall_time);
         melissa_print (VERBOSE_INFO, " --- Total time:                      %g s\n", melissa_get_time() - server_ptr->start_time);
         melissa_print (VERBOSE_INFO, " --- MB received:                     %ld MB\n",server_ptr->total_mbytes_recv);
+        if (server_ptr->wire.codec != MELISSA_WIRE_NO_CODEC && server_ptr->wire.packed_bytes > 0)
+        {
+            melissa_print (VERBOSE_INFO, " --- Wire decompression time:         %g s\n", server_ptr->wire.codec_time);
+            melissa_print (VERBOSE_INFO, " --- Wire compression ratio:          %g\n", (double)server_ptr->wire.raw_bytes / server_ptr->wire.packed_bytes);
+        }
 //        melissa_print (VERBOSE_INFO, " --- Stats structures memory:         %ld MB\n", mem_conso(&melissa_options));
 //        melissa_print (VERBOSE_INFO, " --- Bytes written:                   %ld MB\n", count_mbytes_written(&server_ptr->melissa_options));
         if (server_ptr->melissa_options.sobol_op == 1)
@@ -1015,7 +1442,7 @@ int main (int argc, char **argv)
     simu_data.status = 0;
     simu_data.val_size = 0;
     simu_data.max_val_size = 0;
-    simu_data.val = (double*)melissa_malloc(0);
+    simu_data.val = NULL;
 #ifdef BUILD_WITH_MPI
     int i;
     MPI_Init_thread (&argc, &argv, MPI_THREAD_FUNNELED , &i);
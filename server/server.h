@@ -33,7 +33,11 @@ extern "C" {
 #include "melissa_fields.h"
 #include "melissa_data.h"
 #include "melissa_utils.h"
+#include "melissa_messages.h"
 #include "fault_tolerance.h"
+#include "melissa_ingest.h"
+#include "melissa_checkpoint.h"
+#include "melissa_stream.h"
 #ifdef BUILD_WITH_MPI
 #include <mpi.h>
 #endif // BUILD_WITH_MPI
@@ -59,7 +63,11 @@ struct melissa_server_s
     int                   local_nb_messages;
     int                   nb_bufferized_messages;
     int                   nb_converged_fields;
+    int                   converged_sent;
     double              **buff_tab_ptr;
+    double               *wire_buffer;
+    size_t                wire_buffer_size;
+    melissa_wire_t        wire;
     double                start_time;
     double                total_comm_time;
     double                start_comm_time;
@@ -73,10 +81,12 @@ struct melissa_server_s
     double                total_save_time;
     double                start_save_time;
     double                end_save_time;
+    double                total_stall_time;
     double                total_read_time;
     double                start_read_time;
     double                end_read_time;
     double                total_write_time;
+    double                total_stream_time;
     long int              total_mbytes_recv;
     double                last_timeout_check;
     int                   detected_timeouts;
@@ -85,6 +95,22 @@ struct melissa_server_s
     double                last_msg_launcher;
     double                timeout_launcher;
     vector_t              simulations;
+    melissa_ingest_t     *ingest;
+    melissa_checkpoint_t *checkpoint;
+    melissa_stream_t     *stream;
+#ifdef BUILD_WITH_MPI
+    MPI_Comm              checkpoint_comm;
+    MPI_Request           checkpoint_request;
+    int                   checkpoint_vote[2];     /**< this rank finished, this rank can postpone the checkpoint  */
+    int                   checkpoint_all[2];      /**< every rank finished, every rank can postpone the checkpoint */
+    int                   checkpoint_consistent;  /**< 1 if the shared checkpoint to write is a consistent cut     */
+#endif // BUILD_WITH_MPI
+    size_t                resident_bytes;
+    size_t                next_spill_check;
+    int                   spill_step;         /**< first time step not spilled yet                            */
+    int                   spill_ticket_end;   /**< end of the finished time steps waiting for spill_tickets   */
+    long int             *spill_tickets;      /**< compute threads tickets of the finished time steps         */
+    zmq_msg_t             learning_msg;
 };
 
 typedef struct melissa_server_s melissa_server_t; /**< type corresponding to melissa_server_s */
@@ -97,9 +123,9 @@ struct simulation_data_s
     int     time_stamp;
     int     first_init;
     int     status;
-    double *val;
+    double *val;           /**< last received vector (learning only), points inside a ZeroMQ message, valid until the next melissa_server_run call */
     int     val_size;
-    int     max_val_size;
+    int     max_val_size;  /**< unused, kept for the Python side */
     char*   nn_path_ptr;
 };
 
@@ -120,32 +146,28 @@ int create_port_number (comm_data_t *comm_data,
                         const int    forbidden_port4,
                         const int    forbidden_port5);
 
-int check_simu_state(melissa_field_t *field,
-                     int              nb_fields,
-                     int              group_id,
-                     int              nb_time_steps,
-                     comm_data_t     *comm_data);
+int check_simu_state(melissa_simulation_t *simulation,
+                     int                   nb_data,
+                     int                   nb_time_steps);
 
 
 void process_launcher_message (void*             msg_data,
                                melissa_server_t *server_ptr);
 
-int check_last_timestep(melissa_field_t *fields,
-                        int              nb_fields,
-                        int              group_id,
-                        int              nb_time_steps,
-                        comm_data_t     *comm_data);
+int check_last_timestep(melissa_simulation_t *simulation,
+                        int                   nb_data);
 
 long int count_mbytes_written (melissa_options_t  *options);
 
 int string_recv (void *socket,
                  char *recv_buff);
 
-void global_confidence_sobol_martinez(melissa_field_t *field,
-                                      int              nb_fields,
-                                      comm_data_t     *comm_data,
-                                      double          *interval1,
-                                      double          *interval_tot);
+void spill_finished_steps (melissa_server_t *server_ptr);
+
+int global_confidence_sobol_martinez(melissa_field_t *field,
+                                     int              nb_fields,
+                                     comm_data_t     *comm_data,
+                                     double          *interval);
 
 #ifdef __cplusplus
 }
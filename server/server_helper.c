@@ -78,57 +78,30 @@ int create_port_number (comm_data_t *comm_data,
  *
  * @ingroup melissa_utils
  *
- * This function checks the status of a simulation
+ * This function checks the status of a simulation, from its message counter
  *
  *******************************************************************************
  *
- * @param[in] *fields
- * Melissa fields
+ * @param[in] *simulation
+ * the simulation to check
  *
- * @param[in] nb_fields
- * number of Melissa fields
- *
- * @param[in] group_id
- * id of the group to check
+ * @param[in] nb_data
+ * number of (field, client rank) pairs that received messages
  *
  * @param[in] nb_time_steps
  * number of time step for this study
  *
- * @param[in] *comm_data
- * Structure containing communication informations
+ * @return 1 if messages are missing, 2 if all the messages were recieved
  *
  *******************************************************************************/
 
-int check_simu_state(melissa_field_t *fields,
-                     int              nb_fields,
-                     int              group_id,
-                     int              nb_time_steps,
-                     comm_data_t     *comm_data)
+int check_simu_state(melissa_simulation_t *simulation,
+                     int                   nb_data,
+                     int                   nb_time_steps)
 {
-    int i, j, t;
-
-    if (fields == NULL)
+    if (simulation->nb_received < nb_data * nb_time_steps)
     {
-        return 0;
-    }
-    else
-    {
-        for (j=0; j<nb_fields; j++)
-        {
-            for (i=0; i<comm_data->client_comm_size; i++)
-            {
-                if (fields[j].stats_data[i].steps_init > 0)
-                {
-                    for (t=0; t<nb_time_steps; t++)
-                    {
-                        if (test_bit (fields[j].stats_data[i].step_simu.items[group_id], t) == 0)
-                        {
-                            return 1;
-                        }
-                    }
-                }
-            }
-        }
+        return 1;
     }
     return 2;
 }
@@ -220,33 +193,31 @@ void process_launcher_message (void*             msg_data,
     }
 }
 
-int check_last_timestep(melissa_field_t *fields,
-                        int              nb_fields,
-                        int              group_id,
-                        int              nb_time_steps,
-                        comm_data_t     *comm_data)
-{
-    int i, j, t;
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_utils
+ *
+ * This function checks if a simulation sent all its last time step messages
+ *
+ *******************************************************************************
+ *
+ * @param[in] *simulation
+ * the simulation to check
+ *
+ * @param[in] nb_data
+ * number of (field, client rank) pairs that received messages
+ *
+ * @return 1 if messages are missing, 2 if all the messages were recieved
+ *
+ *******************************************************************************/
 
-    if (fields == NULL)
+int check_last_timestep(melissa_simulation_t *simulation,
+                        int                   nb_data)
+{
+    if (simulation->nb_last_received < nb_data)
     {
-        return 0;
-    }
-    else
-    {
-        for (j=0; j<nb_fields; j++)
-        {
-            for (i=0; i<comm_data->client_comm_size; i++)
-            {
-                if (fields[j].stats_data[i].steps_init > 0)
-                {
-                    if (test_bit (fields[j].stats_data[i].step_simu.items[group_id], nb_time_steps-1) == 0)
-                    {
-                        return 1;
-                    }
-                }
-            }
-        }
+        return 1;
     }
     return 2;
 }
@@ -325,12 +296,116 @@ int string_recv (void  *socket,
     return size;
 }
 
+// 1 if every simulation sent the time step to every client rank
+static int step_finished (melissa_server_t *server_ptr,
+                          int               t)
+{
+    int             i, f;
+    melissa_data_t *data;
+
+    for (f=0; f<server_ptr->melissa_options.nb_fields; f++)
+    {
+        for (i=0; i<server_ptr->comm_data.client_comm_size; i++)
+        {
+            data = &(server_ptr->fields[f].stats_data[i]);
+            if (data->steps_init == 0 ||
+                data->step_received[t] < server_ptr->melissa_options.sampling_size)
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup melissa_server
+ *
+ * This function spills finished time steps (received from every simulation)
+ * to disk, oldest first, until the statistics fit again in the memory budget.
+ * The time steps before server_ptr->spill_step are already spilled. With
+ * compute threads, the finished time steps are only spilled once the messages
+ * dispatched before their completion are computed (melissa_ingest_tickets).
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *server_ptr
+ * pointer to the server structure
+ *
+ *******************************************************************************/
+
+void spill_finished_steps (melissa_server_t *server_ptr)
+{
+    int             i, f, end;
+    int             nb_time_steps = server_ptr->melissa_options.nb_time_steps;
+    size_t          budget = (size_t)server_ptr->melissa_options.memory_budget * 1024 * 1024;
+    size_t          target = budget - budget / 8; // some margin, not to spill at every message
+
+    if (server_ptr->ingest == NULL)
+    {
+        end = server_ptr->spill_step;
+        while (end < nb_time_steps && step_finished (server_ptr, end) != 0)
+        {
+            end++;
+        }
+    }
+    else
+    {
+        if (server_ptr->spill_ticket_end <= server_ptr->spill_step)
+        {
+            // the time steps finished now are computed once the tickets are reached
+            end = server_ptr->spill_step;
+            while (end < nb_time_steps && step_finished (server_ptr, end) != 0)
+            {
+                end++;
+            }
+            if (end > server_ptr->spill_step)
+            {
+                melissa_ingest_tickets (server_ptr->ingest, server_ptr->spill_tickets);
+                server_ptr->spill_ticket_end = end;
+            }
+        }
+        end = server_ptr->spill_step;
+        if (server_ptr->spill_ticket_end > server_ptr->spill_step &&
+            melissa_ingest_reached (server_ptr->ingest, server_ptr->spill_tickets) != 0)
+        {
+            end = server_ptr->spill_ticket_end;
+        }
+    }
+
+    while (server_ptr->spill_step < end && server_ptr->resident_bytes > target)
+    {
+        for (f=0; f<server_ptr->melissa_options.nb_fields; f++)
+        {
+            for (i=0; i<server_ptr->comm_data.client_comm_size; i++)
+            {
+                server_ptr->resident_bytes -= melissa_spill_step (&(server_ptr->fields[f].stats_data[i]),
+                                                                  server_ptr->spill_step);
+            }
+        }
+        server_ptr->spill_step += 1;
+    }
+    if (server_ptr->resident_bytes > budget)
+    {
+        // not enough finished time steps: wait for some growth before the next scan
+        melissa_print (VERBOSE_DEBUG, "Statistics memory above the budget (%zu MB)\n", server_ptr->resident_bytes / (1024*1024));
+        server_ptr->next_spill_check = server_ptr->resident_bytes + budget / 16;
+    }
+    else
+    {
+        server_ptr->next_spill_check = budget;
+    }
+}
+
 /**
  *******************************************************************************
  *
  * @ingroup sobol
  *
- * This function computes the confidence interval for Martinez Sobol indices
+ * This function gathers the convergence of the Martinez Sobol indices of the
+ * fields, as tracked by compute_stats
  *
  *******************************************************************************
  *
@@ -343,25 +418,25 @@ int string_recv (void  *socket,
  * @param[out] *comm_data
  * comm data structure
  *
- * @param[out] *interval1
- * worst confidence interval (first order)
+ * @param[out] *interval
+ * worst confidence interval (first and total order)
  *
- * @param[out] *interval_tot
- * worst confidence interval (total order)
+ * @return The number of (field, client rank) pairs whose time steps all converged
  *
  *******************************************************************************/
 
-void global_confidence_sobol_martinez(melissa_field_t *field,
-                                      int              nb_fields,
-                                      comm_data_t     *comm_data,
-                                      double          *interval1,
-                                      double          *interval_tot)
+int global_confidence_sobol_martinez(melissa_field_t *field,
+                                     int              nb_fields,
+                                     comm_data_t     *comm_data,
+                                     double          *interval)
 {
-    int i, j, t, p, f;
+    int i, f;
+    int nb_converged = 0;
+    double data_interval;
     melissa_data_t *data;
     if (field == NULL)
     {
-        return;
+        return 0;
     }
 
     for (f=0; f<nb_fields; f++)
@@ -371,28 +446,18 @@ void global_confidence_sobol_martinez(melissa_field_t *field,
             data = &(field[f].stats_data[i]);
             if (data->vect_size > 0)
             {
-                for (t=0; t<data->options->nb_time_steps; t++)
+                // updated by the compute threads
+                __atomic_load (&data->sobol_interval, &data_interval, __ATOMIC_RELAXED);
+                if (data_interval > *interval)
+                {
+                    *interval = data_interval;
+                }
+                if (__atomic_load_n (&data->sobol_converged_steps, __ATOMIC_ACQUIRE) == data->options->nb_time_steps)
                 {
-                    for (p=0; p<data->options->nb_parameters; p++)
-                    {
-                        if (data->sobol_indices[t].iteration < 4)
-                        {
-                            return;
-                        }
-                        for (j=0; j< data->options->nb_parameters; j++)
-                        {
-                            if (data->sobol_indices[t].sobol_martinez[p].confidence_interval[0] > *interval1)
-                            {
-                                *interval1 = data->sobol_indices[t].sobol_martinez[p].confidence_interval[0];
-                            }
-                            if (data->sobol_indices[t].sobol_martinez[p].confidence_interval[1] > *interval_tot)
-                            {
-                                *interval_tot = data->sobol_indices[t].sobol_martinez[p].confidence_interval[1];
-                            }
-                        }
-                    }
+                    nb_converged += 1;
                 }
             }
         }
     }
+    return nb_converged;
 }
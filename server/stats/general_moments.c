@@ -38,46 +38,34 @@
 #include "variance.h"
 #include "melissa_utils.h"
 
-static inline void increment_moments_mean (double    *mean,
-                                           double    *in_vect,
-                                           const int  vect_size,
-                                           const int  increment,
-                                           const int  power)
-{
-    int     i;
-    double temp;
-
-#pragma omp parallel for schedule(static) private(temp)
-    for (i=0; i<vect_size; i++)
-    {
-        temp = mean[i];
-        mean[i] = temp + (pow(in_vect[i], power) - temp)/increment;
-    }
-}
-
-static inline void update_moments_mean (double    *m1,
-                                        double    *m2,
-                                        double    *m3,
-                                        const int  increment2,
-                                        const int  increment3,
-                                        const int  vect_size)
-{
-    int    i;
-    double delta;
-
-#pragma omp parallel for schedule(static) private(delta)
-    for (i=0; i<vect_size; i++)
-    {
-        delta = (m2[i] - m1[i]);
-        m3[i] = m1[i] + increment2 * delta / increment3;
-    }}
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define MOMENTS_VECT_WIDTH 8
+typedef __m512d moments_vect_t;
+#define VECT_LOAD(p)     _mm512_loadu_pd(p)
+#define VECT_STORE(p, a) _mm512_storeu_pd(p, a)
+#define VECT_SET1(a)     _mm512_set1_pd(a)
+#define VECT_ADD(a, b)   _mm512_add_pd(a, b)
+#define VECT_SUB(a, b)   _mm512_sub_pd(a, b)
+#define VECT_MUL(a, b)   _mm512_mul_pd(a, b)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define MOMENTS_VECT_WIDTH 4
+typedef __m256d moments_vect_t;
+#define VECT_LOAD(p)     _mm256_loadu_pd(p)
+#define VECT_STORE(p, a) _mm256_storeu_pd(p, a)
+#define VECT_SET1(a)     _mm256_set1_pd(a)
+#define VECT_ADD(a, b)   _mm256_add_pd(a, b)
+#define VECT_SUB(a, b)   _mm256_sub_pd(a, b)
+#define VECT_MUL(a, b)   _mm256_mul_pd(a, b)
+#endif // __AVX512F__
 
 /**
  *******************************************************************************
  *
  * @ingroup stats_base
  *
- * This function initializes a moments structure.
+ * This function initializes a moments structure in a memory arena.
  *
  *******************************************************************************
  *
@@ -90,35 +78,174 @@ static inline void update_moments_mean (double    *m1,
  * @param[in] max_order
  * maximum moment order
  *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ *
  *******************************************************************************/
 
-void init_moments(moments_t *moments,
-                  const int  vect_size,
-                  const int  max_order)
+void init_moments_arena (moments_t       *moments,
+                         const int        vect_size,
+                         const int        max_order,
+                         melissa_arena_t *arena)
 {
     if (max_order > 0)
     {
-        moments->m1 = melissa_calloc(vect_size, sizeof(double));
+        moments->m1 = melissa_arena_calloc (arena, vect_size, sizeof(double));
     }
     if (max_order > 1)
     {
-        moments->m2 = melissa_calloc(vect_size, sizeof(double));
-        moments->theta2 = melissa_calloc(vect_size, sizeof(double));
+        moments->m2 = melissa_arena_calloc (arena, vect_size, sizeof(double));
     }
     if (max_order > 2)
     {
-        moments->m3 = melissa_calloc(vect_size, sizeof(double));
-        moments->theta3 = melissa_calloc(vect_size, sizeof(double));
+        moments->m3 = melissa_arena_calloc (arena, vect_size, sizeof(double));
     }
     if (max_order > 3)
     {
-        moments->m4 = melissa_calloc(vect_size, sizeof(double));
-        moments->theta4 = melissa_calloc(vect_size, sizeof(double));
+        moments->m4 = melissa_arena_calloc (arena, vect_size, sizeof(double));
     }
     moments->increment = 0;
     moments->max_order = max_order;
 }
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a moments structure.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *moments
+ * the moments_t structure to initialize
+ *
+ * @param[in] vect_size
+ * size of the input vector
+ *
+ * @param[in] max_order
+ * maximum moment order
+ *
+ *******************************************************************************/
+
+void init_moments(moments_t *moments,
+                  const int  vect_size,
+                  const int  max_order)
+{
+    init_moments_arena (moments, vect_size, max_order, NULL);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function incrementes a moment structure on the elements [first, last)
+ * of the vectors. The increment of the structure must already be updated.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *moments
+ * the moments_t structure to increment
+ *
+ * @param[in] in_vect[]
+ * the input vector
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void increment_moments_block (moments_t *moments,
+                              double     in_vect[],
+                              const int  first,
+                              const int  last)
+{
+    int    i = first;
+    double delta, delta_n, delta_n2, term1;
+    const double n     = moments->increment;
+    const double inv_n = 1.0 / n;
+    const double c2    = n - 1.0;
+    const double c3    = n - 2.0;
+    const double c4    = n*n - 3.0*n + 3.0;
+    const int    order = moments->max_order;
+
+    if (order < 1)
+    {
+        return;
+    }
+
+#ifdef MOMENTS_VECT_WIDTH
+    {
+        const moments_vect_t v_inv_n = VECT_SET1(inv_n);
+        const moments_vect_t v_c2    = VECT_SET1(c2);
+        const moments_vect_t v_c3    = VECT_SET1(c3);
+        const moments_vect_t v_c4    = VECT_SET1(c4);
+        const moments_vect_t v_three = VECT_SET1(3.0);
+        const moments_vect_t v_four  = VECT_SET1(4.0);
+        const moments_vect_t v_six   = VECT_SET1(6.0);
+        moments_vect_t v_delta, v_delta_n, v_delta_n2, v_term1, v_m2, v_m3, v_m4;
+
+        for (; i+MOMENTS_VECT_WIDTH<=last; i+=MOMENTS_VECT_WIDTH)
+        {
+            v_delta   = VECT_SUB(VECT_LOAD(&in_vect[i]), VECT_LOAD(&moments->m1[i]));
+            v_delta_n = VECT_MUL(v_delta, v_inv_n);
+            VECT_STORE(&moments->m1[i], VECT_ADD(VECT_LOAD(&moments->m1[i]), v_delta_n));
+            if (order > 1)
+            {
+                v_term1 = VECT_MUL(VECT_MUL(v_delta, v_delta_n), v_c2);
+                v_m2 = VECT_LOAD(&moments->m2[i]);
+                if (order > 2)
+                {
+                    v_m3 = VECT_LOAD(&moments->m3[i]);
+                    if (order > 3)
+                    {
+                        v_delta_n2 = VECT_MUL(v_delta_n, v_delta_n);
+                        v_m4 = VECT_LOAD(&moments->m4[i]);
+                        v_m4 = VECT_ADD(v_m4, VECT_MUL(VECT_MUL(v_term1, v_delta_n2), v_c4));
+                        v_m4 = VECT_ADD(v_m4, VECT_MUL(VECT_MUL(v_six, v_delta_n2), v_m2));
+                        v_m4 = VECT_SUB(v_m4, VECT_MUL(VECT_MUL(v_four, v_delta_n), v_m3));
+                        VECT_STORE(&moments->m4[i], v_m4);
+                    }
+                    v_m3 = VECT_ADD(v_m3, VECT_MUL(VECT_MUL(v_term1, v_delta_n), v_c3));
+                    v_m3 = VECT_SUB(v_m3, VECT_MUL(VECT_MUL(v_three, v_delta_n), v_m2));
+                    VECT_STORE(&moments->m3[i], v_m3);
+                }
+                VECT_STORE(&moments->m2[i], VECT_ADD(v_m2, v_term1));
+            }
+        }
+    }
+#endif // MOMENTS_VECT_WIDTH
+
+    // scalar path, and remainder of the vector path
+    for (; i<last; i++)
+    {
+        delta   = in_vect[i] - moments->m1[i];
+        delta_n = delta * inv_n;
+        moments->m1[i] += delta_n;
+        if (order > 1)
+        {
+            term1 = delta * delta_n * c2;
+            if (order > 3)
+            {
+                delta_n2 = delta_n * delta_n;
+                moments->m4[i] += term1 * delta_n2 * c4
+                                + 6.0 * delta_n2 * moments->m2[i]
+                                - 4.0 * delta_n * moments->m3[i];
+            }
+            if (order > 2)
+            {
+                moments->m3[i] += term1 * delta_n * c3
+                                - 3.0 * delta_n * moments->m2[i];
+            }
+            moments->m2[i] += term1;
+        }
+    }
+}
+
 /**
  *******************************************************************************
  *
@@ -150,43 +277,160 @@ void increment_moments (moments_t *moments,
         return;
     }
 
-    //means
-    increment_moments_mean(moments->m1, in_vect, vect_size, moments->increment, 1);
-    if (moments->max_order > 1)
-    {
-        increment_moments_mean(moments->m2, in_vect, vect_size, moments->increment, 2);
-    }
-    if (moments->max_order > 2)
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
     {
-        increment_moments_mean(moments->m3, in_vect, vect_size, moments->increment, 3);
+        increment_moments_block (moments,
+                                 in_vect,
+                                 i,
+                                 (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
     }
-    if (moments->max_order > 3)
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function incrementes a moment structure with several input vectors,
+ * on the elements [first, last). The moments of the batch are computed in
+ * registers, then merged with the structure (Chan et al., Pebay), so that the
+ * moment vectors are read and written once per batch.
+ * The increment of the structure must already be updated.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *moments
+ * the moments_t structure to increment
+ *
+ * @param[in] **in_vects
+ * the input vectors
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void increment_moments_batch_block (moments_t  *moments,
+                                    double    **in_vects,
+                                    const int   nb_vects,
+                                    const int   first,
+                                    const int   last)
+{
+    int    i, k;
+    double mean, m2, m3, m4, k_d;
+    double delta, delta_n, delta_n2, term1;
+    const double n2    = nb_vects;
+    const double n1    = moments->increment - nb_vects;
+    const double n     = moments->increment;
+    const int    order = moments->max_order;
+
+    if (order < 1)
     {
-        increment_moments_mean(moments->m4, in_vect, vect_size, moments->increment, 4);
+        return;
     }
 
-    // thetas
-    if (moments->increment > 1)
+    for (i=first; i<last; i++)
     {
-#pragma omp parallel for schedule(static)
-        for (i=0; i<vect_size; i++)
+        // moments of the batch
+        mean = m2 = m3 = m4 = 0.0;
+        for (k=0; k<nb_vects; k++)
         {
-            if (moments->max_order > 1)
-            {
-                moments->theta2[i] = moments->m2[i] - pow(moments->m1[i], 2);
-            }
-            if (moments->max_order > 2)
+            k_d     = k + 1;
+            delta   = in_vects[k][i] - mean;
+            delta_n = delta / k_d;
+            mean   += delta_n;
+            term1   = delta * delta_n * (k_d - 1.0);
+            delta_n2 = delta_n * delta_n;
+            m4     += term1 * delta_n2 * (k_d*k_d - 3.0*k_d + 3.0)
+                    + 6.0 * delta_n2 * m2
+                    - 4.0 * delta_n * m3;
+            m3     += term1 * delta_n * (k_d - 2.0)
+                    - 3.0 * delta_n * m2;
+            m2     += term1;
+        }
+
+        // pairwise update with the previous moments
+        delta = mean - moments->m1[i];
+        moments->m1[i] += delta * n2 / n;
+        if (order > 1)
+        {
+            delta_n2 = delta * delta;
+            if (order > 3)
             {
-                moments->theta3[i] = moments->m3[i] - 3*moments->m1[i]*moments->m2[i] + 2*pow(moments->m1[i], 3);
+                moments->m4[i] += m4
+                                + delta_n2 * delta_n2 * n1 * n2 * (n1*n1 - n1*n2 + n2*n2) / (n * n * n)
+                                + 6.0 * delta_n2 * (n1*n1 * m2 + n2*n2 * moments->m2[i]) / (n * n)
+                                + 4.0 * delta * (n1 * m3 - n2 * moments->m3[i]) / n;
             }
-            if (moments->max_order > 3)
+            if (order > 2)
             {
-                moments->theta4[i] = moments->m4[i] - 4*moments->m1[i]*moments->m3[i] + 6*pow(moments->m1[i], 2)*moments->m2[i] - 3*pow(moments->m1[i], 4);
+                moments->m3[i] += m3
+                                + delta_n2 * delta * n1 * n2 * (n1 - n2) / (n * n)
+                                + 3.0 * delta * (n1 * m2 - n2 * moments->m2[i]) / n;
             }
+            moments->m2[i] += m2 + delta_n2 * n1 * n2 / n;
         }
     }
 }
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function incrementes a moment structure with several input vectors.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *moments
+ * the moments_t structure to increment
+ *
+ * @param[in] **in_vects
+ * the input vectors
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void increment_moments_batch (moments_t  *moments,
+                              double    **in_vects,
+                              const int   nb_vects,
+                              const int   vect_size)
+{
+    int i;
+
+    if (nb_vects < 1)
+    {
+        return;
+    }
+    moments->increment += nb_vects;
+    if (moments->max_order < 1)
+    {
+        return;
+    }
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        increment_moments_batch_block (moments,
+                                       in_vects,
+                                       nb_vects,
+                                       i,
+                                       (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
+}
+
 /**
  *******************************************************************************
  *
@@ -215,64 +459,44 @@ void update_moments (moments_t *moments1,
                      moments_t *updated_moments,
                      const int  vect_size)
 {
-    int i;
+    int    i;
+    double delta, delta2, m2, m3;
+    const double n1 = moments1->increment;
+    const double n2 = moments2->increment;
+    const double n  = n1 + n2;
+    const int order = updated_moments->max_order;
 
     updated_moments->increment = moments1->increment + moments2->increment;
-    if (updated_moments->max_order < 1)
+    if (order < 1 || updated_moments->increment < 1)
     {
         return;
     }
 
-    //means
-    update_moments_mean (moments1->m1,
-                         moments2->m1,
-                         updated_moments->m1,
-                         moments2->increment,
-                         updated_moments->increment,
-                         vect_size);
-    if (updated_moments->max_order > 1)
-    {
-        update_moments_mean (moments1->m2,
-                             moments2->m2,
-                             updated_moments->m2,
-                             moments2->increment,
-                             updated_moments->increment,
-                             vect_size);
-    }
-    if (updated_moments->max_order > 2)
-    {
-        update_moments_mean (moments1->m3,
-                             moments2->m3,
-                             updated_moments->m3,
-                             moments2->increment,
-                             updated_moments->increment,
-                             vect_size);
-    }
-    if (updated_moments->max_order > 3)
-    {
-        update_moments_mean (moments1->m4,
-                             moments2->m4,
-                             updated_moments->m4,
-                             moments2->increment,
-                             updated_moments->increment,
-                             vect_size);
-    }
-
-    // thetas
-#pragma omp parallel for schedule(static)
+    // pairwise update (Chan et al., Pebay), safe if updated_moments is moments1 or moments2
+#pragma omp parallel for schedule(static) private(delta, delta2, m2, m3)
     for (i=0; i<vect_size; i++)
     {
-        if (updated_moments->max_order > 1)
-        {
-            updated_moments->theta2[i] = updated_moments->m2[i] - pow(updated_moments->m1[i], 2);
-        }
-        if (updated_moments->max_order > 2)
+        delta = moments2->m1[i] - moments1->m1[i];
+        updated_moments->m1[i] = moments1->m1[i] + delta * n2 / n;
+        if (order > 1)
         {
-            updated_moments->theta3[i] = updated_moments->m3[i] - 3*updated_moments->m1[i]*updated_moments->m2[i] + 2*pow(updated_moments->m1[i], 3);
-        }
-        if (updated_moments->max_order > 3)
-        {
-            updated_moments->theta4[i] = updated_moments->m4[i] - 4*updated_moments->m1[i]*updated_moments->m3[i] + 6*pow(updated_moments->m1[i], 2)*updated_moments->m2[i] - 3*pow(updated_moments->m1[i], 4);
+            delta2 = delta * delta;
+            m2 = moments1->m2[i] + moments2->m2[i] + delta2 * n1 * n2 / n;
+            if (order > 2)
+            {
+                m3 = moments1->m3[i] + moments2->m3[i]
+                   + delta2 * delta * n1 * n2 * (n1 - n2) / (n * n)
+                   + 3.0 * delta * (n1 * moments2->m2[i] - n2 * moments1->m2[i]) / n;
+                if (order > 3)
+                {
+                    updated_moments->m4[i] = moments1->m4[i] + moments2->m4[i]
+                                           + delta2 * delta2 * n1 * n2 * (n1*n1 - n1*n2 + n2*n2) / (n * n * n)
+                                           + 6.0 * delta2 * (n1*n1 * moments2->m2[i] + n2*n2 * moments1->m2[i]) / (n * n)
+                                           + 4.0 * delta * (n1 * moments2->m3[i] - n2 * moments1->m3[i]) / n;
+                }
+                updated_moments->m3[i] = m3;
+            }
+            updated_moments->m2[i] = m2;
         }
     }
 }
@@ -441,7 +665,7 @@ void compute_variance (moments_t *moments,
 #pragma omp parallel for schedule(static)
     for (i=0; i<vect_size; i++)
     {
-        variance[i] = moments->theta2[i]*moments->increment/(moments->increment-1);
+        variance[i] = moments->m2[i]/(moments->increment-1);
     }
 }
 
@@ -469,11 +693,13 @@ void compute_skewness (moments_t *moments,
                        double     skewness[],
                        const int  vect_size)
 {
-    int i;
-#pragma omp parallel for schedule(static)
+    int    i;
+    double theta2;
+#pragma omp parallel for schedule(static) private(theta2)
     for (i=0; i<vect_size; i++)
     {
-        skewness[i] = moments->theta3[i] / pow(moments->theta2[i], 1.5);
+        theta2 = moments->m2[i] / moments->increment;
+        skewness[i] = moments->m3[i] / moments->increment / (theta2 * sqrt(theta2));
     }
 }
 
@@ -501,11 +727,13 @@ void compute_kurtosis (moments_t *moments,
                        double     kurtosis[],
                        const int  vect_size)
 {
-    int i;
-#pragma omp parallel for schedule(static)
+    int    i;
+    double theta2;
+#pragma omp parallel for schedule(static) private(theta2)
     for (i=0; i<vect_size; i++)
     {
-        kurtosis[i] = moments->theta4[i] / pow(moments->theta3[i], 2);
+        theta2 = moments->m2[i] / moments->increment;
+        kurtosis[i] = moments->m4[i] / moments->increment / (theta2 * theta2);
     }
 }
 
@@ -532,16 +760,13 @@ void free_moments (moments_t *moments)
     if (moments->max_order > 1)
     {
         melissa_free (moments->m2);
-        melissa_free (moments->theta2);
     }
     if (moments->max_order > 2)
     {
         melissa_free (moments->m3);
-        melissa_free (moments->theta3);
     }
     if (moments->max_order > 3)
     {
         melissa_free (moments->m4);
-        melissa_free (moments->theta4);
     }
 }
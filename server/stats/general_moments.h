@@ -30,6 +30,8 @@
 extern "C" {
 #endif
 
+#include "melissa_utils.h"
+
 /**
  *******************************************************************************
  *
@@ -37,21 +39,20 @@ extern "C" {
  *
  * @struct moments_s
  *
- * Structure containing general moments intermediate values
+ * Structure containing general moments intermediate values.
+ * The central moments are kept as sums of powers of deviations from the
+ * current mean (Welford/Pebay), the thetas are only computed for output.
  *
  *******************************************************************************/
 
 struct moments_s
 {
-    double *m1;        /**< mean1[vect_size]  */
-    double *m2;        /**< mean1[vect_size]  */
-    double *m3;        /**< mean3[vect_size]  */
-    double *m4;        /**< mean4[vect_size]  */
-    double *theta2;    /**< theta2[vect_size] */
-    double *theta3;    /**< theta3[vect_size] */
-    double *theta4;    /**< theta4[vect_size] */
-    int     increment; /**< increment         */
-    int     max_order; /**< max moment order  */
+    double *m1;        /**< mean[vect_size]                         */
+    double *m2;        /**< sum of (x - mean)^2, M2[vect_size]      */
+    double *m3;        /**< sum of (x - mean)^3, M3[vect_size]      */
+    double *m4;        /**< sum of (x - mean)^4, M4[vect_size]      */
+    int     increment; /**< increment                               */
+    int     max_order; /**< max moment order                        */
 };
 
 typedef struct moments_s moments_t; /**< type corresponding to moments_s */
@@ -60,10 +61,36 @@ void init_moments(moments_t *moments,
                   const int  vect_size,
                   const int  max_order);
 
+void init_moments_arena (moments_t       *moments,
+                         const int        vect_size,
+                         const int        max_order,
+                         melissa_arena_t *arena);
+
 void increment_moments (moments_t *moments,
                         double     in_vect[],
                         const int  vect_size);
 
+void increment_moments_block (moments_t *moments,
+                              double     in_vect[],
+                              const int  first,
+                              const int  last);
+
+void increment_moments_batch (moments_t  *moments,
+                              double    **in_vects,
+                              const int   nb_vects,
+                              const int   vect_size);
+
+void increment_moments_batch_block (moments_t  *moments,
+                                    double    **in_vects,
+                                    const int   nb_vects,
+                                    const int   first,
+                                    const int   last);
+
+void update_moments (moments_t *moments1,
+                     moments_t *moments2,
+                     moments_t *updated_moments,
+                     const int  vect_size);
+
 void save_moments(moments_t *moments,
                   int        vect_size,
                   int        nb_time_steps,
@@ -37,6 +37,34 @@
 #include "mean.h"
 #include "melissa_utils.h"
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a mean structure in a memory arena.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *mean
+ * the mean structure to initialize
+ *
+ * @param[in] vect_size
+ * size of the mean vector
+ *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ *
+ *******************************************************************************/
+
+void init_mean_arena (mean_t          *mean,
+                      const int        vect_size,
+                      melissa_arena_t *arena)
+{
+    mean->mean = melissa_arena_calloc (arena, vect_size, sizeof(double));
+    mean->increment = 0;
+}
+
 /**
  *******************************************************************************
  *
@@ -57,8 +85,7 @@
 void init_mean (mean_t    *mean,
                 const int  vect_size)
 {
-    mean->mean = melissa_calloc (vect_size, sizeof(double));
-    mean->increment = 0;
+    init_mean_arena (mean, vect_size, NULL);
 }
 
 /**
@@ -37,6 +37,7 @@ extern "C" {
 #include <mpi.h>
 #endif // BUILD_WITH_MPI
 #include <stdio.h>
+#include "melissa_utils.h"
 
 /**
  *******************************************************************************
@@ -60,6 +61,10 @@ typedef struct mean_s mean_t; /**< type corresponding to mean_s */
 void init_mean(mean_t    *mean,
                const int  vect_size);
 
+void init_mean_arena (mean_t          *mean,
+                      const int        vect_size,
+                      melissa_arena_t *arena);
+
 void increment_mean (mean_t    *mean,
                      double     in_vect[],
                      const int  vect_size);
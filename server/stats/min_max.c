@@ -32,6 +32,37 @@
 #include "min_max.h"
 #include "melissa_utils.h"
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a min and max structure in a memory arena.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *min_max
+ * the min and max structure to initialize
+ *
+ * @param[in] vect_size
+ * size of the vectors
+ *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ *
+ *******************************************************************************/
+
+void init_min_max_arena (min_max_t       *min_max,
+                         const int        vect_size,
+                         melissa_arena_t *arena)
+{
+    min_max->min = melissa_arena_calloc (arena, vect_size, sizeof(double));
+    min_max->max = melissa_arena_calloc (arena, vect_size, sizeof(double));
+    min_max->min_id = melissa_arena_calloc (arena, vect_size, sizeof(int));
+    min_max->max_id = melissa_arena_calloc (arena, vect_size, sizeof(int));
+    min_max->is_init = 0;
+}
+
 /**
  *******************************************************************************
  *
@@ -52,11 +83,7 @@
 void init_min_max (min_max_t *min_max,
                    const int  vect_size)
 {
-    min_max->min = melissa_malloc (vect_size * sizeof(double));
-    min_max->max = melissa_malloc (vect_size * sizeof(double));
-    min_max->min_id = melissa_calloc (vect_size, sizeof(int));
-    min_max->max_id = melissa_calloc (vect_size, sizeof(int));
-    min_max->is_init = 0;
+    init_min_max_arena (min_max, vect_size, NULL);
 }
 
 /**
@@ -65,7 +92,8 @@ void init_min_max (min_max_t *min_max,
  * @ingroup stats_base
  *
  * This function updates the min and the max values of min and max vectors
- * using the input vector.
+ * using the elements [first, last) of the input vector. is_init is not
+ * modified.
  *
  *******************************************************************************
  *
@@ -75,27 +103,33 @@ void init_min_max (min_max_t *min_max,
  * @param[in] in_vect[]
  * input vector of double values
  *
- * @param[in] vect_size
- * size of the input vectors
+ * @param[in] simu_id
+ * id of the simulation that produced in_vect
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
  *
  *******************************************************************************/
 
-void min_and_max (min_max_t *min_max,
-                  double     in_vect[],
-                  const int  simu_id,
-                  const int  vect_size)
+void min_and_max_block (min_max_t *min_max,
+                        double     in_vect[],
+                        const int  simu_id,
+                        const int  first,
+                        const int  last)
 {
+    int i;
+
     if (min_max->is_init == 0)
     {
-        memcpy (min_max->min, in_vect, vect_size * sizeof(double));
-        memcpy (min_max->max, in_vect, vect_size * sizeof(double));
-        min_max->is_init = 1;
+        memcpy (&min_max->min[first], &in_vect[first], (last - first) * sizeof(double));
+        memcpy (&min_max->max[first], &in_vect[first], (last - first) * sizeof(double));
     }
     else
     {
-        int     i;
-#pragma omp parallel for schedule(static)
-        for (i=0; i<vect_size; i++)
+        for (i=first; i<last; i++)
         {
             if (min_max->min[i] > in_vect[i])
             {
@@ -111,6 +145,174 @@ void min_and_max (min_max_t *min_max,
     }
 }
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the min and the max values of min and max vectors
+ * using the input vector.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *min_max
+ * the min and max structure
+ *
+ * @param[in] in_vect[]
+ * input vector of double values
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void min_and_max (min_max_t *min_max,
+                  double     in_vect[],
+                  const int  simu_id,
+                  const int  vect_size)
+{
+    int i;
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        min_and_max_block (min_max,
+                           in_vect,
+                           simu_id,
+                           i,
+                           (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
+    min_max->is_init = 1;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the min and the max values of min and max vectors
+ * using the elements [first, last) of several input vectors. If the structure
+ * is not initialized, the first vector initializes it. is_init is not
+ * modified.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *min_max
+ * the min and max structure
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] simu_id[]
+ * ids of the simulations that produced in_vects
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void min_and_max_batch_block (min_max_t  *min_max,
+                              double    **in_vects,
+                              const int   simu_id[],
+                              const int   nb_vects,
+                              const int   first,
+                              const int   last)
+{
+    int    i, k, k0 = 0;
+    int    min_id, max_id;
+    double min, max;
+
+    if (min_max->is_init == 0)
+    {
+        memcpy (&min_max->min[first], &in_vects[0][first], (last - first) * sizeof(double));
+        memcpy (&min_max->max[first], &in_vects[0][first], (last - first) * sizeof(double));
+        k0 = 1;
+    }
+    for (i=first; i<last; i++)
+    {
+        min    = min_max->min[i];
+        max    = min_max->max[i];
+        min_id = min_max->min_id[i];
+        max_id = min_max->max_id[i];
+        for (k=k0; k<nb_vects; k++)
+        {
+            if (min > in_vects[k][i])
+            {
+                min = in_vects[k][i];
+                min_id = simu_id[k];
+            }
+            if (max < in_vects[k][i])
+            {
+                max = in_vects[k][i];
+                max_id = simu_id[k];
+            }
+        }
+        min_max->min[i]    = min;
+        min_max->max[i]    = max;
+        min_max->min_id[i] = min_id;
+        min_max->max_id[i] = max_id;
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the min and the max values of min and max vectors
+ * using several input vectors.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *min_max
+ * the min and max structure
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] simu_id[]
+ * ids of the simulations that produced in_vects
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void min_and_max_batch (min_max_t  *min_max,
+                        double    **in_vects,
+                        const int   simu_id[],
+                        const int   nb_vects,
+                        const int   vect_size)
+{
+    int i;
+
+    if (nb_vects < 1)
+    {
+        return;
+    }
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        min_and_max_batch_block (min_max,
+                                 in_vects,
+                                 simu_id,
+                                 nb_vects,
+                                 i,
+                                 (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
+    min_max->is_init = 1;
+}
+
 /**
  *******************************************************************************
  *
@@ -29,6 +29,8 @@
 extern "C" {
 #endif
 
+#include "melissa_utils.h"
+
 /**
  *******************************************************************************
  *
@@ -54,11 +56,34 @@ typedef struct min_max_s min_max_t; /**< type corresponding to min_max_s */
 void init_min_max(min_max_t *min_max,
                   const int  vect_size);
 
+void init_min_max_arena (min_max_t       *min_max,
+                         const int        vect_size,
+                         melissa_arena_t *arena);
+
 void min_and_max (min_max_t *min_max,
                   double     in_vect[],
                   const int  simu_id,
                   const int  vect_size);
 
+void min_and_max_block (min_max_t *min_max,
+                        double     in_vect[],
+                        const int  simu_id,
+                        const int  first,
+                        const int  last);
+
+void min_and_max_batch (min_max_t  *min_max,
+                        double    **in_vects,
+                        const int   simu_id[],
+                        const int   nb_vects,
+                        const int   vect_size);
+
+void min_and_max_batch_block (min_max_t  *min_max,
+                              double    **in_vects,
+                              const int   simu_id[],
+                              const int   nb_vects,
+                              const int   first,
+                              const int   last);
+
 void save_min_max(min_max_t *minmax,
                   int        vect_size,
                   int        nb_time_steps,
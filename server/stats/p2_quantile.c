@@ -0,0 +1,726 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file p2_quantile.c
+ * @brief Extended P² quantile estimator.
+ * @author Terraz Théophile
+ * @date 2019-02-18
+ *
+ * Each element keeps 2m+3 markers for m quantile orders: the minimum, the
+ * maximum, one marker per order and one marker between two consecutive
+ * orders (Jain and Chlamtac, Raatikainen). A new value moves the positions
+ * of the markers above it, then the markers too far from their desired
+ * position are adjusted with a piecewise-parabolic interpolation.
+ * Until there are more values than markers, the markers are the sorted
+ * values themselves and the quantiles are exact.
+ *
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#ifdef BUILD_WITH_OPENMP
+#include <omp.h>
+#endif // BUILD_WITH_OPENMP
+#include "p2_quantile.h"
+#include "melissa_utils.h"
+
+static int compare_orders (const void *a,
+                           const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// adds x to the sketch of one element, nb_values counting x
+static void p2_insert (double       *height,
+                       int          *position,
+                       const double *order,
+                       int           nb_markers,
+                       int           nb_values,
+                       double        x)
+{
+    int    j, k, s;
+    double d, h;
+
+    if (nb_values <= nb_markers)
+    {
+        // the markers are still the sorted values
+        k = nb_values - 1;
+        while (k > 0 && height[k-1] > x)
+        {
+            height[k] = height[k-1];
+            k--;
+        }
+        height[k] = x;
+        if (nb_values == nb_markers)
+        {
+            for (j=0; j<nb_markers; j++)
+            {
+                position[j] = j + 1;
+            }
+        }
+        return;
+    }
+
+    if (x < height[0])
+    {
+        height[0] = x;
+        k = 0;
+    }
+    else if (x >= height[nb_markers-1])
+    {
+        height[nb_markers-1] = x;
+        k = nb_markers - 2;
+    }
+    else
+    {
+        k = 0;
+        while (x >= height[k+1])
+        {
+            k++;
+        }
+    }
+    for (j=k+1; j<nb_markers; j++)
+    {
+        position[j] += 1;
+    }
+
+    for (j=1; j<nb_markers-1; j++)
+    {
+        d = 1.0 + (nb_values - 1) * order[j] - position[j];
+        if ((d >= 1.0 && position[j+1] - position[j] > 1) ||
+            (d <= -1.0 && position[j-1] - position[j] < -1))
+        {
+            s = (d > 0) ? 1 : -1;
+            // parabolic prediction, linear if it leaves the neighbour interval
+            h = height[j] + (double)s / (position[j+1] - position[j-1])
+                * ((position[j] - position[j-1] + s) * (height[j+1] - height[j]) / (position[j+1] - position[j])
+                 + (position[j+1] - position[j] - s) * (height[j] - height[j-1]) / (position[j] - position[j-1]));
+            if (!(height[j-1] < h && h < height[j+1]))
+            {
+                h = height[j] + s * (height[j+s] - height[j]) / (position[j+s] - position[j]);
+            }
+            height[j] = h;
+            position[j] += s;
+        }
+    }
+}
+
+// number of values of one sketch below x, interpolated between the markers
+static double p2_rank (const double *height,
+                       const int    *position,
+                       int           nb_markers,
+                       double        x)
+{
+    int k;
+
+    if (x < height[0])
+    {
+        return 0.0;
+    }
+    if (x >= height[nb_markers-1])
+    {
+        return position[nb_markers-1];
+    }
+    k = 0;
+    while (x >= height[k+1])
+    {
+        k++;
+    }
+    return position[k] + (position[k+1] - position[k]) * (x - height[k]) / (height[k+1] - height[k]);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a P² quantile structure in a memory arena.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *p2
+ * the P² quantile structure to initialize
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ * @param[in] nb_quantiles
+ * number of quantile orders
+ *
+ * @param[in] quantile_order
+ * the quantile orders, in any order
+ *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ *
+ *******************************************************************************/
+
+void init_p2_quantile_arena (p2_quantile_t   *p2,
+                             const int        vect_size,
+                             const int        nb_quantiles,
+                             double          *quantile_order,
+                             melissa_arena_t *arena)
+{
+    int     i, nb_orders;
+    double *orders;
+
+    // sorted distinct orders, with the minimum and the maximum
+    orders = melissa_malloc ((nb_quantiles + 2) * sizeof(double));
+    orders[0] = 0.0;
+    orders[1] = 1.0;
+    for (i=0; i<nb_quantiles; i++)
+    {
+        orders[i+2] = (quantile_order[i] < 0.0) ? 0.0 : (quantile_order[i] > 1.0) ? 1.0 : quantile_order[i];
+    }
+    qsort (orders, nb_quantiles + 2, sizeof(double), compare_orders);
+    nb_orders = 1;
+    for (i=1; i<nb_quantiles+2; i++)
+    {
+        if (orders[i] != orders[nb_orders-1])
+        {
+            orders[nb_orders++] = orders[i];
+        }
+    }
+
+    // and one marker between two orders
+    p2->nb_markers = 2 * nb_orders - 1;
+    p2->order      = melissa_arena_calloc (arena, p2->nb_markers, sizeof(double));
+    for (i=0; i<nb_orders; i++)
+    {
+        p2->order[2*i] = orders[i];
+        if (i < nb_orders - 1)
+        {
+            p2->order[2*i+1] = (orders[i] + orders[i+1]) / 2.0;
+        }
+    }
+    melissa_free (orders);
+
+    p2->height    = melissa_arena_calloc (arena, vect_size * p2->nb_markers, sizeof(double));
+    p2->position  = melissa_arena_calloc (arena, vect_size * p2->nb_markers, sizeof(int));
+    p2->increment = 0;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a P² quantile structure.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *p2
+ * the P² quantile structure to initialize
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ * @param[in] nb_quantiles
+ * number of quantile orders
+ *
+ * @param[in] quantile_order
+ * the quantile orders, in any order
+ *
+ *******************************************************************************/
+
+void init_p2_quantile (p2_quantile_t *p2,
+                       const int      vect_size,
+                       const int      nb_quantiles,
+                       double        *quantile_order)
+{
+    init_p2_quantile_arena (p2, vect_size, nb_quantiles, quantile_order, NULL);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function adds the elements [first, last) of a vector to the sketches.
+ * The increment of the structure must already be updated.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *p2
+ * input: previously computed sketches,
+ * output: updated sketches
+ *
+ * @param[in] in_vect[]
+ * input vector of double values
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void increment_p2_quantile_block (p2_quantile_t *p2,
+                                  double         in_vect[],
+                                  const int      first,
+                                  const int      last)
+{
+    int i;
+
+    for (i=first; i<last; i++)
+    {
+        p2_insert (&p2->height[(size_t)i * p2->nb_markers],
+                   &p2->position[(size_t)i * p2->nb_markers],
+                   p2->order,
+                   p2->nb_markers,
+                   p2->increment,
+                   in_vect[i]);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function adds a vector to the sketches.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *p2
+ * input: previously computed sketches,
+ * output: updated sketches
+ *
+ * @param[in] in_vect[]
+ * input vector of double values
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void increment_p2_quantile (p2_quantile_t *p2,
+                            double         in_vect[],
+                            const int      vect_size)
+{
+    int i;
+
+    p2->increment += 1;
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        increment_p2_quantile_block (p2,
+                                     in_vect,
+                                     i,
+                                     (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function adds the elements [first, last) of several vectors to the
+ * sketches. The increment of the structure must already be updated.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *p2
+ * input: previously computed sketches,
+ * output: updated sketches
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void increment_p2_quantile_batch_block (p2_quantile_t  *p2,
+                                        double        **in_vects,
+                                        const int       nb_vects,
+                                        const int       first,
+                                        const int       last)
+{
+    int i, k;
+
+    for (i=first; i<last; i++)
+    {
+        for (k=0; k<nb_vects; k++)
+        {
+            p2_insert (&p2->height[(size_t)i * p2->nb_markers],
+                       &p2->position[(size_t)i * p2->nb_markers],
+                       p2->order,
+                       p2->nb_markers,
+                       p2->increment - nb_vects + k + 1,
+                       in_vects[k][i]);
+        }
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function adds several vectors to the sketches.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *p2
+ * input: previously computed sketches,
+ * output: updated sketches
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void increment_p2_quantile_batch (p2_quantile_t  *p2,
+                                  double        **in_vects,
+                                  const int       nb_vects,
+                                  const int       vect_size)
+{
+    int i;
+
+    p2->increment += nb_vects;
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        increment_p2_quantile_batch_block (p2,
+                                           in_vects,
+                                           nb_vects,
+                                           i,
+                                           (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function merges two P² quantile structures of the same elements, built
+ * with the same quantile orders. updated_p2 can be p2_1 or p2_2.
+ * A sketch still holding its values is replayed in the other one. Otherwise,
+ * the rank functions of the two sketches are summed, and the new markers are
+ * placed at their desired rank.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *p2_1
+ * first input P² quantile structure
+ *
+ * @param[in] *p2_2
+ * second input P² quantile structure
+ *
+ * @param[out] *updated_p2
+ * updated P² quantile structure
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void update_p2_quantile (p2_quantile_t *p2_1,
+                         p2_quantile_t *p2_2,
+                         p2_quantile_t *updated_p2,
+                         const int      vect_size)
+{
+    const int      nb_markers = updated_p2->nb_markers;
+    const int      n          = p2_1->increment + p2_2->increment;
+    p2_quantile_t *big        = (p2_1->increment >= p2_2->increment) ? p2_1 : p2_2;
+    p2_quantile_t *small      = (p2_1->increment >= p2_2->increment) ? p2_2 : p2_1;
+
+#pragma omp parallel
+    {
+        int     i, j, k, l, n_big;
+        double  r;
+        double *height   = melissa_malloc (nb_markers * sizeof(double));
+        int    *position = melissa_malloc (nb_markers * sizeof(int));
+        double *x        = melissa_malloc (2 * nb_markers * sizeof(double));
+        double *rank     = melissa_malloc (2 * nb_markers * sizeof(double));
+        const double *h1, *h2;
+        const int    *p1, *p2;
+
+#pragma omp for schedule(static)
+        for (i=0; i<vect_size; i++)
+        {
+            h1 = &big->height[(size_t)i * nb_markers];
+            p1 = &big->position[(size_t)i * nb_markers];
+            h2 = &small->height[(size_t)i * nb_markers];
+            p2 = &small->position[(size_t)i * nb_markers];
+
+            if (small->increment <= nb_markers)
+            {
+                // few values: insert them one by one
+                memcpy (height, h1, nb_markers * sizeof(double));
+                memcpy (position, p1, nb_markers * sizeof(int));
+                n_big = big->increment;
+                for (j=0; j<small->increment; j++)
+                {
+                    n_big += 1;
+                    p2_insert (height, position, updated_p2->order, nb_markers, n_big, h2[j]);
+                }
+            }
+            else
+            {
+                // sum of the two piecewise linear rank functions, at every marker height
+                j = k = l = 0;
+                while (j < nb_markers || k < nb_markers)
+                {
+                    if (k >= nb_markers || (j < nb_markers && h1[j] <= h2[k]))
+                    {
+                        x[l++] = h1[j++];
+                    }
+                    else
+                    {
+                        x[l++] = h2[k++];
+                    }
+                }
+                for (l=0; l<2*nb_markers; l++)
+                {
+                    rank[l] = p2_rank (h1, p1, nb_markers, x[l]) + p2_rank (h2, p2, nb_markers, x[l]);
+                }
+
+                height[0]              = x[0];
+                height[nb_markers-1]   = x[2*nb_markers-1];
+                position[0]            = 1;
+                position[nb_markers-1] = n;
+                l = 0;
+                for (j=1; j<nb_markers-1; j++)
+                {
+                    r = 1.0 + (n - 1) * updated_p2->order[j];
+                    while (l < 2*nb_markers-1 && rank[l] < r)
+                    {
+                        l++;
+                    }
+                    if (l == 0 || rank[l] <= rank[l-1])
+                    {
+                        height[j] = x[l];
+                    }
+                    else
+                    {
+                        height[j] = x[l-1] + (x[l] - x[l-1]) * (r - rank[l-1]) / (rank[l] - rank[l-1]);
+                    }
+                    position[j] = (int)(r + 0.5);
+                    if (position[j] <= position[j-1])
+                    {
+                        position[j] = position[j-1] + 1;
+                    }
+                    if (position[j] > n - (nb_markers - 1 - j))
+                    {
+                        position[j] = n - (nb_markers - 1 - j);
+                    }
+                }
+            }
+
+            memcpy (&updated_p2->height[(size_t)i * nb_markers], height, nb_markers * sizeof(double));
+            memcpy (&updated_p2->position[(size_t)i * nb_markers], position, nb_markers * sizeof(int));
+        }
+
+        melissa_free (height);
+        melissa_free (position);
+        melissa_free (x);
+        melissa_free (rank);
+    }
+    updated_p2->increment = n;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function computes the quantiles of every requested order from the sketches.
+ *
+ *******************************************************************************
+ *
+ * @param[in] *p2
+ * input P² quantile structure
+ *
+ * @param[out] *quantiles
+ * array of quantile structures, the orders are read from their alpha
+ *
+ * @param[in] nb_quantiles
+ * number of quantile structures
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void compute_p2_quantiles (p2_quantile_t *p2,
+                           quantile_t    *quantiles,
+                           const int      nb_quantiles,
+                           const int      vect_size)
+{
+    int     i, j, k;
+    int     marker;
+    double  index;
+    double *height;
+
+    for (j=0; j<nb_quantiles; j++)
+    {
+        quantiles[j].increment = p2->increment;
+        if (p2->increment < 1)
+        {
+            memset (quantiles[j].quantile, 0, vect_size * sizeof(double));
+        }
+        else if (p2->increment <= p2->nb_markers)
+        {
+            // exact quantile of the sorted values
+            index = quantiles[j].alpha * (p2->increment - 1);
+            index = (index < 0.0) ? 0.0 : (index > p2->increment - 1) ? p2->increment - 1 : index;
+            k = (int)index;
+#pragma omp parallel for schedule(static) private(height)
+            for (i=0; i<vect_size; i++)
+            {
+                height = &p2->height[(size_t)i * p2->nb_markers];
+                quantiles[j].quantile[i] = (k + 1 < p2->increment) ? height[k] + (height[k+1] - height[k]) * (index - k) : height[k];
+            }
+        }
+        else
+        {
+            marker = 0;
+            for (k=1; k<p2->nb_markers; k++)
+            {
+                if (fabs(p2->order[k] - quantiles[j].alpha) < fabs(p2->order[marker] - quantiles[j].alpha))
+                {
+                    marker = k;
+                }
+            }
+#pragma omp parallel for schedule(static)
+            for (i=0; i<vect_size; i++)
+            {
+                quantiles[j].quantile[i] = p2->height[(size_t)i * p2->nb_markers + marker];
+            }
+        }
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup save_stats
+ *
+ * This function writes an array of P² quantile structures on disc
+ *
+ *******************************************************************************
+ *
+ * @param[in] *p2
+ * P² quantile structures to save, size nb_time_steps
+ *
+ * @param[in] vect_size
+ * size of double vectors
+ *
+ * @param[in] nb_time_steps
+ * number of time_steps of the study
+ *
+ * @param[in] f
+ * file descriptor
+ *
+ *******************************************************************************/
+
+void save_p2_quantile (p2_quantile_t *p2,
+                       int            vect_size,
+                       int            nb_time_steps,
+                       FILE*          f)
+{
+    int i;
+    for (i=0; i<nb_time_steps; i++)
+    {
+        fwrite(p2[i].height, sizeof(double), vect_size * p2[i].nb_markers, f);
+        fwrite(p2[i].position, sizeof(int), vect_size * p2[i].nb_markers, f);
+        fwrite(&p2[i].increment, sizeof(int), 1, f);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup save_stats
+ *
+ * This function reads an array of P² quantile structures on disc
+ *
+ *******************************************************************************
+ *
+ * @param[in] *p2
+ * P² quantile structures to read, size nb_time_steps
+ *
+ * @param[in] vect_size
+ * size of double vectors
+ *
+ * @param[in] nb_time_steps
+ * number of time_steps of the study
+ *
+ * @param[in] f
+ * file descriptor
+ *
+ *******************************************************************************/
+
+void read_p2_quantile (p2_quantile_t *p2,
+                       int            vect_size,
+                       int            nb_time_steps,
+                       FILE*          f)
+{
+    int i;
+    for (i=0; i<nb_time_steps; i++)
+    {
+        fread(p2[i].height, sizeof(double), vect_size * p2[i].nb_markers, f);
+        fread(p2[i].position, sizeof(int), vect_size * p2[i].nb_markers, f);
+        fread(&p2[i].increment, sizeof(int), 1, f);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function frees a P² quantile structure.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *p2
+ * the P² quantile structure to free
+ *
+ *******************************************************************************/
+
+void free_p2_quantile (p2_quantile_t *p2)
+{
+    melissa_free (p2->order);
+    melissa_free (p2->height);
+    melissa_free (p2->position);
+}
@@ -0,0 +1,117 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file p2_quantile.h
+ * @author Terraz Théophile
+ * @date 2019-02-18
+ *
+ **/
+
+#ifndef P2_QUANTILE_H
+#define P2_QUANTILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "melissa_utils.h"
+#include "quantile.h"
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * @struct p2_quantile_s
+ *
+ * Structure containing one extended P² sketch per element of a vector.
+ * Every requested quantile order is a marker of the same sketch, and two
+ * sketches of the same elements can be merged.
+ *
+ *******************************************************************************/
+
+struct p2_quantile_s
+{
+    double *height;     /**< marker heights, height[vect_size * nb_markers]     */
+    int    *position;   /**< marker positions, position[vect_size * nb_markers] */
+    double *order;      /**< quantile order of each marker, order[nb_markers]   */
+    int     nb_markers; /**< number of markers per element                      */
+    int     increment;  /**< number of samples in each sketch                   */
+};
+
+typedef struct p2_quantile_s p2_quantile_t; /**< type corresponding to p2_quantile_s */
+
+void init_p2_quantile (p2_quantile_t *p2,
+                       const int      vect_size,
+                       const int      nb_quantiles,
+                       double        *quantile_order);
+
+void init_p2_quantile_arena (p2_quantile_t   *p2,
+                             const int        vect_size,
+                             const int        nb_quantiles,
+                             double          *quantile_order,
+                             melissa_arena_t *arena);
+
+void increment_p2_quantile (p2_quantile_t *p2,
+                            double         in_vect[],
+                            const int      vect_size);
+
+void increment_p2_quantile_block (p2_quantile_t *p2,
+                                  double         in_vect[],
+                                  const int      first,
+                                  const int      last);
+
+void increment_p2_quantile_batch (p2_quantile_t  *p2,
+                                  double        **in_vects,
+                                  const int       nb_vects,
+                                  const int       vect_size);
+
+void increment_p2_quantile_batch_block (p2_quantile_t  *p2,
+                                        double        **in_vects,
+                                        const int       nb_vects,
+                                        const int       first,
+                                        const int       last);
+
+void update_p2_quantile (p2_quantile_t *p2_1,
+                         p2_quantile_t *p2_2,
+                         p2_quantile_t *updated_p2,
+                         const int      vect_size);
+
+void compute_p2_quantiles (p2_quantile_t *p2,
+                           quantile_t    *quantiles,
+                           const int      nb_quantiles,
+                           const int      vect_size);
+
+void save_p2_quantile (p2_quantile_t *p2,
+                       int            vect_size,
+                       int            nb_time_steps,
+                       FILE*          f);
+
+void read_p2_quantile (p2_quantile_t *p2,
+                       int            vect_size,
+                       int            nb_time_steps,
+                       FILE*          f);
+
+void free_p2_quantile (p2_quantile_t *p2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // P2_QUANTILE_H
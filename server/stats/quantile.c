@@ -33,6 +33,39 @@
 #include "quantile.h"
 #include "melissa_utils.h"
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a quantile structure in a memory arena.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *quantile
+ * the quantile structure to initialize
+ *
+ * @param[in] vect_size
+ * size of the quantile vector
+ *
+ * @param[in] alpha
+ * the quantile order
+ *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ *
+ *******************************************************************************/
+
+void init_quantile_arena (quantile_t      *quantile,
+                          const int        vect_size,
+                          const double     alpha,
+                          melissa_arena_t *arena)
+{
+    quantile->quantile = melissa_arena_calloc (arena, vect_size, sizeof(double));
+    quantile->increment = 0;
+    quantile->alpha = alpha;
+}
+
 /**
  *******************************************************************************
  *
@@ -57,9 +90,7 @@ void init_quantile (quantile_t   *quantile,
                     const int     vect_size,
                     const double  alpha)
 {
-    quantile->quantile = melissa_calloc (vect_size, sizeof(double));
-    quantile->increment = 0;
-    quantile->alpha = alpha;
+    init_quantile_arena (quantile, vect_size, alpha, NULL);
 }
 
 /**
@@ -67,7 +98,8 @@ void init_quantile (quantile_t   *quantile,
  *
  * @ingroup stats_base
  *
- * This function updates the incremental quantile.
+ * This function updates the incremental quantile on the elements [first, last)
+ * of the vectors. The increment of the structure must already be updated.
  *
  *******************************************************************************
  *
@@ -81,27 +113,28 @@ void init_quantile (quantile_t   *quantile,
  * @param[in] in_vect[]
  * input vector of double values
  *
- * @param[in] vect_size
- * size of the input vectors
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
  *
  *******************************************************************************/
 
-void increment_quantile (quantile_t *quantile,
-                         const int   nmax,
-                         double      in_vect[],
-                         const int   vect_size)
+void increment_quantile_block (quantile_t *quantile,
+                               const int   nmax,
+                               double      in_vect[],
+                               const int   first,
+                               const int   last)
 {
     int    i;
     double temp, gamma;
 
-    quantile->increment += 1;
-
     if (quantile->increment > 1)
     {
-#pragma omp parallel for schedule(static) private(temp)
-        for (i=0; i<vect_size; i++)
+        gamma = (quantile->increment - 1) * 0.9 / (nmax-1) + 0.1;
+        for (i=first; i<last; i++)
         {
-            gamma = (quantile->increment - 1) * 0.9 / (nmax-1) + 0.1;
             if (quantile->quantile[i] >= in_vect[i])
             {
                 temp = 1 - quantile->alpha;
@@ -115,12 +148,170 @@ void increment_quantile (quantile_t *quantile,
     }
     else
     {
-//#pragma omp parallel for schedule(static)
-//        for (i=0; i<vect_size; i++)
-//        {
-//            quantile->quantile[i] = in_vect[i];
-//        }
-        memcpy (quantile->quantile, in_vect, vect_size * sizeof(double));
+        memcpy (&quantile->quantile[first], &in_vect[first], (last - first) * sizeof(double));
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the incremental quantile.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *quantile
+ * input: previously computed iterative quantile,
+ * output: updated partial quantile
+ *
+ * @param[in] nmax
+ * maximum number of iterations
+ *
+ * @param[in] in_vect[]
+ * input vector of double values
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void increment_quantile (quantile_t *quantile,
+                         const int   nmax,
+                         double      in_vect[],
+                         const int   vect_size)
+{
+    int i;
+
+    quantile->increment += 1;
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        increment_quantile_block (quantile,
+                                  nmax,
+                                  in_vect,
+                                  i,
+                                  (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the incremental quantile on the elements [first, last)
+ * of several input vectors. The vectors are applied in order, on a block small
+ * enough to stay in cache. The increment of the structure must already be
+ * updated.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *quantile
+ * input: previously computed iterative quantile,
+ * output: updated partial quantile
+ *
+ * @param[in] nmax
+ * maximum number of iterations
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void increment_quantile_batch_block (quantile_t  *quantile,
+                                     const int    nmax,
+                                     double     **in_vects,
+                                     const int    nb_vects,
+                                     const int    first,
+                                     const int    last)
+{
+    int    i, k, increment;
+    double step, gamma;
+
+    for (k=0; k<nb_vects; k++)
+    {
+        increment = quantile->increment - nb_vects + k + 1;
+        if (increment > 1)
+        {
+            // one pow per vector, not per element
+            gamma = (increment - 1) * 0.9 / (nmax-1) + 0.1;
+            step  = 1.0 / pow(increment, gamma);
+            for (i=first; i<last; i++)
+            {
+                if (quantile->quantile[i] >= in_vects[k][i])
+                {
+                    quantile->quantile[i] -= (1 - quantile->alpha) * step;
+                }
+                else
+                {
+                    quantile->quantile[i] += quantile->alpha * step;
+                }
+            }
+        }
+        else
+        {
+            memcpy (&quantile->quantile[first], &in_vects[k][first], (last - first) * sizeof(double));
+        }
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the incremental quantile with several input vectors.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *quantile
+ * input: previously computed iterative quantile,
+ * output: updated partial quantile
+ *
+ * @param[in] nmax
+ * maximum number of iterations
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void increment_quantile_batch (quantile_t  *quantile,
+                               const int    nmax,
+                               double     **in_vects,
+                               const int    nb_vects,
+                               const int    vect_size)
+{
+    int i;
+
+    quantile->increment += nb_vects;
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        increment_quantile_batch_block (quantile,
+                                        nmax,
+                                        in_vects,
+                                        nb_vects,
+                                        i,
+                                        (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
     }
 }
 
@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 #include <stdio.h>
+#include "melissa_utils.h"
 
 /**
  *******************************************************************************
@@ -57,11 +58,35 @@ void init_quantile (quantile_t   *quantile,
                     const int     vect_size,
                     const double  alpha);
 
+void init_quantile_arena (quantile_t      *quantile,
+                          const int        vect_size,
+                          const double     alpha,
+                          melissa_arena_t *arena);
+
 void increment_quantile (quantile_t *quantile,
                          const int   nmax,
                          double      in_vect[],
                          const int   vect_size);
 
+void increment_quantile_block (quantile_t *quantile,
+                               const int   nmax,
+                               double      in_vect[],
+                               const int   first,
+                               const int   last);
+
+void increment_quantile_batch (quantile_t  *quantile,
+                               const int    nmax,
+                               double     **in_vects,
+                               const int    nb_vects,
+                               const int    vect_size);
+
+void increment_quantile_batch_block (quantile_t  *quantile,
+                                     const int    nmax,
+                                     double     **in_vects,
+                                     const int    nb_vects,
+                                     const int    first,
+                                     const int    last);
+
 void save_quantile(quantile_t **quantile,
                    int          vect_size,
                    int          nb_time_steps,
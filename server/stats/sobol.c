@@ -36,26 +36,110 @@
 #include "sobol.h"
 #include "melissa_utils.h"
 
-static inline void increment_sobol_covariance (double    *covariance,
-                                               double     in_vect1[],
-                                               double     in_vect2[],
-                                               double     mean1[],
-                                               double     mean2[],
-                                               const int  vect_size,
-                                               const int  increment)
+// pairwise update of a variance or covariance (divided by n-1) of n1 values,
+// with the co-moment c2 of n2 new values. delta1 and delta2 are the differences
+// between the means of the new values and the previous means.
+static inline double sobol_merge_covariance (double covariance,
+                                             double c2,
+                                             double delta1,
+                                             double delta2,
+                                             double n1,
+                                             double n2)
 {
-    int     i;
-    double  incr = 0;
+    double c1 = (n1 > 1) ? covariance * (n1 - 1) : 0.0;
+    double n  = n1 + n2;
+    return (n > 1) ? (c1 + c2 + delta1 * delta2 * n1 * n2 / n) / (n - 1) : 0.0;
+}
+
+// Martinez indices of parameter i on element j, from the variances and covariances
+static inline void sobol_martinez_indices (sobol_array_t *sobol_array,
+                                           const int      i,
+                                           const int      j)
+{
+    const double epsylon = 1e-12;
+    const double var_k   = sobol_array->sobol_martinez[i].variance_k.variance[j];
 
-    incr = (double)increment;
-    if (increment > 1)
+    if (var_k > epsylon && sobol_array->variance_b.variance[j] > epsylon)
     {
-#pragma omp parallel for schedule(static) firstprivate(incr)
-        for (i=0; i<vect_size; i++)
+        sobol_array->sobol_martinez[i].first_order_values[j] = sobol_array->sobol_martinez[i].first_order_covariance[j]
+                / ( sqrt(sobol_array->variance_b.variance[j]) * sqrt(var_k) );
+    }
+    else
+    {
+        sobol_array->sobol_martinez[i].first_order_values[j] = 0;
+    }
+    if (var_k > epsylon && sobol_array->variance_a.variance[j] > epsylon)
+    {
+        sobol_array->sobol_martinez[i].total_order_values[j] = 1.0 - sobol_array->sobol_martinez[i].total_order_covariance[j]
+                / ( sqrt(sobol_array->variance_a.variance[j]) * sqrt(var_k) );
+    }
+    else
+    {
+        sobol_array->sobol_martinez[i].total_order_values[j] = 0;
+    }
+}
+
+// Martinez update of one group on the elements [first, last): the means and
+// variances of A, B and C_k and the covariances are updated while the block is
+// in cache. n is the number of groups, including this one.
+static void increment_sobol_martinez_block (sobol_array_t *sobol_array,
+                                            const int      nb_parameters,
+                                            double       **in_vect_tab,
+                                            const double   n,
+                                            const int      first,
+                                            const int      last)
+{
+    int     i, j;
+    double  temp, diff_k;
+    double  diff_a[MELISSA_BLOCK_SIZE];
+    double  diff_b[MELISSA_BLOCK_SIZE];
+    double *mean, *variance;
+    double *first_cov, *total_cov;
+    const int size = last - first;
+
+    // A and B first, the covariances use their updated means
+    mean     = &sobol_array->variance_a.mean_structure.mean[first];
+    variance = &sobol_array->variance_a.variance[first];
+    for (j=0; j<size; j++)
+    {
+        temp      = mean[j];
+        mean[j]   = temp + (in_vect_tab[0][first+j] - temp)/n;
+        diff_a[j] = in_vect_tab[0][first+j] - mean[j];
+        if (n > 1)
+        {
+            variance[j] = (variance[j] * (n - 2) + diff_a[j] * diff_a[j] * (n/(n-1))) / (n - 1);
+        }
+    }
+    mean     = &sobol_array->variance_b.mean_structure.mean[first];
+    variance = &sobol_array->variance_b.variance[first];
+    for (j=0; j<size; j++)
+    {
+        temp      = mean[j];
+        mean[j]   = temp + (in_vect_tab[1][first+j] - temp)/n;
+        diff_b[j] = in_vect_tab[1][first+j] - mean[j];
+        if (n > 1)
+        {
+            variance[j] = (variance[j] * (n - 2) + diff_b[j] * diff_b[j] * (n/(n-1))) / (n - 1);
+        }
+    }
+
+    for (i=0; i<nb_parameters; i++)
+    {
+        mean      = &sobol_array->sobol_martinez[i].variance_k.mean_structure.mean[first];
+        variance  = &sobol_array->sobol_martinez[i].variance_k.variance[first];
+        first_cov = &sobol_array->sobol_martinez[i].first_order_covariance[first];
+        total_cov = &sobol_array->sobol_martinez[i].total_order_covariance[first];
+        for (j=0; j<size; j++)
         {
-            covariance[i] *= (incr - 2);
-            covariance[i] += (in_vect1[i] - mean1[i]) * (in_vect2[i] - mean2[i]) * (incr/(incr-1));
-            covariance[i] /= (incr - 1);
+            temp    = mean[j];
+            mean[j] = temp + (in_vect_tab[i+2][first+j] - temp)/n;
+            diff_k  = in_vect_tab[i+2][first+j] - mean[j];
+            if (n > 1)
+            {
+                variance[j]  = (variance[j] * (n - 2) + diff_k * diff_k * (n/(n-1))) / (n - 1);
+                first_cov[j] = (first_cov[j] * (n - 2) + diff_b[j] * diff_k * (n/(n-1))) / (n - 1);
+                total_cov[j] = (total_cov[j] * (n - 2) + diff_a[j] * diff_k * (n/(n-1))) / (n - 1);
+            }
         }
     }
 }
@@ -96,6 +180,10 @@ void init_sobol_jansen (sobol_array_t *sobol_array,
         sobol_array->sobol_jansen[j].total_order_values = melissa_calloc (vect_size, sizeof(double));
     }
     sobol_array->iteration = 0;
+    sobol_array->values_iteration = 0;
+    sobol_array->interval = 2.0;
+    sobol_array->fisher_z = 0.0;
+    sobol_array->checked_iteration = 0;
 }
 
 /**
@@ -103,7 +191,7 @@ void init_sobol_jansen (sobol_array_t *sobol_array,
  *
  * @ingroup sobol
  *
- * This function initialise a Martinez Sobol indices structure
+ * This function initialise a Martinez Sobol indices structure in a memory arena
  *
  *******************************************************************************
  *
@@ -117,30 +205,67 @@ void init_sobol_jansen (sobol_array_t *sobol_array,
  * @param[in] vect_size
  * size of the input vectors
  *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ * (the sobol_martinez array itself is always on the heap)
+ *
  *******************************************************************************/
 
-void init_sobol_martinez (sobol_array_t *sobol_array,
-                          int            nb_parameters,
-                          int            vect_size)
+void init_sobol_martinez_arena (sobol_array_t   *sobol_array,
+                                int              nb_parameters,
+                                int              vect_size,
+                                melissa_arena_t *arena)
 {
     int j;
     sobol_array->sobol_martinez = melissa_malloc (nb_parameters * sizeof(sobol_martinez_t));
-    init_variance (&sobol_array->variance_b, vect_size);
-    init_variance (&sobol_array->variance_a, vect_size);
+    init_variance_arena (&sobol_array->variance_b, vect_size, arena);
+    init_variance_arena (&sobol_array->variance_a, vect_size, arena);
     for (j=0; j<nb_parameters; j++)
     {
 //        init_covariance (&(sobol_array->sobol_martinez[j].first_order_covariance), vect_size);
 //        init_covariance (&(sobol_array->sobol_martinez[j].total_order_covariance), vect_size);
-        sobol_array->sobol_martinez[j].first_order_covariance= melissa_calloc (vect_size, sizeof(double));
-        sobol_array->sobol_martinez[j].total_order_covariance= melissa_calloc (vect_size, sizeof(double));
-        init_variance (&(sobol_array->sobol_martinez[j].variance_k), vect_size);
+        sobol_array->sobol_martinez[j].first_order_covariance= melissa_arena_calloc (arena, vect_size, sizeof(double));
+        sobol_array->sobol_martinez[j].total_order_covariance= melissa_arena_calloc (arena, vect_size, sizeof(double));
+        init_variance_arena (&(sobol_array->sobol_martinez[j].variance_k), vect_size, arena);
 
-        sobol_array->sobol_martinez[j].first_order_values = melissa_calloc (vect_size, sizeof(double));
-        sobol_array->sobol_martinez[j].total_order_values = melissa_calloc (vect_size, sizeof(double));
+        sobol_array->sobol_martinez[j].first_order_values = melissa_arena_calloc (arena, vect_size, sizeof(double));
+        sobol_array->sobol_martinez[j].total_order_values = melissa_arena_calloc (arena, vect_size, sizeof(double));
         sobol_array->sobol_martinez[j].confidence_interval[0] = 1;
         sobol_array->sobol_martinez[j].confidence_interval[1] = 1;
     }
     sobol_array->iteration = 0;
+    sobol_array->values_iteration = 0;
+    sobol_array->interval = 2.0;
+    sobol_array->fisher_z = 0.0;
+    sobol_array->checked_iteration = 0;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup sobol
+ *
+ * This function initialise a Martinez Sobol indices structure
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *sobol_array
+ * input: reference or pointer to an uninitialised sobol indices structure,
+ * output: initialised structure, with values and variances set to 0
+ *
+ * @param[in] nb_parameters
+ * number of parameters of the study
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void init_sobol_martinez (sobol_array_t *sobol_array,
+                          int            nb_parameters,
+                          int            vect_size)
+{
+    init_sobol_martinez_arena (sobol_array, nb_parameters, vect_size, NULL);
 }
 
 /**
@@ -229,7 +354,10 @@ void increment_sobol_jansen (sobol_array_t *sobol_array,
  *
  * @ingroup sobol
  *
- * This function computes Sobol indices using Martinez formula
+ * This function updates the Martinez Sobol statistics with a simulation group.
+ * The vectors are processed by blocks of MELISSA_BLOCK_SIZE elements, and the
+ * means, variances and covariances are all updated on a block in one pass.
+ * The index values are only computed by compute_sobol_martinez_values.
  *
  *******************************************************************************
  *
@@ -252,66 +380,180 @@ void increment_sobol_martinez (sobol_array_t *sobol_array,
                                double       **in_vect_tab,
                                int            vect_size)
 {
-    int i, j;
-    double epsylon = 1e-12;
+    int    i;
+    const double n = sobol_array->iteration + 1;
 
-    increment_variance (&(sobol_array->variance_a), in_vect_tab[0], vect_size);
-    increment_variance (&(sobol_array->variance_b), in_vect_tab[1], vect_size);
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        increment_sobol_martinez_block (sobol_array,
+                                        nb_parameters,
+                                        in_vect_tab,
+                                        n,
+                                        i,
+                                        (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
 
-    for (i=0; i< nb_parameters; i++)
+    sobol_array->variance_a.mean_structure.increment += 1;
+    sobol_array->variance_b.mean_structure.increment += 1;
+    for (i=0; i<nb_parameters; i++)
     {
-        increment_variance (&(sobol_array->sobol_martinez[i].variance_k), in_vect_tab[i+2], vect_size);
-        increment_sobol_covariance (sobol_array->sobol_martinez[i].first_order_covariance,
-                                    in_vect_tab[1],
-                                    in_vect_tab[i+2],
-                                    sobol_array->variance_b.mean_structure.mean,
-                                    sobol_array->sobol_martinez[i].variance_k.mean_structure.mean,
-                                    vect_size,
-                                    sobol_array->iteration);
-        increment_sobol_covariance (sobol_array->sobol_martinez[i].total_order_covariance,
-                                    in_vect_tab[0],
-                                    in_vect_tab[i+2],
-                                    sobol_array->variance_a.mean_structure.mean,
-                                    sobol_array->sobol_martinez[i].variance_k.mean_structure.mean,
-                                    vect_size,
-                                    sobol_array->iteration);
-//        increment_covariance (&(sobol_array->sobol_martinez[i].first_order_covariance), in_vect_tab[1], in_vect_tab[i+2], vect_size);
-//        increment_covariance (&(sobol_array->sobol_martinez[i].total_order_covariance), in_vect_tab[0], in_vect_tab[i+2], vect_size);
+        sobol_array->sobol_martinez[i].variance_k.mean_structure.increment += 1;
+    }
+    sobol_array->iteration += 1;
+}
 
-#pragma omp parallel
+/**
+ *******************************************************************************
+ *
+ * @ingroup sobol
+ *
+ * This function updates the Martinez Sobol statistics with the vectors of
+ * several simulation groups. The means, variances and covariances
+ * of the batch are computed element by element, then merged with the previous
+ * ones (Chan et al.), so that the Sobol arrays are read and written once per
+ * batch.
+ *
+ *******************************************************************************
+ *
+ * @param[out] *sobol_array
+ * computed sobol indices, using Martinez formula
+ *
+ * @param[in] nb_parameters
+ * size of sobol_array->sobol_martinez
+ *
+ * @param[in] ***in_vect_tabs
+ * arrays of input vectors, one array per simulation group
+ *
+ * @param[in] nb_groups
+ * number of simulation groups
+ *
+ * @param[in] vect_size
+ * size of input vectors
+ *
+ *******************************************************************************/
+
+void increment_sobol_martinez_batch (sobol_array_t  *sobol_array,
+                                     int             nb_parameters,
+                                     double       ***in_vect_tabs,
+                                     int             nb_groups,
+                                     int             vect_size)
+{
+    int    i, j, k;
+    double mean_a, mean_b, mean_k, delta_a, delta_b, delta_k;
+    double m2_a, m2_b, m2_k, c_ak, c_bk, d_k;
+    const double n1 = sobol_array->iteration;
+    const double n2 = nb_groups;
+
+    if (nb_groups < 1)
+    {
+        return;
+    }
+
+#pragma omp parallel for schedule(static) private(i, k, mean_a, mean_b, mean_k, delta_a, delta_b, delta_k, m2_a, m2_b, m2_k, c_ak, c_bk, d_k)
+    for (j=0; j<vect_size; j++)
+    {
+        mean_a = mean_b = 0.0;
+        for (k=0; k<nb_groups; k++)
         {
-#pragma omp for nowait schedule(static)
-            for (j=0; j<vect_size; j++)
+            mean_a += in_vect_tabs[k][0][j];
+            mean_b += in_vect_tabs[k][1][j];
+        }
+        mean_a /= n2;
+        mean_b /= n2;
+        delta_a = mean_a - sobol_array->variance_a.mean_structure.mean[j];
+        delta_b = mean_b - sobol_array->variance_b.mean_structure.mean[j];
+
+        for (i=0; i<nb_parameters; i++)
+        {
+            mean_k = 0.0;
+            for (k=0; k<nb_groups; k++)
             {
-                if (sobol_array->sobol_martinez[i].variance_k.variance[j] > epsylon && sobol_array->variance_b.variance[j] > epsylon)
-                {
-                    sobol_array->sobol_martinez[i].first_order_values[j] = sobol_array->sobol_martinez[i].first_order_covariance[j]
-                            / ( sqrt(sobol_array->variance_b.variance[j])
-                                * sqrt(sobol_array->sobol_martinez[i].variance_k.variance[j]) );
-                }
-                else
-                {
-                    sobol_array->sobol_martinez[i].first_order_values[j] = 0;
-                }
+                mean_k += in_vect_tabs[k][i+2][j];
             }
-
-#pragma omp for nowait schedule(static)
-            for (j=0; j<vect_size; j++)
+            mean_k /= n2;
+            m2_k = c_ak = c_bk = 0.0;
+            for (k=0; k<nb_groups; k++)
             {
-                if (sobol_array->sobol_martinez[i].variance_k.variance[j] > epsylon && sobol_array->variance_a.variance[j] > epsylon)
-                {
-                    sobol_array->sobol_martinez[i].total_order_values[j] = 1.0 - sobol_array->sobol_martinez[i].total_order_covariance[j]
-                            / ( sqrt(sobol_array->variance_a.variance[j])
-                                * sqrt(sobol_array->sobol_martinez[i].variance_k.variance[j]) );
-                }
-                else
-                {
-                    sobol_array->sobol_martinez[i].total_order_values[j] = 0;
-                }
+                d_k   = in_vect_tabs[k][i+2][j] - mean_k;
+                m2_k += d_k * d_k;
+                c_ak += (in_vect_tabs[k][0][j] - mean_a) * d_k;
+                c_bk += (in_vect_tabs[k][1][j] - mean_b) * d_k;
             }
+            delta_k = mean_k - sobol_array->sobol_martinez[i].variance_k.mean_structure.mean[j];
+
+            sobol_array->sobol_martinez[i].first_order_covariance[j] =
+                sobol_merge_covariance (sobol_array->sobol_martinez[i].first_order_covariance[j], c_bk, delta_b, delta_k, n1, n2);
+            sobol_array->sobol_martinez[i].total_order_covariance[j] =
+                sobol_merge_covariance (sobol_array->sobol_martinez[i].total_order_covariance[j], c_ak, delta_a, delta_k, n1, n2);
+            sobol_array->sobol_martinez[i].variance_k.variance[j] =
+                sobol_merge_covariance (sobol_array->sobol_martinez[i].variance_k.variance[j], m2_k, delta_k, delta_k, n1, n2);
+            sobol_array->sobol_martinez[i].variance_k.mean_structure.mean[j] += delta_k * n2 / (n1 + n2);
+        }
+
+        // A and B last, the covariances need their previous means
+        m2_a = m2_b = 0.0;
+        for (k=0; k<nb_groups; k++)
+        {
+            m2_a += (in_vect_tabs[k][0][j] - mean_a) * (in_vect_tabs[k][0][j] - mean_a);
+            m2_b += (in_vect_tabs[k][1][j] - mean_b) * (in_vect_tabs[k][1][j] - mean_b);
         }
+        sobol_array->variance_a.variance[j] = sobol_merge_covariance (sobol_array->variance_a.variance[j], m2_a, delta_a, delta_a, n1, n2);
+        sobol_array->variance_b.variance[j] = sobol_merge_covariance (sobol_array->variance_b.variance[j], m2_b, delta_b, delta_b, n1, n2);
+        sobol_array->variance_a.mean_structure.mean[j] += delta_a * n2 / (n1 + n2);
+        sobol_array->variance_b.mean_structure.mean[j] += delta_b * n2 / (n1 + n2);
     }
-    sobol_array->iteration += 1;
+
+    sobol_array->variance_a.mean_structure.increment += nb_groups;
+    sobol_array->variance_b.mean_structure.increment += nb_groups;
+    for (i=0; i<nb_parameters; i++)
+    {
+        sobol_array->sobol_martinez[i].variance_k.mean_structure.increment += nb_groups;
+    }
+    sobol_array->iteration += nb_groups;
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup sobol
+ *
+ * This function computes the Martinez Sobol index values from the variances
+ * and covariances, if they changed since the last call.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *sobol_array
+ * Sobol indices
+ *
+ * @param[in] nb_parameters
+ * size of sobol_array->sobol_martinez
+ *
+ * @param[in] vect_size
+ * size of the vectors
+ *
+ *******************************************************************************/
+
+void compute_sobol_martinez_values (sobol_array_t *sobol_array,
+                                    int            nb_parameters,
+                                    int            vect_size)
+{
+    int i, j;
+
+    if (sobol_array->values_iteration == sobol_array->iteration)
+    {
+        return;
+    }
+
+#pragma omp parallel for schedule(static) private(i)
+    for (j=0; j<vect_size; j++)
+    {
+        for (i=0; i<nb_parameters; i++)
+        {
+            sobol_martinez_indices (sobol_array, i, j);
+        }
+    }
+    sobol_array->values_iteration = sobol_array->iteration;
 }
 
 /**
@@ -339,39 +581,96 @@ void confidence_sobol_martinez(sobol_array_t *sobol_array,
                                int            vect_size)
 {
     int i, j;
-    double temp1, temp2, interval;
+    double half_width, min_first, min_total, fisher_z;
 
     if (sobol_array->iteration < 4)
     {
         return;
     }
 
-    temp2 = 1.96/(sqrt(sobol_array->iteration-3));
+    compute_sobol_martinez_values (sobol_array, nb_parameters, vect_size);
+    // the Fisher interval tanh(z+h) - tanh(z-h) is largest for the smallest |z|,
+    // and z = atanh(r) is monotonic, so only the smallest |r| is needed
+    half_width = 1.96/(sqrt(sobol_array->iteration-3));
+    sobol_array->fisher_z = INFINITY;
     for (j=0; j< nb_parameters; j++)
     {
-        interval = 0;
-        sobol_array->sobol_martinez[j].confidence_interval[0]=0;
-        sobol_array->sobol_martinez[j].confidence_interval[1]=0;
+        min_first = 1.0;
+        min_total = 1.0;
+#pragma omp parallel for schedule(static) reduction(min:min_first, min_total)
         for (i=0; i<vect_size; i++)
         {
-            temp1 = 0.5 * log((1.0+sobol_array->sobol_martinez[j].first_order_values[i])/(1.0-sobol_array->sobol_martinez[j].first_order_values[i]));
-            interval = tanh(temp1 + temp2) - tanh(temp1 - temp2);
-            if (sobol_array->sobol_martinez[j].confidence_interval[0] < interval)
-            {
-                sobol_array->sobol_martinez[j].confidence_interval[0] = interval;
-            }
+            min_first = fmin (min_first, fabs(sobol_array->sobol_martinez[j].first_order_values[i]));
+            min_total = fmin (min_total, fabs(1.0 - sobol_array->sobol_martinez[j].total_order_values[i]));
         }
-        interval = 0;
-        for (i=0; i<vect_size; i++)
+        fisher_z = atanh (min_first);
+        sobol_array->sobol_martinez[j].confidence_interval[0] = tanh(fisher_z + half_width) - tanh(fisher_z - half_width);
+        sobol_array->fisher_z = fmin (sobol_array->fisher_z, fisher_z);
+        fisher_z = atanh (min_total);
+        sobol_array->sobol_martinez[j].confidence_interval[1] = tanh(fisher_z + half_width) - tanh(fisher_z - half_width);
+        sobol_array->fisher_z = fmin (sobol_array->fisher_z, fisher_z);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup sobol
+ *
+ * This function updates the worst confidence interval of Martinez Sobol
+ * indices after an increment. The interval is predicted from the Fisher
+ * transform of the worst index at the last check, and the indices are only
+ * checked again when the prediction reaches confidence_value, or when the
+ * number of groups doubled since the last check.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *sobol_array
+ * Sobol indices
+ *
+ * @param[in] nb_parameters
+ * size of sobol_array->sobol_martinez
+ *
+ * @param[in] vect_size
+ * size of input vectors
+ *
+ * @param[in] confidence_value
+ * value to reach for the worst confidence interval
+ *
+ * @return The worst confidence interval (first and total order)
+ *
+ *******************************************************************************/
+
+double update_confidence_sobol_martinez(sobol_array_t *sobol_array,
+                                        int            nb_parameters,
+                                        int            vect_size,
+                                        double         confidence_value)
+{
+    int    j;
+    double half_width;
+
+    if (sobol_array->iteration < 4)
+    {
+        sobol_array->interval = simplified_confidence_sobol_martinez (sobol_array->iteration);
+        return sobol_array->interval;
+    }
+
+    half_width = 1.96/(sqrt(sobol_array->iteration-3));
+    sobol_array->interval = tanh(sobol_array->fisher_z + half_width) - tanh(sobol_array->fisher_z - half_width);
+    if (sobol_array->checked_iteration == 0 ||
+        sobol_array->interval <= confidence_value ||
+        sobol_array->iteration >= 2 * sobol_array->checked_iteration)
+    {
+        confidence_sobol_martinez (sobol_array, nb_parameters, vect_size);
+        sobol_array->checked_iteration = sobol_array->iteration;
+        sobol_array->interval = 0;
+        for (j=0; j<nb_parameters; j++)
         {
-            temp1 = 0.5 * log((2.0-sobol_array->sobol_martinez[j].total_order_values[i])/sobol_array->sobol_martinez[j].total_order_values[i]);
-            interval = (1-tanh(temp1 - temp2)) - (1-tanh(temp1 + temp2));
-            if (sobol_array->sobol_martinez[j].confidence_interval[1] < interval)
-            {
-                sobol_array->sobol_martinez[j].confidence_interval[1] = interval;
-            }
+            sobol_array->interval = fmax (sobol_array->interval, sobol_array->sobol_martinez[j].confidence_interval[0]);
+            sobol_array->interval = fmax (sobol_array->interval, sobol_array->sobol_martinez[j].confidence_interval[1]);
         }
     }
+    return sobol_array->interval;
 }
 
 /**
@@ -533,6 +832,7 @@ void save_sobol_martinez(sobol_array_t *sobol_array,
     int i, j;
     for (i=0; i<nb_time_steps; i++)
     {
+        compute_sobol_martinez_values (&sobol_array[i], nb_parameters, vect_size);
         for (j=0; j<nb_parameters; j++)
         {
             fwrite(sobol_array[i].sobol_martinez[j].first_order_covariance, sizeof(double), vect_size,f);
@@ -642,6 +942,8 @@ void read_sobol_martinez(sobol_array_t *sobol_array,
         read_variance (&sobol_array[i].variance_a, vect_size, 1, f);
         read_variance (&sobol_array[i].variance_b, vect_size, 1, f);
         fread(&sobol_array[i].iteration, sizeof(int), 1, f);
+        sobol_array[i].values_iteration = sobol_array[i].iteration;
+        sobol_array[i].checked_iteration = 0;
     }
 }
 
@@ -29,6 +29,8 @@
 extern "C" {
 #endif
 
+#include "melissa_utils.h"
+
 /**
  *******************************************************************************
  *
@@ -86,11 +88,15 @@ typedef struct sobol_martinez_s sobol_martinez_t; /**< type corresponding to sob
 
 struct sobol_array_s
 {
-    sobol_jansen_t   *sobol_jansen;   /**< array of sobol indices, size nb_parameters     */
-    sobol_martinez_t *sobol_martinez; /**< array of sobol indices, size nb_parameters     */
-    variance_t        variance_a;     /**< first set variance needed by Martinez formula  */
-    variance_t        variance_b;     /**< second set variance needed by Martinez formula */
-    int               iteration;      /**< number of computed groups                      */
+    sobol_jansen_t   *sobol_jansen;      /**< array of sobol indices, size nb_parameters     */
+    sobol_martinez_t *sobol_martinez;    /**< array of sobol indices, size nb_parameters     */
+    variance_t        variance_a;        /**< first set variance needed by Martinez formula  */
+    variance_t        variance_b;        /**< second set variance needed by Martinez formula */
+    int               iteration;         /**< number of computed groups                      */
+    int               values_iteration;  /**< iteration of the last computed index values    */
+    int               checked_iteration; /**< iteration of the last confidence check         */
+    double            fisher_z;          /**< smallest Fisher transform at the last check    */
+    double            interval;          /**< worst confidence interval of the indices       */
 };
 
 typedef struct sobol_array_s sobol_array_t; /**< type corresponding to sobol_array_s */
@@ -103,6 +109,11 @@ void init_sobol_martinez (sobol_array_t *sobol_array,
                           int            nb_parameters,
                           int            vect_size);
 
+void init_sobol_martinez_arena (sobol_array_t   *sobol_array,
+                                int              nb_parameters,
+                                int              vect_size,
+                                melissa_arena_t *arena);
+
 void increment_sobol_jansen (sobol_array_t *sobol_array,
                              int            nb_parameters,
                              double       **in_vect_tab,
@@ -113,10 +124,25 @@ void increment_sobol_martinez (sobol_array_t *sobol_array,
                                double       **in_vect_tab,
                                int            vect_size);
 
+void increment_sobol_martinez_batch (sobol_array_t  *sobol_array,
+                                     int             nb_parameters,
+                                     double       ***in_vect_tabs,
+                                     int             nb_groups,
+                                     int             vect_size);
+
+void compute_sobol_martinez_values (sobol_array_t *sobol_array,
+                                    int            nb_parameters,
+                                    int            vect_size);
+
 void confidence_sobol_martinez(sobol_array_t *sobol_array,
                                int            nb_parameters,
                                int            vect_size);
 
+double update_confidence_sobol_martinez(sobol_array_t *sobol_array,
+                                        int            nb_parameters,
+                                        int            vect_size,
+                                        double         confidence_value);
+
 double simplified_confidence_sobol_martinez(int iteration);
 
 int check_convergence_sobol_martinez(sobol_array_t **sobol_array,
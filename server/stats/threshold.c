@@ -31,6 +31,38 @@
 #include "threshold.h"
 #include "melissa_utils.h"
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a threshold structure in a memory arena.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *threshold
+ * the threshold exceedance structure to initialize
+ *
+ * @param[in] value
+ * thresholds
+ *
+ * @param[in] vect_size
+ * size of the variance vector
+ *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ *
+ *******************************************************************************/
+
+void init_threshold_arena (threshold_t     *threshold,
+                           const int        vect_size,
+                           const double     value,
+                           melissa_arena_t *arena)
+{
+    threshold->threshold_exceedance = melissa_arena_calloc (arena, vect_size, sizeof(int));
+    threshold->value = value;
+}
+
 /**
  *******************************************************************************
  *
@@ -55,8 +87,47 @@ void init_threshold (threshold_t  *threshold,
                      const int     vect_size,
                      const double  value)
 {
-    threshold->threshold_exceedance = melissa_calloc (vect_size, sizeof(int));
-    threshold->value = value;
+    init_threshold_arena (threshold, vect_size, value, NULL);
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the number of values exceeding a given threshold
+ * on the elements [first, last) of the input vector
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] threshold
+ * number of threshold exceedance occurences
+ *
+ * @param[in] in_vect[]
+ * input vector of double values
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void update_threshold_exceedance_block (threshold_t *threshold,
+                                        double       in_vect[],
+                                        const int    first,
+                                        const int    last)
+{
+    int i;
+
+    for (i=first; i<last; i++)
+    {
+        if (in_vect[i] > threshold->value)
+        {
+            threshold->threshold_exceedance[i] += 1;
+        }
+    }
 }
 
 /**
@@ -86,12 +157,100 @@ void update_threshold_exceedance (threshold_t *threshold,
     int i;
 
 #pragma omp parallel for schedule(static)
-    for (i=0; i<vect_size; i++)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
     {
-        if (in_vect[i] > threshold->value)
+        update_threshold_exceedance_block (threshold,
+                                           in_vect,
+                                           i,
+                                           (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the number of values exceeding a given threshold on the
+ * elements [first, last) of several input vectors
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] threshold
+ * number of threshold exceedance occurences
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] first
+ * first element to update
+ *
+ * @param[in] last
+ * element after the last one to update
+ *
+ *******************************************************************************/
+
+void update_threshold_exceedance_batch_block (threshold_t  *threshold,
+                                              double      **in_vects,
+                                              const int     nb_vects,
+                                              const int     first,
+                                              const int     last)
+{
+    int i, k, count;
+
+    for (i=first; i<last; i++)
+    {
+        count = 0;
+        for (k=0; k<nb_vects; k++)
         {
-            threshold->threshold_exceedance[i] += 1;
+            count += (in_vects[k][i] > threshold->value);
         }
+        threshold->threshold_exceedance[i] += count;
+    }
+}
+
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function updates the number of values exceeding a given threshold with
+ * several input vectors
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] threshold
+ * number of threshold exceedance occurences
+ *
+ * @param[in] **in_vects
+ * input vectors of double values
+ *
+ * @param[in] nb_vects
+ * number of input vectors
+ *
+ * @param[in] vect_size
+ * size of the input vectors
+ *
+ *******************************************************************************/
+
+void update_threshold_exceedance_batch (threshold_t  *threshold,
+                                        double      **in_vects,
+                                        const int     nb_vects,
+                                        const int     vect_size)
+{
+    int i;
+
+#pragma omp parallel for schedule(static)
+    for (i=0; i<vect_size; i+=MELISSA_BLOCK_SIZE)
+    {
+        update_threshold_exceedance_batch_block (threshold,
+                                                 in_vects,
+                                                 nb_vects,
+                                                 i,
+                                                 (i+MELISSA_BLOCK_SIZE < vect_size) ? i+MELISSA_BLOCK_SIZE : vect_size);
     }
 }
 
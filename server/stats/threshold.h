@@ -29,6 +29,8 @@
 extern "C" {
 #endif
 
+#include "melissa_utils.h"
+
 /**
  *******************************************************************************
  *
@@ -52,10 +54,31 @@ void init_threshold (threshold_t  *threshold,
                      const int     vect_size,
                      const double  value);
 
+void init_threshold_arena (threshold_t     *threshold,
+                           const int        vect_size,
+                           const double     value,
+                           melissa_arena_t *arena);
+
 void update_threshold_exceedance (threshold_t *threshold,
                                   double       in_vect[],
                                   const int    vect_size);
 
+void update_threshold_exceedance_block (threshold_t *threshold,
+                                        double       in_vect[],
+                                        const int    first,
+                                        const int    last);
+
+void update_threshold_exceedance_batch (threshold_t  *threshold,
+                                        double      **in_vects,
+                                        const int     nb_vects,
+                                        const int     vect_size);
+
+void update_threshold_exceedance_batch_block (threshold_t  *threshold,
+                                              double      **in_vects,
+                                              const int     nb_vects,
+                                              const int     first,
+                                              const int     last);
+
 void save_threshold(threshold_t **threshold,
                     int           vect_size,
                     int           nb_time_steps,
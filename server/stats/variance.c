@@ -33,6 +33,36 @@
 #include "variance.h"
 #include "melissa_utils.h"
 
+/**
+ *******************************************************************************
+ *
+ * @ingroup stats_base
+ *
+ * This function initializes a variance structure in a memory arena.
+ *
+ *******************************************************************************
+ *
+ * @param[in,out] *variance
+ * the variance structure to initialize
+ *
+ * @param[in] vect_size
+ * size of the variance vector
+ *
+ * @param[in,out] *arena
+ * arena in which the vectors are allocated, NULL to use the heap
+ *
+ *******************************************************************************/
+
+void init_variance_arena (variance_t      *variance,
+                          const int        vect_size,
+                          melissa_arena_t *arena)
+{
+    variance->variance = melissa_arena_calloc (arena, vect_size, sizeof(double));
+    init_mean_arena (&(variance->mean_structure),
+                     vect_size,
+                     arena);
+}
+
 /**
  *******************************************************************************
  *
@@ -53,9 +83,7 @@
 void init_variance (variance_t *variance,
                     const int   vect_size)
 {
-    variance->variance = melissa_calloc (vect_size, sizeof(double));
-    init_mean (&(variance->mean_structure),
-               vect_size);
+    init_variance_arena (variance, vect_size, NULL);
 }
 
 /**
@@ -32,6 +32,7 @@ extern "C" {
 #ifdef BUILD_WITH_MPI
 #include <mpi.h>
 #endif // BUILD_WITH_MPI
+#include "melissa_utils.h"
 
 /**
  *******************************************************************************
@@ -55,6 +56,10 @@ typedef struct variance_s variance_t; /**< type corresponding to variance_s */
 void init_variance(variance_t *variance,
                    const int   vect_size);
 
+void init_variance_arena (variance_t      *variance,
+                          const int        vect_size,
+                          melissa_arena_t *arena);
+
 void increment_mean_and_variance (variance_t *partial_variance,
                                   double      in_vect[],
                                   const int   vect_size);
@@ -0,0 +1,157 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_bitmap.c
+ * @brief Checks the received time step bitmap and its checkpoint forms.
+ * @author Terraz Théophile
+ * @date 2019-03-04
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bitmap.h"
+#include "melissa_utils.h"
+
+static int compare_bitmaps (const char *name,
+                            bitmap_t   *bitmap,
+                            bitmap_t   *ref)
+{
+    int i, t;
+
+    if (bitmap->nb_rows != ref->nb_rows)
+    {
+        fprintf (stdout, "%s: bad number of rows (%d != %d)\n", name, bitmap->nb_rows, ref->nb_rows);
+        return 1;
+    }
+    for (i=0; i<ref->nb_rows; i++)
+    {
+        for (t=0; t<ref->nb_cols; t++)
+        {
+            if (bitmap_test (bitmap, i, t) != bitmap_test (ref, i, t))
+            {
+                fprintf (stdout, "%s: bit (%d, %d) failed\n", name, i, t);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bitmap_t  bitmap, copy;
+    int       nb_rows = 10; // initial number of simulations
+    int       nb_cols = 150; // time steps
+    int       i, t, count;
+    int       ret = 0;
+    long      sizes[2];
+    FILE     *f;
+
+    alloc_bitmap (&bitmap, nb_rows, nb_cols);
+    // full, scattered, empty, sparse, and run rows, some of them above the
+    // initial size
+    for (i=0; i<40; i++)
+    {
+        for (t=0; t<nb_cols; t++)
+        {
+            if (i%5 == 0 || (i%5 == 1 && (t*7+i)%5 == 0) ||
+                (i%5 == 3 && (t == i || t == 2*i+1)) ||
+                (i%5 == 4 && (t < 10+i || (t >= 100 && t < 120))))
+            {
+                bitmap_set (&bitmap, i, t);
+            }
+        }
+    }
+    if (bitmap.nb_rows != 40 || bitmap_test (&bitmap, 1000, 0) != 0)
+    {
+        fprintf (stdout, "bitmap size failed\n");
+        ret += 1;
+    }
+    for (i=0; i<40; i++)
+    {
+        count = 0;
+        for (t=0; t<nb_cols; t++)
+        {
+            count += bitmap_test (&bitmap, i, t);
+        }
+        if (count != bitmap_count_row (&bitmap, i))
+        {
+            fprintf (stdout, "bitmap row count failed\n");
+            ret += 1;
+            break;
+        }
+    }
+    for (t=0; t<nb_cols; t++)
+    {
+        count = 0;
+        for (i=0; i<40; i++)
+        {
+            count += bitmap_test (&bitmap, i, t);
+        }
+        if (count != bitmap_count_col (&bitmap, t))
+        {
+            fprintf (stdout, "bitmap column count failed\n");
+            ret += 1;
+            break;
+        }
+    }
+
+    for (i=0; i<2; i++)
+    {
+        f = tmpfile ();
+        bitmap_write (&bitmap, i, f);
+        sizes[i] = ftell (f);
+        rewind (f);
+        alloc_bitmap (&copy, 3, nb_cols);
+        bitmap_set (&copy, 2, 1);
+        if (bitmap_read (&copy, f) != 0)
+        {
+            fprintf (stdout, "bitmap read failed\n");
+            ret += 1;
+        }
+        ret += compare_bitmaps ((i == 0) ? "raw bitmap" : "compressed bitmap", &copy, &bitmap);
+        free_bitmap (&copy);
+        fclose (f);
+    }
+    // smaller than with the 24 scattered, sparse and run rows in words
+    if (sizes[1] >= (long)(3 * sizeof(int) + 40 + 24 * 3 * sizeof(uint64_t)))
+    {
+        fprintf (stdout, "compressed bitmap too large (%ld bytes)\n", sizes[1]);
+        ret += 1;
+    }
+
+    // a row tag that is not known is refused
+    f = tmpfile ();
+    bitmap_write (&bitmap, 1, f);
+    fseek (f, 3 * sizeof(int), SEEK_SET);
+    fputc (7, f);
+    rewind (f);
+    alloc_bitmap (&copy, 0, nb_cols);
+    if (bitmap_read (&copy, f) != -1)
+    {
+        fprintf (stdout, "bad row tag not detected\n");
+        ret += 1;
+    }
+    free_bitmap (&copy);
+    fclose (f);
+
+    free_bitmap (&bitmap);
+
+    return ret;
+}
@@ -0,0 +1,589 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_checkpoint.c
+ * @brief Checks the incremental, compressed and shared checkpoints of the statistics.
+ * @author Terraz Théophile
+ * @date 2019-03-18
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/wait.h>
+#include "melissa_data.h"
+#include "melissa_io.h"
+#include "melissa_checkpoint.h"
+#include "melissa_codec.h"
+#include "compute_stats.h"
+#include "melissa_utils.h"
+
+static int compare_data (const char     *name,
+                         melissa_data_t *data,
+                         melissa_data_t *ref)
+{
+    int i, t;
+
+    for (t=0; t<ref->options->nb_time_steps; t++)
+    {
+        if (data->moments[t].increment != ref->moments[t].increment ||
+            data->step_received[t] != ref->step_received[t])
+        {
+            fprintf (stdout, "%s failed (time step %d: %d and %d values)\n", name, t, data->moments[t].increment, ref->moments[t].increment);
+            return 1;
+        }
+        for (i=0; i<ref->vect_size; i++)
+        {
+            if (data->moments[t].m1[i] != ref->moments[t].m1[i] ||
+                data->moments[t].m2[i] != ref->moments[t].m2[i] ||
+                data->min_max[t].max[i] != ref->min_max[t].max[i])
+            {
+                fprintf (stdout, "%s failed (time step %d, element %d)\n", name, t, i);
+                return 1;
+            }
+        }
+    }
+    if (data->step_simu.nb_rows != ref->step_simu.nb_rows ||
+        bitmap_count_row (&data->step_simu, 0) != bitmap_count_row (&ref->step_simu, 0))
+    {
+        fprintf (stdout, "%s failed (simulation steps)\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+// one message, as the server bookkeeping does it
+static void add_message (melissa_data_t *data,
+                         int             time_step,
+                         int             simu_id,
+                         double         *vect)
+{
+    compute_stats (data, time_step, simu_id, 1, &vect);
+    bitmap_set (&data->step_simu, simu_id, time_step);
+    data->step_received[time_step] += 1;
+    set_bit (data->step_dirty, time_step);
+}
+
+static void read_checkpoint (melissa_data_t    *data,
+                             melissa_options_t *options,
+                             comm_data_t       *comm_data,
+                             int                vect_size)
+{
+    memset (data, 0, sizeof(melissa_data_t));
+    melissa_init_data (data, options, vect_size);
+    read_saved_stats (data, comm_data, "checkpoint", 0);
+}
+
+// round trip of the codec on buffers of every kind, down to a few bytes
+static int test_codec (void)
+{
+    size_t sizes[5] = {0, 5, 13, 1000, 100003};
+    char  *buffer, *shuffled, *packed, *unpacked;
+    size_t i, packed_size;
+    int    k, kind, ret = 0;
+
+    buffer   = melissa_malloc (100003);
+    shuffled = melissa_malloc (100003);
+    unpacked = melissa_malloc (100003);
+    packed   = melissa_malloc (melissa_codec_bound (100003));
+    for (kind=0; kind<3; kind++)
+    {
+        for (k=0; k<5; k++)
+        {
+            for (i=0; i<sizes[k]; i++)
+            {
+                buffer[i] = (kind == 0) ? 0 : (kind == 1) ? (char)(i % 7) : (char)rand();
+            }
+            melissa_shuffle (buffer, sizes[k], sizeof(double), shuffled);
+            packed_size = melissa_lz4_compress (shuffled, sizes[k], packed);
+            if (packed_size > melissa_codec_bound (sizes[k]) ||
+                melissa_lz4_decompress (packed, packed_size, shuffled, sizes[k]) != 0 ||
+                (sizes[k] > 0 && melissa_lz4_decompress (packed, packed_size, shuffled, sizes[k] - 1) == 0))
+            {
+                fprintf (stdout, "codec failed (%lu bytes, kind %d)\n", (unsigned long)sizes[k], kind);
+                ret += 1;
+                continue;
+            }
+            melissa_unshuffle (shuffled, sizes[k], sizeof(double), unpacked);
+            if (sizes[k] > 0 && memcmp (buffer, unpacked, sizes[k]) != 0)
+            {
+                fprintf (stdout, "codec failed (%lu bytes, kind %d, wrong content)\n", (unsigned long)sizes[k], kind);
+                ret += 1;
+            }
+        }
+    }
+    melissa_free (buffer);
+    melissa_free (shuffled);
+    melissa_free (unpacked);
+    melissa_free (packed);
+    return ret;
+}
+
+// Sobol indices restored from a checkpoint: the time steps completed before it
+// get no more messages, so their convergence is rebuilt on restart
+static int test_sobol_restart (melissa_options_t *options,
+                               comm_data_t       *comm_data)
+{
+    melissa_options_t sobol_options = *options;
+    melissa_data_t    data, copy;
+    double            values[4], a[2], b[2];
+    double           *vects[4] = {&values[0], &values[1], &values[2], &values[3]};
+    int               j, t;
+    int               ret = 0;
+
+    sobol_options.sobol_op      = 1;
+    sobol_options.nb_parameters = 2;
+    sobol_options.nb_time_steps = 4;
+    sobol_options.sampling_size = 120000;
+    memset (&data, 0, sizeof(melissa_data_t));
+    melissa_init_data (&data, &sobol_options, 1);
+
+    // y = x1 + x2: the indices of the first two time steps converge, the
+    // other time steps only get a few groups
+    for (j=0; j<sobol_options.sampling_size; j++)
+    {
+        for (t=0; t<2; t++)
+        {
+            a[t] = rand() / (double)RAND_MAX;
+            b[t] = rand() / (double)RAND_MAX;
+        }
+        values[0] = a[0] + a[1];
+        values[1] = b[0] + b[1];
+        values[2] = b[0] + a[1];
+        values[3] = a[0] + b[1];
+        for (t=0; t<sobol_options.nb_time_steps && (t < 2 || j < 10); t++)
+        {
+            compute_stats (&data, t, j, 4, vects);
+            bitmap_set (&data.step_simu, j, t);
+            data.step_received[t] += 1;
+            set_bit (data.step_dirty, t);
+        }
+    }
+    save_stats (&data, comm_data, "sobol");
+
+    memset (&copy, 0, sizeof(melissa_data_t));
+    melissa_init_data (&copy, &sobol_options, 1);
+    read_saved_stats (&copy, comm_data, "sobol", 0);
+    restore_sobol_convergence (&copy);
+    if (copy.sobol_converged_steps != 2 || copy.sobol_worst_step < 2 ||
+        copy.sobol_interval <= MELISSA_SOBOL_CONFIDENCE || copy.sobol_interval >= 2.0)
+    {
+        fprintf (stdout, "Sobol restart failed (%d converged time steps, worst interval %g)\n",
+                 copy.sobol_converged_steps, copy.sobol_interval);
+        ret += 1;
+    }
+    // the same intervals as the indices before the checkpoint
+    restore_sobol_convergence (&data);
+    for (t=0; t<sobol_options.nb_time_steps; t++)
+    {
+        if (copy.sobol_intervals[t] != data.sobol_intervals[t])
+        {
+            fprintf (stdout, "Sobol restart failed (time step %d: %g != %g)\n", t,
+                     copy.sobol_intervals[t], data.sobol_intervals[t]);
+            ret += 1;
+        }
+    }
+    if (copy.sobol_interval != data.sobol_interval || copy.sobol_worst_step != data.sobol_worst_step)
+    {
+        fprintf (stdout, "Sobol restart failed (worst interval)\n");
+        ret += 1;
+    }
+    melissa_free_data (&copy);
+    melissa_free_data (&data);
+    unlink ("sobol0_0.image");
+    unlink ("sobol0_0.delta");
+    return ret;
+}
+
+#ifdef BUILD_WITH_MPI
+#define NB_CLIENTS 3
+
+static const int client_sizes[NB_CLIENTS] = {7000, 1, 9001};
+
+// elements of a client rank on a server rank, as partitioned by the api
+static void piece_range (int  nb_servers,
+                         int  server_rank,
+                         int  client_rank,
+                         int *first,
+                         int *size)
+{
+    int global_size = 0, client_first = 0, c, server_begin, server_end, end;
+
+    for (c=0; c<NB_CLIENTS; c++)
+    {
+        client_first += (c < client_rank) ? client_sizes[c] : 0;
+        global_size += client_sizes[c];
+    }
+    server_begin = server_rank * (global_size / nb_servers) + ((server_rank < global_size % nb_servers) ? server_rank : global_size % nb_servers);
+    server_end   = (server_rank + 1) * (global_size / nb_servers) + ((server_rank + 1 < global_size % nb_servers) ? server_rank + 1 : global_size % nb_servers);
+    *first = (server_begin > client_first) ? server_begin : client_first;
+    end    = (server_end < client_first + client_sizes[client_rank]) ? server_end : client_first + client_sizes[client_rank];
+    *size  = (end > *first) ? end - *first : 0;
+}
+
+// the messages of a few simulations for the elements [first, first + size)
+static void add_piece_messages (melissa_data_t *data,
+                                int             first,
+                                int             size,
+                                double         *vect)
+{
+    int i, j, t;
+
+    for (j=0; j<3; j++)
+    {
+        for (t=0; t<data->options->nb_time_steps; t+=j+1)
+        {
+            for (i=0; i<size; i++)
+            {
+                vect[i] = sin (j * 13.0 + t * 7.0 + (first + i) * 0.001);
+            }
+            add_message (data, t, j, vect);
+        }
+    }
+}
+
+// shared checkpoint written by every rank, read back on the same number of
+// ranks, then on 1 and 3 ranks
+static int test_shared (melissa_options_t *options)
+{
+    comm_data_t     comm_data, restart_comm;
+    melissa_data_t  data[NB_CLIENTS], copy[NB_CLIENTS], ref;
+    double         *vect;
+    int             c, r, first, size, nb_servers;
+    int             ret = 0;
+
+    options->mpi_io_checkpoint = 1;
+    memset (&comm_data, 0, sizeof(comm_data_t));
+    comm_data.comm = MPI_COMM_WORLD;
+    MPI_Comm_size (MPI_COMM_WORLD, &comm_data.comm_size);
+    MPI_Comm_rank (MPI_COMM_WORLD, &comm_data.rank);
+    comm_data.client_comm_size = NB_CLIENTS;
+
+    vect = melissa_malloc (client_sizes[2] * sizeof(double));
+    memset (data, 0, sizeof(data));
+    for (c=0; c<NB_CLIENTS; c++)
+    {
+        piece_range (comm_data.comm_size, comm_data.rank, c, &first, &size);
+        melissa_init_data (&data[c], options, size);
+        if (size > 0)
+        {
+            add_piece_messages (&data[c], first, size, vect);
+        }
+    }
+    if (shared_steps_consistent (data, &comm_data, MPI_COMM_WORLD) != 1)
+    {
+        fprintf (stdout, "shared checkpoint not consistent\n");
+        ret += 1;
+    }
+    if (save_stats_shared (data, &comm_data, "shared", MPI_COMM_WORLD, 1) != 0)
+    {
+        fprintf (stdout, "shared checkpoint failed\n");
+        ret += 1;
+    }
+    for (c=0; c<NB_CLIENTS; c++)
+    {
+        if (data[c].stats_init != 1)
+        {
+            continue;
+        }
+        memset (&copy[c], 0, sizeof(melissa_data_t));
+        melissa_init_data (&copy[c], options, data[c].vect_size);
+        read_saved_stats (copy, &comm_data, "shared", c);
+        ret += compare_data ("shared", &copy[c], &data[c]);
+        melissa_free_data (&copy[c]);
+        melissa_free_data (&data[c]);
+    }
+
+    // restart on other numbers of server ranks, checked by the first rank
+    if (comm_data.rank == 0)
+    {
+        for (nb_servers=1; nb_servers<=3; nb_servers+=2)
+        {
+            restart_comm = comm_data;
+            restart_comm.comm_size = nb_servers;
+            for (r=0; r<nb_servers; r++)
+            {
+                restart_comm.rank = r;
+                for (c=0; c<NB_CLIENTS; c++)
+                {
+                    piece_range (nb_servers, r, c, &first, &size);
+                    if (size == 0)
+                    {
+                        continue;
+                    }
+                    memset (&ref, 0, sizeof(melissa_data_t));
+                    melissa_init_data (&ref, options, size);
+                    add_piece_messages (&ref, first, size, vect);
+                    memset (&copy[c], 0, sizeof(melissa_data_t));
+                    melissa_init_data (&copy[c], options, size);
+                    read_saved_stats (copy, &restart_comm, "shared", c);
+                    ret += compare_data ((nb_servers == 1) ? "restart on 1 rank" : "restart on 3 ranks", &copy[c], &ref);
+                    melissa_free_data (&copy[c]);
+                    melissa_free_data (&ref);
+                }
+            }
+        }
+    }
+    melissa_free (vect);
+    MPI_Allreduce (MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    return ret;
+}
+
+// the last rank received a time step of the last client rank that the other
+// ranks did not: the checkpoint can only be read on the same number of ranks
+static int test_shared_inconsistent (melissa_options_t *options)
+{
+    comm_data_t     comm_data, restart_comm;
+    melissa_data_t  data[NB_CLIENTS], copy[NB_CLIENTS];
+    double         *vect;
+    int             c, first, size, status;
+    int             ret = 0;
+    pid_t           pid;
+
+    options->mpi_io_checkpoint = 1;
+    memset (&comm_data, 0, sizeof(comm_data_t));
+    comm_data.comm = MPI_COMM_WORLD;
+    MPI_Comm_size (MPI_COMM_WORLD, &comm_data.comm_size);
+    MPI_Comm_rank (MPI_COMM_WORLD, &comm_data.rank);
+    comm_data.client_comm_size = NB_CLIENTS;
+    if (comm_data.comm_size < 2)
+    {
+        return 0;
+    }
+
+    vect = melissa_malloc (client_sizes[2] * sizeof(double));
+    memset (data, 0, sizeof(data));
+    for (c=0; c<NB_CLIENTS; c++)
+    {
+        piece_range (comm_data.comm_size, comm_data.rank, c, &first, &size);
+        melissa_init_data (&data[c], options, size);
+        if (size > 0)
+        {
+            add_piece_messages (&data[c], first, size, vect);
+        }
+    }
+    if (comm_data.rank == comm_data.comm_size - 1)
+    {
+        piece_range (comm_data.comm_size, comm_data.rank, NB_CLIENTS - 1, &first, &size);
+        memset (vect, 0, size * sizeof(double));
+        add_message (&data[NB_CLIENTS - 1], 1, 5, vect);
+    }
+    if (shared_steps_consistent (data, &comm_data, MPI_COMM_WORLD) != 0)
+    {
+        fprintf (stdout, "inconsistent shared checkpoint not detected\n");
+        ret += 1;
+    }
+    save_stats_shared (data, &comm_data, "inconsistent", MPI_COMM_WORLD, 0);
+    for (c=0; c<NB_CLIENTS; c++)
+    {
+        melissa_free_data (&data[c]);
+    }
+
+    // the restart on one rank is refused before any statistic is read
+    if (comm_data.rank == 0)
+    {
+        fflush (stdout);
+        pid = fork ();
+        if (pid == 0)
+        {
+            restart_comm = comm_data;
+            restart_comm.comm_size = 1;
+            memset (&copy[NB_CLIENTS - 1], 0, sizeof(melissa_data_t));
+            melissa_init_data (&copy[NB_CLIENTS - 1], options, client_sizes[NB_CLIENTS - 1]);
+            read_saved_stats (copy, &restart_comm, "inconsistent", NB_CLIENTS - 1);
+            _exit (0);
+        }
+        if (pid < 0 || waitpid (pid, &status, 0) != pid || !WIFEXITED (status) || WEXITSTATUS (status) == 0)
+        {
+            fprintf (stdout, "restart from an inconsistent shared checkpoint not refused\n");
+            ret += 1;
+        }
+        unlink ("inconsistent.ckpt");
+    }
+    melissa_free (vect);
+    MPI_Allreduce (MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    return ret;
+}
+#endif // BUILD_WITH_MPI
+
+int main(int argc, char **argv)
+{
+    melissa_options_t     options;
+    comm_data_t           comm_data;
+    melissa_data_t        data, copy, partial;
+    melissa_checkpoint_t *checkpoint;
+    double               *vect;
+    long int              base_size;
+    double                write_time = 0.0;
+    int                   nb_time_steps = 8;
+    int                   vect_size = 20000; // arena above MELISSA_HUGE_PAGE_SIZE, mapped on restart
+    int                   i, j, t;
+    int                   ret = 0;
+
+    memset (&options, 0, sizeof(melissa_options_t));
+    options.nb_time_steps  = nb_time_steps;
+    options.nb_parameters  = 1;
+    options.sampling_size  = 20;
+    options.mean_op        = 1;
+    options.variance_op    = 1;
+    options.min_and_max_op = 1;
+    options.check_interval = 300.0;
+    options.timeout_simu   = 300;
+    options.restart        = 1;
+    sprintf (options.restart_dir, ".");
+    sprintf (options.launcher_name, "localhost");
+    memset (&comm_data, 0, sizeof(comm_data_t));
+    comm_data.comm_size        = 1;
+    comm_data.client_comm_size = 1;
+#ifdef BUILD_WITH_MPI
+    MPI_Init (&argc, &argv);
+    if (argc > 1 && strcmp (argv[1], "shared") == 0)
+    {
+        ret = test_shared (&options);
+        ret += test_shared_inconsistent (&options);
+        MPI_Finalize ();
+        return ret;
+    }
+#endif // BUILD_WITH_MPI
+    unlink ("checkpoint0_0.delta");
+
+    memset (&data, 0, sizeof(melissa_data_t));
+    melissa_init_data (&data, &options, vect_size);
+    vect = melissa_malloc (vect_size * sizeof(double));
+
+    // first checkpoint: full
+    for (j=0; j<4; j++)
+    {
+        for (t=0; t<nb_time_steps; t++)
+        {
+            for (i=0; i<vect_size; i++)
+            {
+                vect[i] = rand() / (double)RAND_MAX;
+            }
+            add_message (&data, t, j, vect);
+        }
+    }
+    save_stats (&data, &comm_data, "checkpoint");
+    base_size = data.checkpoint_base_size;
+    if (base_size <= 0 || data.checkpoint_delta_size != 0)
+    {
+        fprintf (stdout, "full checkpoint failed\n");
+        ret += 1;
+    }
+
+    // then deltas, holding the modified time steps only
+    for (j=4; j<6; j++)
+    {
+        add_message (&data, 2, j, vect);
+        save_stats (&data, &comm_data, "checkpoint");
+    }
+    if (data.checkpoint_delta_size <= 0 || data.checkpoint_delta_size > base_size / 2)
+    {
+        fprintf (stdout, "delta checkpoint failed (%ld bytes, full checkpoint %ld bytes)\n", data.checkpoint_delta_size, base_size);
+        ret += 1;
+    }
+    read_checkpoint (&copy, &options, &comm_data, vect_size);
+    ret += compare_data ("base + deltas", &copy, &data);
+    melissa_free_data (&copy);
+
+    // a delta written by the checkpoint thread
+    checkpoint = melissa_checkpoint_start ();
+    add_message (&data, 5, 6, vect);
+    add_message (&data, 7, 6, vect);
+    save_stats_async (&data, &comm_data, "checkpoint", checkpoint);
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_stop (checkpoint, &write_time) != 0)
+    {
+        fprintf (stdout, "async checkpoint not written\n");
+        ret += 1;
+    }
+    read_checkpoint (&copy, &options, &comm_data, vect_size);
+    ret += compare_data ("async delta", &copy, &data);
+    melissa_free_data (&copy);
+
+    // a record cut by a crash is ignored
+    read_checkpoint (&partial, &options, &comm_data, vect_size);
+    add_message (&data, 1, 7, vect);
+    save_stats (&data, &comm_data, "checkpoint");
+    truncate ("checkpoint0_0.delta", data.checkpoint_delta_size - 10);
+    read_checkpoint (&copy, &options, &comm_data, vect_size);
+    ret += compare_data ("cut delta", &copy, &partial);
+    melissa_free_data (&copy);
+    melissa_free_data (&partial);
+    truncate ("checkpoint0_0.delta", data.checkpoint_delta_size);
+
+    // compaction in a new full checkpoint, the old log is ignored
+    for (j=8; j<20 && data.checkpoint_delta_size > 0; j++)
+    {
+        for (t=0; t<nb_time_steps; t++)
+        {
+            add_message (&data, t, j, vect);
+        }
+        save_stats (&data, &comm_data, "checkpoint");
+    }
+    if (data.checkpoint_delta_size != 0 || data.checkpoint_generation != 2)
+    {
+        fprintf (stdout, "compaction failed\n");
+        ret += 1;
+    }
+    read_checkpoint (&copy, &options, &comm_data, vect_size);
+    ret += compare_data ("compaction", &copy, &data);
+    melissa_free_data (&copy);
+
+    // compressed full checkpoints, written directly or by the checkpoint thread,
+    // read back with or without the option
+    ret += test_codec ();
+    options.compress_checkpoint = 3;
+    data.checkpoint_base_size = 0;
+    save_stats (&data, &comm_data, "checkpoint");
+    if (data.checkpoint_base_size <= 0 || data.checkpoint_base_size >= base_size)
+    {
+        fprintf (stdout, "compressed checkpoint failed (%ld bytes, not compressed %ld bytes)\n", data.checkpoint_base_size, base_size);
+        ret += 1;
+    }
+    read_checkpoint (&copy, &options, &comm_data, vect_size);
+    ret += compare_data ("compressed", &copy, &data);
+    melissa_free_data (&copy);
+    add_message (&data, 3, 20, vect);
+    data.checkpoint_base_size = 0;
+    checkpoint = melissa_checkpoint_start ();
+    save_stats_async (&data, &comm_data, "checkpoint", checkpoint);
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_stop (checkpoint, &write_time) != 0)
+    {
+        fprintf (stdout, "async checkpoint not written\n");
+        ret += 1;
+    }
+    options.compress_checkpoint = 0;
+    read_checkpoint (&copy, &options, &comm_data, vect_size);
+    ret += compare_data ("async compressed", &copy, &data);
+    melissa_free_data (&copy);
+
+    ret += test_sobol_restart (&options, &comm_data);
+
+    melissa_free_data (&data);
+    melissa_free (vect);
+#ifdef BUILD_WITH_MPI
+    MPI_Finalize ();
+#endif // BUILD_WITH_MPI
+
+    return ret;
+}
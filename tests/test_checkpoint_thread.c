@@ -0,0 +1,213 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_checkpoint_thread.c
+ * @brief Checks the checkpoint I/O thread: submission, wait, stop, the
+ *        replacement of the files through temporary files, and the files
+ *        kept when a write fails.
+ * @author Terraz Théophile
+ * @date 2019-04-30
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "melissa_checkpoint.h"
+#include "melissa_utils.h"
+
+#define NB_FILES 40
+
+// 0 if the file holds exactly content
+static int check_file (const char *file_name,
+                       const char *content)
+{
+    char   buffer[256];
+    size_t size;
+    FILE  *f;
+
+    f = fopen (file_name, "rb");
+    if (f == NULL)
+    {
+        fprintf (stdout, "%s not written\n", file_name);
+        return 1;
+    }
+    size = fread (buffer, 1, sizeof(buffer) - 1, f);
+    fclose (f);
+    buffer[size] = '\0';
+    if (strcmp (buffer, content) != 0)
+    {
+        fprintf (stdout, "%s failed (\"%s\" instead of \"%s\")\n", file_name, buffer, content);
+        return 1;
+    }
+    return 0;
+}
+
+// 0 if the temporary file of file_name was renamed
+static int check_no_tmp (const char *file_name)
+{
+    char tmp_name[260];
+
+    sprintf (tmp_name, "%s.tmp", file_name);
+    if (access (tmp_name, F_OK) == 0)
+    {
+        fprintf (stdout, "%s not renamed\n", tmp_name);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    melissa_checkpoint_t *checkpoint;
+    char                  file_name[256], content[256];
+    char                 *large;
+    double                write_time = 0.0;
+    struct rlimit         limit, small_limit;
+    int                   i;
+    int                   ret = 0;
+
+    unlink ("thread_full");
+    unlink ("thread_log");
+    unlink ("thread_kept");
+    unlink ("thread_next");
+    rmdir ("thread_kept.tmp");
+
+    // a replaced file and an appended file
+    checkpoint = melissa_checkpoint_start ();
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_full", 0), "first");
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_log", 1), "first;");
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_wait (checkpoint, &write_time) != 0 ||
+        checkpoint->pending != 0 || checkpoint->nb_files != 0)
+    {
+        fprintf (stdout, "wait failed\n");
+        ret += 1;
+    }
+    ret += check_file ("thread_full", "first");
+    ret += check_file ("thread_log", "first;");
+    ret += check_no_tmp ("thread_full");
+
+    // the writing time is reported once
+    write_time = 0.0;
+    melissa_checkpoint_wait (checkpoint, &write_time);
+    if (write_time != 0.0)
+    {
+        fprintf (stdout, "writing time reported twice\n");
+        ret += 1;
+    }
+
+    // the next checkpoint replaces the first file and appends to the second
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_full", 0), "second");
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_log", 1), "second;");
+    melissa_checkpoint_submit (checkpoint);
+    melissa_checkpoint_wait (checkpoint, &write_time);
+    ret += check_file ("thread_full", "second");
+    ret += check_file ("thread_log", "first;second;");
+    ret += check_no_tmp ("thread_full");
+
+    // a file whose temporary file can not be written keeps its previous content
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_kept", 0), "kept");
+    melissa_checkpoint_submit (checkpoint);
+    melissa_checkpoint_wait (checkpoint, &write_time);
+    mkdir ("thread_kept.tmp", 0700);
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_kept", 0), "lost");
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_wait (checkpoint, &write_time) != -1)
+    {
+        fprintf (stdout, "unopenable file not reported\n");
+        ret += 1;
+    }
+    ret += check_file ("thread_kept", "kept");
+    rmdir ("thread_kept.tmp");
+
+    // short writes, the file size being limited: the replaced file keeps its
+    // content, the log is truncated back to its last record, the files after
+    // the failure are not written, and the failure is reported once
+    large = malloc (1 << 16);
+    memset (large, 'x', (1 << 16) - 1);
+    large[(1 << 16) - 1] = '\0';
+    signal (SIGXFSZ, SIG_IGN);
+    getrlimit (RLIMIT_FSIZE, &limit);
+    small_limit = limit;
+    small_limit.rlim_cur = 4096;
+    setrlimit (RLIMIT_FSIZE, &small_limit);
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_kept", 0), "%s", large);
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_wait (checkpoint, &write_time) != -1)
+    {
+        fprintf (stdout, "short write not reported\n");
+        ret += 1;
+    }
+    ret += check_file ("thread_kept", "kept");
+    ret += check_no_tmp ("thread_kept");
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_log", 1), "%s", large);
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_next", 0), "next");
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_wait (checkpoint, &write_time) != -1)
+    {
+        fprintf (stdout, "short append not reported\n");
+        ret += 1;
+    }
+    ret += check_file ("thread_log", "first;second;");
+    if (access ("thread_next", F_OK) == 0)
+    {
+        fprintf (stdout, "file written after a failure\n");
+        ret += 1;
+    }
+    setrlimit (RLIMIT_FSIZE, &limit);
+    fprintf (melissa_checkpoint_open (checkpoint, "thread_log", 1), "third;");
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_wait (checkpoint, &write_time) != 0)
+    {
+        fprintf (stdout, "failure reported twice\n");
+        ret += 1;
+    }
+    ret += check_file ("thread_log", "first;second;third;");
+    free (large);
+    unlink ("thread_kept");
+
+    // more files than the initial array, written when the thread stops
+    for (i=0; i<NB_FILES; i++)
+    {
+        sprintf (file_name, "thread_%d", i);
+        fprintf (melissa_checkpoint_open (checkpoint, file_name, 0), "file %d", i);
+    }
+    melissa_checkpoint_submit (checkpoint);
+    if (melissa_checkpoint_stop (checkpoint, &write_time) != 0)
+    {
+        fprintf (stdout, "stop failed\n");
+        ret += 1;
+    }
+    for (i=0; i<NB_FILES; i++)
+    {
+        sprintf (file_name, "thread_%d", i);
+        sprintf (content, "file %d", i);
+        ret += check_file (file_name, content);
+        ret += check_no_tmp (file_name);
+        unlink (file_name);
+    }
+
+    unlink ("thread_full");
+    unlink ("thread_log");
+    return ret;
+}
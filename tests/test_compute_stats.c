@@ -0,0 +1,301 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_compute_stats.c
+ * @brief Checks the fused statistics kernel against the separate updates.
+ * @author Terraz Théophile
+ * @date 2019-02-11
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "melissa_data.h"
+#include "compute_stats.h"
+#include "melissa_utils.h"
+
+static int compare_vect (const char *name,
+                         double     *vect1,
+                         double     *vect2,
+                         int         vect_size)
+{
+    int i;
+    for (i=0; i<vect_size; i++)
+    {
+        if (vect1[i] != vect2[i])
+        {
+            fprintf (stdout, "%s failed (element %d: %g and %g)\n", name, i, vect1[i], vect2[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_vect_tol (const char *name,
+                             double     *vect1,
+                             double     *vect2,
+                             int         vect_size)
+{
+    int i;
+    for (i=0; i<vect_size; i++)
+    {
+        if (fabs(vect1[i] - vect2[i]) > 1e-9 * (1.0 + fabs(vect2[i])))
+        {
+            fprintf (stdout, "%s failed (element %d: %g and %g)\n", name, i, vect1[i], vect2[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    melissa_options_t  options;
+    melissa_data_t     data;
+    melissa_data_t     batch_data;
+    moments_t          ref_moments;
+    moments_t          half_moments[2];
+    min_max_t          ref_min_max;
+    threshold_t        ref_thresholds[2];
+    quantile_t         ref_quantiles[2];
+    double             thresholds[2] = {250.0, 750.0};
+    double             quantile_orders[2] = {0.1, 0.9};
+    double            *tableau = NULL;
+    double            *vect_ptr;
+    double            *vect_ptrs[7];
+    double           **vect_tabs[7];
+    int                simu_ids[7];
+    double            *result, *two_pass;
+    double             mean, delta, c2, c3, c4;
+    int                n = 200; // n experiences
+    int                vect_size = 1500; // not a multiple of the block size
+    int                i, j, k, nb;
+    int                ret = 0;
+
+    memset (&options, 0, sizeof(melissa_options_t));
+    options.nb_time_steps  = 1;
+    options.nb_parameters  = 1;
+    options.sampling_size  = n;
+    options.mean_op        = 1;
+    options.variance_op    = 1;
+    options.skewness_op    = 1;
+    options.kurtosis_op    = 1;
+    options.min_and_max_op = 1;
+    options.threshold_op   = 1;
+    options.nb_thresholds  = 2;
+    options.threshold      = thresholds;
+    options.quantile_op    = 1;
+    options.nb_quantiles   = 2;
+    options.quantile_order = quantile_orders;
+    options.check_interval = 300.0;
+    options.timeout_simu   = 300;
+    options.memory_budget  = 1; // file backed arena, to check the spilling
+    sprintf (options.restart_dir, ".");
+    sprintf (options.launcher_name, "localhost");
+
+    memset (&data, 0, sizeof(melissa_data_t));
+    melissa_init_data (&data, &options, vect_size);
+    if ((uintptr_t)data.moments[0].m4 % MELISSA_ALIGNMENT != 0 ||
+        (char*)data.quantiles[0][1].quantile < data.arena.base ||
+        (char*)data.quantiles[0][1].quantile >= data.arena.base + data.arena.size)
+    {
+        fprintf (stdout, "statistics arena layout failed\n");
+        ret += 1;
+    }
+
+    init_moments (&ref_moments, vect_size, 4);
+    init_moments (&half_moments[0], vect_size, 4);
+    init_moments (&half_moments[1], vect_size, 4);
+    init_min_max (&ref_min_max, vect_size);
+    for (i=0; i<2; i++)
+    {
+        init_threshold (&ref_thresholds[i], vect_size, thresholds[i]);
+        init_quantile (&ref_quantiles[i], vect_size, quantile_orders[i]);
+    }
+
+    tableau = melissa_calloc (n * vect_size, sizeof(double));
+    for (j=0; j<vect_size * n; j++)
+    {
+        tableau[j] = rand() / (double)RAND_MAX * (1000);
+    }
+
+    for (j=0; j<n; j++)
+    {
+        vect_ptr = &tableau[j * vect_size];
+        compute_stats (&data, 0, j, 1, &vect_ptr);
+
+        increment_moments (&ref_moments, vect_ptr, vect_size);
+        increment_moments (&half_moments[(j < n/3) ? 0 : 1], vect_ptr, vect_size);
+        min_and_max (&ref_min_max, vect_ptr, j, vect_size);
+        for (i=0; i<2; i++)
+        {
+            update_threshold_exceedance (&ref_thresholds[i], vect_ptr, vect_size);
+            increment_quantile (&ref_quantiles[i], n, vect_ptr, vect_size);
+        }
+    }
+
+    ret += compare_vect ("m1", data.moments[0].m1, ref_moments.m1, vect_size);
+    ret += compare_vect ("m2", data.moments[0].m2, ref_moments.m2, vect_size);
+    ret += compare_vect ("m3", data.moments[0].m3, ref_moments.m3, vect_size);
+    ret += compare_vect ("m4", data.moments[0].m4, ref_moments.m4, vect_size);
+
+    // central moments against a two-pass computation
+    result   = melissa_malloc (vect_size * sizeof(double));
+    two_pass = melissa_malloc (3 * vect_size * sizeof(double));
+    for (i=0; i<vect_size; i++)
+    {
+        mean = 0;
+        for (j=0; j<n; j++)
+        {
+            mean += tableau[j * vect_size + i];
+        }
+        mean /= n;
+        c2 = c3 = c4 = 0;
+        for (j=0; j<n; j++)
+        {
+            delta = tableau[j * vect_size + i] - mean;
+            c2 += delta * delta;
+            c3 += delta * delta * delta;
+            c4 += delta * delta * delta * delta;
+        }
+        two_pass[i]               = c2 / (n - 1);
+        two_pass[vect_size + i]   = (c3 / n) / sqrt(c2 / n * c2 / n * c2 / n);
+        two_pass[2*vect_size + i] = (c4 / n) / (c2 / n * c2 / n);
+    }
+    compute_variance (&data.moments[0], result, vect_size);
+    ret += compare_vect_tol ("variance", result, &two_pass[0], vect_size);
+    compute_skewness (&data.moments[0], result, vect_size);
+    ret += compare_vect_tol ("skewness", result, &two_pass[vect_size], vect_size);
+    compute_kurtosis (&data.moments[0], result, vect_size);
+    ret += compare_vect_tol ("kurtosis", result, &two_pass[2*vect_size], vect_size);
+
+    // statistics dropped from memory and read back from the arena file
+    memcpy (result, data.moments[0].m4, vect_size * sizeof(double));
+    melissa_touch_step (&data, 0);
+    if (melissa_spill_step (&data, 0) != data.step_size)
+    {
+        fprintf (stdout, "spill failed\n");
+        ret += 1;
+    }
+    ret += compare_vect ("spilled m4", data.moments[0].m4, result, vect_size);
+
+    // pairwise merge of two partial structures
+    update_moments (&half_moments[0], &half_moments[1], &half_moments[0], vect_size);
+    ret += compare_vect_tol ("merged m1", half_moments[0].m1, ref_moments.m1, vect_size);
+    ret += compare_vect_tol ("merged m2", half_moments[0].m2, ref_moments.m2, vect_size);
+    ret += compare_vect_tol ("merged m3", half_moments[0].m3, ref_moments.m3, vect_size);
+    ret += compare_vect_tol ("merged m4", half_moments[0].m4, ref_moments.m4, vect_size);
+    ret += compare_vect ("min", data.min_max[0].min, ref_min_max.min, vect_size);
+    ret += compare_vect ("max", data.min_max[0].max, ref_min_max.max, vect_size);
+    if (data.moments[0].increment != n)
+    {
+        fprintf (stdout, "moments increment failed\n");
+        ret += 1;
+    }
+    for (i=0; i<vect_size; i++)
+    {
+        if (data.min_max[0].min_id[i] != ref_min_max.min_id[i] ||
+            data.min_max[0].max_id[i] != ref_min_max.max_id[i])
+        {
+            fprintf (stdout, "min max id failed\n");
+            ret += 1;
+            break;
+        }
+    }
+    for (j=0; j<2; j++)
+    {
+        ret += compare_vect ("quantile", data.quantiles[0][j].quantile, ref_quantiles[j].quantile, vect_size);
+        for (i=0; i<vect_size; i++)
+        {
+            if (data.thresholds[0][j].threshold_exceedance[i] != ref_thresholds[j].threshold_exceedance[i])
+            {
+                fprintf (stdout, "threshold exceedance failed\n");
+                ret += 1;
+                break;
+            }
+        }
+    }
+
+    // the same messages, computed by batches of 7
+    memset (&batch_data, 0, sizeof(melissa_data_t));
+    melissa_init_data (&batch_data, &options, vect_size);
+    for (j=0; j<n; j+=7)
+    {
+        nb = (n - j < 7) ? n - j : 7;
+        for (k=0; k<nb; k++)
+        {
+            vect_ptrs[k] = &tableau[(j+k) * vect_size];
+            vect_tabs[k] = &vect_ptrs[k];
+            simu_ids[k]  = j + k;
+        }
+        compute_stats_batch (&batch_data, 0, nb, simu_ids, 1, vect_tabs);
+    }
+    ret += compare_vect_tol ("batch m1", batch_data.moments[0].m1, ref_moments.m1, vect_size);
+    ret += compare_vect_tol ("batch m2", batch_data.moments[0].m2, ref_moments.m2, vect_size);
+    ret += compare_vect_tol ("batch m3", batch_data.moments[0].m3, ref_moments.m3, vect_size);
+    ret += compare_vect_tol ("batch m4", batch_data.moments[0].m4, ref_moments.m4, vect_size);
+    ret += compare_vect ("batch min", batch_data.min_max[0].min, ref_min_max.min, vect_size);
+    ret += compare_vect ("batch max", batch_data.min_max[0].max, ref_min_max.max, vect_size);
+    if (batch_data.moments[0].increment != n)
+    {
+        fprintf (stdout, "batch moments increment failed\n");
+        ret += 1;
+    }
+    for (i=0; i<vect_size; i++)
+    {
+        if (batch_data.min_max[0].min_id[i] != ref_min_max.min_id[i] ||
+            batch_data.min_max[0].max_id[i] != ref_min_max.max_id[i])
+        {
+            fprintf (stdout, "batch min max id failed\n");
+            ret += 1;
+            break;
+        }
+    }
+    for (j=0; j<2; j++)
+    {
+        ret += compare_vect_tol ("batch quantile", batch_data.quantiles[0][j].quantile, ref_quantiles[j].quantile, vect_size);
+        for (i=0; i<vect_size; i++)
+        {
+            if (batch_data.thresholds[0][j].threshold_exceedance[i] != ref_thresholds[j].threshold_exceedance[i])
+            {
+                fprintf (stdout, "batch threshold exceedance failed\n");
+                ret += 1;
+                break;
+            }
+        }
+    }
+
+    melissa_free_data (&batch_data);
+    melissa_free_data (&data);
+    free_moments (&ref_moments);
+    free_moments (&half_moments[0]);
+    free_moments (&half_moments[1]);
+    melissa_free (result);
+    melissa_free (two_pass);
+    free_min_max (&ref_min_max);
+    for (i=0; i<2; i++)
+    {
+        free_threshold (&ref_thresholds[i]);
+        free_quantile (&ref_quantiles[i]);
+    }
+    melissa_free (tableau);
+    return ret;
+}
@@ -0,0 +1,271 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_ingest.c
+ * @brief Checks that the ingest pipeline computes the statistics of
+ *        interleaved messages as the serial server does.
+ * @author Terraz Théophile
+ * @date 2019-04-30
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <zmq.h>
+#include "melissa_ingest.h"
+#include "melissa_data.h"
+#include "melissa_messages.h"
+#include "compute_stats.h"
+#include "melissa_utils.h"
+
+#define NB_FIELDS  2
+#define NB_CLIENTS 2
+#define NB_SIMU    12
+#define NB_WORKERS 3
+
+static const int vect_sizes[NB_CLIENTS] = {500, 77};
+
+static double value (int field,
+                     int client_rank,
+                     int simu_id,
+                     int t,
+                     int i)
+{
+    return sin (field * 5.0 + client_rank * 3.0 + simu_id * 0.7 + t * 0.3 + i * 0.01) * (simu_id + 1);
+}
+
+static int compare_data (const char     *name,
+                         melissa_data_t *data,
+                         melissa_data_t *ref)
+{
+    int    i, t;
+    double tolerance;
+
+    for (t=0; t<ref->options->nb_time_steps; t++)
+    {
+        if (data->moments[t].increment != ref->moments[t].increment)
+        {
+            fprintf (stdout, "%s failed (time step %d: %d and %d values)\n", name, t, data->moments[t].increment, ref->moments[t].increment);
+            return 1;
+        }
+        for (i=0; i<ref->vect_size; i++)
+        {
+            // the batches may sum in another order
+            tolerance = 1e-12 * (1.0 + fabs (ref->moments[t].m2[i]));
+            if (fabs (data->moments[t].m1[i] - ref->moments[t].m1[i]) > tolerance ||
+                fabs (data->moments[t].m2[i] - ref->moments[t].m2[i]) > tolerance ||
+                data->min_max[t].min[i] != ref->min_max[t].min[i] ||
+                data->min_max[t].max[i] != ref->min_max[t].max[i])
+            {
+                fprintf (stdout, "%s failed (time step %d, element %d)\n", name, t, i);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// sends every message through the pipeline, time step after time step, the
+// fields and client ranks of a simulation one after the other
+static int run_pipeline (melissa_options_t *options,
+                         const char        *name)
+{
+    melissa_data_t    data[NB_FIELDS][NB_CLIENTS], ref[NB_FIELDS][NB_CLIENTS];
+    melissa_ingest_t *ingest;
+    melissa_wire_t    wire, counters;
+    void             *context, *puller, *pusher;
+    zmq_msg_t         msg;
+    char              field_name[MAX_FIELD_NAME];
+    char             *field_name_ptr;
+    double           *vect, *payload;
+    double            computation_time = 0.0;
+    long int          tickets[NB_WORKERS];
+    int               nb_messages = 0, nb_received = 0, half_checked = 0;
+    int               f, c, j, t, i, idle;
+    int               time_stamp, simu_id, client_rank, vect_size;
+    int               ret = 0;
+
+    context = zmq_ctx_new ();
+    puller = zmq_socket (context, ZMQ_PULL);
+    pusher = zmq_socket (context, ZMQ_PUSH);
+    zmq_bind (puller, "inproc://ingest");
+    zmq_connect (pusher, "inproc://ingest");
+
+    memset (data, 0, sizeof(data));
+    memset (ref, 0, sizeof(ref));
+    for (f=0; f<NB_FIELDS; f++)
+    {
+        for (c=0; c<NB_CLIENTS; c++)
+        {
+            melissa_init_data (&ref[f][c], options, vect_sizes[c]);
+        }
+    }
+    melissa_wire_init (&wire, options->wire_format, options->wire_codec, options->wire_tolerance);
+    melissa_wire_init (&counters, options->wire_format, options->wire_codec, options->wire_tolerance);
+    vect = melissa_malloc (vect_sizes[0] * sizeof(double));
+    ingest = melissa_ingest_start (options, puller, NB_WORKERS);
+
+    for (t=0; t<options->nb_time_steps; t++)
+    {
+        for (j=0; j<NB_SIMU; j++)
+        {
+            for (f=0; f<NB_FIELDS; f++)
+            {
+                for (c=0; c<NB_CLIENTS; c++)
+                {
+                    for (i=0; i<vect_sizes[c]; i++)
+                    {
+                        vect[i] = value (f, c, j, t, i);
+                    }
+                    sprintf (field_name, "field%d", f);
+                    message_simu_data (&msg, t, j, c, vect_sizes[c], 1, field_name, &vect, &wire);
+                    zmq_msg_send (&msg, pusher, 0);
+                    compute_stats (&ref[f][c], t, j, 1, &vect);
+                    nb_messages += 1;
+                }
+            }
+        }
+    }
+
+    // the control thread, as melissa_server_run
+    zmq_msg_init (&msg);
+    idle = 0;
+    while (nb_received < nb_messages && idle < 100000)
+    {
+        if (melissa_ingest_pop_received (ingest, &msg) == 0)
+        {
+            idle += 1;
+            sched_yield ();
+            continue;
+        }
+        idle = 0;
+        read_message_simu_data ((char*)zmq_msg_data (&msg), &time_stamp, &simu_id,
+                                &client_rank, &vect_size, &field_name_ptr, &payload);
+        f = field_name_ptr[5] - '0';
+        if (data[f][client_rank].stats_init != 1)
+        {
+            melissa_init_data (&data[f][client_rank], options, vect_size);
+        }
+        if (melissa_wire_check ((char*)payload, zmq_msg_size (&msg) - ((char*)payload - (char*)zmq_msg_data (&msg)),
+                                1, vect_size, &wire) != 0)
+        {
+            fprintf (stdout, "%s: message %d rejected\n", name, nb_received);
+            ret += 1;
+        }
+        melissa_ingest_dispatch (ingest, &msg, &data[f][client_rank], f, client_rank, time_stamp, simu_id, 1, payload);
+        nb_received += 1;
+
+        // the messages dispatched so far are computed once their tickets are reached
+        if (nb_received == nb_messages / 2)
+        {
+            melissa_ingest_tickets (ingest, tickets);
+            idle = 0;
+            while (melissa_ingest_reached (ingest, tickets) == 0 && idle < 100000)
+            {
+                idle += 1;
+                sched_yield ();
+            }
+            half_checked = 1;
+            for (i=0; i<NB_WORKERS; i++)
+            {
+                if (ingest->workers[i].nb_done < tickets[i])
+                {
+                    half_checked = 0;
+                }
+            }
+            idle = 0;
+        }
+    }
+    zmq_msg_close (&msg);
+    if (nb_received != nb_messages || half_checked == 0)
+    {
+        fprintf (stdout, "%s: %d messages received out of %d, tickets %s\n", name, nb_received, nb_messages, half_checked ? "reached" : "not reached");
+        ret += 1;
+    }
+
+    // after the drain, no message is left in the workers
+    melissa_ingest_drain (ingest);
+    melissa_ingest_tickets (ingest, tickets);
+    if (melissa_ingest_reached (ingest, tickets) == 0)
+    {
+        fprintf (stdout, "%s: tickets not reached after the drain\n", name);
+        ret += 1;
+    }
+    for (i=0; i<NB_WORKERS; i++)
+    {
+        if (ingest->workers[i].nb_done != ingest->workers[i].nb_dispatched ||
+            ingest->workers[i].jobs.head != ingest->workers[i].jobs.tail ||
+            ingest->workers[i].nb_dispatched == 0)
+        {
+            fprintf (stdout, "%s: worker %d not drained (%ld dispatched, %ld done)\n", name, i,
+                     ingest->workers[i].nb_dispatched, ingest->workers[i].nb_done);
+            ret += 1;
+        }
+    }
+    for (f=0; f<NB_FIELDS; f++)
+    {
+        for (c=0; c<NB_CLIENTS; c++)
+        {
+            ret += compare_data (name, &data[f][c], &ref[f][c]);
+            melissa_free_data (&data[f][c]);
+            melissa_free_data (&ref[f][c]);
+        }
+    }
+
+    melissa_ingest_stop (ingest, &computation_time, &counters);
+    if (options->wire_codec != MELISSA_WIRE_NO_CODEC && counters.raw_bytes != wire.raw_bytes)
+    {
+        fprintf (stdout, "%s: %ld bytes decoded, %ld bytes encoded\n", name, (long)counters.raw_bytes, (long)wire.raw_bytes);
+        ret += 1;
+    }
+    melissa_wire_free (&wire);
+    melissa_wire_free (&counters);
+    melissa_free (vect);
+    zmq_close (pusher);
+    zmq_close (puller);
+    zmq_ctx_term (context);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    melissa_options_t options;
+    int               ret = 0;
+
+    memset (&options, 0, sizeof(melissa_options_t));
+    options.nb_time_steps  = 5;
+    options.nb_fields      = NB_FIELDS;
+    options.nb_parameters  = 1;
+    options.sampling_size  = NB_SIMU;
+    options.mean_op        = 1;
+    options.variance_op    = 1;
+    options.min_and_max_op = 1;
+
+    options.wire_format = MELISSA_WIRE_DOUBLE;
+    options.wire_codec  = MELISSA_WIRE_NO_CODEC;
+    ret += run_pipeline (&options, "double");
+
+    // decoded by the workers, losslessly
+    options.wire_codec  = MELISSA_WIRE_LZ4;
+    ret += run_pipeline (&options, "lz4");
+
+    return ret;
+}
@@ -0,0 +1,345 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_output.c
+ * @brief Checks that the statistics written by every rank, in one file, in
+ *        one part per rank or in a columnar container, are the gathered ones.
+ * @author Terraz Théophile
+ * @date 2019-04-09
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include "melissa_data.h"
+#include "melissa_output.h"
+#include "melissa_results.h"
+#include "compute_stats.h"
+#include "melissa_utils.h"
+
+#define NB_FILES 7
+
+static const char *statistics[NB_FILES] = {"mean", "variance", "min", "min_id", "max", "max_id", "threshold0.5"};
+
+static char* read_file (const char *file_name,
+                        long int   *size)
+{
+    FILE *f;
+    char *buffer;
+
+    f = fopen (file_name, "rb");
+    if (f == NULL)
+    {
+        *size = -1;
+        return NULL;
+    }
+    fseek (f, 0, SEEK_END);
+    *size = ftell (f);
+    fseek (f, 0, SEEK_SET);
+    buffer = melissa_malloc (*size + 1);
+    if (fread (buffer, 1, *size, f) != (size_t)*size)
+    {
+        *size = -1;
+    }
+    fclose (f);
+    return buffer;
+}
+
+// writes the container with one corruption, 0 if the reader refuses it, or
+// reads it if it is valid
+static int open_corrupted (const char *name,
+                           const char *buffer,
+                           long int    size,
+                           int         valid)
+{
+    melissa_results_t *results;
+    FILE              *f;
+
+    f = fopen ("corrupted.mres", "wb");
+    fwrite (buffer, 1, size, f);
+    fclose (f);
+    results = melissa_results_open ("corrupted.mres");
+    unlink ("corrupted.mres");
+    if (results != NULL)
+    {
+        melissa_results_close (results);
+    }
+    if ((results != NULL) != valid)
+    {
+        fprintf (stdout, "container %s (%s)\n", valid ? "refused" : "not refused", name);
+        return 1;
+    }
+    return 0;
+}
+
+// the reader refuses headers, entries and index whose offsets leave the file
+static int test_corrupted_results (const char *file_name)
+{
+    melissa_results_header_t header;
+    melissa_results_entry_t  entry;
+    int64_t                  offset;
+    char                    *buffer, *copy;
+    long int                 size;
+    int                      ret = 0;
+
+    buffer = read_file (file_name, &size);
+    if (buffer == NULL || size < (long int)sizeof(header))
+    {
+        fprintf (stdout, "can not read %s\n", file_name);
+        return 1;
+    }
+    copy = melissa_malloc (size);
+    memcpy (&header, buffer, sizeof(header));
+
+    memcpy (copy, buffer, size);
+    ((melissa_results_header_t*)copy)->entries = -(int64_t)sizeof(entry);
+    ret += open_corrupted ("negative entries", copy, size, 0);
+
+    memcpy (copy, buffer, size);
+    ((melissa_results_header_t*)copy)->entries = 0;
+    ret += open_corrupted ("entries in the header", copy, size, 0);
+
+    memcpy (copy, buffer, size);
+    ((melissa_results_header_t*)copy)->nb_statistics = INT_MAX;
+    ret += open_corrupted ("too many statistics", copy, size, 0);
+
+    memcpy (copy, buffer, size);
+    ((melissa_results_header_t*)copy)->vect_size = INT64_MAX / 4;
+    ret += open_corrupted ("overflowing vector size", copy, size, 0);
+
+    memcpy (copy, buffer, size);
+    memcpy (&entry, copy + header.entries, sizeof(entry));
+    entry.elem_size = 3;
+    memcpy (copy + header.entries, &entry, sizeof(entry));
+    ret += open_corrupted ("bad value size", copy, size, 0);
+
+    memcpy (copy, buffer, size);
+    offset = INT64_MAX - 8;
+    memcpy (copy + header.index, &offset, sizeof(offset));
+    ret += open_corrupted ("overflowing block offset", copy, size, 0);
+
+    // the same bytes, not corrupted, are read
+    memcpy (copy, buffer, size);
+    ret += open_corrupted ("not corrupted", copy, size, 1);
+
+    melissa_free (copy);
+    melissa_free (buffer);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    melissa_options_t  options;
+    comm_data_t        comm_data;
+    melissa_data_t    *data;
+    double            *vect;
+    double             threshold = 0.5;
+    char               file_name[256];
+    char              *gathered[NB_FILES][2];
+    char              *written;
+    melissa_results_t *results;
+    const double      *mean, *variance;
+    const int32_t     *min_id;
+    double            *local_variance;
+    int                offset = 0;
+    long int           gathered_size[NB_FILES][2], size;
+    int                vect_size;
+    int                i, j, t, k, r;
+    int                ret = 0;
+
+    MPI_Init (&argc, &argv);
+    memset (&options, 0, sizeof(melissa_options_t));
+    options.nb_time_steps  = 2;
+    options.nb_parameters  = 1;
+    options.sampling_size  = 4;
+    options.mean_op        = 1;
+    options.variance_op    = 1;
+    options.min_and_max_op = 1;
+    options.threshold_op   = 1;
+    options.nb_thresholds  = 1;
+    options.threshold      = &threshold;
+    memset (&comm_data, 0, sizeof(comm_data_t));
+    comm_data.client_comm_size = 1;
+    comm_data.comm = MPI_COMM_WORLD;
+    MPI_Comm_rank (MPI_COMM_WORLD, &comm_data.rank);
+    MPI_Comm_size (MPI_COMM_WORLD, &comm_data.comm_size);
+
+    // parts of different sizes, none of them aligned
+    vect_size = 1000 + 337 * comm_data.rank;
+    data = melissa_calloc (1, sizeof(melissa_data_t));
+    melissa_init_data (data, &options, vect_size);
+    vect = melissa_malloc (vect_size * sizeof(double));
+    for (j=0; j<4; j++)
+    {
+        for (t=0; t<options.nb_time_steps; t++)
+        {
+            for (i=0; i<vect_size; i++)
+            {
+                vect[i] = (comm_data.rank + 1) * rand() / (double)RAND_MAX;
+            }
+            compute_stats (data, t, j, 1, &vect);
+        }
+    }
+
+    // gathered on rank 0
+    options.gather_output = INT_MAX;
+    melissa_write_stats_seq (&data, &options, &comm_data, "field");
+    for (k=0; k<NB_FILES; k++)
+    {
+        for (t=0; t<options.nb_time_steps; t++)
+        {
+            gathered[k][t] = NULL;
+            if (comm_data.rank == 0)
+            {
+                // removed, so that a file not written again is not compared with itself
+                sprintf (file_name, "results.field_%s.%d", statistics[k], t+1);
+                gathered[k][t] = read_file (file_name, &gathered_size[k][t]);
+                unlink (file_name);
+            }
+        }
+    }
+    MPI_Barrier (MPI_COMM_WORLD);
+
+    // written by every rank
+    options.gather_output = 0;
+    melissa_write_stats_seq (&data, &options, &comm_data, "field");
+    if (comm_data.rank == 0)
+    {
+        for (k=0; k<NB_FILES; k++)
+        {
+            for (t=0; t<options.nb_time_steps; t++)
+            {
+                sprintf (file_name, "results.field_%s.%d", statistics[k], t+1);
+                written = read_file (file_name, &size);
+                if (gathered_size[k][t] <= 0 || size != gathered_size[k][t] ||
+                    memcmp (written, gathered[k][t], size) != 0)
+                {
+                    fprintf (stdout, "%s differs (%ld bytes, gathered %ld bytes)\n", file_name, size, gathered_size[k][t]);
+                    ret += 1;
+                }
+                melissa_free (written);
+                // removed, so that the reassembled file is not this one
+                unlink (file_name);
+            }
+        }
+    }
+    MPI_Barrier (MPI_COMM_WORLD);
+
+    // one part per rank, written without communication (streamed output),
+    // reassembled at the end of the study
+    for (t=0; t<options.nb_time_steps; t++)
+    {
+        melissa_write_step_parts (data, &options, &comm_data, "field", t);
+    }
+    melissa_merge_step_parts (&options, &comm_data, "field");
+    if (comm_data.rank == 0)
+    {
+        for (k=0; k<NB_FILES; k++)
+        {
+            for (t=0; t<options.nb_time_steps; t++)
+            {
+                sprintf (file_name, "results.field_%s.%d", statistics[k], t+1);
+                written = read_file (file_name, &size);
+                if (size < 0 || size != gathered_size[k][t] || memcmp (written, gathered[k][t], size) != 0)
+                {
+                    fprintf (stdout, "parts of %s differ\n", file_name);
+                    ret += 1;
+                }
+                melissa_free (written);
+                for (r=0; r<comm_data.comm_size; r++)
+                {
+                    sprintf (file_name, "results.field_%s.%d.p%d", statistics[k], t+1, r);
+                    if (access (file_name, F_OK) == 0)
+                    {
+                        fprintf (stdout, "%s not removed\n", file_name);
+                        ret += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    // one container per field, read back by every rank
+    options.columnar_output = 1;
+    melissa_write_stats_seq (&data, &options, &comm_data, "field");
+    options.columnar_output = 0;
+    MPI_Exscan (&vect_size, &offset, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (comm_data.rank == 0)
+    {
+        offset = 0;
+    }
+    local_variance = melissa_malloc (vect_size * sizeof(double));
+    results = melissa_results_open ("results.field.mres");
+    if (results == NULL || results->header->nb_statistics != NB_FILES ||
+        results->header->vect_size != comm_data.comm_size * 1000 + 337 * comm_data.comm_size * (comm_data.comm_size - 1) / 2 ||
+        melissa_results_find (results, "threshold0.5") < 0 ||
+        melissa_results_find (results, "skewness") >= 0 ||
+        melissa_results_get_i (results, "mean", 0) != NULL)
+    {
+        fprintf (stdout, "wrong results.field.mres header\n");
+        ret += 1;
+    }
+    else
+    {
+        for (t=0; t<options.nb_time_steps; t++)
+        {
+            mean     = melissa_results_get_d (results, "mean", t);
+            variance = melissa_results_get_d (results, "variance", t);
+            min_id   = melissa_results_get_i (results, "min_id", t);
+            compute_variance (&data->moments[t], local_variance, vect_size);
+            if (mean == NULL || variance == NULL || min_id == NULL ||
+                (uintptr_t)mean % MELISSA_RESULTS_ALIGN != 0 ||
+                memcmp (&mean[offset], data->moments[t].m1, vect_size * sizeof(double)) != 0 ||
+                memcmp (&variance[offset], local_variance, vect_size * sizeof(double)) != 0 ||
+                memcmp (&min_id[offset], data->min_max[t].min_id, vect_size * sizeof(int)) != 0)
+            {
+                fprintf (stdout, "time step %d of results.field.mres differs on rank %d\n", t, comm_data.rank);
+                ret += 1;
+            }
+        }
+    }
+    if (results != NULL)
+    {
+        melissa_results_close (results);
+    }
+    melissa_free (local_variance);
+    MPI_Allreduce (MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (comm_data.rank == 0)
+    {
+        ret += test_corrupted_results ("results.field.mres");
+        unlink ("results.field.mres");
+    }
+
+    for (k=0; k<NB_FILES; k++)
+    {
+        for (t=0; t<options.nb_time_steps; t++)
+        {
+            melissa_free (gathered[k][t]);
+        }
+    }
+
+    melissa_free_data (data);
+    melissa_free (data);
+    melissa_free (vect);
+    MPI_Finalize ();
+
+    return ret;
+}
@@ -0,0 +1,199 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_quantile.c
+ * @brief Checks the P² quantiles against sorted samples.
+ * @author Terraz Théophile
+ * @date 2019-02-18
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "quantile.h"
+#include "p2_quantile.h"
+#include "melissa_utils.h"
+
+static int compare_doubles (const void *a,
+                            const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// largest distance between the rank of the estimated quantiles and their order
+static double max_rank_error (double     *tableau,
+                              quantile_t *quantiles,
+                              int         nb_quantiles,
+                              int         n,
+                              int         vect_size)
+{
+    int     i, j, k;
+    double  err, max_err = 0;
+    double *sorted = melissa_malloc (n * sizeof(double));
+
+    for (i=0; i<vect_size; i++)
+    {
+        for (j=0; j<n; j++)
+        {
+            sorted[j] = tableau[i + j*vect_size];
+        }
+        qsort (sorted, n, sizeof(double), compare_doubles);
+        for (j=0; j<nb_quantiles; j++)
+        {
+            k = 0;
+            while (k < n && sorted[k] < quantiles[j].quantile[i])
+            {
+                k++;
+            }
+            err = fabs(k / (double)n - quantiles[j].alpha);
+            max_err = (err > max_err) ? err : max_err;
+        }
+    }
+    melissa_free (sorted);
+    return max_err;
+}
+
+int main(int argc, char **argv)
+{
+    double        *tableau = NULL;
+    double         sorted[16];
+    p2_quantile_t  small_p2, my_p2, half_p2[2];
+    quantile_t     my_quantiles[3];
+    double         quantile_orders[3] = {0.95, 0.05, 0.5}; // not sorted
+    int            n_small = 9; // less values than markers
+    int            n = 5000; // n experiences
+    int            vect_size = 100;
+    int            i, j;
+    int            ret = 0;
+    double         index, ref, max_err;
+    FILE          *f;
+
+    tableau = melissa_calloc (n * vect_size, sizeof(double));
+    for (j=0; j<vect_size * n; j++)
+    {
+        tableau[j] = rand() / (double)RAND_MAX * (1000);
+    }
+
+    init_p2_quantile (&small_p2, vect_size, 3, quantile_orders);
+    init_p2_quantile (&my_p2, vect_size, 3, quantile_orders);
+    init_p2_quantile (&half_p2[0], vect_size, 3, quantile_orders);
+    init_p2_quantile (&half_p2[1], vect_size, 3, quantile_orders);
+    for (j=0; j<3; j++)
+    {
+        init_quantile (&my_quantiles[j], vect_size, quantile_orders[j]);
+    }
+    if (my_p2.nb_markers != 9)
+    {
+        fprintf (stdout, "P2 markers failed (%d markers)\n", my_p2.nb_markers);
+        ret = 1;
+    }
+
+    // small samples: the markers are the values, the quantiles are exact
+    for (j=0; j<n_small; j++)
+    {
+        increment_p2_quantile (&small_p2, &tableau[j * vect_size], vect_size);
+    }
+    compute_p2_quantiles (&small_p2, my_quantiles, 3, vect_size);
+    for (i=0; i<vect_size; i++)
+    {
+        for (j=0; j<n_small; j++)
+        {
+            sorted[j] = tableau[i + j*vect_size];
+        }
+        qsort (sorted, n_small, sizeof(double), compare_doubles);
+        for (j=0; j<3; j++)
+        {
+            index = quantile_orders[j] * (n_small - 1);
+            ref = sorted[(int)index] + (sorted[(int)index + 1] - sorted[(int)index]) * (index - (int)index);
+            if (fabs(my_quantiles[j].quantile[i] - ref) > 1e-9)
+            {
+                fprintf (stdout, "small sample quantile failed (P2 = %g, ref = %g, i=%d)\n", my_quantiles[j].quantile[i], ref, i);
+                ret = 1;
+            }
+        }
+    }
+
+    // large samples, with one sketch and with two merged sketches
+    for (j=0; j<n; j++)
+    {
+        increment_p2_quantile (&my_p2, &tableau[j * vect_size], vect_size);
+        increment_p2_quantile (&half_p2[j < n/3 ? 0 : 1], &tableau[j * vect_size], vect_size);
+    }
+    update_p2_quantile (&half_p2[0], &half_p2[1], &half_p2[0], vect_size);
+    if (half_p2[0].increment != n)
+    {
+        fprintf (stdout, "merged P2 increment failed (%d)\n", half_p2[0].increment);
+        ret = 1;
+    }
+
+    compute_p2_quantiles (&my_p2, my_quantiles, 3, vect_size);
+    max_err = max_rank_error (tableau, my_quantiles, 3, n, vect_size);
+    fprintf (stdout, "P2 max rank error: %g\n", max_err);
+    if (max_err > 0.01)
+    {
+        fprintf (stdout, "P2 quantile failed\n");
+        ret = 1;
+    }
+
+    compute_p2_quantiles (&half_p2[0], my_quantiles, 3, vect_size);
+    max_err = max_rank_error (tableau, my_quantiles, 3, n, vect_size);
+    fprintf (stdout, "merged P2 max rank error: %g\n", max_err);
+    if (max_err > 0.02)
+    {
+        fprintf (stdout, "merged P2 quantile failed\n");
+        ret = 1;
+    }
+
+    // a small sketch merged in a large one
+    update_p2_quantile (&small_p2, &my_p2, &small_p2, vect_size);
+    if (small_p2.increment != n + n_small)
+    {
+        fprintf (stdout, "merged small P2 increment failed (%d)\n", small_p2.increment);
+        ret = 1;
+    }
+
+    // checkpoint round trip
+    f = tmpfile ();
+    save_p2_quantile (&my_p2, vect_size, 1, f);
+    rewind (f);
+    read_p2_quantile (&half_p2[1], vect_size, 1, f);
+    fclose (f);
+    if (half_p2[1].increment != my_p2.increment ||
+        memcmp (half_p2[1].height, my_p2.height, vect_size * my_p2.nb_markers * sizeof(double)) != 0 ||
+        memcmp (half_p2[1].position, my_p2.position, vect_size * my_p2.nb_markers * sizeof(int)) != 0)
+    {
+        fprintf (stdout, "P2 save and read failed\n");
+        ret = 1;
+    }
+
+    melissa_free (tableau);
+    free_p2_quantile (&small_p2);
+    free_p2_quantile (&my_p2);
+    free_p2_quantile (&half_p2[0]);
+    free_p2_quantile (&half_p2[1]);
+    for (j=0; j<3; j++)
+    {
+        free_quantile (&my_quantiles[j]);
+    }
+
+    return ret;
+}
@@ -33,41 +33,127 @@
 #include "sobol.h"
 #include "melissa_utils.h"
 
+static int compare_sobol (const char *name,
+                          double     *vect,
+                          double     *ref,
+                          int         vect_size)
+{
+    int i;
+    for (i=0; i<vect_size; i++)
+    {
+        if (fabs(vect[i] - ref[i]) > 1e-9 * (1.0 + fabs(ref[i])))
+        {
+            fprintf (stdout, "%s failed (%d: %g != %g)\n", name, i, vect[i], ref[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     double         *tableau = NULL;
     sobol_array_t   sobol_indices;
+    sobol_array_t   sobol_batch;
     double        **vect_tab;
+    double       ***vect_tabs;
     int             nb_parameters = 3; // number of parameters
     int             n = 1000; // sampling size
     int             vect_size = 10000; // space size
-    int             i, j;
+    int             batch_size = 8; // groups per batch
+    int             i, j, k;
     int             ret = 0;
     double          start_time = 0;
     double          end_time = 0;
+    double          batch_time = 0;
+    double          temp1, temp2, interval;
 
     init_sobol_martinez (&sobol_indices, nb_parameters, vect_size);
-    tableau = melissa_calloc ((nb_parameters+2) * vect_size, sizeof(double));
-    vect_tab = melissa_malloc ((nb_parameters+2) * sizeof(double*));
+    init_sobol_martinez (&sobol_batch, nb_parameters, vect_size);
+    tableau = melissa_calloc (batch_size * (nb_parameters+2) * vect_size, sizeof(double));
+    vect_tab = melissa_malloc (batch_size * (nb_parameters+2) * sizeof(double*));
+    vect_tabs = melissa_malloc (batch_size * sizeof(double**));
 
-    for (j=0; j<n; j++)
+    for (k=0; k<batch_size; k++)
     {
-        for (i=0; i<vect_size * (nb_parameters+2); i++)
+        vect_tabs[k] = &vect_tab[k * (nb_parameters+2)];
+    }
+    for (i=0; i<batch_size * (nb_parameters+2); i++)
+    {
+        vect_tab[i] = &tableau[vect_size * i];
+    }
+
+    for (j=0; j<n; j+=batch_size)
+    {
+        for (i=0; i<batch_size * vect_size * (nb_parameters+2); i++)
         {
             tableau[i] = rand() / (double)RAND_MAX * (1000);
         }
-        for (i=0; i<(nb_parameters+2); i++)
+        start_time = melissa_get_time();
+        for (k=0; k<batch_size; k++)
         {
-            vect_tab[i] = &tableau[vect_size * i];
+            increment_sobol_martinez (&sobol_indices, nb_parameters, vect_tabs[k], vect_size);
         }
-        start_time = melissa_get_time();
-        increment_sobol_martinez (&sobol_indices, nb_parameters, vect_tab, vect_size);
         end_time += melissa_get_time() - start_time;
+        start_time = melissa_get_time();
+        increment_sobol_martinez_batch (&sobol_batch, nb_parameters, vect_tabs, batch_size, vect_size);
+        batch_time += melissa_get_time() - start_time;
     }
     fprintf (stdout, "Sobol time: %g\n", end_time);
+    fprintf (stdout, "Sobol batch time: %g\n", batch_time);
+
+    if (sobol_batch.iteration != sobol_indices.iteration)
+    {
+        fprintf (stdout, "Sobol batch iteration failed\n");
+        ret += 1;
+    }
+    ret += compare_sobol ("variance a", sobol_batch.variance_a.variance, sobol_indices.variance_a.variance, vect_size);
+    ret += compare_sobol ("variance b", sobol_batch.variance_b.variance, sobol_indices.variance_b.variance, vect_size);
+    compute_sobol_martinez_values (&sobol_indices, nb_parameters, vect_size);
+    compute_sobol_martinez_values (&sobol_batch, nb_parameters, vect_size);
+    for (k=0; k<nb_parameters; k++)
+    {
+        ret += compare_sobol ("first order covariance",
+                              sobol_batch.sobol_martinez[k].first_order_covariance,
+                              sobol_indices.sobol_martinez[k].first_order_covariance,
+                              vect_size);
+        ret += compare_sobol ("total order covariance",
+                              sobol_batch.sobol_martinez[k].total_order_covariance,
+                              sobol_indices.sobol_martinez[k].total_order_covariance,
+                              vect_size);
+        ret += compare_sobol ("first order indices",
+                              sobol_batch.sobol_martinez[k].first_order_values,
+                              sobol_indices.sobol_martinez[k].first_order_values,
+                              vect_size);
+        ret += compare_sobol ("total order indices",
+                              sobol_batch.sobol_martinez[k].total_order_values,
+                              sobol_indices.sobol_martinez[k].total_order_values,
+                              vect_size);
+    }
+
+    // worst Fisher interval, element by element
+    temp2 = 1.96/(sqrt(sobol_indices.iteration-3));
+    interval = 0;
+    for (k=0; k<nb_parameters; k++)
+    {
+        for (i=0; i<vect_size; i++)
+        {
+            temp1 = 0.5 * log((1.0+sobol_indices.sobol_martinez[k].first_order_values[i])/(1.0-sobol_indices.sobol_martinez[k].first_order_values[i]));
+            interval = fmax (interval, tanh(temp1 + temp2) - tanh(temp1 - temp2));
+            temp1 = 0.5 * log((2.0-sobol_indices.sobol_martinez[k].total_order_values[i])/sobol_indices.sobol_martinez[k].total_order_values[i]);
+            interval = fmax (interval, (1-tanh(temp1 - temp2)) - (1-tanh(temp1 + temp2)));
+        }
+    }
+    if (fabs(update_confidence_sobol_martinez (&sobol_indices, nb_parameters, vect_size, 0.01) - interval) > 1e-12)
+    {
+        fprintf (stdout, "Sobol confidence interval failed (%g != %g)\n", sobol_indices.interval, interval);
+        ret += 1;
+    }
 
+    melissa_free(vect_tabs);
     melissa_free(vect_tab);
     melissa_free(tableau);
+    free_sobol_martinez (&sobol_batch, nb_parameters);
     free_sobol_martinez (&sobol_indices, nb_parameters);
 
     return ret;
@@ -0,0 +1,279 @@
+/******************************************************************
+*                            Melissa                              *
+*-----------------------------------------------------------------*
+*   COPYRIGHT (C) 2017  by INRIA and EDF. ALL RIGHTS RESERVED.    *
+*                                                                 *
+* This source is covered by the BSD 3-Clause License.             *
+* Refer to the  LICENCE file for further information.             *
+*                                                                 *
+*-----------------------------------------------------------------*
+*  Original Contributors:                                         *
+*    Theophile Terraz,                                            *
+*    Bruno Raffin,                                                *
+*    Alejandro Ribes,                                             *
+*    Bertrand Iooss,                                              *
+******************************************************************/
+
+/**
+ *
+ * @file test_wire.c
+ * @brief Checks the formats and codecs of the simulation data messages.
+ * @author Terraz Théophile
+ * @date 2019-04-29
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "melissa_messages.h"
+#include "melissa_utils.h"
+
+// relative error of a round trip, the values being decoded in dest
+static int check_round_trip (const char   *name,
+                             const double *src,
+                             int           nb_values,
+                             int           wire_format,
+                             double        tolerance)
+{
+    int     i;
+    int     ret = 0;
+    void   *wire;
+    double *dest;
+
+    wire = malloc (nb_values * melissa_wire_size (wire_format));
+    dest = malloc (nb_values * sizeof(double));
+    melissa_wire_encode (src, nb_values, wire_format, wire);
+    melissa_wire_decode (wire, nb_values, wire_format, dest);
+    for (i=0; i<nb_values; i++)
+    {
+        if (fabs (dest[i] - src[i]) > tolerance * fabs (src[i]))
+        {
+            fprintf (stdout, "%s: value %d failed (%g != %g)\n", name, i, dest[i], src[i]);
+            ret = 1;
+            break;
+        }
+    }
+    free (wire);
+    free (dest);
+    return ret;
+}
+
+// packs the vectors in a data message and unpacks them as the server does,
+// returns the largest absolute error, -1 if the message can not be unpacked
+static double pack_unpack (double        **vectors,
+                           int             nb_vect,
+                           int             vect_size,
+                           melissa_wire_t *client,
+                           melissa_wire_t *server,
+                           size_t         *msg_size)
+{
+    int        i, k;
+    int        time_stamp, simu_id, client_rank, recv_vect_size;
+    double    *data, *decoded;
+    double     error = 0.0;
+    char       field_name[MAX_FIELD_NAME] = "heat";
+    char      *field_name_ptr;
+    zmq_msg_t  msg;
+
+    message_simu_data (&msg, 7, 3, 1, vect_size, nb_vect, field_name, vectors, client);
+    *msg_size = zmq_msg_size (&msg);
+    read_message_simu_data ((char*)zmq_msg_data (&msg), &time_stamp, &simu_id,
+                            &client_rank, &recv_vect_size, &field_name_ptr, &data);
+    decoded = malloc (nb_vect * vect_size * sizeof(double));
+    if (recv_vect_size != vect_size ||
+        melissa_wire_check ((char*)data, *msg_size - ((char*)data - (char*)zmq_msg_data (&msg)),
+                            nb_vect, vect_size, server) != 0 ||
+        melissa_wire_unpack ((char*)data, *msg_size - ((char*)data - (char*)zmq_msg_data (&msg)),
+                             nb_vect, vect_size, server, decoded) != 0)
+    {
+        error = -1.0;
+    }
+    for (k=0; k<nb_vect && error >= 0; k++)
+    {
+        for (i=0; i<vect_size; i++)
+        {
+            if (fabs (decoded[k * vect_size + i] - vectors[k][i]) > error)
+            {
+                error = fabs (decoded[k * vect_size + i] - vectors[k][i]);
+            }
+        }
+    }
+    free (decoded);
+    zmq_msg_close (&msg);
+    return error;
+}
+
+int main(int argc, char **argv)
+{
+    int             nb_values = 10000;
+    int             nb_vect = 3;
+    int             i, k;
+    int             ret = 0;
+    double         *values, *noise, *vectors[3], result[4];
+    double          special[4];
+    double          error;
+    uint16_t        bf16;
+    uint64_t        bits;
+    size_t          msg_size, header_size = 4 * sizeof(int) + MAX_FIELD_NAME;
+    size_t          payload_size;
+    char            field_name[MAX_FIELD_NAME] = "heat";
+    char           *payload, *corrupted;
+    zmq_msg_t       msg;
+    melissa_wire_t  client, server;
+
+    values = malloc (nb_values * sizeof(double));
+    for (i=0; i<nb_values; i++)
+    {
+        values[i] = (i % 2 == 0 ? 1.0 : -1.0) * exp ((i % 200 - 100) * 0.3) * (1.0 + i * 1e-4);
+    }
+
+    if (melissa_wire_size (MELISSA_WIRE_DOUBLE) != 8 ||
+        melissa_wire_size (MELISSA_WIRE_FLOAT) != 4 ||
+        melissa_wire_size (MELISSA_WIRE_BFLOAT16) != 2)
+    {
+        fprintf (stdout, "wire sizes failed\n");
+        ret += 1;
+    }
+
+    // half an ulp of the mantissa: 24 bits for float, 8 bits for bfloat16
+    ret += check_round_trip ("double", values, nb_values, MELISSA_WIRE_DOUBLE, 0.0);
+    ret += check_round_trip ("float32", values, nb_values, MELISSA_WIRE_FLOAT, 6e-8);
+    ret += check_round_trip ("bfloat16", values, nb_values, MELISSA_WIRE_BFLOAT16, 4e-3);
+
+    // 1 + 2^-8 is halfway between two bfloat16, rounded to the even 1.0,
+    // 1 + 3*2^-8 is rounded to the even 1 + 2^-6
+    special[0] = 1.0 + 1.0 / 256;
+    special[1] = 1.0 + 3.0 / 256;
+    special[2] = INFINITY;
+    special[3] = NAN;
+    for (i=0; i<4; i++)
+    {
+        melissa_wire_encode (&special[i], 1, MELISSA_WIRE_BFLOAT16, &bf16);
+        melissa_wire_decode (&bf16, 1, MELISSA_WIRE_BFLOAT16, &result[i]);
+    }
+    if (result[0] != 1.0 || result[1] != 1.0 + 4.0 / 256 ||
+        !isinf (result[2]) || !isnan (result[3]))
+    {
+        fprintf (stdout, "bfloat16 rounding failed (%g %g %g %g)\n", result[0], result[1], result[2], result[3]);
+        ret += 1;
+    }
+
+    // Sobol group messages of a smooth field
+    for (i=0; i<nb_values; i++)
+    {
+        values[i] = 300.0 + 20.0 * sin (i * 0.001);
+    }
+    for (k=0; k<nb_vect; k++)
+    {
+        vectors[k] = &values[k * 1000];
+    }
+
+    melissa_wire_init (&client, MELISSA_WIRE_FLOAT, MELISSA_WIRE_NO_CODEC, 0.0);
+    melissa_wire_init (&server, MELISSA_WIRE_FLOAT, MELISSA_WIRE_NO_CODEC, 0.0);
+    error = pack_unpack (vectors, nb_vect, 1000, &client, &server, &msg_size);
+    if (error < 0 || error > 320.0 * 6e-8 || msg_size != header_size + nb_vect * 1000 * sizeof(float))
+    {
+        fprintf (stdout, "float32 message failed (error %g, size %zu)\n", error, msg_size);
+        ret += 1;
+    }
+    melissa_wire_free (&client);
+    melissa_wire_free (&server);
+
+    // lossless: the same values, in fewer bytes
+    melissa_wire_init (&client, MELISSA_WIRE_DOUBLE, MELISSA_WIRE_LZ4, 0.0);
+    melissa_wire_init (&server, MELISSA_WIRE_DOUBLE, MELISSA_WIRE_LZ4, 0.0);
+    error = pack_unpack (vectors, nb_vect, 1000, &client, &server, &msg_size);
+    if (error != 0.0 || msg_size >= header_size + nb_vect * 1000 * sizeof(double) ||
+        client.raw_bytes != server.raw_bytes || client.packed_bytes != server.packed_bytes)
+    {
+        fprintf (stdout, "lz4 message failed (error %g, size %zu)\n", error, msg_size);
+        ret += 1;
+    }
+
+    // incompressible values are sent as they are
+    noise = malloc (1000 * sizeof(double));
+    srand (1);
+    for (i=0; i<1000; i++)
+    {
+        // random bits, the highest bit of the exponent cleared to stay finite
+        bits = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+        bits &= ~((uint64_t)1 << 62);
+        memcpy (&noise[i], &bits, sizeof(double));
+    }
+    error = pack_unpack (&noise, 1, 1000, &client, &server, &msg_size);
+    if (error != 0.0 || msg_size != header_size + 2 * sizeof(int32_t) + 1000 * sizeof(double))
+    {
+        fprintf (stdout, "incompressible message failed (error %g, size %zu)\n", error, msg_size);
+        ret += 1;
+    }
+    melissa_wire_free (&client);
+    melissa_wire_free (&server);
+
+    // lossy: every value within the tolerance, much smaller than lz4
+    melissa_wire_init (&client, MELISSA_WIRE_DOUBLE, MELISSA_WIRE_QUANTIZE, 1e-3);
+    melissa_wire_init (&server, MELISSA_WIRE_DOUBLE, MELISSA_WIRE_QUANTIZE, 1e-3);
+    error = pack_unpack (vectors, nb_vect, 1000, &client, &server, &msg_size);
+    if (error < 0 || error > 1e-3 * (1.0 + 1e-9) || msg_size * 4 > header_size + nb_vect * 1000 * sizeof(double))
+    {
+        fprintf (stdout, "quantize message failed (error %g, size %zu)\n", error, msg_size);
+        ret += 1;
+    }
+
+    // values that can not be quantized fall back to lz4, losslessly
+    vectors[0][10] = NAN;
+    vectors[0][11] = 0.0;
+    error = pack_unpack (vectors, 1, 1000, &client, &server, &msg_size);
+    vectors[0][10] = 0.0;
+    if (error != 0.0)
+    {
+        fprintf (stdout, "quantize fallback failed (error %g)\n", error);
+        ret += 1;
+    }
+    melissa_wire_free (&client);
+    melissa_wire_free (&server);
+
+    // truncated and corrupted payloads are detected, by the check as by the decoding
+    melissa_wire_init (&client, MELISSA_WIRE_DOUBLE, MELISSA_WIRE_LZ4, 0.0);
+    memset (special, 0xff, sizeof(special));
+    if (melissa_wire_unpack ((char*)special, 4, 1, 1000, &client, values) != -1 ||
+        melissa_wire_unpack ((char*)special, sizeof(special), 1, 1000, &client, values) != -1 ||
+        melissa_wire_check ((char*)special, 4, 1, 1000, &client) != -1 ||
+        melissa_wire_check ((char*)special, sizeof(special), 1, 1000, &client) != -1)
+    {
+        fprintf (stdout, "corrupted payload not detected\n");
+        ret += 1;
+    }
+
+    // the check accepts exactly the payloads that can be decoded
+    message_simu_data (&msg, 7, 3, 1, 1000, 1, field_name, vectors, &client);
+    payload = (char*)zmq_msg_data (&msg) + header_size;
+    payload_size = zmq_msg_size (&msg) - header_size;
+    corrupted = malloc (payload_size);
+    for (k=0; k<1000; k++)
+    {
+        memcpy (corrupted, payload, payload_size);
+        corrupted[2 * sizeof(int32_t) + rand() % (payload_size - 2 * sizeof(int32_t))] ^= (char)(1 << (rand() % 8));
+        if ((melissa_wire_check (corrupted, payload_size, 1, 1000, &client) == 0) !=
+            (melissa_wire_unpack (corrupted, payload_size, 1, 1000, &client, values) == 0))
+        {
+            fprintf (stdout, "check and decoding disagree (corruption %d)\n", k);
+            ret += 1;
+            break;
+        }
+    }
+    if (melissa_wire_check (payload, payload_size - 1, 1, 1000, &client) != -1)
+    {
+        fprintf (stdout, "truncated payload not detected\n");
+        ret += 1;
+    }
+    free (corrupted);
+    zmq_msg_close (&msg);
+    melissa_wire_free (&client);
+
+    free (noise);
+    free (values);
+    return ret;
+}